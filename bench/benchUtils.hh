@@ -0,0 +1,67 @@
+#pragma once
+#include <glib.h>
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+#include <chrono>
+#include <string>
+
+#include "element.hh"
+#include "pipeline.hh"
+
+namespace bench {
+
+inline double cpu_time_ms() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  auto to_ms = [](const timeval& tv) {
+    return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+  };
+  return to_ms(usage.ru_utime) + to_ms(usage.ru_stime);
+}
+
+struct Measure {
+  double wall_ms{0};
+  double cpu_ms{0};
+};
+
+class Stopwatch {
+ public:
+  Stopwatch() { reset(); }
+
+  void reset() {
+    wallStart = std::chrono::steady_clock::now();
+    cpuStart = cpu_time_ms();
+  }
+
+  Measure elapsed() const {
+    std::chrono::duration<double, std::milli> wall =
+        std::chrono::steady_clock::now() - wallStart;
+    return {wall.count(), cpu_time_ms() - cpuStart};
+  }
+
+ private:
+  std::chrono::steady_clock::time_point wallStart;
+  double cpuStart{0};
+};
+
+// pipeline quits the loop on EOS or error
+inline Measure run_until_eos(vptyp::Pipeline& pipeline, GMainLoop* loop) {
+  Stopwatch watch;
+  pipeline.play();
+  g_main_loop_run(loop);
+  auto result = watch.elapsed();
+  pipeline.stop();
+  return result;
+}
+
+inline vptyp::Element make_capsfilter(std::string_view alias,
+                                      const std::string& description) {
+  vptyp::Element filter("capsfilter", alias);
+  GstCaps* caps = gst_caps_from_string(description.c_str());
+  filter.object_set("caps", caps);
+  gst_caps_unref(caps);
+  return filter;
+}
+
+}  // namespace bench
@@ -0,0 +1,101 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "benchUtils.hh"
+#include "histogram.hh"
+#include "pipelineGraph.hh"
+
+DEFINE_int32(posters, 4, "threads posting messages, like streaming threads");
+DEFINE_int32(messages, 50000, "messages posted by every thread");
+DEFINE_int32(tick_ms, 1, "interval of the loop responsiveness timer");
+
+namespace {
+
+// how late the loop runs a periodic timer while the bus is flooded
+struct Ticks {
+  vptyp::Histogram lateness;  // us
+  gint64 expected{0};
+  gint64 interval{0};
+};
+
+gboolean tick(gpointer data) {
+  auto ticks = static_cast<Ticks*>(data);
+  gint64 now = g_get_monotonic_time();
+  if (ticks->expected) {
+    ticks->lateness.record(std::max<gint64>(0, now - ticks->expected));
+  }
+  ticks->expected = now + ticks->interval;
+  return G_SOURCE_CONTINUE;
+}
+
+void measure(GMainLoop* loop, vptyp::Pipeline::BusDispatch dispatch,
+             std::string_view mode) {
+  vptyp::Pipeline pipeline(*loop, "bus-bench");
+  // live and idle, so the streaming thread doesn't compete for cpu
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc is-live=true ! fakesink");
+  if (!graph || !graph->build(pipeline)) LOG(FATAL) << "cannot build";
+  pipeline.dispatch_bus(dispatch);
+
+  const int total = FLAGS_posters * FLAGS_messages;
+  std::atomic<int> delivered{0};
+  pipeline.subscribe(GST_MESSAGE_APPLICATION, [&](GstMessage*) {
+    if (++delivered == total) {
+      gst_element_post_message(pipeline.raw(),
+                               gst_message_new_eos(GST_OBJECT(pipeline.raw())));
+    }
+  });
+
+  Ticks ticks{.interval = FLAGS_tick_ms * 1000};
+  guint timer = g_timeout_add(FLAGS_tick_ms, tick, &ticks);
+
+  bench::Stopwatch watch;
+  std::vector<std::thread> posters;
+  for (int i = 0; i < FLAGS_posters; ++i) {
+    posters.emplace_back([&pipeline]() {
+      for (int m = 0; m < FLAGS_messages; ++m) {
+        gst_element_post_message(
+            pipeline.raw(),
+            gst_message_new_application(GST_OBJECT(pipeline.raw()),
+                                        gst_structure_new_empty("bench")));
+      }
+    });
+  }
+  auto elapsed = bench::run_until_eos(pipeline, loop);
+  auto wall = watch.elapsed().wall_ms;
+  for (auto& poster : posters) poster.join();
+  g_source_remove(timer);
+
+  auto lateness = ticks.lateness.snapshot();
+  std::cout << std::format(
+                   "{:<6} {} messages in {:.0f}ms: {:.0f} msg/s, cpu {:.0f}ms; "
+                   "loop timer late us p50: {} p99: {} max: {}",
+                   mode, delivered.load(), wall, delivered / wall * 1000,
+                   elapsed.cpu_ms, lateness.percentile(0.5),
+                   lateness.percentile(0.99), lateness.max)
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+  measure(loop, vptyp::Pipeline::BusDispatch::Loop, "loop");
+  measure(loop, vptyp::Pipeline::BusDispatch::Worker, "worker");
+  g_main_loop_unref(loop);
+  return 0;
+}
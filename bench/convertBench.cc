@@ -0,0 +1,172 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "benchUtils.hh"
+#include "colorKernels.hh"
+#include "gstppPlugin.hh"
+#include "pipelineGraph.hh"
+
+DEFINE_int32(frames, 300, "frames per pipeline run and kernel measurement");
+DEFINE_int32(width, 1920, "frame width");
+DEFINE_int32(height, 1080, "frame height");
+DEFINE_int32(threads, 4, "slices per frame for the threaded runs");
+
+namespace {
+
+using vptyp::color::Isa;
+using vptyp::color::PixelFormat;
+
+struct Pair {
+  PixelFormat in;
+  PixelFormat out;
+};
+
+constexpr Pair kPairs[] = {{PixelFormat::NV12, PixelFormat::BGRx},
+                           {PixelFormat::I420, PixelFormat::RGBA},
+                           {PixelFormat::RGBA, PixelFormat::I420},
+                           {PixelFormat::BGRx, PixelFormat::NV12},
+                           {PixelFormat::NV12, PixelFormat::I420},
+                           {PixelFormat::RGBA, PixelFormat::BGRx}};
+
+// one contiguous frame with tight strides
+struct Frame {
+  Frame(PixelFormat format, int width, int height) {
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    image = {.format = format, .width = width, .height = height};
+    switch (format) {
+      case PixelFormat::NV12:
+        data.assign(size_t(width) * height + 2 * chromaWidth * chromaHeight,
+                    128);
+        image.planes[0] = {data.data(), width};
+        image.planes[1] = {data.data() + size_t(width) * height,
+                           2 * chromaWidth};
+        break;
+      case PixelFormat::I420:
+        data.assign(size_t(width) * height + 2 * chromaWidth * chromaHeight,
+                    128);
+        image.planes[0] = {data.data(), width};
+        image.planes[1] = {data.data() + size_t(width) * height, chromaWidth};
+        image.planes[2] = {image.planes[1].data + chromaWidth * chromaHeight,
+                           chromaWidth};
+        break;
+      default:
+        data.assign(size_t(width) * height * 4, 128);
+        image.planes[0] = {data.data(), 4 * width};
+    }
+  }
+
+  vptyp::color::Image image;
+  std::vector<uint8_t> data;
+};
+
+double kernel_ms(const Pair& pair, Isa isa, vptyp::color::SlicePool* pool) {
+  Frame in(pair.in, FLAGS_width, FLAGS_height);
+  Frame out(pair.out, FLAGS_width, FLAGS_height);
+  vptyp::color::convert(in.image, out.image, isa, pool);  // warm up
+  bench::Stopwatch watch;
+  for (int i = 0; i < FLAGS_frames; ++i) {
+    vptyp::color::convert(in.image, out.image, isa, pool);
+  }
+  return watch.elapsed().wall_ms / FLAGS_frames;
+}
+
+void run_kernels() {
+  std::vector<Isa> isas{Isa::Scalar};
+  if (vptyp::color::detect_isa() >= Isa::SSE41) isas.push_back(Isa::SSE41);
+  if (vptyp::color::detect_isa() >= Isa::AVX2) isas.push_back(Isa::AVX2);
+  vptyp::color::SlicePool pool(std::max(FLAGS_threads, 1) - 1);
+
+  std::cout << std::format("kernels, {}x{}, ms per frame", FLAGS_width,
+                           FLAGS_height)
+            << std::endl;
+  for (const auto& pair : kPairs) {
+    std::string line =
+        std::format("{:>4} -> {:<4}", vptyp::color::format_name(pair.in),
+                    vptyp::color::format_name(pair.out));
+    double scalar{0};
+    for (auto isa : isas) {
+      double ms = kernel_ms(pair, isa, nullptr);
+      if (isa == Isa::Scalar) scalar = ms;
+      line += std::format("  {}: {:>6.3f} (x{:.1f})",
+                          vptyp::color::isa_name(isa), ms, scalar / ms);
+    }
+    double sliced = kernel_ms(pair, isas.back(), &pool);
+    line += std::format("  {} threads: {:>6.3f} (x{:.1f})", pool.size(),
+                        sliced, scalar / sliced);
+    std::cout << line << std::endl;
+  }
+}
+
+bench::Measure run_pipeline(GMainLoop* loop, std::string_view converter,
+                            const Pair& pair) {
+  auto caps = [](PixelFormat format) {
+    return std::format("video/x-raw,format={},width={},height={}",
+                       vptyp::color::format_name(format), FLAGS_width,
+                       FLAGS_height);
+  };
+  std::string description = std::format(
+      "videotestsrc num-buffers={} ! {} ! ", FLAGS_frames, caps(pair.in));
+  if (!converter.empty()) {
+    description += std::format("{} n-threads={} ! {} ! ", converter,
+                               FLAGS_threads, caps(pair.out));
+  }
+  description += "fakesink";
+
+  vptyp::Pipeline pipeline(*loop, converter.empty() ? "source" : converter);
+  auto graph = vptyp::PipelineGraph::parse(description);
+  if (!graph || !graph->build(pipeline)) {
+    LOG(FATAL) << std::format("cannot build {}", description);
+  }
+  return bench::run_until_eos(pipeline, loop);
+}
+
+void report(std::string_view name, const bench::Measure& m,
+            const bench::Measure& source) {
+  double fps = FLAGS_frames / (m.wall_ms / 1e3);
+  std::cout << std::format("  {:<13} wall: {:>9.2f} ms  cpu: {:>9.2f} ms  "
+                           "fps: {:>8.1f}  convert cpu/frame: {:>6.3f} ms",
+                           name, m.wall_ms, m.cpu_ms, fps,
+                           (m.cpu_ms - source.cpu_ms) / FLAGS_frames)
+            << std::endl;
+}
+
+void run_pipelines(GMainLoop* loop) {
+  std::cout << std::format("pipelines, {} frames, {} threads", FLAGS_frames,
+                           FLAGS_threads)
+            << std::endl;
+  for (const auto& pair : kPairs) {
+    std::cout << std::format("{} -> {}", vptyp::color::format_name(pair.in),
+                             vptyp::color::format_name(pair.out))
+              << std::endl;
+    // the test source alone, subtracted from the converter cpu time
+    auto source = run_pipeline(loop, "", pair);
+    report("videoconvert", run_pipeline(loop, "videoconvert", pair), source);
+    report("gstppconvert", run_pipeline(loop, "gstppconvert", pair), source);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+  vptyp::register_elements();
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+
+  std::cout << std::format("cpu: {}",
+                           vptyp::color::isa_name(vptyp::color::detect_isa()))
+            << std::endl;
+  run_kernels();
+  run_pipelines(loop);
+
+  g_main_loop_unref(loop);
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <format>
+#include <iostream>
+
+#include "benchUtils.hh"
+#include "frameTap.hh"
+
+DEFINE_int32(frames, 600, "number of frames pushed through each pipeline");
+DEFINE_int32(width, 1920, "frame width");
+DEFINE_int32(height, 1080, "frame height");
+DEFINE_string(format, "I420", "raw video format produced by the source");
+
+namespace {
+
+std::string caps_description() {
+  return std::format("video/x-raw,format={},width={},height={},framerate=60/1",
+                     FLAGS_format, FLAGS_width, FLAGS_height);
+}
+
+vptyp::Element make_source() {
+  vptyp::Element src("videotestsrc", "src");
+  src.object_set("num-buffers", FLAGS_frames);
+  return src;
+}
+
+vptyp::Element make_filesink() {
+  vptyp::Element sink("filesink", "sink");
+  sink.object_set("location", "/dev/null");
+  return sink;
+}
+
+// videotestsrc ! caps ! videoconvert ! filesink
+bench::Measure run_baseline(GMainLoop* loop) {
+  vptyp::Pipeline pipeline(*loop, "baseline");
+  auto src = make_source();
+  auto caps = bench::make_capsfilter("caps", caps_description());
+  auto convert = vptyp::Element("videoconvert", "convert");
+  auto sink = make_filesink();
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  pipeline.add_element(convert);
+  pipeline.add_element(sink);
+  src.link(caps);
+  caps.link(convert);
+  convert.link(sink);
+
+  return bench::run_until_eos(pipeline, loop);
+}
+
+// videotestsrc ! caps ! [appsink -> C++ -> appsrc] ! videoconvert ! filesink
+bench::Measure run_tap(GMainLoop* loop, uint64_t& checksum) {
+  vptyp::Pipeline pipeline(*loop, "frame-tap");
+  auto src = make_source();
+  auto caps = bench::make_capsfilter("caps", caps_description());
+  vptyp::FrameTap tap("tap");
+  auto convert = vptyp::Element("videoconvert", "convert");
+  auto sink = make_filesink();
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  tap.attach(pipeline);
+  pipeline.add_element(convert);
+  pipeline.add_element(sink);
+  src.link(caps);
+  caps.link(tap.sink());
+  tap.source().link(convert);
+  convert.link(sink);
+
+  tap.on_frame([&tap, &checksum](vptyp::Frame& frame) {
+    // touch one byte per page, enough to fault the mapping in
+    for (gsize i = 0; i < frame.size(); i += 4096) checksum += frame.data()[i];
+    tap.push(std::move(frame));
+  });
+
+  return bench::run_until_eos(pipeline, loop);
+}
+
+void report(std::string_view name, const bench::Measure& m) {
+  double fps = FLAGS_frames / (m.wall_ms / 1e3);
+  std::cout << std::format("{:<10} wall: {:>9.2f} ms  cpu: {:>9.2f} ms  "
+                           "fps: {:>8.1f}",
+                           name, m.wall_ms, m.cpu_ms, fps)
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+
+  std::cout << std::format("{} frames of {}", FLAGS_frames, caps_description())
+            << std::endl;
+  report("baseline", run_baseline(loop));
+
+  uint64_t checksum{0};
+  report("frame-tap", run_tap(loop, checksum));
+  LOG(INFO) << "checksum: " << checksum;
+
+  g_main_loop_unref(loop);
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchUtils.hh"
+#include "pipelineManager.hh"
+
+DEFINE_int32(streams, 32, "number of concurrent videotestsrc pipelines");
+DEFINE_int32(shards, 0, "worker loops, 0 - one per hardware thread");
+DEFINE_int32(seconds, 10, "measurement duration");
+DEFINE_int32(ping_ms, 10, "interval of latency probes posted on every bus");
+
+namespace {
+
+constexpr const char* kPing = "bench-ping";
+
+class LatencyRecorder {
+ public:
+  void record(gint64 us) {
+    std::lock_guard lock(guard);
+    samples.push_back(us);
+  }
+
+  void report() {
+    std::lock_guard lock(guard);
+    if (samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    auto at = [this](double q) {
+      return samples[std::min(samples.size() - 1,
+                              size_t(q * samples.size()))];
+    };
+    std::cout << std::format(
+                     "bus latency us  p50: {}  p99: {}  max: {}  samples: {}",
+                     at(0.5), at(0.99), samples.back(), samples.size())
+              << std::endl;
+  }
+
+ private:
+  std::mutex guard;
+  std::vector<gint64> samples;
+};
+
+void build_stream(vptyp::Pipeline& pipeline, LatencyRecorder& latency) {
+  vptyp::Element src("videotestsrc", "src");
+  src.object_set("is-live", TRUE);
+  auto caps = bench::make_capsfilter(
+      "caps", "video/x-raw,format=I420,width=640,height=360,framerate=30/1");
+  vptyp::Element sink("fakesink", "sink");
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  pipeline.add_element(sink);
+  src.link(caps);
+  caps.link(sink);
+
+  pipeline.add_bus_observer([&latency](GstMessage* msg) {
+    if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_APPLICATION) return;
+    const GstStructure* s = gst_message_get_structure(msg);
+    if (!gst_structure_has_name(s, kPing)) return;
+    gint64 sent{0};
+    gst_structure_get_int64(s, "sent", &sent);
+    latency.record(g_get_monotonic_time() - sent);
+  });
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  LatencyRecorder latency;
+  vptyp::PipelineManager manager(
+      {.shards = unsigned(FLAGS_shards), .pin_threads = true});
+
+  std::vector<vptyp::Pipeline*> pipelines;
+  for (int i = 0; i < FLAGS_streams; ++i) {
+    pipelines.push_back(&manager.add(
+        std::format("stream-{}", i),
+        [&latency](vptyp::Pipeline& p) { build_stream(p, latency); }));
+  }
+
+  bench::Stopwatch watch;
+  manager.play_all();
+
+  std::atomic<bool> running{true};
+  std::thread pinger([&]() {
+    while (running) {
+      for (auto pipeline : pipelines) {
+        auto s = gst_structure_new(kPing, "sent", G_TYPE_INT64,
+                                   g_get_monotonic_time(), nullptr);
+        gst_element_post_message(
+            pipeline->raw(),
+            gst_message_new_application(GST_OBJECT(pipeline->raw()), s));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_ping_ms));
+    }
+  });
+
+  std::this_thread::sleep_for(std::chrono::seconds(FLAGS_seconds));
+  running = false;
+  pinger.join();
+  auto measure = watch.elapsed();
+  auto status = manager.status();
+  manager.stop_all();
+
+  double cpuPercent = measure.cpu_ms / measure.wall_ms * 100.0;
+  std::cout << std::format("{} streams on {} shards, {} playing",
+                           status.pipelines, manager.shard_count(),
+                           status.playing)
+            << std::endl;
+  std::cout << std::format("cpu total: {:.1f}%  per stream: {:.2f}%",
+                           cpuPercent, cpuPercent / FLAGS_streams)
+            << std::endl;
+  latency.report();
+  return 0;
+}
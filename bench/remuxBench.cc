@@ -0,0 +1,91 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <filesystem>
+#include <format>
+#include <iostream>
+
+#include "benchUtils.hh"
+#include "mediaProbe.hh"
+#include "pipelineGraph.hh"
+#include "webPlayer.hh"
+
+DEFINE_int32(frames, 900, "number of frames in the generated input");
+DEFINE_int32(width, 1280, "frame width");
+DEFINE_int32(height, 720, "frame height");
+DEFINE_string(input, "", "H.264 mp4 to use instead of a generated one");
+
+namespace {
+
+bench::Measure run_description(GMainLoop* loop, std::string_view name,
+                               const std::string& description) {
+  vptyp::Pipeline pipeline(*loop, name);
+  auto graph = vptyp::PipelineGraph::parse(description);
+  if (!graph || !graph->build(pipeline)) {
+    LOG(FATAL) << std::format("cannot build {}", description);
+  }
+  return bench::run_until_eos(pipeline, loop);
+}
+
+void report(std::string_view name, const bench::Measure& m) {
+  std::cout << std::format("{:<10} wall: {:>9.2f} ms  cpu: {:>9.2f} ms", name,
+                           m.wall_ms, m.cpu_ms)
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+  auto tmp = std::filesystem::temp_directory_path();
+  std::string input = FLAGS_input;
+  if (input.empty()) {
+    input = (tmp / "gstpp-remux-bench-input.mp4").string();
+    run_description(
+        loop, "generate",
+        std::format("videotestsrc num-buffers={} ! "
+                    "video/x-raw,width={},height={},framerate=30/1 ! "
+                    "x264enc ! mp4mux ! filesink location={}",
+                    FLAGS_frames, FLAGS_width, FLAGS_height, input));
+  }
+
+  bench::Stopwatch watch;
+  auto info = vptyp::probe_media(input, std::chrono::seconds(10));
+  auto probe = watch.elapsed();
+  if (!info || !info->video()) LOG(FATAL) << "no video in " << input;
+  bool remuxable = vptyp::caps_compatible(
+      *info->video(), vptyp::WebToFilePlayer::kRemuxTarget);
+  std::cout << std::format("{}\nremuxable: {}", *info->video(), remuxable)
+            << std::endl;
+  report("probe", probe);
+
+  auto output = (tmp / "gstpp-remux-bench-output.mp4").string();
+  auto transcode = run_description(
+      loop, "transcode",
+      std::format("filesrc location={} ! qtdemux ! h264parse ! avdec_h264 ! "
+                  "videoconvert ! x264enc ! mp4mux ! filesink location={}",
+                  input, output));
+  report("transcode", transcode);
+
+  auto remux = run_description(
+      loop, "remux",
+      std::format("filesrc location={} ! qtdemux ! h264parse ! mp4mux ! "
+                  "filesink location={}",
+                  input, output));
+  report("remux", remux);
+  std::cout << std::format("speedup wall: {:.1f}x  cpu: {:.1f}x",
+                           transcode.wall_ms / remux.wall_ms,
+                           transcode.cpu_ms / remux.cpu_ms)
+            << std::endl;
+
+  std::filesystem::remove(output);
+  if (FLAGS_input.empty()) std::filesystem::remove(input);
+  g_main_loop_unref(loop);
+  return 0;
+}
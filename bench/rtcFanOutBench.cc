@@ -0,0 +1,139 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "baseRtcPlayer.hh"
+#include "benchUtils.hh"
+
+// needs a signalling server, e.g. gst-webrtc-signalling-server from
+// gst-plugins-rs listening on the uri below, and gst-launch-1.0 in PATH
+DEFINE_string(signalling, "ws://127.0.0.1:8443", "signalling server uri");
+DEFINE_int32(consumers, 8, "headless consumers to connect");
+DEFINE_int32(warmup, 5, "seconds to let every consumer negotiate");
+DEFINE_int32(seconds, 20, "measured streaming time");
+DEFINE_string(codec, "vp8", "video codec of every encoder");
+DEFINE_string(ladder, "default", "renditions of the shared mode");
+
+namespace {
+
+class CountedPlayer : public vptyp::BaseRTCPlayer {
+ public:
+  using BaseRTCPlayer::BaseRTCPlayer;
+
+  size_t encoder_count() {
+    std::lock_guard lock(encoders_guard);
+    return encoders.size();
+  }
+};
+
+// every consumer is its own process, so the sender cpu time taken from
+// RUSAGE_SELF does not include the decoding side
+std::vector<GPid> spawn_consumers(int count) {
+  std::vector<GPid> consumers;
+  std::string uri = std::format("signaller::uri={}", FLAGS_signalling);
+  for (int i = 0; i < count; ++i) {
+    const gchar* argv[] = {"gst-launch-1.0",
+                           "-q",
+                           "webrtcsrc",
+                           uri.c_str(),
+                           "connect-to-first-producer=true",
+                           "!",
+                           "fakesink",
+                           nullptr};
+    GPid pid{};
+    GError* error{nullptr};
+    if (!g_spawn_async(nullptr, const_cast<gchar**>(argv), nullptr,
+                       GSpawnFlags(G_SPAWN_SEARCH_PATH |
+                                   G_SPAWN_DO_NOT_REAP_CHILD),
+                       nullptr, nullptr, &pid, &error)) {
+      LOG(ERROR) << std::format("cannot spawn a consumer: {}",
+                                error->message);
+      g_error_free(error);
+      break;
+    }
+    consumers.push_back(pid);
+  }
+  return consumers;
+}
+
+void stop_consumers(const std::vector<GPid>& consumers) {
+  for (GPid pid : consumers) {
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    g_spawn_close_pid(pid);
+  }
+}
+
+void run_for(GMainLoop* loop, int seconds) {
+  g_timeout_add_seconds(
+      seconds,
+      +[](gpointer data) {
+        g_main_loop_quit(static_cast<GMainLoop*>(data));
+        return gboolean(G_SOURCE_REMOVE);
+      },
+      loop);
+  g_main_loop_run(loop);
+}
+
+void measure(GMainLoop* loop, std::string_view mode,
+             const vptyp::BaseRTCPlayer::Options& options) {
+  CountedPlayer sender(*loop, FLAGS_signalling, options);
+  sender.create();
+  sender.play();
+  auto consumers = spawn_consumers(FLAGS_consumers);
+  run_for(loop, FLAGS_warmup);
+
+  bench::Stopwatch watch;
+  run_for(loop, FLAGS_seconds);
+  auto elapsed = watch.elapsed();
+  auto encoders = sender.encoder_count();
+  stop_consumers(consumers);
+  sender.stop();
+
+  std::cout << std::format(
+                   "{:<9} consumers: {}  encoders: {}  sender cpu: {:.0f}% "
+                   "({:.0f}ms in {:.1f}s)",
+                   mode, consumers.size(), encoders,
+                   elapsed.cpu_ms / elapsed.wall_ms * 100, elapsed.cpu_ms,
+                   elapsed.wall_ms / 1000)
+            << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  auto ladder =
+      FLAGS_ladder == "default"
+          ? std::optional(vptyp::BaseRTCPlayer::default_ladder())
+          : vptyp::BaseRTCPlayer::parse_ladder(FLAGS_ladder);
+  if (!ladder) LOG(FATAL) << "bad rendition ladder " << FLAGS_ladder;
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+  vptyp::BaseRTCPlayer::Options options;
+  options.pattern = 0;  // smpte bars keep the encoders busy
+  options.codec = FLAGS_codec;
+  options.bitrate_gauges = true;
+  measure(loop, "per-peer", options);
+
+  // connect-to-first-producer puts every consumer on the same rendition,
+  // the others are encoded regardless of having viewers
+  options.renditions = *ladder;
+  measure(loop, "shared", options);
+
+  g_main_loop_unref(loop);
+  return 0;
+}
@@ -0,0 +1,245 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+#include "baseRtcPlayer.hh"
+#include "benchUtils.hh"
+#include "histogram.hh"
+#include "pipelineGraph.hh"
+
+// needs a signalling server, e.g. gst-webrtc-signalling-server from
+// gst-plugins-rs listening on the uri below
+DEFINE_string(signalling, "ws://127.0.0.1:8443", "signalling server uri");
+DEFINE_int32(seconds, 20, "measured streaming time");
+DEFINE_bool(low_latency, true, "use the low latency profile");
+DEFINE_string(codec, "vp8", "video codec, empty lets webrtcsink pick");
+
+namespace {
+
+// the send time is drawn into the top luma rows as 32 black or white
+// blocks, coarse enough to survive the encoder
+constexpr int kBits = 32;
+constexpr int kBlockWidth = 8;
+constexpr int kBlockHeight = 16;
+
+uint32_t now_ms() {
+  return uint32_t(std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+bool stampable(const GstVideoInfo& info) {
+  return GST_VIDEO_INFO_IS_YUV(&info) &&
+         GST_VIDEO_INFO_COMP_DEPTH(&info, 0) == 8 &&
+         GST_VIDEO_INFO_WIDTH(&info) >= kBits * kBlockWidth &&
+         GST_VIDEO_INFO_HEIGHT(&info) >= kBlockHeight;
+}
+
+bool negotiated(GstPad* pad, GstVideoInfo& video) {
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  if (!caps) return false;
+  bool parsed = gst_video_info_from_caps(&video, caps);
+  gst_caps_unref(caps);
+  return parsed && stampable(video);
+}
+
+GstPadProbeReturn stamp(GstPad* pad, GstPadProbeInfo* info, gpointer) {
+  GstVideoInfo video;
+  if (!negotiated(pad, video)) return GST_PAD_PROBE_OK;
+  GstBuffer* buffer =
+      gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+  GST_PAD_PROBE_INFO_DATA(info) = buffer;
+  GstVideoFrame frame;
+  if (!gst_video_frame_map(&frame, &video, buffer, GST_MAP_WRITE)) {
+    return GST_PAD_PROBE_OK;
+  }
+  auto luma = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0));
+  int stride = GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0);
+  uint32_t sent = now_ms();
+  for (int y = 0; y < kBlockHeight; ++y) {
+    for (int bit = 0; bit < kBits; ++bit) {
+      uint8_t value = (sent >> bit) & 1 ? 235 : 16;
+      std::fill_n(luma + y * stride + bit * kBlockWidth, kBlockWidth, value);
+    }
+  }
+  gst_video_frame_unmap(&frame);
+  return GST_PAD_PROBE_OK;
+}
+
+// reads the centre of every block back
+bool read_stamp(const uint8_t* luma, int stride, uint32_t& sent) {
+  sent = 0;
+  for (int bit = 0; bit < kBits; ++bit) {
+    int sum{0};
+    for (int y = 4; y < kBlockHeight - 4; ++y) {
+      for (int x = 2; x < kBlockWidth - 2; ++x) {
+        sum += luma[y * stride + bit * kBlockWidth + x];
+      }
+    }
+    int mean = sum / ((kBlockHeight - 8) * (kBlockWidth - 4));
+    // grey means the stamp did not survive
+    if (mean > 80 && mean < 170) return false;
+    if (mean >= 170) sent |= uint32_t(1) << bit;
+  }
+  return true;
+}
+
+struct Receiver {
+  vptyp::Histogram latency;  // ms
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> unreadable{0};
+};
+
+GstPadProbeReturn measure(GstPad* pad, GstPadProbeInfo* info, gpointer data) {
+  auto receiver = static_cast<Receiver*>(data);
+  GstVideoInfo video;
+  if (!negotiated(pad, video)) return GST_PAD_PROBE_OK;
+  GstVideoFrame frame;
+  if (!gst_video_frame_map(&frame, &video, GST_PAD_PROBE_INFO_BUFFER(info),
+                           GST_MAP_READ)) {
+    return GST_PAD_PROBE_OK;
+  }
+  uint32_t sent{0};
+  bool readable = read_stamp(
+      static_cast<const uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, 0)),
+      GST_VIDEO_FRAME_PLANE_STRIDE(&frame, 0), sent);
+  gst_video_frame_unmap(&frame);
+
+  ++receiver->frames;
+  uint32_t elapsed = now_ms() - sent;
+  // a bit flip gives nonsense rather than grey
+  if (!readable || elapsed > 10'000) {
+    ++receiver->unreadable;
+  } else {
+    receiver->latency.record(elapsed);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+// stamps frames at the source and samples the encoder bitrate gauges
+class StampedPlayer : public vptyp::BaseRTCPlayer {
+ public:
+  using BaseRTCPlayer::BaseRTCPlayer;
+
+  void create() override {
+    BaseRTCPlayer::create();
+    auto pad = vptyp::make_gst(
+        gst_element_get_static_pad(pipeline.find("src")->raw(), "src"));
+    gst_pad_add_probe(pad.get(), GST_PAD_PROBE_TYPE_BUFFER, stamp, nullptr,
+                      nullptr);
+  }
+
+  double bitrate_bps() {
+    std::lock_guard lock(encoders_guard);
+    double sum{0};
+    for (auto& watch : encoders) sum += watch.bitrate->value();
+    return sum;
+  }
+};
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+  auto options = FLAGS_low_latency
+                     ? vptyp::BaseRTCPlayer::low_latency_profile()
+                     : vptyp::BaseRTCPlayer::Options{};
+  options.pattern = 0;  // smpte bars keep the encoder busy
+  options.codec = FLAGS_codec;
+  options.bitrate_gauges = true;
+  StampedPlayer sender(*loop, FLAGS_signalling, options);
+  sender.create();
+
+  // the consumer side lives in the same process, so both ends share the
+  // steady clock the stamps are taken from
+  vptyp::Pipeline receiver(*loop, "rtc-receiver");
+  auto graph = vptyp::PipelineGraph::parse(std::format(
+      "webrtcsrc name=src signaller::uri={} connect-to-first-producer=true ! "
+      "videoconvert ! video/x-raw,format=I420 ! fakesink name=sink sync=true",
+      FLAGS_signalling));
+  if (!graph || !graph->build(receiver)) {
+    LOG(FATAL) << "cannot build the receiver, is gst-plugins-rs installed?";
+  }
+  Receiver measured;
+  auto sinkPad = vptyp::make_gst(
+      gst_element_get_static_pad(receiver.find("sink")->raw(), "sink"));
+  gst_pad_add_probe(sinkPad.get(), GST_PAD_PROBE_TYPE_BUFFER, measure,
+                    &measured, nullptr);
+
+  std::vector<double> bitrates;
+  struct Sampling {
+    StampedPlayer& sender;
+    std::vector<double>& bitrates;
+  } sampling{sender, bitrates};
+  g_timeout_add(
+      1000,
+      +[](gpointer data) {
+        auto s = static_cast<Sampling*>(data);
+        if (double bps = s->sender.bitrate_bps()) s->bitrates.push_back(bps);
+        return gboolean(G_SOURCE_CONTINUE);
+      },
+      &sampling);
+  g_timeout_add_seconds(
+      FLAGS_seconds,
+      +[](gpointer data) {
+        g_main_loop_quit(static_cast<GMainLoop*>(data));
+        return gboolean(G_SOURCE_REMOVE);
+      },
+      loop);
+
+  bench::Stopwatch watch;
+  sender.play();
+  receiver.play();
+  g_main_loop_run(loop);
+  auto elapsed = watch.elapsed();
+  receiver.stop();
+  sender.stop();
+
+  auto latency = measured.latency.snapshot();
+  std::cout << std::format(
+                   "frames: {} ({} unreadable) in {:.1f}s, cpu {:.0f}ms",
+                   measured.frames.load(), measured.unreadable.load(),
+                   elapsed.wall_ms / 1000, elapsed.cpu_ms)
+            << std::endl;
+  std::cout << std::format(
+                   "glass to glass ms  mean: {:.1f}  p50: {}  p95: {}  "
+                   "p99: {}  max: {}",
+                   latency.mean(), latency.percentile(0.5),
+                   latency.percentile(0.95), latency.percentile(0.99),
+                   latency.max)
+            << std::endl;
+
+  if (!bitrates.empty()) {
+    double mean = std::accumulate(bitrates.begin(), bitrates.end(), 0.0) /
+                  bitrates.size();
+    double variance{0};
+    for (double bps : bitrates) variance += (bps - mean) * (bps - mean);
+    double deviation = std::sqrt(variance / bitrates.size());
+    std::cout << std::format(
+                     "encoder kbit/s  mean: {:.0f}  stddev: {:.0f}  "
+                     "variation: {:.1f}%  samples: {}",
+                     mean / 1000, deviation / 1000,
+                     mean ? deviation / mean * 100 : 0, bitrates.size())
+              << std::endl;
+  }
+
+  g_main_loop_unref(loop);
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <gflags/gflags.h>
+#include <glib.h>
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <atomic>
+#include <format>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "benchUtils.hh"
+#include "pipelineGraph.hh"
+#include "pipelinePool.hh"
+
+DEFINE_string(graph,
+              "videotestsrc ! video/x-raw,width=1280,height=720 ! "
+              "videoconvert ! videoscale ! video/x-raw,width=640,height=360 ! "
+              "fakesink name=sink",
+              "stream template, its sink has to be a fakesink named sink");
+DEFINE_int32(requests, 20, "stream starts measured per mode");
+DEFINE_int32(pool, 2, "pre-rolled pipelines kept by the pool");
+
+namespace {
+
+// resolves with the first rendered buffer, preroll does not count
+class FirstFrame {
+ public:
+  explicit FirstFrame(vptyp::Pipeline& pipeline) {
+    auto sink = pipeline.find("sink");
+    if (!sink) LOG(FATAL) << "the graph has no element named sink";
+    sink->object_set("signal-handoffs", TRUE);
+    g_signal_connect(sink->raw(), "handoff", G_CALLBACK(handoff), this);
+  }
+
+  bool wait() {
+    return rendered.get_future().wait_for(std::chrono::seconds(10)) ==
+           std::future_status::ready;
+  }
+
+ private:
+  static void handoff(GstElement*, GstBuffer*, GstPad*, gpointer data) {
+    auto that = static_cast<FirstFrame*>(data);
+    if (!that->seen.exchange(true)) that->rendered.set_value();
+  }
+
+  std::atomic<bool> seen{false};
+  std::promise<void> rendered;
+};
+
+double start(vptyp::Pipeline& pipeline, bench::Stopwatch& watch) {
+  FirstFrame first(pipeline);
+  pipeline.play();
+  if (!first.wait()) LOG(FATAL) << "no frame within 10s";
+  double ms = watch.elapsed().wall_ms;
+  pipeline.stop();
+  g_signal_handlers_disconnect_by_data(pipeline.find("sink")->raw(), &first);
+  return ms;
+}
+
+void report(std::string_view mode, std::vector<double> samples) {
+  if (samples.empty()) return;
+  std::sort(samples.begin(), samples.end());
+  double mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                samples.size();
+  std::cout << std::format(
+                   "{:<14} time to first frame ms  mean: {:.2f}  p50: {:.2f}  "
+                   "max: {:.2f}  samples: {}",
+                   mode, mean, samples[samples.size() / 2], samples.back(),
+                   samples.size())
+            << std::endl;
+}
+
+// cold requests parse and build the graph, then go from NULL to PLAYING
+std::vector<double> run_cold(GMainLoop* loop) {
+  std::vector<double> samples;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    bench::Stopwatch watch;
+    vptyp::Pipeline pipeline(*loop, std::format("cold-{}", i));
+    auto graph = vptyp::PipelineGraph::parse(FLAGS_graph);
+    if (!graph || !graph->build(pipeline)) LOG(FATAL) << "cannot build";
+    samples.push_back(start(pipeline, watch));
+  }
+  return samples;
+}
+
+// warm requests take a pre-rolled pipeline, the pool refills in between
+std::vector<double> run_warm(GMainLoop* loop) {
+  vptyp::PipelinePool pool(
+      *loop, {.per_template = static_cast<size_t>(FLAGS_pool)});
+  pool.add_template("bench", FLAGS_graph);
+  std::vector<double> samples;
+  for (int i = 0; i < FLAGS_requests; ++i) {
+    while (pool.status("bench").warm == 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    bench::Stopwatch watch;
+    auto pipeline = pool.acquire("bench");
+    if (!pipeline) LOG(FATAL) << "pool failed to build";
+    samples.push_back(start(*pipeline, watch));
+  }
+  auto status = pool.status("bench");
+  std::cout << std::format("pool hits: {} misses: {}", status.hits,
+                           status.misses)
+            << std::endl;
+  return samples;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  gst_init(&argc, &argv);
+  if (FLAGS_requests < 1) LOG(FATAL) << "at least one request is needed";
+
+  GMainLoop* loop = g_main_loop_new(nullptr, false);
+  std::thread bus([loop]() { g_main_loop_run(loop); });
+
+  // the first build also loads plugins and fills the element factory cache
+  auto cold = run_cold(loop);
+  report("first build", {cold.front()});
+  report("cold", {cold.begin() + 1, cold.end()});
+  report("warm pool", run_warm(loop));
+
+  g_main_loop_quit(loop);
+  bus.join();
+  g_main_loop_unref(loop);
+  return 0;
+}
@@ -0,0 +1,306 @@
+#include "asyncFileWriter.hh"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+#ifdef GSTPP_HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+
+namespace vptyp {
+
+namespace {
+
+constexpr size_t kAlignment = AsyncFileWriter::kAlignment;
+// user data of the no-op that stops the io_uring reaper
+constexpr uintptr_t kStopReaper = UINTPTR_MAX;
+
+size_t align_up(size_t value) {
+  return (value + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+// bytes written or -errno, short only when the device takes no more
+ssize_t write_all(int fd, const uint8_t* data, size_t size, uint64_t offset) {
+  size_t done{0};
+  while (done < size) {
+    ssize_t n = pwrite(fd, data + done, size - done, off_t(offset + done));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) return -errno;
+    if (n == 0) break;
+    done += size_t(n);
+  }
+  return ssize_t(done);
+}
+
+}  // namespace
+
+void AsyncFileWriter::Free::operator()(uint8_t* data) const {
+  std::free(data);
+}
+
+void AsyncFileWriter::RingDeleter::operator()(io_uring* ring) const {
+#ifdef GSTPP_HAVE_LIBURING
+  io_uring_queue_exit(ring);
+  delete ring;
+#endif
+}
+
+std::unique_ptr<AsyncFileWriter> AsyncFileWriter::open(
+    std::string_view path, const Options& options) {
+  std::string location(path);
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  if (options.sync) flags |= O_DSYNC;
+  int fd = ::open(location.c_str(), flags, 0644);
+  if (fd < 0) {
+    LOG(ERROR) << std::format("cannot open {}: {}", location,
+                              std::strerror(errno));
+    return nullptr;
+  }
+  int direct_fd = fd;
+  if (options.direct) {
+    direct_fd = ::open(location.c_str(), (flags & ~O_TRUNC) | O_DIRECT);
+    if (direct_fd < 0) {
+      // tmpfs and a few others refuse O_DIRECT
+      LOG(WARNING) << std::format("{} written without O_DIRECT: {}",
+                                  location, std::strerror(errno));
+      direct_fd = fd;
+    }
+  }
+  // the constructor is not public, so no make_unique
+  return std::unique_ptr<AsyncFileWriter>(
+      new AsyncFileWriter(options, fd, direct_fd));
+}
+
+AsyncFileWriter::AsyncFileWriter(const Options& options, int fd,
+                                 int direct_fd)
+    : options(options), fd(fd), direct_fd(direct_fd) {
+  this->options.batch_bytes =
+      align_up(std::max<size_t>(options.batch_bytes, 1));
+  this->options.depth = std::max<size_t>(options.depth, 1);
+  // one buffer fills while the others are in flight
+  for (size_t i = 0; i <= this->options.depth; ++i) {
+    buffers.emplace_back(static_cast<uint8_t*>(
+        std::aligned_alloc(kAlignment, this->options.batch_bytes)));
+    if (i) free_buffers.push_back(i);
+  }
+  submitted.resize(buffers.size());
+  if (options.uring && start_uring()) {
+    mode = Backend::IoUring;
+    return;
+  }
+  for (size_t i = 0; i < std::max<size_t>(options.threads, 1); ++i) {
+    workers.emplace_back(&AsyncFileWriter::run_worker, this);
+  }
+}
+
+AsyncFileWriter::~AsyncFileWriter() { close(); }
+
+bool AsyncFileWriter::start_uring() {
+#ifdef GSTPP_HAVE_LIBURING
+  auto created = new io_uring{};
+  int result = io_uring_queue_init(unsigned(options.depth), created, 0);
+  if (result < 0) {
+    // old kernels, seccomp profiles and io_uring_disabled
+    LOG(WARNING) << std::format("io_uring unavailable ({}), writing from "
+                                "a thread pool",
+                                std::strerror(-result));
+    delete created;
+    return false;
+  }
+  ring.reset(created);
+  // completions are taken as they arrive, so latency ends there and
+  // buffers come back right away
+  workers.emplace_back(&AsyncFileWriter::run_reaper, this);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool AsyncFileWriter::write(const uint8_t* data, size_t size) {
+  while (size) {
+    size_t chunk = std::min(capacity() - filling.size, size);
+    std::memcpy(buffers[filling.buffer].get() + filling.size, data, chunk);
+    filling.size += chunk;
+    cursor += chunk;
+    data += chunk;
+    size -= chunk;
+    if (filling.size == capacity() && !submit()) return false;
+  }
+  return true;
+}
+
+bool AsyncFileWriter::seek(uint64_t offset) {
+  if (offset == cursor) return true;
+  bool ok = submit();
+  // a rewrite must not race the batch it overwrites
+  drain();
+  filling.offset = cursor = offset;
+  return ok;
+}
+
+bool AsyncFileWriter::flush() {
+  bool ok = submit();
+  drain();
+  std::lock_guard lock(guard);
+  return ok && !failed;
+}
+
+bool AsyncFileWriter::close() {
+  if (fd < 0) return true;
+  bool ok = flush();
+  {
+    std::lock_guard lock(guard);
+    stopping = true;
+  }
+  queued.notify_all();
+#ifdef GSTPP_HAVE_LIBURING
+  if (ring) {
+    // nothing is in flight after the flush, the no-op completes last
+    io_uring_sqe* sqe = io_uring_get_sqe(ring.get());
+    io_uring_prep_nop(sqe);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(kStopReaper));
+    io_uring_submit(ring.get());
+  }
+#endif
+  for (auto& worker : workers) worker.join();
+  workers.clear();
+  ring.reset();
+  if (direct_fd != fd) ::close(direct_fd);
+  ok = ::close(fd) == 0 && ok;
+  fd = direct_fd = -1;
+  return ok;
+}
+
+uint64_t AsyncFileWriter::position() const { return cursor; }
+
+AsyncFileWriter::Backend AsyncFileWriter::backend() const { return mode; }
+
+AsyncFileWriter::Stats AsyncFileWriter::stats() const {
+  return {bytes.load(), batches.load(), latency.snapshot()};
+}
+
+size_t AsyncFileWriter::capacity() const {
+  return options.batch_bytes - filling.offset % kAlignment;
+}
+
+int AsyncFileWriter::target(const Batch& batch) const {
+  bool aligned = batch.offset % kAlignment == 0 && batch.size % kAlignment == 0;
+  return aligned ? direct_fd : fd;
+}
+
+bool AsyncFileWriter::submit() {
+  if (filling.size) {
+    Batch batch = filling;
+    batch.submitted = std::chrono::steady_clock::now();
+    {
+      std::lock_guard lock(guard);
+      ++in_flight;
+      if (mode == Backend::Threads) pending.push_back(batch);
+    }
+    if (mode == Backend::Threads) {
+      queued.notify_one();
+    } else {
+#ifdef GSTPP_HAVE_LIBURING
+      // the ring has an entry per buffer that can be in flight
+      io_uring_sqe* sqe = io_uring_get_sqe(ring.get());
+      io_uring_prep_write(sqe, target(batch), buffers[batch.buffer].get(),
+                          unsigned(batch.size), batch.offset);
+      io_uring_sqe_set_data(sqe,
+                            reinterpret_cast<void*>(uintptr_t(batch.buffer)));
+      submitted[batch.buffer] = batch;
+      int result = io_uring_submit(ring.get());
+      if (result < 0) complete(batch, result);
+#endif
+    }
+    filling = {.buffer = take_buffer(), .size = 0, .offset = cursor};
+  }
+  std::lock_guard lock(guard);
+  return !failed;
+}
+
+size_t AsyncFileWriter::take_buffer() {
+  std::unique_lock lock(guard);
+  completed.wait(lock, [this]() { return !free_buffers.empty(); });
+  size_t buffer = free_buffers.back();
+  free_buffers.pop_back();
+  return buffer;
+}
+
+void AsyncFileWriter::complete(const Batch& batch, ssize_t written) {
+  if (written >= 0 && size_t(written) < batch.size) {
+    // the rest synchronously, it fails too if the disk is full
+    ssize_t rest = write_all(fd, buffers[batch.buffer].get() + written,
+                             batch.size - written, batch.offset + written);
+    written = rest < 0 ? rest : written + rest;
+  }
+  uint64_t took = std::chrono::duration_cast<std::chrono::microseconds>(
+                      std::chrono::steady_clock::now() - batch.submitted)
+                      .count();
+  latency.record(took);
+  if (options.latency) options.latency->record(took);
+
+  std::lock_guard lock(guard);
+  if (written < 0 || size_t(written) != batch.size) {
+    if (!failed) {
+      LOG(ERROR) << std::format("write of {} bytes at {} failed: {}",
+                                batch.size, batch.offset,
+                                std::strerror(written < 0 ? -written : ENOSPC));
+    }
+    failed = true;
+  } else {
+    bytes += batch.size;
+    ++batches;
+  }
+  free_buffers.push_back(batch.buffer);
+  --in_flight;
+  completed.notify_all();
+}
+
+void AsyncFileWriter::run_reaper() {
+#ifdef GSTPP_HAVE_LIBURING
+  while (true) {
+    io_uring_cqe* cqe{nullptr};
+    int result = io_uring_wait_cqe(ring.get(), &cqe);
+    if (result == -EINTR) continue;
+    if (result < 0) {
+      LOG(ERROR) << std::format("io_uring completions lost: {}",
+                                std::strerror(-result));
+      return;
+    }
+    auto data = reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe));
+    ssize_t written = cqe->res;
+    io_uring_cqe_seen(ring.get(), cqe);
+    if (data == kStopReaper) return;
+    complete(submitted[size_t(data)], written);
+  }
+#endif
+}
+
+void AsyncFileWriter::drain() {
+  std::unique_lock lock(guard);
+  completed.wait(lock, [this]() { return in_flight == 0; });
+}
+
+void AsyncFileWriter::run_worker() {
+  std::unique_lock lock(guard);
+  while (true) {
+    queued.wait(lock, [this]() { return stopping || !pending.empty(); });
+    // batches still queued are written before stopping
+    if (pending.empty()) return;
+    Batch batch = pending.front();
+    pending.pop_front();
+    lock.unlock();
+    complete(batch, write_all(target(batch), buffers[batch.buffer].get(),
+                              batch.size, batch.offset));
+    lock.lock();
+  }
+}
+
+}  // namespace vptyp
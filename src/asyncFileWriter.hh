@@ -0,0 +1,132 @@
+#pragma once
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "histogram.hh"
+
+struct io_uring;
+
+namespace vptyp {
+
+// Collects small writes into large aligned batches and writes those in the
+// background, so a slow disk holds the caller back only once every batch
+// buffer is in flight. Batches are submitted through io_uring when the
+// kernel allows it, otherwise a small thread pool pwrite()s them. Direct
+// opens the file O_DIRECT; batches that do not start and end aligned, like
+// the tail or bytes rewritten after a seek, take a buffered descriptor.
+// One thread writes, stats() may be read from any.
+class AsyncFileWriter {
+ public:
+  static constexpr size_t kAlignment = 4096;
+
+  enum class Backend { IoUring, Threads };
+
+  struct Options {
+    size_t batch_bytes{1 << 20};  // rounded up to kAlignment
+    size_t depth{4};  // batches in flight at most
+    size_t threads{2};  // thread pool backend
+    bool direct{false};  // bypass the page cache
+    bool sync{false};  // O_DSYNC, a completed batch is on stable storage
+    bool uring{true};  // false - thread pool even where io_uring works
+    Histogram* latency{nullptr};  // also recorded here, us
+  };
+
+  struct Stats {
+    uint64_t bytes{0};  // written so far
+    uint64_t batches{0};
+    Histogram::Snapshot latency{};  // submission to completion, us
+  };
+
+  // nullptr if the file cannot be created
+  static std::unique_ptr<AsyncFileWriter> open(std::string_view path,
+                                               const Options& options);
+  AsyncFileWriter(const AsyncFileWriter&) = delete;
+  AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+  ~AsyncFileWriter();
+
+  // false once a write failed, the error is logged
+  bool write(const uint8_t* data, size_t size);
+  // the next write lands at offset, after every batch in flight completed
+  bool seek(uint64_t offset);
+  // submits the partial batch and waits until everything is written
+  bool flush();
+  // flush() and closes the file, further calls are no-ops
+  bool close();
+
+  uint64_t position() const;
+  Backend backend() const;
+  Stats stats() const;
+
+ protected:
+  struct Batch {
+    size_t buffer{0};  // index into buffers
+    size_t size{0};
+    uint64_t offset{0};
+    std::chrono::steady_clock::time_point submitted{};
+  };
+
+  struct Free {
+    void operator()(uint8_t* data) const;
+  };
+
+  struct RingDeleter {
+    void operator()(io_uring* ring) const;
+  };
+
+  AsyncFileWriter(const Options& options, int fd, int direct_fd);
+  bool start_uring();
+  // hands the filling batch to the backend and takes the next free buffer
+  bool submit();
+  // blocks for a free buffer
+  size_t take_buffer();
+  void complete(const Batch& batch, ssize_t written);
+  // io_uring completions until the stop no-op
+  void run_reaper();
+  // until nothing is in flight
+  void drain();
+  void run_worker();
+  // room of the filling batch, so the next one starts aligned
+  size_t capacity() const;
+  // direct descriptor for aligned batches, the buffered one otherwise
+  int target(const Batch& batch) const;
+
+ protected:
+  Options options;
+  int fd{-1};
+  int direct_fd{-1};  // O_DIRECT, fd without direct
+  Backend mode{Backend::Threads};
+  std::vector<std::unique_ptr<uint8_t, Free>> buffers;
+  Batch filling{};
+  std::atomic<uint64_t> cursor{0};  // file offset of the next byte written
+
+  mutable std::mutex guard;
+  std::condition_variable completed;
+  std::condition_variable queued;
+  std::vector<size_t> free_buffers;  // under guard
+  std::deque<Batch> pending;  // under guard, thread pool only
+  // by buffer, io_uring only; written before submission, read on
+  // completion
+  std::vector<Batch> submitted;
+  size_t in_flight{0};  // under guard
+  bool failed{false};  // under guard
+  bool stopping{false};  // under guard
+  std::vector<std::thread> workers;  // thread pool or the io_uring reaper
+  std::unique_ptr<io_uring, RingDeleter> ring;
+
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> batches{0};
+  Histogram latency;
+};
+
+}  // namespace vptyp
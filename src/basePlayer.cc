@@ -5,36 +5,77 @@
 
 #include <format>
 
-#include "element.hh"
+#include "flags.hh"
+#include "pipelineGraph.hh"
 namespace vptyp {
+bool BasePlayer::drain(std::chrono::milliseconds) { return false; }
+
+bool BasePlayer::restart() { return false; }
+
+void BasePlayer::instrument(Pipeline& pipeline) {
+  const auto& flags = get_flags();
+  if (flags.metrics_port || !flags.metrics_file.empty()) {
+    pipeline.enable_metrics();
+  }
+  if (flags.profile.empty()) return;
+
+  pipeline.enable_profiling(
+      {.interval = std::chrono::milliseconds(flags.profile_interval_ms),
+       .output = flags.profile == "-" ? "" : flags.profile});
+}
+
+std::string_view BasePlayer::converter() {
+  if (get_flags().fast_convert) {
+    if (auto factory = gst_element_factory_find("gstppconvert")) {
+      gst_object_unref(factory);
+      return "gstppconvert";
+    }
+  }
+  return "videoconvert";
+}
+
+std::string BasePlayer::source_uri(std::string_view source) {
+  std::string path(source);
+  if (gst_uri_is_valid(path.c_str())) return path;
+  GError* error{nullptr};
+  gchar* uri = gst_filename_to_uri(path.c_str(), &error);
+  if (!uri) {
+    LOG(ERROR) << std::format("{} is not a valid source: {}", path,
+                              error->message);
+    g_error_free(error);
+    return path;
+  }
+  std::string result(uri);
+  g_free(uri);
+  return result;
+}
+
 VideoPlayback::VideoPlayback(GMainLoop& loop, std::string_view file)
     : BasePlayer(), file(file), loop(loop), pipeline(loop, "video-playback") {}
 
 void VideoPlayback::play() { pipeline.play(); }
 void VideoPlayback::stop() { pipeline.stop(); }
 
+bool VideoPlayback::drain(std::chrono::milliseconds timeout) {
+  return pipeline.drain(timeout);
+}
+
+bool VideoPlayback::restart() { return pipeline.restart(); }
+
 void VideoPlayback::create() {
   LOG(INFO) << std::format("location: {}", file.data());
 
-  Element filesrc = Element("filesrc", "filesrc");
-  filesrc.object_set("location", file.data());
-  pipeline.add_element(filesrc);
-  auto decodeBin = Element("decodebin", "decodebin");
-  pipeline.add_element(decodeBin);
-  auto converter = Element("videoconvert", "converter");
-  pipeline.add_element(converter);
-  auto videosink = Element("autovideosink", "video-output");
-  pipeline.add_element(videosink);
-
-  std::list<Element> elements;
-  elements.push_back(std::move(decodeBin));
-  elements.push_back(std::move(converter));
-  elements.push_back(std::move(videosink));
-  auto res = filesrc.link(elements.begin(), elements.end());
-
-  if (!res) {
+  PipelineGraph graph;
+  graph.add("filesrc", "filesrc")
+      .set("location", file)
+      .then("decodebin", "decodebin")
+      .then(converter(), "converter")
+      .then("autovideosink", "video-output");
+
+  if (!graph.build(pipeline)) {
     LOG(ERROR) << std::format("Linkage failed");
   }
+  instrument(pipeline);
 }
 
 }  // namespace vptyp
\ No newline at end of file
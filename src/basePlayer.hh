@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+
 #include "glib.h"
 #include "pipeline.hh"
 namespace vptyp {
@@ -11,6 +13,19 @@ class BasePlayer {
   virtual void create() = 0;
   virtual void play() = 0;
   virtual void stop() = 0;
+  // EOS through the pipeline so muxers finish their files before stop();
+  // the loop quits when it is through. False - nothing to drain, quit now
+  virtual bool drain(std::chrono::milliseconds timeout);
+  // plays from the start again with the pipeline already built
+  virtual bool restart();
+
+ protected:
+  // enables pipeline profiling and metrics when requested by flags
+  static void instrument(Pipeline& pipeline);
+  // colorspace converter factory, gstppconvert when enabled and registered
+  static std::string_view converter();
+  // uri as is, local paths converted to file:// uris
+  static std::string source_uri(std::string_view source);
 };
 
 class VideoPlayback : public BasePlayer {
@@ -21,6 +36,8 @@ class VideoPlayback : public BasePlayer {
   void create() override;
   void play() override;
   void stop() override;
+  bool drain(std::chrono::milliseconds timeout) override;
+  bool restart() override;
 
  protected:
   std::string file;
@@ -2,39 +2,408 @@
 
 #include <glog/logging.h>
 
-#include "src/pipeline.hh"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <format>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "flags.hh"
 
 namespace vptyp {
 
+namespace {
+
+constexpr guint kBitrateSampleMs = 1000;
+
+std::string_view factory_name(GstElement* element) {
+  GstElementFactory* factory = gst_element_get_factory(element);
+  return factory ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory))
+                 : "";
+}
+
+// low latency settings per encoder, gst-launch serialised values
+struct EncoderTuning {
+  std::string_view factory;
+  std::vector<std::pair<const char*, const char*>> settings;
+  const char* keyframe_property;
+};
+
+const std::vector<EncoderTuning>& encoder_tunings() {
+  static const std::vector<EncoderTuning> tunings{
+      {"x264enc",
+       {{"tune", "zerolatency"},
+        {"speed-preset", "ultrafast"},
+        {"bframes", "0"},
+        {"b-adapt", "false"},
+        {"sliced-threads", "true"},
+        {"vbv-buf-capacity", "120"}},
+       "key-int-max"},
+      {"x265enc",
+       {{"tune", "zerolatency"}, {"speed-preset", "ultrafast"}},
+       "key-int-max"},
+      {"openh264enc", {{"complexity", "low"}}, "gop-size"},
+      {"vp8enc",
+       {{"deadline", "1"},
+        {"lag-in-frames", "0"},
+        {"error-resilient", "default"}},
+       "keyframe-max-dist"},
+      {"vp9enc",
+       {{"deadline", "1"}, {"lag-in-frames", "0"}, {"row-mt", "true"}},
+       "keyframe-max-dist"},
+  };
+  return tunings;
+}
+
+// encoded input webrtcsink payloads without an encoder of its own
+constexpr std::array<std::string_view, 2> kPassthroughCodecs{"h264", "vp8"};
+
+const char* congestion_name(BaseRTCPlayer::Options::Congestion congestion) {
+  using Congestion = BaseRTCPlayer::Options::Congestion;
+  switch (congestion) {
+    case Congestion::Homegrown:
+      return "homegrown";
+    case Congestion::GoogleCC:
+      return "gcc";
+    default:
+      return "disabled";
+  }
+}
+
+}  // namespace
+
 bool validate_ws(const std::string& wsUri) { return true; }
 
+BaseRTCPlayer::Options BaseRTCPlayer::low_latency_profile() {
+  return {.congestion = Options::Congestion::GoogleCC,
+          .start_bitrate = 1'000'000,
+          .min_bitrate = 300'000,
+          .max_bitrate = 4'000'000,
+          .low_latency = true,
+          .keyframe_interval = 60};
+}
+
+std::optional<BaseRTCPlayer::Options::Congestion>
+BaseRTCPlayer::parse_congestion(std::string_view name) {
+  using Congestion = Options::Congestion;
+  for (auto congestion :
+       {Congestion::Disabled, Congestion::Homegrown, Congestion::GoogleCC}) {
+    if (name == congestion_name(congestion)) return congestion;
+  }
+  return std::nullopt;
+}
+
 BaseRTCPlayer::BaseRTCPlayer(GMainLoop& loop, const std::string& wsUri)
-    : BasePlayer(), wsUri(wsUri), loop(loop), pipeline(loop, "BaseRTCPlayer") {}
+    : BaseRTCPlayer(loop, wsUri, Options{}) {}
+
+BaseRTCPlayer::BaseRTCPlayer(GMainLoop& loop, const std::string& wsUri,
+                             const Options& options)
+    : BasePlayer(),
+      wsUri(wsUri),
+      options(options),
+      loop(loop),
+      pipeline(loop, "BaseRTCPlayer") {}
+
+BaseRTCPlayer::~BaseRTCPlayer() {
+  if (bitrate_sample) {
+    g_source_destroy(bitrate_sample);
+    g_source_unref(bitrate_sample);
+  }
+  for (auto sink : webrtcsinks) {
+    g_signal_handlers_disconnect_by_data(sink, this);
+  }
+  for (auto& watch : encoders) gst_object_unref(watch.encoder);
+}
+
+std::vector<BaseRTCPlayer::Rendition> BaseRTCPlayer::default_ladder() {
+  return {{"720p", 1280, 720, 2'500'000},
+          {"360p", 640, 360, 800'000},
+          {"180p", 320, 180, 250'000}};
+}
+
+std::optional<std::vector<BaseRTCPlayer::Rendition>>
+BaseRTCPlayer::parse_ladder(std::string_view description) {
+  std::vector<Rendition> ladder;
+  while (!description.empty()) {
+    auto comma = description.find(',');
+    auto item = description.substr(0, comma);
+    description = comma == std::string_view::npos
+                      ? std::string_view{}
+                      : description.substr(comma + 1);
+
+    Rendition rendition;
+    unsigned kbps{0};
+    auto colon = item.find(':');
+    if (colon == 0 || colon == std::string_view::npos) return std::nullopt;
+    rendition.name = item.substr(0, colon);
+    std::string size(item.substr(colon + 1));
+    if (std::sscanf(size.c_str(), "%dx%d@%u", &rendition.width,
+                    &rendition.height, &kbps) != 3 ||
+        rendition.width <= 0 || rendition.height <= 0 || !kbps) {
+      return std::nullopt;
+    }
+    rendition.bitrate = kbps * 1000;
+    ladder.push_back(std::move(rendition));
+  }
+  if (ladder.empty()) return std::nullopt;
+  return ladder;
+}
 
 void BaseRTCPlayer::create() {
-  auto src = Element("videotestsrc", "src");
-  auto rssink = Element("webrtcsink", "sink");
+  if (!validate_ws(wsUri)) {
+    LOG(FATAL) << "Web Socket uri is incorrect, please, verify";
+  }
 
-  if (!rssink.is_initialised()) {
+  PipelineGraph graph;
+  bool shared = !options.renditions.empty();
+  if (options.source.empty()) {
+    graph.add("videotestsrc", "src")
+        .set("pattern", options.pattern)
+        .set("is-live", true)
+        .caps("video/x-raw,format=I420");
+  } else {
+    graph.add("uridecodebin", "src").set("uri", source_uri(options.source));
+    // the ladder scales and encodes by itself, audio pads are drained
+    if (shared) graph.then(converter()).caps("video/x-raw,format=I420");
+  }
+  if (shared) {
+    add_ladder(graph);
+  } else {
+    graph.then("webrtcsink", "sink");
+    configure_sink(graph, true);
+    if (!options.source.empty()) add_passthrough(graph);
+  }
+
+  if (!graph.build(pipeline)) {
     LOG(FATAL) << "Failed on init of webrtcsink, make sure, that "
                   "gst-plugins-rs is installed on the system";
   }
+  instrument(pipeline);
 
-  if (!validate_ws(wsUri)) {
-    LOG(FATAL) << "Web Socket uri is incorrect, please, verify";
+  const auto& flags = get_flags();
+  if (flags.metrics_port || !flags.metrics_file.empty()) {
+    options.bitrate_gauges = true;
+  }
+  if (options.renditions.empty()) {
+    watch_sink(pipeline.find("sink")->raw());
   }
+  if (Element* parse = pipeline.find("parse")) {
+    auto sinkPad = make_gst(gst_element_get_static_pad(parse->raw(), "sink"));
+    g_signal_connect(sinkPad.get(), "linked",
+                     G_CALLBACK(&BaseRTCPlayer::passthrough_linked), this);
+  }
+  for (auto& rendition : options.renditions) {
+    watch_sink(pipeline.find(std::format("sink-{}", rendition.name))->raw());
+    GstElement* encoder =
+        pipeline.find(std::format("encoder-{}", rendition.name))->raw();
+    tune_encoder(encoder, true);
+    Element::set_bitrate(encoder, rendition.bitrate);
+    if (options.bitrate_gauges) {
+      watch_encoder(encoder, "shared", rendition.name);
+    }
+  }
+
+  if (!options.bitrate_gauges) return;
+  bitrate_sample = g_timeout_source_new(kBitrateSampleMs);
+  g_source_set_callback(bitrate_sample, sample_bitrates, this, nullptr);
+  g_source_attach(bitrate_sample, g_main_loop_get_context(&loop));
+}
+
+bool BaseRTCPlayer::set_rendition(const Rendition& rendition) {
+  auto current = std::find_if(
+      options.renditions.begin(), options.renditions.end(),
+      [&](const Rendition& r) { return r.name == rendition.name; });
+  if (current == options.renditions.end()) {
+    LOG(ERROR) << std::format("no shared rendition {}", rendition.name);
+    return false;
+  }
+  if (rendition.bitrate &&
+      !pipeline.set_bitrate(std::format("encoder-{}", rendition.name),
+                            rendition.bitrate)) {
+    return false;
+  }
+  if (rendition.bitrate) current->bitrate = rendition.bitrate;
+  if (!rendition.width || !rendition.height) return true;
+  // the encoder restarts its stream on the new size, peers get a keyframe
+  if (!pipeline.set_caps(std::format("size-{}", rendition.name),
+                         std::format("video/x-raw,width={},height={}",
+                                     rendition.width, rendition.height))) {
+    return false;
+  }
+  current->width = rendition.width;
+  current->height = rendition.height;
+  return true;
+}
+
+void BaseRTCPlayer::configure_sink(PipelineGraph& graph, bool encodes) const {
+  graph.set("signaller::uri", wsUri);
+  if (!encodes) {
+    // an encoded input is only payloaded, nothing to adapt per peer
+    graph.set("congestion-control", "disabled");
+    return;
+  }
+  graph.set("congestion-control", congestion_name(options.congestion));
+  if (!options.codec.empty()) {
+    graph.set("video-caps", std::format("video/x-{}", options.codec));
+  }
+  if (options.start_bitrate) graph.set("start-bitrate", options.start_bitrate);
+  if (options.min_bitrate) graph.set("min-bitrate", options.min_bitrate);
+  if (options.max_bitrate) graph.set("max-bitrate", options.max_bitrate);
+}
+
+void BaseRTCPlayer::add_ladder(PipelineGraph& graph) const {
+  bool vp8 = options.codec == "vp8";
+  bool vp9 = options.codec == "vp9";
+  if (!vp8 && !vp9 && !options.codec.empty() && options.codec != "h264") {
+    LOG(WARNING) << std::format("no shared encoder for {}, using h264",
+                                options.codec);
+  }
+  graph.then("tee", "ladder");
+  for (auto& rendition : options.renditions) {
+    graph.from("ladder")
+        .queue(std::format("queue-{}", rendition.name))
+        .set("leaky", "downstream")
+        .then("videoscale")
+        .then("capsfilter", std::format("size-{}", rendition.name))
+        .set("caps", std::format("video/x-raw,width={},height={}",
+                                 rendition.width, rendition.height))
+        .then(vp8 ? "vp8enc" : vp9 ? "vp9enc" : "x264enc",
+              std::format("encoder-{}", rendition.name));
+    if (!vp8 && !vp9) graph.then("h264parse");
+    graph.then("webrtcsink", std::format("sink-{}", rendition.name))
+        .set("meta", std::format("meta,rendition={},width={},height={},"
+                                 "bitrate={}",
+                                 rendition.name, rendition.width,
+                                 rendition.height, rendition.bitrate));
+    configure_sink(graph, false);
+  }
+}
+
+void BaseRTCPlayer::add_passthrough(PipelineGraph& graph) const {
+  if (!options.passthrough) return;
+  // uridecodebin hands out the first of these caps it reaches, so raw
+  // and differently encoded streams are still decoded for webrtcsink
+  std::string caps = "video/x-raw(ANY);audio/x-raw(ANY)";
+  bool h264{false};
+  for (auto codec : kPassthroughCodecs) {
+    if (!options.codec.empty() && options.codec != codec) continue;
+    caps += std::format(";video/x-{}", codec);
+    h264 |= codec == "h264";
+  }
+  graph.from("src").set("caps", caps);
+  if (!h264) return;
+  // parameter sets with every keyframe for peers joining mid stream. The
+  // parser goes on to webrtcsink once h264 reaches it, see
+  // passthrough_linked(), so other sources request no pad they never feed
+  graph.add("h264parse", "parse")
+      .set("config-interval", -1)
+      .link("src", "parse", "video/x-h264");
+}
+
+void BaseRTCPlayer::passthrough_linked(GstPad* pad, GstPad*, gpointer data) {
+  auto that = static_cast<BaseRTCPlayer*>(data);
+  GstElement* parse = gst_pad_get_parent_element(pad);
+  if (!parse) return;
+  auto src = make_gst(gst_element_get_static_pad(parse, "src"));
+  // still linked after a restart through READY
+  if (!gst_pad_is_linked(src.get()) &&
+      !gst_element_link(parse, that->pipeline.find("sink")->raw())) {
+    LOG(ERROR) << "cannot link h264 passthrough to webrtcsink";
+  }
+  gst_object_unref(parse);
+}
+
+void BaseRTCPlayer::watch_sink(GstElement* sink) {
+  webrtcsinks.push_back(sink);
+  g_signal_connect(sink, "encoder-setup",
+                   G_CALLBACK(&BaseRTCPlayer::encoder_setup), this);
+}
 
-  rssink.child_proxy_set("signaller::uri", wsUri.c_str());
-  rssink.object_set("congestion-control", 0);
-  src.object_set("pattern", 18);
+void BaseRTCPlayer::watch_encoder(GstElement* encoder, std::string_view peer,
+                                  std::string_view pad) {
+  auto& gauge = MetricsRegistry::instance().gauge(
+      "gstpp_webrtc_encoder_bitrate_bps",
+      "configured bitrate of webrtcsink encoders",
+      {{"peer", std::string(peer)}, {"pad", std::string(pad)}});
+  std::lock_guard lock(encoders_guard);
+  encoders.push_back({GST_ELEMENT(gst_object_ref(encoder)), &gauge});
+}
 
-  pipeline.add_element(src);
-  pipeline.add_element(rssink);
-  src.link(rssink);
+gboolean BaseRTCPlayer::encoder_setup(GstElement* sink, const gchar* peer,
+                                      const gchar* pad, GstElement* encoder,
+                                      gpointer data) {
+  auto that = static_cast<BaseRTCPlayer*>(data);
+  bool tuned = that->tune_encoder(encoder, that->options.low_latency);
+  if (that->options.bitrate_gauges) that->watch_encoder(encoder, peer, pad);
+  // unless tuned here webrtcsink applies its own defaults
+  return tuned;
+}
+
+bool BaseRTCPlayer::tune_encoder(GstElement* encoder, bool low_latency) const {
+  if (!low_latency && !options.keyframe_interval) return false;
+  auto factory = factory_name(encoder);
+  const auto& tunings = encoder_tunings();
+  auto tuning = std::find_if(
+      tunings.begin(), tunings.end(),
+      [factory](const EncoderTuning& t) { return t.factory == factory; });
+  if (tuning == tunings.end()) {
+    LOG(WARNING) << std::format("no low latency settings for {}", factory);
+    return false;
+  }
+
+  GObjectClass* klass = G_OBJECT_GET_CLASS(encoder);
+  if (low_latency) {
+    for (auto [property, value] : tuning->settings) {
+      if (g_object_class_find_property(klass, property)) {
+        gst_util_set_object_arg(G_OBJECT(encoder), property, value);
+      }
+    }
+  }
+  if (options.keyframe_interval) {
+    gst_util_set_object_arg(
+        G_OBJECT(encoder), tuning->keyframe_property,
+        std::to_string(options.keyframe_interval).c_str());
+  }
+  // webrtcsink would have set the initial bitrate, congestion control
+  // takes over from there
+  if (options.start_bitrate) {
+    Element::set_bitrate(encoder, options.start_bitrate);
+  }
+  LOG(INFO) << std::format("{} tuned{}, keyframe every {} frames", factory,
+                           low_latency ? " for low latency" : "",
+                           options.keyframe_interval);
+  return true;
+}
+
+gboolean BaseRTCPlayer::sample_bitrates(gpointer data) {
+  auto that = static_cast<BaseRTCPlayer*>(data);
+  std::lock_guard lock(that->encoders_guard);
+  std::erase_if(that->encoders, [](EncoderWatch& watch) {
+    // congestion control retunes the encoder, an orphan belongs to a peer
+    // that has left
+    if (GstObject* parent = gst_object_get_parent(GST_OBJECT(watch.encoder))) {
+      gst_object_unref(parent);
+      watch.bitrate->set(Element::bitrate(watch.encoder));
+      return false;
+    }
+    watch.bitrate->set(0);
+    gst_object_unref(watch.encoder);
+    return true;
+  });
+  return G_SOURCE_CONTINUE;
 }
 
 void BaseRTCPlayer::play() { pipeline.play(); }
 
 void BaseRTCPlayer::stop() { pipeline.stop(); }
 
+bool BaseRTCPlayer::drain(std::chrono::milliseconds timeout) {
+  return pipeline.drain(timeout);
+}
+
+bool BaseRTCPlayer::restart() { return pipeline.restart(); }
+
 }  // namespace vptyp
\ No newline at end of file
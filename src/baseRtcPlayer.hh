@@ -1,23 +1,112 @@
 #pragma once
 
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
 #include "basePlayer.hh"
+#include "metrics.hh"
 #include "pipeline.hh"
+#include "pipelineGraph.hh"
 
 namespace vptyp {
 
 class BaseRTCPlayer : public BasePlayer {
  public:
+  // one encode of the source served to every peer of its own producer,
+  // peers pick a rendition by the producer meta
+  struct Rendition {
+    std::string name{};  // "rendition" field of the producer meta
+    int width{0};
+    int height{0};
+    guint bitrate{0};  // bit/s
+  };
+
+  // webrtcsink tuning, bitrates in bit/s, zero keeps the webrtcsink default
+  struct Options {
+    enum class Congestion { Disabled, Homegrown, GoogleCC };
+
+    std::string source{};  // uri or path, empty - videotestsrc
+    int pattern{18};  // videotestsrc pattern
+    // encoded h264/vp8 sources matching codec go to webrtcsink undecoded,
+    // no encoder means no bitrate adaptation for them
+    bool passthrough{true};
+    std::string codec{};  // "vp8", "h264", ..., empty - any webrtcsink has
+    Congestion congestion{Congestion::Disabled};
+    guint start_bitrate{0};
+    guint min_bitrate{0};
+    guint max_bitrate{0};
+    bool low_latency{false};  // zero latency encoder settings, no B frames
+    guint keyframe_interval{0};  // frames, 0 - encoder default
+    bool bitrate_gauges{false};  // sample encoders without metrics flags
+    // shared encodes instead of an encoder per peer; congestion control
+    // and the bitrates above don't apply to them
+    std::vector<Rendition> renditions{};
+  };
+
+  // GCC congestion control, capped bitrate and short GOP
+  static Options low_latency_profile();
+  static std::optional<Options::Congestion> parse_congestion(
+      std::string_view name);
+  // 720p, 360p and 180p
+  static std::vector<Rendition> default_ladder();
+  // "name:WxH@kbps,...", e.g. "hd:1280x720@2500,sd:640x360@800"
+  static std::optional<std::vector<Rendition>> parse_ladder(
+      std::string_view description);
+
   BaseRTCPlayer(GMainLoop& loop, const std::string& wsUri);
-  ~BaseRTCPlayer() override = default;
+  BaseRTCPlayer(GMainLoop& loop, const std::string& wsUri,
+                const Options& options);
+  ~BaseRTCPlayer() override;
 
   void create() override;
   void play() override;
   void stop() override;
+  bool drain(std::chrono::milliseconds timeout) override;
+  bool restart() override;
+
+  // retunes a shared rendition by name while it streams; zero size or
+  // bitrate keeps the current one. Per peer encoders follow congestion
+  // control instead
+  bool set_rendition(const Rendition& rendition);
+
+ protected:
+  // encoder of a peer or of a shared rendition, sampled for its bitrate
+  struct EncoderWatch {
+    GstElement* encoder{nullptr};  // owned ref
+    Gauge* bitrate{nullptr};
+  };
+
+  // webrtcsink properties shared by every sink, on the current graph node
+  void configure_sink(PipelineGraph& graph, bool encodes) const;
+  void add_ladder(PipelineGraph& graph) const;
+  // stops decoding at a codec webrtcsink can send as is
+  void add_passthrough(PipelineGraph& graph) const;
+  void watch_sink(GstElement* sink);
+  void watch_encoder(GstElement* encoder, std::string_view peer,
+                     std::string_view pad);
+  // applies the low latency and keyframe options, true if it knew the
+  // encoder, so webrtcsink leaves it alone
+  bool tune_encoder(GstElement* encoder, bool low_latency) const;
+  static gboolean encoder_setup(GstElement* sink, const gchar* peer,
+                                const gchar* pad, GstElement* encoder,
+                                gpointer data);
+  // links the h264 passthrough parser to webrtcsink once the source
+  // linked it
+  static void passthrough_linked(GstPad* pad, GstPad* peer, gpointer data);
+  static gboolean sample_bitrates(gpointer data);
 
  protected:
   std::string wsUri;
+  Options options;
   GMainLoop& loop;
   Pipeline pipeline;
+  std::mutex encoders_guard;
+  std::vector<EncoderWatch> encoders;
+  std::vector<GstElement*> webrtcsinks;  // non-owned
+  GSource* bitrate_sample{nullptr};
 };
 
 }  // namespace vptyp
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "bufferPool.hh"
+
+#include <glog/logging.h>
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <bit>
+#include <format>
+
+namespace {
+
+struct GstppBufferPool {
+  GstBufferPool parent;
+  std::shared_ptr<vptyp::BufferPool::Counters>* counters;
+};
+
+struct GstppBufferPoolClass {
+  GstBufferPoolClass parent_class;
+};
+
+// set by alloc_buffer, lets acquire_buffer tell recycled buffers from fresh
+thread_local bool allocatedInCall{false};
+
+}  // namespace
+
+G_DEFINE_TYPE(GstppBufferPool, gstpp_buffer_pool, GST_TYPE_BUFFER_POOL)
+
+static GstFlowReturn gstpp_buffer_pool_alloc(GstBufferPool* pool,
+                                             GstBuffer** buffer,
+                                             GstBufferPoolAcquireParams* params) {
+  auto ret = GST_BUFFER_POOL_CLASS(gstpp_buffer_pool_parent_class)
+                 ->alloc_buffer(pool, buffer, params);
+  if (ret == GST_FLOW_OK) {
+    allocatedInCall = true;
+    auto self = reinterpret_cast<GstppBufferPool*>(pool);
+    (*self->counters)->allocated.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+static GstFlowReturn gstpp_buffer_pool_acquire(
+    GstBufferPool* pool, GstBuffer** buffer,
+    GstBufferPoolAcquireParams* params) {
+  allocatedInCall = false;
+  auto ret = GST_BUFFER_POOL_CLASS(gstpp_buffer_pool_parent_class)
+                 ->acquire_buffer(pool, buffer, params);
+  if (ret == GST_FLOW_OK) {
+    auto self = reinterpret_cast<GstppBufferPool*>(pool);
+    auto& counter = allocatedInCall ? (*self->counters)->misses
+                                    : (*self->counters)->hits;
+    counter.fetch_add(1, std::memory_order_relaxed);
+  }
+  return ret;
+}
+
+static void gstpp_buffer_pool_finalize(GObject* object) {
+  auto self = reinterpret_cast<GstppBufferPool*>(object);
+  delete self->counters;
+  self->counters = nullptr;
+  G_OBJECT_CLASS(gstpp_buffer_pool_parent_class)->finalize(object);
+}
+
+static void gstpp_buffer_pool_class_init(GstppBufferPoolClass* klass) {
+  G_OBJECT_CLASS(klass)->finalize = gstpp_buffer_pool_finalize;
+  auto poolClass = GST_BUFFER_POOL_CLASS(klass);
+  poolClass->alloc_buffer = gstpp_buffer_pool_alloc;
+  poolClass->acquire_buffer = gstpp_buffer_pool_acquire;
+}
+
+static void gstpp_buffer_pool_init(GstppBufferPool* self) {
+  self->counters = nullptr;
+}
+
+namespace vptyp {
+
+BufferPool::BufferPool() : BufferPool(Config{}) {}
+
+BufferPool::BufferPool(const Config& config)
+    : config(config), counters(std::make_shared<Counters>()) {
+  if (!std::has_single_bit(config.align)) {
+    LOG(ERROR) << std::format("buffer pool alignment {} is not a power of two",
+                              config.align);
+    this->config.align = 64;
+  }
+}
+
+BufferPool::~BufferPool() {
+  for (auto& [size, pool] : classes) {
+    gst_buffer_pool_set_active(pool, FALSE);
+    gst_object_unref(pool);
+  }
+}
+
+gsize BufferPool::size_class(gsize size) {
+  constexpr gsize kMinClass = 4096;
+  if (size <= kMinClass) return kMinClass;
+
+  gsize step = std::bit_floor(size) / 4;
+  return (size + step - 1) / step * step;
+}
+
+GstBufferPool* BufferPool::make_pool(GstCaps* caps, gsize size) {
+  auto pool = GST_BUFFER_POOL(
+      g_object_new(gstpp_buffer_pool_get_type(), nullptr));
+  gst_object_ref_sink(pool);
+  reinterpret_cast<GstppBufferPool*>(pool)->counters =
+      new std::shared_ptr<Counters>(counters);
+
+  GstStructure* poolConfig = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(poolConfig, caps, guint(size),
+                                    config.min_buffers, config.max_buffers);
+  GstAllocationParams params;
+  gst_allocation_params_init(&params);
+  params.align = config.align - 1;
+  gst_buffer_pool_config_set_allocator(poolConfig, nullptr, &params);
+
+  if (!gst_buffer_pool_set_config(pool, poolConfig)) {
+    LOG(ERROR) << std::format("buffer pool config for size {} rejected", size);
+    gst_object_unref(pool);
+    return nullptr;
+  }
+  return pool;
+}
+
+GstBuffer* BufferPool::acquire(gsize size) {
+  GstBufferPool* pool{nullptr};
+  {
+    std::lock_guard lock(guard);
+    gsize sizeClass = size_class(size);
+    auto it = classes.find(sizeClass);
+    if (it == classes.end()) {
+      pool = make_pool(nullptr, sizeClass);
+      if (!pool) return nullptr;
+      if (!gst_buffer_pool_set_active(pool, TRUE)) {
+        LOG(ERROR) << std::format("buffer pool of class {} failed to start",
+                                  sizeClass);
+        gst_object_unref(pool);
+        return nullptr;
+      }
+      it = classes.emplace(sizeClass, pool).first;
+    }
+    pool = it->second;
+  }
+
+  // may block on max_buffers, so outside of the lock
+  GstBuffer* buffer{nullptr};
+  if (gst_buffer_pool_acquire_buffer(pool, &buffer, nullptr) != GST_FLOW_OK) {
+    return nullptr;
+  }
+  gst_buffer_resize(buffer, 0, size);
+  return buffer;
+}
+
+bool BufferPool::decide_allocation(GstQuery* query) {
+  GstCaps* caps{nullptr};
+  gboolean needPool{FALSE};
+  gst_query_parse_allocation(query, &caps, &needPool);
+  if (!caps) return false;
+
+  gsize size{0};
+  guint min{config.min_buffers};
+  guint max{config.max_buffers};
+  guint pools = gst_query_get_n_allocation_pools(query);
+  if (pools > 0) {
+    GstBufferPool* downstream{nullptr};
+    guint size32{0};
+    gst_query_parse_nth_allocation_pool(query, 0, &downstream, &size32, &min,
+                                        &max);
+    if (downstream) gst_object_unref(downstream);
+    size = size32;
+    // downstream may require more buffers in flight than we preallocate
+    min = std::max(min, config.min_buffers);
+    if (config.max_buffers && max) max = std::min(max, config.max_buffers);
+    if (max && max < min) max = min;
+  }
+
+  GstVideoInfo info;
+  if (gst_video_info_from_caps(&info, caps)) size = std::max(size, info.size);
+  if (size == 0) return false;
+
+  GstBufferPool* pool = make_pool(caps, size);
+  if (!pool) return false;
+
+  if (pools > 0) {
+    gst_query_set_nth_allocation_pool(query, 0, pool, guint(size), min, max);
+  } else {
+    gst_query_add_allocation_pool(query, pool, guint(size), min, max);
+  }
+  gst_object_unref(pool);
+
+  GstAllocationParams params;
+  gst_allocation_params_init(&params);
+  params.align = config.align - 1;
+  if (gst_query_get_n_allocation_params(query) > 0) {
+    gst_query_set_nth_allocation_param(query, 0, nullptr, &params);
+  } else {
+    gst_query_add_allocation_param(query, nullptr, &params);
+  }
+  return true;
+}
+
+BufferPool::Stats BufferPool::stats() const {
+  return {counters->hits.load(std::memory_order_relaxed),
+          counters->misses.load(std::memory_order_relaxed),
+          counters->allocated.load(std::memory_order_relaxed)};
+}
+
+}  // namespace vptyp
@@ -0,0 +1,63 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace vptyp {
+
+// Set of preallocated, aligned GstBufferPools. Buffers acquired directly are
+// served from a pool per size class; elements attached through
+// Element::use_buffer_pool get their own pool handed over in the allocation
+// query. Hit/miss statistics are shared across all of them.
+class BufferPool {
+ public:
+  struct Config {
+    guint min_buffers{4};  // preallocated on activation
+    guint max_buffers{0};  // 0 - unlimited
+    gsize align{64};       // bytes, power of two
+  };
+
+  struct Stats {
+    uint64_t hits{0};       // buffer recycled from a pool
+    uint64_t misses{0};     // acquire had to allocate
+    uint64_t allocated{0};  // allocations including preallocation
+  };
+
+  struct Counters {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> allocated{0};
+  };
+
+  BufferPool();
+  explicit BufferPool(const Config& config);
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+  ~BufferPool();
+
+  // rounds size up to its class, quarter steps between powers of two
+  static gsize size_class(gsize size);
+
+  // transfer full, buffer is resized to exactly size bytes
+  GstBuffer* acquire(gsize size);
+
+  // configured but inactive pool, transfer full
+  GstBufferPool* make_pool(GstCaps* caps, gsize size);
+
+  // puts a fresh pool on the first position of an answered ALLOCATION query
+  bool decide_allocation(GstQuery* query);
+
+  Stats stats() const;
+
+ protected:
+  Config config;
+  std::shared_ptr<Counters> counters;
+  std::mutex guard;
+  std::map<gsize, GstBufferPool*> classes;  // active pools by size class
+};
+
+}  // namespace vptyp
@@ -0,0 +1,694 @@
+#include "colorKernels.hh"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace vptyp::color {
+
+namespace {
+
+// BT.601 limited range. YUV to RGB works in 6 bit fixed point on 16 bit
+// lanes, multipliers are Q15 and applied with a multiply-high so the
+// products keep full precision. Coefficients that exceed Q15 are split into
+// a shift and a fraction (1.596 = 1 + 0.596, 2.018 = 2 + 0.018).
+constexpr int kLuma = 38142;   // 1.164
+constexpr int kVtoR = 19530;   // 1.596 - 1
+constexpr int kUtoG = -12812;  // -0.391
+constexpr int kVtoG = -26640;  // -0.813
+constexpr int kUtoB = 590;     // 2.018 - 2
+
+// RGB to YUV in 7 bit fixed point, small enough for signed byte
+// multipliers (pmaddubsw); each row of coefficients sums to the range.
+constexpr int kRtoY = 33, kGtoY = 64, kBtoY = 13;
+constexpr int kRtoU = -19, kGtoU = -37, kBtoU = 56;
+constexpr int kRtoV = 56, kGtoV = -47, kBtoV = -9;
+
+inline uint8_t* row(const Plane& plane, int y) {
+  return plane.data + ptrdiff_t(y) * plane.stride;
+}
+
+inline uint8_t clamp8(int value) { return uint8_t(std::clamp(value, 0, 255)); }
+
+// arithmetic shift, same rounding as pmulhw
+inline int mulhi(int a, int b) { return (a * b) >> 16; }
+
+inline uint8_t avg(uint8_t a, uint8_t b) { return uint8_t((a + b + 1) >> 1); }
+
+inline uint32_t load32(const uint8_t* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline void store32(uint8_t* p, uint32_t value) {
+  std::memcpy(p, &value, sizeof(value));
+}
+
+// ---- scalar rows, also finish the tails of the vector ones ----
+
+template <bool kNv12, bool kBgr>
+void yuv_row_scalar(const uint8_t* y, const uint8_t* u, const uint8_t* v,
+                    uint8_t* out, int x, int width) {
+  for (; x < width; ++x) {
+    int cx = x / 2;
+    int U = kNv12 ? u[2 * cx] : u[cx];
+    int V = kNv12 ? u[2 * cx + 1] : v[cx];
+
+    int luma = (std::max(y[x] - 16, 0) * 128 * kLuma) >> 16;
+    int u7 = (U - 128) * 128;
+    int v7 = (V - 128) * 128;
+    int r = (luma + (V - 128) * 64 + mulhi(v7, kVtoR) + 32) >> 6;
+    int g = (luma + mulhi(u7, kUtoG) + mulhi(v7, kVtoG) + 32) >> 6;
+    int b = (luma + u7 + mulhi(u7, kUtoB) + 32) >> 6;
+
+    uint8_t* pixel = out + 4 * x;
+    pixel[0] = clamp8(kBgr ? b : r);
+    pixel[1] = clamp8(g);
+    pixel[2] = clamp8(kBgr ? r : b);
+    pixel[3] = 255;
+  }
+}
+
+template <bool kBgr>
+void luma_row_scalar(const uint8_t* in, uint8_t* out, int x, int width) {
+  for (; x < width; ++x) {
+    const uint8_t* p = in + 4 * x;
+    int r = kBgr ? p[2] : p[0], g = p[1], b = kBgr ? p[0] : p[2];
+    out[x] = clamp8(((kRtoY * r + kGtoY * g + kBtoY * b + 64) >> 7) + 16);
+  }
+}
+
+// x and width in pixels, x even
+template <bool kBgr, bool kNv12>
+void chroma_row_scalar(const uint8_t* in0, const uint8_t* in1, uint8_t* u,
+                       uint8_t* v, int x, int width) {
+  for (; x < width; x += 2) {
+    int next = std::min(x + 1, width - 1);
+    uint8_t px[3];
+    for (int c = 0; c < 3; ++c) {
+      px[c] = avg(avg(in0[4 * x + c], in1[4 * x + c]),
+                  avg(in0[4 * next + c], in1[4 * next + c]));
+    }
+    int r = kBgr ? px[2] : px[0], g = px[1], b = kBgr ? px[0] : px[2];
+    uint8_t U = clamp8(((kRtoU * r + kGtoU * g + kBtoU * b + 64) >> 7) + 128);
+    uint8_t V = clamp8(((kRtoV * r + kGtoV * g + kBtoV * b + 64) >> 7) + 128);
+    if constexpr (kNv12) {
+      u[x] = U;
+      u[x + 1] = V;
+    } else {
+      u[x / 2] = U;
+      v[x / 2] = V;
+    }
+  }
+}
+
+void swizzle_row_scalar(const uint8_t* in, uint8_t* out, int x, int width) {
+  for (; x < width; ++x) {
+    out[4 * x] = in[4 * x + 2];
+    out[4 * x + 1] = in[4 * x + 1];
+    out[4 * x + 2] = in[4 * x];
+    out[4 * x + 3] = 255;
+  }
+}
+
+// pairs of chroma samples
+void deinterleave_scalar(const uint8_t* uv, uint8_t* u, uint8_t* v, int x,
+                         int pairs) {
+  for (; x < pairs; ++x) {
+    u[x] = uv[2 * x];
+    v[x] = uv[2 * x + 1];
+  }
+}
+
+void interleave_scalar(const uint8_t* u, const uint8_t* v, uint8_t* uv, int x,
+                       int pairs) {
+  for (; x < pairs; ++x) {
+    uv[2 * x] = u[x];
+    uv[2 * x + 1] = v[x];
+  }
+}
+
+// ---- SSE4.1 ----
+
+template <bool kNv12, bool kBgr>
+__attribute__((target("sse4.1"))) int yuv_row_sse41(const uint8_t* y,
+                                                    const uint8_t* u,
+                                                    const uint8_t* v,
+                                                    uint8_t* out, int width) {
+  const __m128i k16 = _mm_set1_epi16(16);
+  const __m128i k128 = _mm_set1_epi16(128);
+  const __m128i round = _mm_set1_epi16(32);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alpha = _mm_set1_epi8(-1);
+  const __m128i luma = _mm_set1_epi16(short(kLuma));
+  const __m128i vr = _mm_set1_epi16(kVtoR);
+  const __m128i ug = _mm_set1_epi16(kUtoG);
+  const __m128i vg = _mm_set1_epi16(kVtoG);
+  const __m128i ub = _mm_set1_epi16(kUtoB);
+  // duplicate every chroma byte into a zero extended 16 bit lane
+  const __m128i evenPairs =
+      _mm_setr_epi8(0, -1, 0, -1, 2, -1, 2, -1, 4, -1, 4, -1, 6, -1, 6, -1);
+  const __m128i oddPairs =
+      _mm_setr_epi8(1, -1, 1, -1, 3, -1, 3, -1, 5, -1, 5, -1, 7, -1, 7, -1);
+  const __m128i dup =
+      _mm_setr_epi8(0, -1, 0, -1, 1, -1, 1, -1, 2, -1, 2, -1, 3, -1, 3, -1);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i yy = _mm_cvtepu8_epi16(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(y + x)));
+    yy = _mm_slli_epi16(_mm_max_epi16(_mm_sub_epi16(yy, k16), zero), 7);
+    __m128i l = _mm_mulhi_epu16(yy, luma);
+
+    __m128i uu, vv;
+    if constexpr (kNv12) {
+      __m128i uv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x));
+      uu = _mm_shuffle_epi8(uv, evenPairs);
+      vv = _mm_shuffle_epi8(uv, oddPairs);
+    } else {
+      uu = _mm_shuffle_epi8(_mm_cvtsi32_si128(load32(u + x / 2)), dup);
+      vv = _mm_shuffle_epi8(_mm_cvtsi32_si128(load32(v + x / 2)), dup);
+    }
+    uu = _mm_sub_epi16(uu, k128);
+    vv = _mm_sub_epi16(vv, k128);
+    __m128i u7 = _mm_slli_epi16(uu, 7);
+    __m128i v7 = _mm_slli_epi16(vv, 7);
+
+    __m128i r = _mm_adds_epi16(
+        _mm_adds_epi16(l, _mm_adds_epi16(_mm_slli_epi16(vv, 6),
+                                         _mm_mulhi_epi16(v7, vr))),
+        round);
+    __m128i g = _mm_adds_epi16(
+        _mm_adds_epi16(l, _mm_adds_epi16(_mm_mulhi_epi16(u7, ug),
+                                         _mm_mulhi_epi16(v7, vg))),
+        round);
+    __m128i b = _mm_adds_epi16(
+        _mm_adds_epi16(l, _mm_adds_epi16(u7, _mm_mulhi_epi16(u7, ub))), round);
+
+    __m128i r8 = _mm_packus_epi16(_mm_srai_epi16(r, 6), zero);
+    __m128i g8 = _mm_packus_epi16(_mm_srai_epi16(g, 6), zero);
+    __m128i b8 = _mm_packus_epi16(_mm_srai_epi16(b, 6), zero);
+    __m128i c01 = _mm_unpacklo_epi8(kBgr ? b8 : r8, g8);
+    __m128i c23 = _mm_unpacklo_epi8(kBgr ? r8 : b8, alpha);
+    auto dst = reinterpret_cast<__m128i*>(out + 4 * x);
+    _mm_storeu_si128(dst, _mm_unpacklo_epi16(c01, c23));
+    _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(c01, c23));
+  }
+  return x;
+}
+
+template <bool kBgr>
+__attribute__((target("sse4.1"))) __m128i coefficients(int r, int g, int b) {
+  return kBgr ? _mm_setr_epi8(b, g, r, 0, b, g, r, 0, b, g, r, 0, b, g, r, 0)
+              : _mm_setr_epi8(r, g, b, 0, r, g, b, 0, r, g, b, 0, r, g, b, 0);
+}
+
+template <bool kBgr>
+__attribute__((target("sse4.1"))) int luma_row_sse41(const uint8_t* in,
+                                                     uint8_t* out, int width) {
+  const __m128i coef = coefficients<kBgr>(kRtoY, kGtoY, kBtoY);
+  const __m128i round = _mm_set1_epi16(64);
+  const __m128i offset = _mm_set1_epi16(16);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    auto src = reinterpret_cast<const __m128i*>(in + 4 * x);
+    __m128i a = _mm_maddubs_epi16(_mm_loadu_si128(src), coef);
+    __m128i b = _mm_maddubs_epi16(_mm_loadu_si128(src + 1), coef);
+    __m128i s = _mm_hadd_epi16(a, b);
+    s = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(s, round), 7), offset);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                     _mm_packus_epi16(s, s));
+  }
+  return x;
+}
+
+template <bool kBgr, bool kNv12>
+__attribute__((target("sse4.1"))) int chroma_row_sse41(const uint8_t* in0,
+                                                       const uint8_t* in1,
+                                                       uint8_t* u, uint8_t* v,
+                                                       int width) {
+  const __m128i coefU = coefficients<kBgr>(kRtoU, kGtoU, kBtoU);
+  const __m128i coefV = coefficients<kBgr>(kRtoV, kGtoV, kBtoV);
+  const __m128i round = _mm_set1_epi16(64);
+  const __m128i offset = _mm_set1_epi16(128);
+  const __m128i interleave =
+      _mm_setr_epi8(0, 4, 1, 5, 2, 6, 3, 7, -1, -1, -1, -1, -1, -1, -1, -1);
+
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    auto top = reinterpret_cast<const __m128i*>(in0 + 4 * x);
+    auto bottom = reinterpret_cast<const __m128i*>(in1 + 4 * x);
+    __m128 va = _mm_castsi128_ps(
+        _mm_avg_epu8(_mm_loadu_si128(top), _mm_loadu_si128(bottom)));
+    __m128 vb = _mm_castsi128_ps(
+        _mm_avg_epu8(_mm_loadu_si128(top + 1), _mm_loadu_si128(bottom + 1)));
+    __m128i even = _mm_castps_si128(_mm_shuffle_ps(va, vb, 0x88));
+    __m128i odd = _mm_castps_si128(_mm_shuffle_ps(va, vb, 0xDD));
+    __m128i px = _mm_avg_epu8(even, odd);
+
+    __m128i s = _mm_hadd_epi16(_mm_maddubs_epi16(px, coefU),
+                               _mm_maddubs_epi16(px, coefV));
+    s = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(s, round), 7), offset);
+    __m128i packed = _mm_packus_epi16(s, s);  // U0..U3 V0..V3
+    if constexpr (kNv12) {
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x),
+                       _mm_shuffle_epi8(packed, interleave));
+    } else {
+      store32(u + x / 2, uint32_t(_mm_cvtsi128_si32(packed)));
+      store32(v + x / 2,
+              uint32_t(_mm_cvtsi128_si32(_mm_srli_si128(packed, 4))));
+    }
+  }
+  return x;
+}
+
+__attribute__((target("sse4.1"))) int swizzle_row_sse41(const uint8_t* in,
+                                                        uint8_t* out,
+                                                        int width) {
+  const __m128i order =
+      _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1);
+  const __m128i alpha = _mm_set1_epi32(int(0xFF000000));
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * x),
+                     _mm_or_si128(_mm_shuffle_epi8(px, order), alpha));
+  }
+  return x;
+}
+
+__attribute__((target("sse4.1"))) int deinterleave_sse41(const uint8_t* uv,
+                                                         uint8_t* u,
+                                                         uint8_t* v,
+                                                         int pairs) {
+  const __m128i split =
+      _mm_setr_epi8(0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15);
+  int x = 0;
+  for (; x + 8 <= pairs; x += 8) {
+    __m128i both = _mm_shuffle_epi8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(uv + 2 * x)), split);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x), both);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x),
+                     _mm_srli_si128(both, 8));
+  }
+  return x;
+}
+
+__attribute__((target("sse4.1"))) int interleave_sse41(const uint8_t* u,
+                                                       const uint8_t* v,
+                                                       uint8_t* uv,
+                                                       int pairs) {
+  int x = 0;
+  for (; x + 8 <= pairs; x += 8) {
+    __m128i uu = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x));
+    __m128i vv = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + 2 * x),
+                     _mm_unpacklo_epi8(uu, vv));
+  }
+  return x;
+}
+
+// ---- AVX2, chroma subsampling and plane shuffles stay on SSE4.1 ----
+
+template <bool kNv12, bool kBgr>
+__attribute__((target("avx2"))) int yuv_row_avx2(const uint8_t* y,
+                                                 const uint8_t* u,
+                                                 const uint8_t* v,
+                                                 uint8_t* out, int width) {
+  const __m256i k16 = _mm256_set1_epi16(16);
+  const __m256i k128 = _mm256_set1_epi16(128);
+  const __m256i round = _mm256_set1_epi16(32);
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i alpha = _mm256_set1_epi8(-1);
+  const __m256i luma = _mm256_set1_epi16(short(kLuma));
+  const __m256i vr = _mm256_set1_epi16(kVtoR);
+  const __m256i ug = _mm256_set1_epi16(kUtoG);
+  const __m256i vg = _mm256_set1_epi16(kVtoG);
+  const __m256i ub = _mm256_set1_epi16(kUtoB);
+  const __m128i evenBytes =
+      _mm_setr_epi8(0, 0, 2, 2, 4, 4, 6, 6, 8, 8, 10, 10, 12, 12, 14, 14);
+  const __m128i oddBytes =
+      _mm_setr_epi8(1, 1, 3, 3, 5, 5, 7, 7, 9, 9, 11, 11, 13, 13, 15, 15);
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m256i yy = _mm256_cvtepu8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + x)));
+    yy = _mm256_slli_epi16(
+        _mm256_max_epi16(_mm256_sub_epi16(yy, k16), zero), 7);
+    __m256i l = _mm256_mulhi_epu16(yy, luma);
+
+    __m256i uu, vv;
+    if constexpr (kNv12) {
+      __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(u + x));
+      uu = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv, evenBytes));
+      vv = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(uv, oddBytes));
+    } else {
+      __m128i u8 =
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(u + x / 2));
+      __m128i v8 =
+          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(v + x / 2));
+      uu = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(u8, u8));
+      vv = _mm256_cvtepu8_epi16(_mm_unpacklo_epi8(v8, v8));
+    }
+    uu = _mm256_sub_epi16(uu, k128);
+    vv = _mm256_sub_epi16(vv, k128);
+    __m256i u7 = _mm256_slli_epi16(uu, 7);
+    __m256i v7 = _mm256_slli_epi16(vv, 7);
+
+    __m256i r = _mm256_adds_epi16(
+        _mm256_adds_epi16(l, _mm256_adds_epi16(_mm256_slli_epi16(vv, 6),
+                                               _mm256_mulhi_epi16(v7, vr))),
+        round);
+    __m256i g = _mm256_adds_epi16(
+        _mm256_adds_epi16(l, _mm256_adds_epi16(_mm256_mulhi_epi16(u7, ug),
+                                               _mm256_mulhi_epi16(v7, vg))),
+        round);
+    __m256i b = _mm256_adds_epi16(
+        _mm256_adds_epi16(l,
+                          _mm256_adds_epi16(u7, _mm256_mulhi_epi16(u7, ub))),
+        round);
+
+    // packs and unpacks work per 128 bit lane: lane 0 carries pixels 0-7,
+    // lane 1 pixels 8-15
+    __m256i r8 = _mm256_packus_epi16(_mm256_srai_epi16(r, 6), zero);
+    __m256i g8 = _mm256_packus_epi16(_mm256_srai_epi16(g, 6), zero);
+    __m256i b8 = _mm256_packus_epi16(_mm256_srai_epi16(b, 6), zero);
+    __m256i c01 = _mm256_unpacklo_epi8(kBgr ? b8 : r8, g8);
+    __m256i c23 = _mm256_unpacklo_epi8(kBgr ? r8 : b8, alpha);
+    __m256i lo = _mm256_unpacklo_epi16(c01, c23);  // 0-3 | 8-11
+    __m256i hi = _mm256_unpackhi_epi16(c01, c23);  // 4-7 | 12-15
+    auto dst = reinterpret_cast<__m256i*>(out + 4 * x);
+    _mm256_storeu_si256(dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+    _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(lo, hi, 0x31));
+  }
+  return x;
+}
+
+template <bool kBgr>
+__attribute__((target("avx2"))) int luma_row_avx2(const uint8_t* in,
+                                                  uint8_t* out, int width) {
+  const __m256i coef = _mm256_broadcastsi128_si256(
+      coefficients<kBgr>(kRtoY, kGtoY, kBtoY));
+  const __m256i round = _mm256_set1_epi16(64);
+  const __m256i offset = _mm256_set1_epi16(16);
+
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    auto src = reinterpret_cast<const __m256i*>(in + 4 * x);
+    __m256i a = _mm256_maddubs_epi16(_mm256_loadu_si256(src), coef);
+    __m256i b = _mm256_maddubs_epi16(_mm256_loadu_si256(src + 1), coef);
+    // per lane hadd leaves quads of pixels as 0-3, 8-11 | 4-7, 12-15
+    __m256i s = _mm256_permute4x64_epi64(_mm256_hadd_epi16(a, b), 0xD8);
+    s = _mm256_add_epi16(
+        _mm256_srai_epi16(_mm256_add_epi16(s, round), 7), offset);
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(s, s), 0xD8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                     _mm256_castsi256_si128(packed));
+  }
+  return x;
+}
+
+__attribute__((target("avx2"))) int swizzle_row_avx2(const uint8_t* in,
+                                                     uint8_t* out,
+                                                     int width) {
+  const __m256i order = _mm256_broadcastsi128_si256(
+      _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1));
+  const __m256i alpha = _mm256_set1_epi32(int(0xFF000000));
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m256i px =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * x));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x),
+                        _mm256_or_si256(_mm256_shuffle_epi8(px, order), alpha));
+  }
+  return x;
+}
+
+// ---- frame kernels ----
+
+template <bool kNv12, bool kBgr, Isa kIsa>
+void yuv420_to_rgbx(const Image& src, const Image& dst, int first, int last) {
+  for (int y = first; y < last; ++y) {
+    const uint8_t* yp = row(src.planes[0], y);
+    const uint8_t* up = row(src.planes[1], y / 2);
+    const uint8_t* vp = kNv12 ? nullptr : row(src.planes[2], y / 2);
+    uint8_t* out = row(dst.planes[0], y);
+    int x{0};
+    if constexpr (kIsa == Isa::AVX2) {
+      x = yuv_row_avx2<kNv12, kBgr>(yp, up, vp, out, src.width);
+    } else if constexpr (kIsa == Isa::SSE41) {
+      x = yuv_row_sse41<kNv12, kBgr>(yp, up, vp, out, src.width);
+    }
+    yuv_row_scalar<kNv12, kBgr>(yp, up, vp, out, x, src.width);
+  }
+}
+
+template <bool kBgr, bool kNv12, Isa kIsa>
+void rgbx_to_yuv420(const Image& src, const Image& dst, int first, int last) {
+  for (int y = first; y < last; ++y) {
+    const uint8_t* in = row(src.planes[0], y);
+    uint8_t* out = row(dst.planes[0], y);
+    int x{0};
+    if constexpr (kIsa == Isa::AVX2) {
+      x = luma_row_avx2<kBgr>(in, out, src.width);
+    } else if constexpr (kIsa == Isa::SSE41) {
+      x = luma_row_sse41<kBgr>(in, out, src.width);
+    }
+    luma_row_scalar<kBgr>(in, out, x, src.width);
+
+    if (y % 2) continue;
+    // the last row of an odd height pairs with itself
+    const uint8_t* below = y + 1 < src.height ? row(src.planes[0], y + 1) : in;
+    uint8_t* u = row(dst.planes[1], y / 2);
+    uint8_t* v = kNv12 ? nullptr : row(dst.planes[2], y / 2);
+    x = 0;
+    if constexpr (kIsa != Isa::Scalar) {
+      x = chroma_row_sse41<kBgr, kNv12>(in, below, u, v, src.width);
+    }
+    chroma_row_scalar<kBgr, kNv12>(in, below, u, v, x, src.width);
+  }
+}
+
+template <Isa kIsa>
+void rgbx_swizzle(const Image& src, const Image& dst, int first, int last) {
+  for (int y = first; y < last; ++y) {
+    const uint8_t* in = row(src.planes[0], y);
+    uint8_t* out = row(dst.planes[0], y);
+    int x{0};
+    if constexpr (kIsa == Isa::AVX2) {
+      x = swizzle_row_avx2(in, out, src.width);
+    } else if constexpr (kIsa == Isa::SSE41) {
+      x = swizzle_row_sse41(in, out, src.width);
+    }
+    swizzle_row_scalar(in, out, x, src.width);
+  }
+}
+
+template <bool kToI420, Isa kIsa>
+void repack_chroma(const Image& src, const Image& dst, int first, int last) {
+  int pairs = (src.width + 1) / 2;
+  for (int y = first; y < last; ++y) {
+    std::memcpy(row(dst.planes[0], y), row(src.planes[0], y), src.width);
+    if (y % 2) continue;
+    int x{0};
+    if constexpr (kToI420) {
+      const uint8_t* uv = row(src.planes[1], y / 2);
+      uint8_t* u = row(dst.planes[1], y / 2);
+      uint8_t* v = row(dst.planes[2], y / 2);
+      if constexpr (kIsa != Isa::Scalar) {
+        x = deinterleave_sse41(uv, u, v, pairs);
+      }
+      deinterleave_scalar(uv, u, v, x, pairs);
+    } else {
+      const uint8_t* u = row(src.planes[1], y / 2);
+      const uint8_t* v = row(src.planes[2], y / 2);
+      uint8_t* uv = row(dst.planes[1], y / 2);
+      if constexpr (kIsa != Isa::Scalar) {
+        x = interleave_sse41(u, v, uv, pairs);
+      }
+      interleave_scalar(u, v, uv, x, pairs);
+    }
+  }
+}
+
+template <Isa kIsa>
+Kernel kernel_for(PixelFormat in, PixelFormat out) {
+  using F = PixelFormat;
+  switch (in) {
+    case F::NV12:
+      if (out == F::I420) return repack_chroma<true, kIsa>;
+      if (out == F::RGBA) return yuv420_to_rgbx<true, false, kIsa>;
+      if (out == F::BGRx) return yuv420_to_rgbx<true, true, kIsa>;
+      break;
+    case F::I420:
+      if (out == F::NV12) return repack_chroma<false, kIsa>;
+      if (out == F::RGBA) return yuv420_to_rgbx<false, false, kIsa>;
+      if (out == F::BGRx) return yuv420_to_rgbx<false, true, kIsa>;
+      break;
+    case F::RGBA:
+      if (out == F::NV12) return rgbx_to_yuv420<false, true, kIsa>;
+      if (out == F::I420) return rgbx_to_yuv420<false, false, kIsa>;
+      if (out == F::BGRx) return rgbx_swizzle<kIsa>;
+      break;
+    case F::BGRx:
+      if (out == F::NV12) return rgbx_to_yuv420<true, true, kIsa>;
+      if (out == F::I420) return rgbx_to_yuv420<true, false, kIsa>;
+      if (out == F::RGBA) return rgbx_swizzle<kIsa>;
+      break;
+  }
+  return nullptr;
+}
+
+bool is_yuv420(PixelFormat format) {
+  return format == PixelFormat::NV12 || format == PixelFormat::I420;
+}
+
+}  // namespace
+
+Isa detect_isa() {
+  static const Isa detected = []() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return Isa::AVX2;
+    if (__builtin_cpu_supports("sse4.1")) return Isa::SSE41;
+    return Isa::Scalar;
+  }();
+  return detected;
+}
+
+std::string_view isa_name(Isa isa) {
+  switch (isa) {
+    case Isa::AVX2:
+      return "avx2";
+    case Isa::SSE41:
+      return "sse4.1";
+    default:
+      return "scalar";
+  }
+}
+
+std::optional<Isa> parse_isa(std::string_view name) {
+  for (auto isa : {Isa::Scalar, Isa::SSE41, Isa::AVX2}) {
+    if (isa_name(isa) == name) return isa;
+  }
+  return std::nullopt;
+}
+
+std::string_view format_name(PixelFormat format) {
+  switch (format) {
+    case PixelFormat::NV12:
+      return "NV12";
+    case PixelFormat::I420:
+      return "I420";
+    case PixelFormat::RGBA:
+      return "RGBA";
+    default:
+      return "BGRx";
+  }
+}
+
+std::optional<PixelFormat> parse_format(std::string_view name) {
+  for (auto format : {PixelFormat::NV12, PixelFormat::I420, PixelFormat::RGBA,
+                      PixelFormat::BGRx}) {
+    if (format_name(format) == name) return format;
+  }
+  return std::nullopt;
+}
+
+Kernel find_kernel(PixelFormat in, PixelFormat out, Isa isa) {
+  switch (std::min(isa, detect_isa())) {
+    case Isa::AVX2:
+      return kernel_for<Isa::AVX2>(in, out);
+    case Isa::SSE41:
+      return kernel_for<Isa::SSE41>(in, out);
+    default:
+      return kernel_for<Isa::Scalar>(in, out);
+  }
+}
+
+SlicePool::SlicePool(unsigned count) {
+  for (unsigned i = 0; i < count; ++i) {
+    workers.emplace_back(&SlicePool::work, this);
+  }
+}
+
+SlicePool::~SlicePool() {
+  {
+    std::lock_guard lock(guard);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& worker : workers) worker.join();
+}
+
+unsigned SlicePool::size() const { return workers.size() + 1; }
+
+void SlicePool::drain() {
+  for (unsigned i = next.fetch_add(1); i < jobSize; i = next.fetch_add(1)) {
+    (*job)(i);
+  }
+}
+
+void SlicePool::work() {
+  uint64_t seen{0};
+  while (true) {
+    {
+      std::unique_lock lock(guard);
+      wake.wait(lock, [&]() { return stopping || generation != seen; });
+      if (stopping) return;
+      seen = generation;
+    }
+    drain();
+    std::lock_guard lock(guard);
+    if (--pending == 0) done.notify_all();
+  }
+}
+
+void SlicePool::run(unsigned count, const std::function<void(unsigned)>& fn) {
+  if (workers.empty() || count <= 1) {
+    for (unsigned i = 0; i < count; ++i) fn(i);
+    return;
+  }
+  {
+    std::lock_guard lock(guard);
+    job = &fn;
+    jobSize = count;
+    next = 0;
+    pending = size();
+    ++generation;
+  }
+  wake.notify_all();
+  drain();
+
+  std::unique_lock lock(guard);
+  if (--pending == 0) return;
+  done.wait(lock, [&]() { return pending == 0; });
+}
+
+bool convert(const Image& src, const Image& dst, Isa isa, SlicePool* pool) {
+  if (src.width != dst.width || src.height != dst.height) return false;
+  Kernel kernel = find_kernel(src.format, dst.format, isa);
+  if (!kernel) return false;
+
+  unsigned slices = pool ? pool->size() : 1;
+  if (src.height < kMinSliceRows * 2) slices = 1;
+  if (slices == 1) {
+    kernel(src, dst, 0, src.height);
+    return true;
+  }
+
+  // 4:2:0 rows come in pairs sharing a chroma row
+  int step = (src.height + slices - 1) / slices;
+  if (is_yuv420(src.format) || is_yuv420(dst.format)) step += step % 2;
+  pool->run(slices, [&](unsigned i) {
+    int first = int(i) * step;
+    int last = std::min(src.height, first + step);
+    if (first < last) kernel(src, dst, first, last);
+  });
+  return true;
+}
+
+}  // namespace vptyp::color
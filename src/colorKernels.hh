@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace vptyp::color {
+
+enum class PixelFormat { NV12, I420, RGBA, BGRx };
+// instruction sets in ascending order, a kernel for one runs on all above
+enum class Isa { Scalar, SSE41, AVX2 };
+
+struct Plane {
+  uint8_t* data{nullptr};
+  int stride{0};
+};
+
+// planes: Y, U, V for I420; Y, UV for NV12; packed pixels for RGBA/BGRx
+struct Image {
+  PixelFormat format{PixelFormat::I420};
+  int width{0};
+  int height{0};
+  std::array<Plane, 3> planes{};
+};
+
+// converts rows [first, last) of src into dst, same dimensions; for 4:2:0
+// outputs first must be even
+using Kernel = void (*)(const Image& src, const Image& dst, int first,
+                        int last);
+
+// best instruction set of the running cpu
+Isa detect_isa();
+std::string_view isa_name(Isa isa);
+std::optional<Isa> parse_isa(std::string_view name);
+
+std::optional<PixelFormat> parse_format(std::string_view name);
+std::string_view format_name(PixelFormat format);
+
+// nullptr when the pair is not supported or equal; isa is capped at the
+// detected one
+Kernel find_kernel(PixelFormat in, PixelFormat out, Isa isa);
+
+// Persistent workers for row slices of one frame; the calling thread takes
+// a slice too.
+class SlicePool {
+ public:
+  explicit SlicePool(unsigned workers);
+  SlicePool(const SlicePool&) = delete;
+  SlicePool& operator=(const SlicePool&) = delete;
+  ~SlicePool();
+
+  unsigned size() const;  // workers plus the caller
+  // fn(i) for every i in [0, count), returns once all of them finished
+  void run(unsigned count, const std::function<void(unsigned)>& fn);
+
+ protected:
+  void work();
+  void drain();
+
+ protected:
+  std::vector<std::thread> workers;
+  std::mutex guard;
+  std::condition_variable wake;
+  std::condition_variable done;
+  uint64_t generation{0};
+  bool stopping{false};
+  const std::function<void(unsigned)>* job{nullptr};
+  unsigned jobSize{0};
+  std::atomic<unsigned> next{0};
+  unsigned pending{0};
+};
+
+// frames shorter than this are not sliced
+constexpr int kMinSliceRows = 128;
+
+// converts the whole frame, sliced over the pool when one is given
+bool convert(const Image& src, const Image& dst, Isa isa,
+             SlicePool* pool = nullptr);
+
+}  // namespace vptyp::color
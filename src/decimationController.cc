@@ -0,0 +1,131 @@
+#include "decimationController.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <format>
+
+#include "elementCatalog.hh"
+
+namespace vptyp {
+
+namespace {
+
+using Decimate = Props<"gstppdecimate">;
+
+}  // namespace
+
+DecimationController::DecimationController(GMainLoop& loop,
+                                           std::vector<Branch> branches)
+    : DecimationController(loop, std::move(branches), Options{}) {}
+
+DecimationController::DecimationController(GMainLoop& loop,
+                                           std::vector<Branch> branches,
+                                           const Options& options)
+    : loop(loop), options(options) {
+  for (auto& branch : branches) {
+    states.emplace_back().branch = std::move(branch);
+  }
+}
+
+DecimationController::~DecimationController() {
+  *alive = false;
+  if (ticker) {
+    g_source_destroy(ticker);
+    g_source_unref(ticker);
+  }
+}
+
+bool DecimationController::attach(Pipeline& pipeline) {
+  std::string pipelineName = GST_ELEMENT_NAME(pipeline.raw());
+  for (auto& state : states) {
+    state.decimator = pipeline.find(state.branch.decimator);
+    if (!state.decimator) {
+      LOG(ERROR) << std::format("no decimator {} in {}",
+                                state.branch.decimator, pipelineName);
+      return false;
+    }
+    if (!state.branch.queue.empty()) {
+      state.queue = pipeline.find(state.branch.queue);
+      if (!state.queue) {
+        LOG(ERROR) << std::format("no queue {} in {}", state.branch.queue,
+                                  pipelineName);
+        return false;
+      }
+    }
+    if (!state.branch.sink.empty()) {
+      auto sink = pipeline.find(state.branch.sink);
+      if (!sink) {
+        LOG(ERROR) << std::format("no sink {} in {}", state.branch.sink,
+                                  pipelineName);
+        return false;
+      }
+      state.sink = sink->raw();
+    }
+    state.keep = Decimate::get<"keep">(state.decimator->raw());
+    state.gauge = &MetricsRegistry::instance().gauge(
+        "gstpp_decimation_keep", "one of this many frames passes a branch",
+        {{"pipeline", pipelineName}, {"element", state.branch.decimator}});
+    state.gauge->set(state.keep);
+  }
+
+  pipeline.add_bus_observer([this, alive = alive](GstMessage* msg) {
+    if (*alive) on_message(msg);
+  });
+  ticker = g_timeout_source_new(options.interval.count());
+  g_source_set_callback(ticker, tick_call, this, nullptr);
+  g_source_attach(ticker, g_main_loop_get_context(&loop));
+  return true;
+}
+
+unsigned DecimationController::next_keep(unsigned keep, unsigned& calm,
+                                         const Sample& sample) const {
+  if (sample.late || sample.fill >= options.high_fill) {
+    calm = 0;
+    return std::min(keep * 2, options.max_keep);
+  }
+  if (sample.fill > options.low_fill || ++calm < options.calm_ticks) {
+    return keep;
+  }
+  calm = 0;
+  return std::max(keep - 1, 1u);
+}
+
+unsigned DecimationController::keep(size_t branch) const {
+  return branch < states.size() ? states[branch].keep : 1;
+}
+
+void DecimationController::on_message(GstMessage* msg) {
+  if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_QOS) return;
+  gint64 jitter{0};
+  gst_message_parse_qos_values(msg, &jitter, nullptr, nullptr);
+  if (jitter <= 0) return;
+  for (auto& state : states) {
+    if (!state.sink || GST_MESSAGE_SRC(msg) == GST_OBJECT(state.sink)) {
+      state.late = true;
+    }
+  }
+}
+
+gboolean DecimationController::tick_call(gpointer data) {
+  static_cast<DecimationController*>(data)->tick();
+  return G_SOURCE_CONTINUE;
+}
+
+void DecimationController::tick() {
+  for (auto& state : states) {
+    Sample sample{.late = state.late.exchange(false)};
+    if (state.queue) sample.fill = Pipeline::queue_level(*state.queue).fill;
+
+    unsigned keep = next_keep(state.keep, state.calm, sample);
+    if (keep == state.keep) continue;
+    LOG(INFO) << std::format("{}: keeping 1 of {} frames ({:.0f}% queued{})",
+                             state.branch.decimator, keep, sample.fill * 100,
+                             sample.late ? ", late" : "");
+    state.keep = keep;
+    Decimate::set<"keep">(state.decimator->raw(), keep);
+    state.gauge->set(keep);
+  }
+}
+
+}  // namespace vptyp
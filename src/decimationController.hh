@@ -0,0 +1,83 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "metrics.hh"
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Adjusts the "keep" ratio of gstppdecimate elements on slow branches, e.g.
+// analytics behind a tee, while the other branches keep full rate. Each tick
+// looks at the fill of the queue in front of the branch and at QoS messages
+// from the branch sink: lateness or a filling queue doubles the ratio, a calm
+// branch lowers it by one step.
+class DecimationController {
+ public:
+  struct Branch {
+    std::string decimator{};  // gstppdecimate alias
+    std::string queue{};  // queue feeding the branch, empty - QoS only
+    std::string sink{};  // QoS source, empty - QoS of any element counts
+  };
+
+  struct Options {
+    std::chrono::milliseconds interval{500};
+    guint max_keep{16};
+    double high_fill{0.7};  // queue fill that counts as falling behind
+    double low_fill{0.3};  // below it the branch may speed up
+    unsigned calm_ticks{4};  // ticks without pressure before stepping down
+  };
+
+  struct Sample {
+    double fill{0};
+    bool late{false};  // QoS reported lateness since the last tick
+  };
+
+  DecimationController(GMainLoop& loop, std::vector<Branch> branches);
+  DecimationController(GMainLoop& loop, std::vector<Branch> branches,
+                       const Options& options);
+  DecimationController(const DecimationController&) = delete;
+  DecimationController& operator=(const DecimationController&) = delete;
+  ~DecimationController();
+
+  // finds the branch elements and starts ticking; call after the graph was
+  // built, the pipeline has to outlive the controller (its bus observer goes
+  // quiet once the controller is gone)
+  bool attach(Pipeline& pipeline);
+  // next ratio for a branch at the current one
+  unsigned next_keep(unsigned keep, unsigned& calm, const Sample& sample) const;
+  unsigned keep(size_t branch) const;
+
+ protected:
+  struct State {
+    Branch branch;
+    Element* decimator{nullptr};  // non-owned
+    Element* queue{nullptr};  // non-owned
+    GstElement* sink{nullptr};  // non-owned
+    // set by the bus handler, which may run on the bus worker thread
+    std::atomic<bool> late{false};
+    unsigned keep{1};
+    unsigned calm{0};
+    Gauge* gauge{nullptr};
+  };
+
+  void on_message(GstMessage* msg);
+  static gboolean tick_call(gpointer data);
+  void tick();
+
+ protected:
+  GMainLoop& loop;
+  Options options;
+  std::deque<State> states;  // not movable
+  GSource* ticker{nullptr};
+  std::shared_ptr<std::atomic<bool>> alive{
+      std::make_shared<std::atomic<bool>>(true)};
+};
+
+}  // namespace vptyp
@@ -0,0 +1,109 @@
+#include "downloadStage.hh"
+
+#include <glog/logging.h>
+
+#include <filesystem>
+#include <format>
+
+namespace vptyp {
+
+DownloadStage::DownloadStage(std::string_view url)
+    : DownloadStage(url, Options{}) {}
+
+DownloadStage::DownloadStage(std::string_view url, const Options& options)
+    : url(url), options(options) {}
+
+PipelineGraph& DownloadStage::add_to(PipelineGraph& graph) const {
+  std::filesystem::path directory = options.directory.empty()
+                                        ? std::filesystem::path(g_get_tmp_dir())
+                                        : options.directory;
+  graph.add("souphttpsrc", "web-source")
+      .set("location", url)
+      .set("retries", options.retries)
+      .set("timeout", options.timeout_s)
+      .set("keep-alive", true)
+      .then("queue2", "download-buffer")
+      // a temp template switches queue2 into download mode, downstream
+      // activates in pull mode and unread ranges become range requests
+      .set("temp-template", (directory / "gstpp-download-XXXXXX").string())
+      .set("use-buffering", true)
+      .set("max-size-bytes", options.max_bytes)
+      .set("max-size-buffers", 0)
+      .set("max-size-time", 0)
+      .set("low-watermark", options.low_watermark)
+      .set("high-watermark", options.high_watermark);
+  if (options.ring_buffer_bytes) {
+    graph.set("ring-buffer-max-size", options.ring_buffer_bytes);
+  }
+  return graph;
+}
+
+void DownloadStage::attach(Pipeline& pipeline) {
+  auto sourceElement = pipeline.find("web-source");
+  auto bufferElement = pipeline.find("download-buffer");
+  if (!sourceElement || !bufferElement) {
+    LOG(ERROR) << "download stage is not part of the pipeline";
+    return;
+  }
+  this->pipeline = &pipeline;
+  source = sourceElement->raw();
+  buffer = bufferElement->raw();
+  pipeline.add_bus_observer([this](GstMessage* msg) { on_message(msg); });
+}
+
+void DownloadStage::on_message(GstMessage* msg) {
+  if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_BUFFERING ||
+      GST_MESSAGE_SRC(msg) != GST_OBJECT(buffer)) {
+    return;
+  }
+
+  gint value{0};
+  gst_message_parse_buffering(msg, &value);
+  GstBufferingMode mode;
+  gint in{0}, out{0};
+  gint64 left{0};
+  gst_message_parse_buffering_stats(msg, &mode, &in, &out, &left);
+  percent = value;
+  avgIn = in;
+
+  GstState current{GST_STATE_NULL}, pending{GST_STATE_VOID_PENDING};
+  gst_element_get_state(pipeline->raw(), &current, &pending, 0);
+  bool playing = current == GST_STATE_PLAYING || pending == GST_STATE_PLAYING;
+
+  if (value < 100 && playing && !buffering) {
+    buffering = true;
+    LOG(INFO) << std::format("{}: buffering at {}%, {} B/s in, pausing", url,
+                             value, in);
+    gst_element_set_state(pipeline->raw(), GST_STATE_PAUSED);
+  } else if (value >= 100 && buffering) {
+    buffering = false;
+    LOG(INFO) << std::format("{}: buffered, resuming", url);
+    gst_element_set_state(pipeline->raw(), GST_STATE_PLAYING);
+  }
+}
+
+DownloadStage::Progress DownloadStage::progress() const {
+  Progress result{.percent = percent.load(),
+                  .buffering = buffering.load(),
+                  .avg_in = avgIn.load()};
+  if (!buffer) return result;
+
+  GstQuery* query = gst_query_new_buffering(GST_FORMAT_BYTES);
+  if (gst_element_query(buffer, query)) {
+    for (guint i = 0; i < gst_query_get_n_buffering_ranges(query); ++i) {
+      gint64 start{0}, stop{0};
+      gst_query_parse_nth_buffering_range(query, i, &start, &stop);
+      if (stop > start) result.downloaded += stop - start;
+    }
+  }
+  gst_query_unref(query);
+
+  gint64 total{0};
+  if (gst_element_query_duration(source, GST_FORMAT_BYTES, &total) &&
+      total > 0) {
+    result.total = total;
+  }
+  return result;
+}
+
+}  // namespace vptyp
@@ -0,0 +1,63 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <string>
+#include <string_view>
+
+#include "pipeline.hh"
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+// souphttpsrc followed by queue2 in download mode. The download lands in a
+// temp file (or a ring buffer on disk) and qtdemux pulls from it at random
+// offsets, so a moov atom at the end of the file is fetched with a range
+// request up front instead of buffering the whole mdat. A dropped connection
+// is resumed with a range request from the last received byte.
+class DownloadStage {
+ public:
+  struct Options {
+    std::string directory{};  // temp files, empty - system temp dir
+    guint64 ring_buffer_bytes{0};  // 0 - keep the whole download
+    guint max_bytes{8 * 1024 * 1024};  // in memory ahead of the demuxer
+    int retries{8};   // reconnects, -1 - forever
+    guint timeout_s{15};  // per request
+    double low_watermark{0.01};
+    double high_watermark{0.99};
+  };
+
+  struct Progress {
+    int percent{0};  // buffering level, 100 - enough to run
+    bool buffering{false};  // pipeline held in PAUSED to refill
+    guint64 downloaded{0};  // bytes in the download file
+    guint64 total{0};  // content length, 0 - unknown
+    gint avg_in{0};  // bytes/s
+  };
+
+  explicit DownloadStage(std::string_view url);
+  DownloadStage(std::string_view url, const Options& options);
+
+  // adds "web-source" ! "download-buffer" to the graph, the buffer is the
+  // current node afterwards so the graph continues from it
+  PipelineGraph& add_to(PipelineGraph& graph) const;
+  // follows buffering messages: pauses a playing pipeline on underrun and
+  // resumes it once refilled; call after the graph was built
+  void attach(Pipeline& pipeline);
+  Progress progress() const;
+
+ protected:
+  void on_message(GstMessage* msg);
+
+ protected:
+  std::string url;
+  Options options;
+  Pipeline* pipeline{nullptr};  // non-owned
+  GstElement* source{nullptr};  // non-owned
+  GstElement* buffer{nullptr};  // non-owned
+  std::atomic<int> percent{0};
+  std::atomic<bool> buffering{false};
+  std::atomic<gint> avgIn{0};
+};
+
+}  // namespace vptyp
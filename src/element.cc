@@ -4,37 +4,238 @@
 #include <glog/logging.h>
 
 #include <format>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
 #include <string_view>
 
+#include "bufferPool.hh"
 #include "glib-object.h"
+#include "metrics.hh"
 
 namespace vptyp {
 
-bool Element::on_pad_added(GstElement* src, GstPad* new_pad,
-                           GstElement* target) {
-  GstPad* sink_pad = gst_element_get_static_pad(target, "sink");
+namespace {
+
+// caps a new pad carries, owned
+GstCaps* pad_caps(GstPad* pad) {
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  return caps ? caps : gst_pad_query_caps(pad, nullptr);
+}
+
+std::string media_of(GstCaps* caps) {
+  if (gst_caps_is_empty(caps) || gst_caps_is_any(caps)) return "any";
+  return gst_structure_get_name(gst_caps_get_structure(caps, 0));
+}
+
+// takes the pad reference, hands it back while the pad is unlinked and
+// accepts the caps
+GstPad* free_sink(GstPad* pad, GstCaps* caps) {
+  GstCaps* accepted = gst_pad_query_caps(pad, nullptr);
+  bool free = !gst_pad_is_linked(pad) && gst_caps_can_intersect(caps, accepted);
+  gst_caps_unref(accepted);
+  if (free) return pad;
+  gst_object_unref(pad);
+  return nullptr;
+}
+
+GstPadTemplate* request_template(GstElement* target, GstCaps* caps) {
+  GList* templates =
+      gst_element_class_get_pad_template_list(GST_ELEMENT_GET_CLASS(target));
+  for (GList* l = templates; l != nullptr; l = l->next) {
+    auto templ = static_cast<GstPadTemplate*>(l->data);
+    if (GST_PAD_TEMPLATE_DIRECTION(templ) != GST_PAD_SINK ||
+        GST_PAD_TEMPLATE_PRESENCE(templ) != GST_PAD_REQUEST) {
+      continue;
+    }
+    GstCaps* templateCaps = gst_pad_template_get_caps(templ);
+    bool fits = gst_caps_can_intersect(caps, templateCaps);
+    gst_caps_unref(templateCaps);
+    if (fits) return templ;
+  }
+  return nullptr;
+}
 
-  // Check if the sink is already linked (e.g., if multiple pads are found)
-  if (gst_pad_is_linked(sink_pad)) {
-    g_object_unref(sink_pad);
+bool accepts(GstElement* target, GstCaps* caps) {
+  if (GstPad* pad = gst_element_get_static_pad(target, "sink")) {
+    GstPad* free = free_sink(pad, caps);
+    if (!free) return false;
+    gst_object_unref(free);
     return true;
   }
+  return request_template(target, caps) != nullptr;
+}
+
+std::string_view factory_name(GstElement* element) {
+  GstElementFactory* factory = gst_element_get_factory(element);
+  return factory ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory))
+                 : "";
+}
+
+// scale is bit/s per unit of the returned property, nullptr if there is none
+const char* bitrate_property(GstElement* encoder, double& scale) {
+  GObjectClass* klass = G_OBJECT_GET_CLASS(encoder);
+  scale = 1000;  // kbit/s for x264enc, x265enc, nvh264enc, va*
+  if (g_object_class_find_property(klass, "target-bitrate")) {
+    scale = 1;  // vp8enc, vp9enc, rav1enc in bit/s
+    return "target-bitrate";
+  }
+  if (!g_object_class_find_property(klass, "bitrate")) return nullptr;
+  if (factory_name(encoder) == "openh264enc") scale = 1;
+  return "bitrate";
+}
+
+// everything an element needs from the registry, looked up once per
+// factory name instead of on every construction
+struct CachedFactory {
+  GstElementFactory* factory{nullptr};  // owned, plugin loaded
+  Element::PadTypes padType{Element::PadTypes::Undefined};
+  Counter* created{nullptr};
+};
+
+std::mutex factories_guard;
+std::map<std::string, CachedFactory, std::less<>> factories;
+
+// nullopt if there is no such factory or its plugin does not load
+std::optional<CachedFactory> cached_factory(std::string_view name) {
+  std::lock_guard lock(factories_guard);
+  if (auto it = factories.find(name); it != factories.end()) {
+    return it->second;
+  }
+  std::string key(name);
+  GstElementFactory* found = gst_element_factory_find(key.c_str());
+  if (!found) return std::nullopt;
+  auto loaded = GST_ELEMENT_FACTORY(
+      gst_plugin_feature_load(GST_PLUGIN_FEATURE(found)));
+  gst_object_unref(found);
+  if (!loaded) return std::nullopt;
+  CachedFactory entry{
+      .factory = loaded,
+      .created = &MetricsRegistry::instance().counter(
+          "gstpp_elements_created_total", "elements created",
+          {{"factory", key}})};
+  return factories.emplace(std::move(key), entry).first->second;
+}
+
+void cache_pad_type(std::string_view name, Element::PadTypes padType) {
+  std::lock_guard lock(factories_guard);
+  if (auto it = factories.find(name); it != factories.end()) {
+    it->second.padType = padType;
+  }
+}
+
+}  // namespace
+
+GstPad* Element::target_pad(GstElement* target, GstCaps* caps) {
+  if (GstPad* pad = gst_element_get_static_pad(target, "sink")) {
+    return free_sink(pad, caps);
+  }
+  GstPadTemplate* templ = request_template(target, caps);
+  return templ ? gst_element_request_pad(target, templ, nullptr, caps)
+               : nullptr;
+}
+
+bool Element::on_pad_added(GstElement* src, GstPad* new_pad,
+                           GstElement* target) {
+  GstCaps* caps = pad_caps(new_pad);
+  GstPad* sink_pad = target_pad(target, caps);
+  gst_caps_unref(caps);
+  if (!sink_pad) {
+    LOG(ERROR) << "No free pad for dynamic pad on "
+               << GST_ELEMENT_NAME(target);
+    return false;
+  }
+
   bool state{false};
-  // Check if the new pad's caps are compatible with the target
   GstPadLinkReturn ret = gst_pad_link(new_pad, sink_pad);
   if (GST_PAD_LINK_FAILED(ret)) {
     LOG(ERROR) << "Failed to link dynamic pad to "
-               << gst_element_get_name(target);
+               << GST_ELEMENT_NAME(target);
+    GstPadTemplate* templ = GST_PAD_PAD_TEMPLATE(sink_pad);
+    if (templ && GST_PAD_TEMPLATE_PRESENCE(templ) == GST_PAD_REQUEST) {
+      gst_element_release_request_pad(target, sink_pad);
+    }
   } else {
-    LOG(INFO) << "Successfully linked dynamic pad to "
-              << gst_element_get_name(target);
+    LOG(INFO) << std::format("Successfully linked dynamic pad {} to {}:{}",
+                             GST_PAD_NAME(new_pad), GST_ELEMENT_NAME(target),
+                             GST_PAD_NAME(sink_pad));
     state = true;
   }
 
-  g_object_unref(sink_pad);
+  gst_object_unref(sink_pad);
   return state;
 }
 
+void Element::on_no_more_pads(GstElement* src) {
+  for (auto& route : routes) {
+    auto pad = make_gst(gst_element_get_static_pad(route.target, "sink"));
+    if (!pad || gst_pad_is_linked(pad.get())) continue;
+    LOG(WARNING) << std::format("{}: no pad for {}, ending its branch", alias,
+                                GST_ELEMENT_NAME(route.target));
+    gst_pad_send_event(pad.get(), gst_event_new_eos());
+  }
+}
+
+GstElement* Element::pick_route(GstCaps* caps) const {
+  for (bool filtered : {true, false}) {
+    for (auto& route : routes) {
+      if ((route.caps != nullptr) != filtered) continue;
+      if (route.caps && !gst_caps_can_intersect(caps, route.caps)) continue;
+      if (accepts(route.target, caps)) return route.target;
+    }
+  }
+  return nullptr;
+}
+
+void Element::drain(GstElement* src, GstPad* pad) {
+  auto parent = GST_ELEMENT(gst_element_get_parent(src));
+  if (!parent) return;
+  GstElement* sink = gst_element_factory_make("fakesink", nullptr);
+  g_object_set(sink, "sync", FALSE, "async", FALSE, nullptr);
+  gst_bin_add(GST_BIN(parent), sink);
+  gst_element_sync_state_with_parent(sink);
+  auto sinkPad = make_gst(gst_element_get_static_pad(sink, "sink"));
+  gst_pad_link(pad, sinkPad.get());
+  gst_object_unref(parent);
+}
+
+void Element::pad_added_call(GstElement* src, GstPad* pad, gpointer data) {
+  auto that = static_cast<Element*>(data);
+  if (GST_PAD_DIRECTION(pad) != GST_PAD_SRC) return;
+
+  GstCaps* caps = pad_caps(pad);
+  std::string media = media_of(caps);
+  GstElement* target = that->pick_route(caps);
+  gst_caps_unref(caps);
+  if (target && that->on_pad_added(src, pad, target)) return;
+
+  // an unlinked pad would stop its stream with not-linked
+  LOG(WARNING) << std::format("{}: no route for pad {} ({}), draining it",
+                              that->alias, GST_PAD_NAME(pad), media);
+  drain(src, pad);
+}
+
+void Element::no_more_pads_call(GstElement* src, gpointer data) {
+  static_cast<Element*>(data)->on_no_more_pads(src);
+}
+
+void Element::connect_router() {
+  if (pad_added_id || !element) return;
+  pad_added_id = g_signal_connect(element.get(), "pad-added",
+                                  G_CALLBACK(pad_added_call), this);
+  no_more_pads_id = g_signal_connect(element.get(), "no-more-pads",
+                                     G_CALLBACK(no_more_pads_call), this);
+}
+
+void Element::disconnect_router() {
+  if (element && pad_added_id) {
+    g_signal_handler_disconnect(element.get(), pad_added_id);
+    g_signal_handler_disconnect(element.get(), no_more_pads_id);
+  }
+  pad_added_id = no_more_pads_id = 0;
+}
+
 Element::PadTypes checkPadType(GstElement* element) {
   GstElementClass* klass = GST_ELEMENT_GET_CLASS(element);
   GList* templates = gst_element_class_get_pad_template_list(klass);
@@ -53,21 +254,41 @@ Element::PadTypes checkPadType(GstElement* element) {
 
 Element::Element(std::string_view element_name, std::string_view alias)
     : name(element_name), alias(alias) {
-  this->element = decltype(element)(
-      gst_element_factory_make(name.data(), alias.data()), {});
+  auto factory = cached_factory(name);
+  if (factory) {
+    this->element = decltype(element)(
+        gst_element_factory_create(factory->factory, alias.data()), {});
+  }
 
   if (!this->element) {
+    MetricsRegistry::instance()
+        .counter("gstpp_element_failures_total",
+                 "elements that could not be created", {{"factory", name}})
+        .inc();
     LOG(ERROR) << std::format("element {} was not created", element_name);
     return;
   }
+  factory->created->inc();
 
-  this->padType = checkPadType(this->element.get());
+  this->padType = factory->padType;
+  if (this->padType == PadTypes::Undefined) {
+    this->padType = checkPadType(this->element.get());
+    cache_pad_type(name, this->padType);
+  }
   LOG(INFO) << std::format("element: {}; alias: {}; created: {}; padType: {}",
                            name, alias, uint64_t(element.get()),
                            static_cast<int>(this->padType));
 }
 
+bool Element::prefetch(std::string_view factory) {
+  return cached_factory(factory).has_value();
+}
+
 Element::~Element() {
+  disconnect_router();
+  for (auto& route : routes) {
+    if (route.caps) gst_caps_unref(route.caps);
+  }
   if (owned) {
     void* ptr = element.release();
     (void)ptr;
@@ -78,34 +299,33 @@ bool Element::is_expired() { return !element && owned; }
 
 bool Element::is_initialised() { return element.get(); }
 
-void Element::handle_dynamic_pad(Element& element) {
-  GstElement* target = element.element.get();
-  auto elementLambda = [this, target](GstElement* src, GstPad* pad,
-                                      gpointer data) {
-    this->on_pad_added(src, pad, target);
-  };
-  using LambdaType = decltype(elementLambda);
-  auto* lambdaPtr = new LambdaType(std::move(elementLambda));
-  g_signal_connect_data(
-      this->element.get(), "pad-added",
-      reinterpret_cast<void (*)()>(
-          +[](GstElement* src, GstPad* pad, gpointer data) {
-            auto* func = static_cast<LambdaType*>(data);
-            (*func)(src, pad, nullptr);
-          }),
-      lambdaPtr,
-      +[](gpointer data, GClosure* closure) {
-        delete static_cast<LambdaType*>(data);
-      },
-      GConnectFlags(0));
-  LOG(INFO) << "linkage would be dynamically handled";
+GstElement* Element::raw() const { return element.get(); }
+
+const std::string& Element::get_name() const { return name; }
+
+const std::string& Element::get_alias() const { return alias; }
+
+Element::PadTypes Element::pad_type() const { return padType; }
+
+bool Element::route(Element& target, std::string_view caps) {
+  if (!element || !target.element) return false;
+  GstCaps* filter{nullptr};
+  if (!caps.empty()) {
+    filter = gst_caps_from_string(std::string(caps).c_str());
+    if (!filter) {
+      LOG(ERROR) << std::format("{}: bad route caps {}", alias, caps);
+      return false;
+    }
+  }
+  routes.push_back({target.element.get(), filter});
+  connect_router();
+  LOG(INFO) << std::format("{}: pads of {} routed to {}", alias,
+                           caps.empty() ? "any caps" : caps, target.alias);
+  return true;
 }
 
 bool Element::link(Element& element) {
-  if (padType == PadTypes::Sometime) {
-    handle_dynamic_pad(element);
-    return true;
-  }
+  if (padType == PadTypes::Sometime) return route(element);
 
   auto res = gst_element_link(this->element.get(), element.element.get());
   if (!res) {
@@ -122,8 +342,7 @@ bool Element::link(std::list<Element>::iterator begin,
   auto next = std::next(begin);
 
   if (padType == PadTypes::Sometime) {
-    handle_dynamic_pad(*begin);
-    return begin->link(next, end);
+    return route(*begin) && begin->link(next, end);
   }
   if (!gst_element_link(this->element.get(), begin->element.get())) {
     LOG(INFO) << std::format("Failed linkage of {} and {}", this->alias,
@@ -133,17 +352,127 @@ bool Element::link(std::list<Element>::iterator begin,
   return begin->link(next, end);
 }
 
+GstPadProbeReturn Element::allocation_probe(GstPad* pad,
+                                            GstPadProbeInfo* info,
+                                            gpointer data) {
+  GstQuery* query = GST_PAD_PROBE_INFO_QUERY(info);
+  if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION) return GST_PAD_PROBE_OK;
+
+  auto pool = static_cast<std::shared_ptr<BufferPool>*>(data);
+  if (!(*pool)->decide_allocation(query)) {
+    LOG(WARNING) << std::format("buffer pool was not offered on {}",
+                                GST_PAD_NAME(pad));
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+bool Element::use_buffer_pool(std::shared_ptr<BufferPool> pool) {
+  auto srcPad = make_gst(gst_element_get_static_pad(element.get(), "src"));
+  if (!srcPad) {
+    LOG(ERROR) << std::format("element {} has no static src pad for a pool",
+                              alias);
+    return false;
+  }
+
+  // probe the answered query (PULL), so the pool ends up first in the list
+  // the element picks from in its decide_allocation
+  gst_pad_add_probe(
+      srcPad.get(),
+      GstPadProbeType(GST_PAD_PROBE_TYPE_QUERY_DOWNSTREAM |
+                      GST_PAD_PROBE_TYPE_PULL),
+      allocation_probe, new std::shared_ptr<BufferPool>(std::move(pool)),
+      +[](gpointer data) {
+        delete static_cast<std::shared_ptr<BufferPool>*>(data);
+      });
+  return true;
+}
+
 Element::Element(Element&& other) {
+  // signal handlers carry the object address, they follow the move
+  other.disconnect_router();
   element = std::move(other.element);
   std::swap(name, other.name);
   std::swap(alias, other.alias);
   std::swap(padType, other.padType);
   std::swap(owned, other.owned);
+  std::swap(routes, other.routes);
+  if (!routes.empty()) connect_router();
+}
+
+bool Element::set_live(std::string_view property, std::string_view value) {
+  return element && set_live(element.get(), property, value);
+}
+
+bool Element::set_live(GstElement* element, std::string_view property,
+                       std::string_view value) {
+  std::string key(property);
+  GParamSpec* spec =
+      g_object_class_find_property(G_OBJECT_GET_CLASS(element), key.c_str());
+  if (!spec || !(spec->flags & G_PARAM_WRITABLE)) {
+    LOG(ERROR) << std::format("{} has no writable property {}",
+                              GST_ELEMENT_NAME(element), property);
+    return false;
+  }
+  // the element takes the object lock, the state is a snapshot either way
+  GstState state = GST_STATE(element);
+  bool mutableNow = state <= GST_STATE_READY ||
+                    (spec->flags & GST_PARAM_MUTABLE_PLAYING) ||
+                    (state == GST_STATE_PAUSED &&
+                     (spec->flags & GST_PARAM_MUTABLE_PAUSED));
+  if (!mutableNow) {
+    LOG(ERROR) << std::format("{} of {} cannot change in {}", property,
+                              GST_ELEMENT_NAME(element),
+                              gst_element_state_get_name(state));
+    return false;
+  }
+  gst_util_set_object_arg(G_OBJECT(element), key.c_str(),
+                          std::string(value).c_str());
+  return true;
+}
+
+bool Element::set_bitrate(guint bps) {
+  return element && set_bitrate(element.get(), bps);
+}
+
+bool Element::set_bitrate(GstElement* encoder, guint bps) {
+  double scale{1};
+  const char* property = bitrate_property(encoder, scale);
+  if (!property) {
+    LOG(ERROR) << std::format("{} has no bitrate",
+                              GST_ELEMENT_NAME(encoder));
+    return false;
+  }
+  return set_live(encoder, property, std::to_string(guint64(bps / scale)));
+}
+
+double Element::bitrate(GstElement* encoder) {
+  double scale{1};
+  const char* property = bitrate_property(encoder, scale);
+  if (!property) return 0;
+
+  GValue value = G_VALUE_INIT;
+  GValue converted = G_VALUE_INIT;
+  g_value_init(&converted, G_TYPE_DOUBLE);
+  g_object_get_property(G_OBJECT(encoder), property, &value);
+  double result{0};
+  if (g_value_transform(&value, &converted)) {
+    result = g_value_get_double(&converted) * scale;
+  }
+  g_value_unset(&value);
+  g_value_unset(&converted);
+  return result;
 }
 
 Element& Element::operator=(Element&& other) {
   if (this == &other) return *this;
 
+  disconnect_router();
+  for (auto& route : routes) {
+    if (route.caps) gst_caps_unref(route.caps);
+  }
+  other.disconnect_router();
+  routes = std::move(other.routes);
+  other.routes.clear();
   element = std::move(other.element);
   name = std::move(other.name);
   alias = std::move(other.alias);
@@ -152,6 +481,7 @@ Element& Element::operator=(Element&& other) {
 
   other.padType = PadTypes::Undefined;
   other.owned = false;
+  if (!routes.empty()) connect_router();
   return *this;
 }
 }  // namespace vptyp
\ No newline at end of file
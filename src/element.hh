@@ -4,27 +4,43 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <type_traits>
+#include <vector>
 
 #include "gst/gstelement.h"
 #include "gstDeleter.hh"
 namespace vptyp {
 
 class Pipeline;
+class BufferPool;
 
 class Element {
  public:
-  Element(std::string_view element_name, std::string_view alias);  // factory
+  // factory lookups and the pad type are cached per factory name, so
+  // repeated construction skips the registry
+  Element(std::string_view element_name, std::string_view alias);
   Element(Element&& other);
   Element& operator=(Element&& other);
   Element(Element& other) = delete;
   Element& operator=(Element&) = delete;
   virtual ~Element();
 
+  // loads the factory and its plugin into the cache ahead of construction
+  static bool prefetch(std::string_view factory);
+
   bool is_initialised();
   bool is_expired();
 
+  // non-owned access to the underlying gst element
+  GstElement* raw() const;
+  const std::string& get_name() const;
+  const std::string& get_alias() const;
+
+  enum class PadTypes { Undefined, Always, Sometime };
+  PadTypes pad_type() const;
+
   template <typename... Args>
   void object_set(Args&&... properties);
 
@@ -34,18 +50,59 @@ class Element {
   template <typename... Args>
   void child_proxy_set(Args&&... properties);
 
+  // static pads are linked right away; pads this element adds later are
+  // routed by caps, see route()
   bool link(Element& element);
 
   bool link(std::list<Element>::iterator begin,
             std::list<Element>::iterator end);
 
-  enum class PadTypes { Undefined, Always, Sometime };
+  // pads added later whose caps intersect the filter go to the target, to
+  // its free static "sink" pad or to a new pad of a matching request
+  // template (e.g. a muxer's "audio_%u"); without a filter a pad goes to the
+  // first target whose sink accepts its caps. Pads no route takes are
+  // drained into a fakesink, targets still waiting once no more pads come
+  // get an EOS so their branch does not hold the preroll back
+  bool route(Element& target, std::string_view caps = {});
+
+  // element allocates its output buffers from the given pool
+  bool use_buffer_pool(std::shared_ptr<BufferPool> pool);
+
+  // changes a property of a running element from its gst-launch form;
+  // refused unless the property is flagged mutable in the current state
+  bool set_live(std::string_view property, std::string_view value);
+  static bool set_live(GstElement* element, std::string_view property,
+                       std::string_view value);
+  // encoders disagree on the bitrate property and its unit, these take and
+  // give bit/s; false or 0 for an element without one
+  bool set_bitrate(guint bps);
+  static bool set_bitrate(GstElement* encoder, guint bps);
+  static double bitrate(GstElement* encoder);
 
  protected:
+  struct Route {
+    GstElement* target{nullptr};  // non-owned
+    GstCaps* caps{nullptr};  // owned, nullptr - whatever the target accepts
+  };
+
+  // links the new pad to the pad of target picked for its caps
   virtual bool on_pad_added(GstElement* src, GstPad* new_pad,
                             GstElement* target);
-
-  virtual void handle_dynamic_pad(Element& element);
+  virtual void on_no_more_pads(GstElement* src);
+
+  // target of the first route taking the caps, filtered routes go first
+  GstElement* pick_route(GstCaps* caps) const;
+  // free static sink pad or new request pad of target for caps, owned ref
+  static GstPad* target_pad(GstElement* target, GstCaps* caps);
+  static void drain(GstElement* src, GstPad* pad);
+  // one handler per signal with this as data, moved along with the element
+  void connect_router();
+  void disconnect_router();
+  static void pad_added_call(GstElement* src, GstPad* pad, gpointer data);
+  static void no_more_pads_call(GstElement* src, gpointer data);
+
+  static GstPadProbeReturn allocation_probe(GstPad* pad, GstPadProbeInfo* info,
+                                            gpointer data);
 
  protected:
   friend Pipeline;  // pipeline can access any private field
@@ -55,6 +112,9 @@ class Element {
   std::string alias{};
   PadTypes padType{PadTypes::Undefined};
   bool owned{false};  // is it owned by a pipeline?
+  std::vector<Route> routes{};
+  gulong pad_added_id{0};
+  gulong no_more_pads_id{0};
 };
 
 template <typename... Args>
@@ -0,0 +1,122 @@
+#include "elementCatalog.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+#include <string>
+
+namespace vptyp::catalog {
+
+GParamSpec* resolve(GObject* object, std::string_view factory,
+                    const char* name, GType expected) {
+  // listing keeps overrides as they are, find_property() would redirect
+  // them to the overridden spec and its class
+  guint count{0};
+  GParamSpec** specs =
+      g_object_class_list_properties(G_OBJECT_GET_CLASS(object), &count);
+  GParamSpec* found{nullptr};
+  for (guint i = 0; i < count && !found; ++i) {
+    if (std::string_view(g_param_spec_get_name(specs[i])) == name) {
+      found = specs[i];
+    }
+  }
+  g_free(specs);
+  if (!found) {
+    LOG(ERROR) << std::format("{} has no property {}", factory, name);
+    return nullptr;
+  }
+
+  GType type = G_PARAM_SPEC_VALUE_TYPE(found);
+  bool matches = expected == G_TYPE_INVALID
+                     ? G_TYPE_IS_ENUM(type) || G_TYPE_IS_FLAGS(type)
+                     : G_TYPE_FUNDAMENTAL(type) == expected;
+  if (!matches) {
+    LOG(ERROR) << std::format("{} property {} is a {}, not what the catalog "
+                              "says",
+                              factory, name, g_type_name(type));
+    return nullptr;
+  }
+  // specs live as long as their class, classes of elements are never freed
+  return found;
+}
+
+namespace {
+
+// class whose set_property/get_property handle the spec directly, nullptr
+// when it has to go through the generic path; specs are cached per factory
+// name, an object of another type must not reach the owner's vfuncs
+GObjectClass* owner(GObject* object, GParamSpec* spec) {
+  if (G_IS_PARAM_SPEC_OVERRIDE(spec) ||
+      G_TYPE_IS_INTERFACE(spec->owner_type) ||
+      !g_type_is_a(G_OBJECT_TYPE(object), spec->owner_type)) {
+    return nullptr;
+  }
+  return G_OBJECT_CLASS(g_type_class_peek(spec->owner_type));
+}
+
+}  // namespace
+
+bool set(GObject* object, GParamSpec* spec, GValue& value) {
+  if (!(spec->flags & G_PARAM_WRITABLE) ||
+      (spec->flags & G_PARAM_CONSTRUCT_ONLY)) {
+    LOG(ERROR) << std::format("property {} cannot be set now", spec->name);
+    return false;
+  }
+  GObjectClass* klass = owner(object, spec);
+  if (!klass) {
+    g_object_set_property(object, spec->name, &value);
+    return true;
+  }
+  if (g_param_value_validate(spec, &value) &&
+      !(spec->flags & G_PARAM_LAX_VALIDATION)) {
+    LOG(ERROR) << std::format("value out of range for property {}",
+                              spec->name);
+    return false;
+  }
+  klass->set_property(object, spec->param_id, &value, spec);
+  if (!(spec->flags & G_PARAM_EXPLICIT_NOTIFY)) {
+    g_object_notify_by_pspec(object, spec);
+  }
+  return true;
+}
+
+bool get(GObject* object, GParamSpec* spec, GValue& value) {
+  if (!(spec->flags & G_PARAM_READABLE)) {
+    LOG(ERROR) << std::format("property {} is not readable", spec->name);
+    return false;
+  }
+  GObjectClass* klass = owner(object, spec);
+  if (!klass) {
+    g_object_get_property(object, spec->name, &value);
+    return true;
+  }
+  klass->get_property(object, spec->param_id, &value, spec);
+  return true;
+}
+
+std::string nick(const GValue& value) {
+  std::string result;
+  if (G_VALUE_HOLDS_ENUM(&value)) {
+    auto klass =
+        static_cast<GEnumClass*>(g_type_class_ref(G_VALUE_TYPE(&value)));
+    if (GEnumValue* found = g_enum_get_value(klass, g_value_get_enum(&value))) {
+      result = found->value_nick;
+    }
+    g_type_class_unref(klass);
+  } else if (G_VALUE_HOLDS_FLAGS(&value)) {
+    auto klass =
+        static_cast<GFlagsClass*>(g_type_class_ref(G_VALUE_TYPE(&value)));
+    guint flags = g_value_get_flags(&value);
+    for (guint i = 0; i < klass->n_values; ++i) {
+      guint bits = klass->values[i].value;
+      if (!bits || (flags & bits) != bits) continue;
+      if (!result.empty()) result += '+';
+      result += klass->values[i].value_nick;
+      flags &= ~bits;
+    }
+    g_type_class_unref(klass);
+  }
+  return result;
+}
+
+}  // namespace vptyp::catalog
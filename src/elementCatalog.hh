@@ -0,0 +1,305 @@
+#pragma once
+#include <glib-object.h>
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "element.hh"
+
+namespace vptyp {
+
+// Typed element catalog. Factories and their properties are described at
+// compile time, so a property the catalog does not know or a value of the
+// wrong type fails to build:
+//
+//   Elem<"x264enc"> encoder("encoder");
+//   encoder.set<"bitrate">(2500u);        // kbit/s
+//   encoder.set<"tune">("zerolatency");   // enum and flags by nick
+//   guint keep = Props<"gstppdecimate">::get<"keep">(element.raw());
+//
+// Every property is resolved to its GParamSpec once per process and then
+// set through the owning class directly, without the lookup by name
+// g_object_set() does on every call.
+
+// string usable as a template argument
+template <size_t N>
+struct FixedString {
+  char value[N]{};
+  constexpr FixedString(const char (&text)[N]) {
+    std::copy_n(text, N, value);
+  }
+  constexpr std::string_view view() const { return {value, N - 1}; }
+  constexpr const char* c_str() const { return value; }
+};
+
+// enum or flags property, set and read by nick
+struct Nick {};
+
+template <FixedString Name, typename T>
+struct Prop {
+  static constexpr auto name = Name;
+  using type = T;
+};
+
+template <typename... Properties>
+struct PropList {};
+
+// specialised below for every factory in the catalog
+template <FixedString Factory>
+struct Catalog;
+
+template <>
+struct Catalog<"queue"> {
+  using Properties = PropList<
+      Prop<"max-size-buffers", guint>, Prop<"max-size-bytes", guint>,
+      Prop<"max-size-time", guint64>, Prop<"min-threshold-time", guint64>,
+      Prop<"current-level-buffers", guint>,
+      Prop<"current-level-bytes", guint>,
+      Prop<"current-level-time", guint64>, Prop<"leaky", Nick>>;
+};
+
+template <>
+struct Catalog<"queue2"> {
+  using Properties = PropList<
+      Prop<"max-size-buffers", guint>, Prop<"max-size-bytes", guint>,
+      Prop<"max-size-time", guint64>, Prop<"current-level-buffers", guint>,
+      Prop<"current-level-bytes", guint64>,
+      Prop<"current-level-time", guint64>, Prop<"use-buffering", bool>>;
+};
+
+template <>
+struct Catalog<"x264enc"> {
+  using Properties =
+      PropList<Prop<"bitrate", guint>,  // kbit/s
+               Prop<"key-int-max", guint>, Prop<"bframes", guint>,
+               Prop<"b-adapt", bool>, Prop<"sliced-threads", bool>,
+               Prop<"vbv-buf-capacity", guint>, Prop<"tune", Nick>,
+               Prop<"speed-preset", Nick>>;
+};
+
+template <>
+struct Catalog<"openh264enc"> {
+  using Properties =
+      PropList<Prop<"bitrate", guint>,  // bit/s
+               Prop<"gop-size", guint>, Prop<"complexity", Nick>>;
+};
+
+template <>
+struct Catalog<"vp8enc"> {
+  using Properties =
+      PropList<Prop<"target-bitrate", gint>,  // bit/s
+               Prop<"keyframe-max-dist", gint>, Prop<"deadline", gint64>,
+               Prop<"lag-in-frames", gint>, Prop<"cpu-used", gint>,
+               Prop<"error-resilient", Nick>>;
+};
+
+template <>
+struct Catalog<"vp9enc"> {
+  using Properties =
+      PropList<Prop<"target-bitrate", gint>,  // bit/s
+               Prop<"keyframe-max-dist", gint>, Prop<"deadline", gint64>,
+               Prop<"lag-in-frames", gint>, Prop<"cpu-used", gint>,
+               Prop<"row-mt", bool>>;
+};
+
+template <>
+struct Catalog<"videotestsrc"> {
+  using Properties = PropList<Prop<"pattern", Nick>, Prop<"is-live", bool>,
+                              Prop<"num-buffers", gint>>;
+};
+
+template <>
+struct Catalog<"fakesink"> {
+  using Properties = PropList<Prop<"sync", bool>, Prop<"async", bool>,
+                              Prop<"signal-handoffs", bool>>;
+};
+
+template <>
+struct Catalog<"gstppdecimate"> {
+  using Properties = PropList<Prop<"keep", guint>, Prop<"passed", guint64>,
+                              Prop<"dropped", guint64>>;
+};
+
+namespace catalog {
+
+template <FixedString Name, typename List>
+struct Find {
+  using type = void;
+};
+
+template <FixedString Name, typename Head, typename... Tail>
+struct Find<Name, PropList<Head, Tail...>> {
+  using type =
+      std::conditional_t<Head::name.view() == Name.view(), Head,
+                         typename Find<Name, PropList<Tail...>>::type>;
+};
+
+template <FixedString Factory, FixedString Name>
+struct Lookup {
+  using Found =
+      typename Find<Name, typename Catalog<Factory>::Properties>::type;
+  static_assert(!std::is_void_v<Found>,
+                "the property is not in the catalog of this factory");
+  // keeps the failed assertion the only error
+  using type = typename std::conditional_t<std::is_void_v<Found>,
+                                           Prop<Name, bool>, Found>::type;
+};
+
+template <typename T>
+struct Value {
+  using set_type = T;
+  using get_type = T;
+};
+
+template <>
+struct Value<Nick> {
+  using set_type = std::string_view;
+  using get_type = std::string;
+};
+
+template <>
+struct Value<std::string> {
+  using set_type = std::string_view;
+  using get_type = std::string;
+};
+
+template <typename T>
+constexpr GType fundamental() {
+  if constexpr (std::is_same_v<T, bool>) return G_TYPE_BOOLEAN;
+  else if constexpr (std::is_same_v<T, gint>) return G_TYPE_INT;
+  else if constexpr (std::is_same_v<T, guint>) return G_TYPE_UINT;
+  else if constexpr (std::is_same_v<T, gint64>) return G_TYPE_INT64;
+  else if constexpr (std::is_same_v<T, guint64>) return G_TYPE_UINT64;
+  else if constexpr (std::is_same_v<T, gdouble>) return G_TYPE_DOUBLE;
+  else if constexpr (std::is_same_v<T, std::string>) return G_TYPE_STRING;
+  else if constexpr (std::is_same_v<T, Nick>) return G_TYPE_INVALID;
+  else static_assert(sizeof(T) == 0, "no GValue mapping for the type");
+}
+
+// property of the instance's class by name, checked against the expected
+// fundamental type (G_TYPE_INVALID - enum or flags); logs and returns
+// nullptr when the installed plugin disagrees with the catalog
+GParamSpec* resolve(GObject* object, std::string_view factory,
+                    const char* name, GType expected);
+// what g_object_set_property() does once it found the spec; false if the
+// property is not writable or the value is out of its range
+bool set(GObject* object, GParamSpec* spec, GValue& value);
+bool get(GObject* object, GParamSpec* spec, GValue& value);
+// nick of an enum value, flags as nicks joined by '+'
+std::string nick(const GValue& value);
+
+}  // namespace catalog
+
+template <FixedString Factory, FixedString Name>
+using PropType = typename catalog::Lookup<Factory, Name>::type;
+
+template <FixedString Factory, FixedString Name>
+constexpr bool has_property = !std::is_void_v<typename catalog::Find<
+    Name, typename Catalog<Factory>::Properties>::type>;
+
+// typed access to elements of a catalogued factory
+template <FixedString Factory>
+struct Props {
+  template <FixedString Name>
+  using SetType = typename catalog::Value<PropType<Factory, Name>>::set_type;
+  template <FixedString Name>
+  using GetType = typename catalog::Value<PropType<Factory, Name>>::get_type;
+
+  // resolved on first use, nullptr if the property is missing
+  template <FixedString Name>
+  static GParamSpec* spec(GstElement* element) {
+    using T = PropType<Factory, Name>;
+    static GParamSpec* const resolved =
+        catalog::resolve(G_OBJECT(element), Factory.view(), Name.c_str(),
+                         catalog::fundamental<T>());
+    return resolved;
+  }
+
+  template <FixedString Name>
+  static bool set(GstElement* element, const SetType<Name>& value) {
+    using T = PropType<Factory, Name>;
+    GParamSpec* resolved = spec<Name>(element);
+    if (!resolved) return false;
+    GValue gvalue = G_VALUE_INIT;
+    g_value_init(&gvalue, resolved->value_type);
+    bool stored{true};
+    if constexpr (std::is_same_v<T, bool>) {
+      g_value_set_boolean(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, gint>) {
+      g_value_set_int(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, guint>) {
+      g_value_set_uint(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, gint64>) {
+      g_value_set_int64(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, guint64>) {
+      g_value_set_uint64(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, gdouble>) {
+      g_value_set_double(&gvalue, value);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      g_value_set_string(&gvalue, std::string(value).c_str());
+    } else {
+      stored = gst_value_deserialize(&gvalue, std::string(value).c_str());
+    }
+    stored = stored && catalog::set(G_OBJECT(element), resolved, gvalue);
+    g_value_unset(&gvalue);
+    return stored;
+  }
+
+  // default value when the property is missing
+  template <FixedString Name>
+  static GetType<Name> get(GstElement* element) {
+    using T = PropType<Factory, Name>;
+    GetType<Name> result{};
+    GParamSpec* resolved = spec<Name>(element);
+    if (!resolved) return result;
+    GValue gvalue = G_VALUE_INIT;
+    g_value_init(&gvalue, resolved->value_type);
+    if (!catalog::get(G_OBJECT(element), resolved, gvalue)) {
+      g_value_unset(&gvalue);
+      return result;
+    }
+    if constexpr (std::is_same_v<T, bool>) {
+      result = g_value_get_boolean(&gvalue);
+    } else if constexpr (std::is_same_v<T, gint>) {
+      result = g_value_get_int(&gvalue);
+    } else if constexpr (std::is_same_v<T, guint>) {
+      result = g_value_get_uint(&gvalue);
+    } else if constexpr (std::is_same_v<T, gint64>) {
+      result = g_value_get_int64(&gvalue);
+    } else if constexpr (std::is_same_v<T, guint64>) {
+      result = g_value_get_uint64(&gvalue);
+    } else if constexpr (std::is_same_v<T, gdouble>) {
+      result = g_value_get_double(&gvalue);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      if (const gchar* text = g_value_get_string(&gvalue)) result = text;
+    } else {
+      result = catalog::nick(gvalue);
+    }
+    g_value_unset(&gvalue);
+    return result;
+  }
+};
+
+// element of a catalogued factory with typed property access
+template <FixedString Factory>
+class Elem : public Element {
+ public:
+  explicit Elem(std::string_view alias) : Element(Factory.view(), alias) {}
+
+  template <FixedString Name>
+  bool set(const typename Props<Factory>::template SetType<Name>& value) {
+    return raw() && Props<Factory>::template set<Name>(raw(), value);
+  }
+
+  template <FixedString Name>
+  typename Props<Factory>::template GetType<Name> get() const {
+    if (!raw()) return {};
+    return Props<Factory>::template get<Name>(raw());
+  }
+};
+
+}  // namespace vptyp
@@ -0,0 +1,104 @@
+#include "fanOutPlayer.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+namespace {
+
+// live branches drop old frames instead of holding the tee back
+constexpr guint kLiveQueueBuffers = 5;
+
+}  // namespace
+
+FanOutPlayer::FanOutPlayer(GMainLoop& loop, std::string_view source)
+    : FanOutPlayer(loop, source, Options{}) {}
+
+FanOutPlayer::FanOutPlayer(GMainLoop& loop, std::string_view source,
+                           const Options& options)
+    : BasePlayer(),
+      source(source),
+      options(options),
+      loop(loop),
+      pipeline(loop, "fan-out-player") {}
+
+void FanOutPlayer::create() {
+  PipelineGraph graph;
+  graph.add("uridecodebin", "decode").set("uri", source_uri(source));
+  // tee takes any caps, without the filter an audio pad could take it
+  graph.add("tee", "fanout")
+      .set("allow-not-linked", true)
+      .link("decode", "fanout", "video/x-raw");
+  if (!graph.build(pipeline)) {
+    LOG(FATAL) << std::format("Failed to build fan out trunk for {}", source);
+  }
+  branches = std::make_unique<TeeFanOut>(pipeline, loop, "fanout");
+
+  if (!options.record.empty() && !add_record(options.record)) {
+    LOG(FATAL) << std::format("Failed to add recording to {}",
+                              options.record);
+  }
+  if (options.preview && !add_preview()) {
+    LOG(FATAL) << "Failed to add preview";
+  }
+  if (!options.ws_uri.empty() && !add_webrtc(options.ws_uri)) {
+    LOG(FATAL) << "Failed on init of webrtcsink, make sure, that "
+                  "gst-plugins-rs is installed on the system";
+  }
+  instrument(pipeline);
+}
+
+void FanOutPlayer::play() { pipeline.play(); }
+
+void FanOutPlayer::stop() { pipeline.stop(); }
+
+bool FanOutPlayer::drain(std::chrono::milliseconds timeout) {
+  return pipeline.drain(timeout);
+}
+
+bool FanOutPlayer::restart() { return pipeline.restart(); }
+
+bool FanOutPlayer::add_record(std::string_view path) {
+  PipelineGraph graph;
+  graph.add("queue", "queue")
+      .then(converter(), "converter")
+      .then("x264enc", "encoder")
+      .set("tune", "zerolatency")
+      .then("h264parse", "parser")
+      .then("mp4mux", "mux")
+      .then("filesink", "sink")
+      .set("location", path);
+  return branches && branches->add(kRecord, std::move(graph), true);
+}
+
+bool FanOutPlayer::add_preview() {
+  PipelineGraph graph;
+  graph.add("queue", "queue")
+      .set("leaky", "downstream")
+      .set("max-size-buffers", kLiveQueueBuffers)
+      .then(converter(), "converter")
+      .then("autovideosink", "sink");
+  return branches && branches->add(kPreview, std::move(graph));
+}
+
+bool FanOutPlayer::add_webrtc(std::string_view wsUri) {
+  PipelineGraph graph;
+  graph.add("queue", "queue")
+      .set("leaky", "downstream")
+      .set("max-size-buffers", kLiveQueueBuffers)
+      .then("webrtcsink", "sink")
+      .set("signaller::uri", wsUri);
+  return branches && branches->add(kWebRtc, std::move(graph));
+}
+
+bool FanOutPlayer::remove_branch(std::string_view name) {
+  return branches && branches->remove(name);
+}
+
+TeeFanOut* FanOutPlayer::fanout() { return branches.get(); }
+
+}  // namespace vptyp
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "basePlayer.hh"
+#include "pipeline.hh"
+#include "teeFanOut.hh"
+
+namespace vptyp {
+
+// Decodes one source once and fans the frames out to recording, local
+// preview and WebRTC branches. Branches can be added and removed while
+// playing without disturbing the others.
+class FanOutPlayer : public BasePlayer {
+ public:
+  struct Options {
+    std::string record{};  // mp4 path, empty - no recording
+    bool preview{false};
+    std::string ws_uri{};  // signalling server, empty - no WebRTC
+  };
+
+  static constexpr std::string_view kRecord = "record";
+  static constexpr std::string_view kPreview = "preview";
+  static constexpr std::string_view kWebRtc = "webrtc";
+
+  // source is an uri or a local path
+  FanOutPlayer(GMainLoop& loop, std::string_view source);
+  FanOutPlayer(GMainLoop& loop, std::string_view source,
+               const Options& options);
+  ~FanOutPlayer() override = default;
+
+  void create() override;
+  void play() override;
+  void stop() override;
+  bool drain(std::chrono::milliseconds timeout) override;
+  bool restart() override;
+
+  // runtime branch control, call from the loop after create()
+  bool add_record(std::string_view path);
+  bool add_preview();
+  bool add_webrtc(std::string_view wsUri);
+  // the recording is finished (moov written) before its branch goes away
+  bool remove_branch(std::string_view name);
+  TeeFanOut* fanout();
+
+ protected:
+  std::string source;
+  Options options;
+  GMainLoop& loop;
+  Pipeline pipeline;
+  std::unique_ptr<TeeFanOut> branches{nullptr};
+};
+
+}  // namespace vptyp
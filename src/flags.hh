@@ -7,6 +7,38 @@ struct Flags {
   std::string filename{};
   std::string output{};
   std::string wsUri{};
+  std::string graph{};
+  std::string profile{};  // profile json path, "-" logs it, empty - off
+  int profile_interval_ms{5000};
+  int metrics_port{0};  // localhost http exposition, 0 - off
+  std::string metrics_file{};  // periodically rewritten exposition
+  int segments{1};  // parallel transcode segments, 0 - one per core
+  bool force_transcode{false};  // re-encode even remuxable input
+  std::string download_dir{};  // download buffer files, empty - temp dir
+  int download_ring_mb{0};  // on disk ring buffer, 0 - whole file
+  bool fast_convert{false};  // gstppconvert instead of videoconvert
+  std::string fanout{};  // source decoded once for all branches below
+  std::string record{};  // fan out recording path
+  bool preview{false};  // fan out local preview
+  bool rtc_low_latency{false};  // start from the low latency profile
+  std::string rtc_codec{};  // empty - any codec webrtcsink offers
+  std::string rtc_congestion{};  // disabled, homegrown, gcc; empty - default
+  int rtc_start_kbps{0};  // 0 - profile or webrtcsink default
+  int rtc_min_kbps{0};
+  int rtc_max_kbps{0};
+  int rtc_keyframe_interval{0};  // frames
+  std::string rtc_ladder{};  // shared encodes, "default" or name:WxH@kbps,..
+  std::string rtc_source{};  // uri or path, empty - test pattern
+  bool rtc_passthrough{true};  // send matching encoded input undecoded
+  int drain_timeout_ms{5000};  // EOS wait on SIGINT/SIGTERM
+  std::string recording_mode{"single"};  // single, fragmented, segmented
+  int recording_fragment_ms{1000};
+  int recording_segment_s{60};  // 0 - rotate by size only
+  int recording_segment_mb{0};  // 0 - rotate by time only
+  int recording_max_files{0};  // 0 - keep every segment
+  std::string recording_sync{"none"};  // none, segment, write
+  std::string recording_index{};  // segment index path, empty - none
+  std::string recording_sink{"filesink"};  // or gstppasyncfilesink
 };
 
 void init_flags(const Flags&);
@@ -0,0 +1,203 @@
+#include "frameTap.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+#include <utility>
+
+namespace vptyp {
+
+Frame::Frame(GstSample* sample, GstMapFlags flags) {
+  if (!sample) return;
+
+  GstBuffer* sampleBuffer = gst_sample_get_buffer(sample);
+  if (sampleBuffer) buf = gst_buffer_ref(sampleBuffer);
+  if (GstCaps* sampleCaps = gst_sample_get_caps(sample))
+    bufCaps = gst_caps_ref(sampleCaps);
+  gst_sample_unref(sample);
+
+  if (!buf) return;
+  // sample reference is already dropped, so in the common case we are the
+  // only holder and no copy happens here
+  if (flags & GST_MAP_WRITE) buf = gst_buffer_make_writable(buf);
+
+  mapped = gst_buffer_map(buf, &mapInfo, flags);
+  if (!mapped) {
+    LOG(ERROR) << "Failed to map frame buffer";
+  }
+  if (bufCaps) hasVideoInfo = gst_video_info_from_caps(&videoInfo, bufCaps);
+}
+
+Frame::Frame(Frame&& other)
+    : buf(std::exchange(other.buf, nullptr)),
+      bufCaps(std::exchange(other.bufCaps, nullptr)),
+      mapInfo(other.mapInfo),
+      videoInfo(other.videoInfo),
+      mapped(std::exchange(other.mapped, false)),
+      hasVideoInfo(std::exchange(other.hasVideoInfo, false)) {}
+
+Frame& Frame::operator=(Frame&& other) {
+  if (this == &other) return *this;
+
+  reset();
+  buf = std::exchange(other.buf, nullptr);
+  bufCaps = std::exchange(other.bufCaps, nullptr);
+  mapInfo = other.mapInfo;
+  videoInfo = other.videoInfo;
+  mapped = std::exchange(other.mapped, false);
+  hasVideoInfo = std::exchange(other.hasVideoInfo, false);
+  return *this;
+}
+
+Frame::~Frame() { reset(); }
+
+void Frame::reset() {
+  if (mapped) gst_buffer_unmap(buf, &mapInfo);
+  mapped = false;
+  if (buf) gst_buffer_unref(buf);
+  buf = nullptr;
+  if (bufCaps) gst_caps_unref(bufCaps);
+  bufCaps = nullptr;
+  hasVideoInfo = false;
+}
+
+bool Frame::is_mapped() const { return mapped; }
+
+guint8* Frame::data() const { return mapped ? mapInfo.data : nullptr; }
+
+gsize Frame::size() const { return mapped ? mapInfo.size : 0; }
+
+GstClockTime Frame::pts() const {
+  return buf ? GST_BUFFER_PTS(buf) : GST_CLOCK_TIME_NONE;
+}
+
+GstClockTime Frame::duration() const {
+  return buf ? GST_BUFFER_DURATION(buf) : GST_CLOCK_TIME_NONE;
+}
+
+GstBuffer* Frame::buffer() const { return buf; }
+
+GstCaps* Frame::caps() const { return bufCaps; }
+
+const GstVideoInfo* Frame::video_info() const {
+  return hasVideoInfo ? &videoInfo : nullptr;
+}
+
+GstBuffer* Frame::release() {
+  if (mapped) gst_buffer_unmap(buf, &mapInfo);
+  mapped = false;
+  return std::exchange(buf, nullptr);
+}
+
+FrameTap::FrameTap(std::string_view alias) : FrameTap(alias, Options{}) {}
+
+FrameTap::FrameTap(std::string_view alias, const Options& options)
+    : options(options),
+      appsink("appsink", std::format("{}-sink", alias)),
+      appsrc("appsrc", std::format("{}-src", alias)) {
+  if (!appsink.is_initialised() || !appsrc.is_initialised()) {
+    LOG(ERROR) << std::format("frame tap {} was not created", alias);
+    return;
+  }
+
+  appsink.object_set("max-buffers", options.max_buffers, "drop",
+                     gboolean(options.drop), "sync", gboolean(options.sync));
+  // the last sample holds another buffer ref, making every writable map
+  // a copy
+  if (options.writable) appsink.object_set("enable-last-sample", FALSE);
+  // block instead of growing the appsrc queue without bound
+  appsrc.object_set("format", GST_FORMAT_TIME, "block", TRUE);
+  install_callbacks();
+}
+
+Element& FrameTap::sink() { return appsink; }
+
+Element& FrameTap::source() { return appsrc; }
+
+void FrameTap::attach(Pipeline& pipeline) {
+  pipeline.add_element(appsink);
+  pipeline.add_element(appsrc);
+}
+
+std::optional<Frame> FrameTap::pull(GstClockTime timeout) {
+  GstSample* sample =
+      gst_app_sink_try_pull_sample(GST_APP_SINK(appsink.raw()), timeout);
+  if (!sample) return std::nullopt;
+
+  pulledFrames.fetch_add(1, std::memory_order_relaxed);
+  return Frame(sample, map_flags());
+}
+
+void FrameTap::on_frame(Callback cb) {
+  callback = std::move(cb);
+  install_callbacks();
+}
+
+bool FrameTap::push(Frame&& frame) {
+  if (GstCaps* caps = frame.caps()) {
+    auto src = GST_APP_SRC(appsrc.raw());
+    // follows renegotiations upstream, e.g. a new resolution
+    GstCaps* current = gst_app_src_get_caps(src);
+    if (!current || (current != caps && !gst_caps_is_equal(current, caps))) {
+      gst_app_src_set_caps(src, caps);
+    }
+    if (current) gst_caps_unref(current);
+  }
+  GstBuffer* buffer = frame.release();
+  if (!buffer) return false;
+  return push(buffer);
+}
+
+bool FrameTap::push(GstBuffer* buffer) {
+  auto ret = gst_app_src_push_buffer(GST_APP_SRC(appsrc.raw()), buffer);
+  if (ret != GST_FLOW_OK) {
+    LOG(WARNING) << std::format("frame push into {} failed: {}",
+                                appsrc.get_alias(), gst_flow_get_name(ret));
+    return false;
+  }
+  pushedFrames.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void FrameTap::end_of_stream() {
+  gst_app_src_end_of_stream(GST_APP_SRC(appsrc.raw()));
+}
+
+uint64_t FrameTap::pulled() const {
+  return pulledFrames.load(std::memory_order_relaxed);
+}
+
+uint64_t FrameTap::pushed() const {
+  return pushedFrames.load(std::memory_order_relaxed);
+}
+
+GstMapFlags FrameTap::map_flags() const {
+  return options.writable ? GstMapFlags(GST_MAP_READWRITE) : GST_MAP_READ;
+}
+
+void FrameTap::install_callbacks() {
+  GstAppSinkCallbacks callbacks{};
+  callbacks.eos = &FrameTap::eos;
+  if (callback) callbacks.new_sample = &FrameTap::new_sample;
+  gst_app_sink_set_callbacks(GST_APP_SINK(appsink.raw()), &callbacks, this,
+                             nullptr);
+}
+
+GstFlowReturn FrameTap::new_sample(GstAppSink* sink, gpointer data) {
+  auto that = static_cast<FrameTap*>(data);
+  GstSample* sample = gst_app_sink_pull_sample(sink);
+  if (!sample) return GST_FLOW_EOS;
+
+  that->pulledFrames.fetch_add(1, std::memory_order_relaxed);
+  Frame frame(sample, that->map_flags());
+  that->callback(frame);
+  return GST_FLOW_OK;
+}
+
+void FrameTap::eos(GstAppSink* sink, gpointer data) {
+  auto that = static_cast<FrameTap*>(data);
+  // also without frames, so the appsrc side finishes on an empty stream
+  if (that->options.forward_eos) that->end_of_stream();
+}
+
+}  // namespace vptyp
@@ -0,0 +1,107 @@
+#pragma once
+#include <gst/app/app.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <atomic>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "element.hh"
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Mapped view over a buffer pulled out of a pipeline. Keeps its own reference
+// on the GstBuffer, pixel data is never copied.
+class Frame {
+ public:
+  Frame(GstSample* sample, GstMapFlags flags);  // takes ownership of sample
+  Frame(Frame&& other);
+  Frame& operator=(Frame&& other);
+  Frame(const Frame&) = delete;
+  Frame& operator=(const Frame&) = delete;
+  ~Frame();
+
+  bool is_mapped() const;
+  guint8* data() const;
+  gsize size() const;
+  GstClockTime pts() const;
+  GstClockTime duration() const;
+
+  GstBuffer* buffer() const;  // non-owned
+  GstCaps* caps() const;      // non-owned
+  // nullptr if the caps are not raw video
+  const GstVideoInfo* video_info() const;
+
+  // unmaps the frame and hands its buffer reference over to the caller
+  GstBuffer* release();
+
+ private:
+  void reset();
+
+ private:
+  GstBuffer* buf{nullptr};
+  GstCaps* bufCaps{nullptr};
+  GstMapInfo mapInfo{};
+  GstVideoInfo videoInfo{};
+  bool mapped{false};
+  bool hasVideoInfo{false};
+};
+
+// Bridge between pipeline and in-process C++ stages: upstream chain is linked
+// into sink() (appsink), processed buffers are pushed back through source()
+// (appsrc) into the downstream chain.
+class FrameTap {
+ public:
+  struct Options {
+    bool writable{false};  // map frames read-write
+    guint max_buffers{2};  // appsink queue depth, 0 - unlimited
+    bool drop{false};      // drop old frames when consumer is too slow
+    bool sync{false};      // appsink synchronises on the clock
+    bool forward_eos{true};  // appsink EOS is forwarded into appsrc
+  };
+  using Callback = std::function<void(Frame&)>;
+
+  explicit FrameTap(std::string_view alias);
+  FrameTap(std::string_view alias, const Options& options);
+  FrameTap(const FrameTap&) = delete;
+  FrameTap& operator=(const FrameTap&) = delete;
+
+  Element& sink();
+  Element& source();
+
+  // adds both appsink and appsrc to the pipeline
+  void attach(Pipeline& pipeline);
+
+  // blocking pull, std::nullopt on EOS or timeout
+  std::optional<Frame> pull(GstClockTime timeout = GST_CLOCK_TIME_NONE);
+
+  // callback is invoked on the streaming thread for every new frame
+  void on_frame(Callback callback);
+
+  bool push(Frame&& frame);
+  bool push(GstBuffer* buffer);  // takes ownership of buffer
+  void end_of_stream();
+
+  uint64_t pulled() const;
+  uint64_t pushed() const;
+
+ protected:
+  static GstFlowReturn new_sample(GstAppSink* sink, gpointer data);
+  static void eos(GstAppSink* sink, gpointer data);
+  void install_callbacks();
+  GstMapFlags map_flags() const;
+
+ protected:
+  Options options;
+  Element appsink;
+  Element appsrc;
+  Callback callback{};
+  std::atomic<uint64_t> pulledFrames{0};
+  std::atomic<uint64_t> pushedFrames{0};
+};
+
+}  // namespace vptyp
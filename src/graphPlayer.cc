@@ -0,0 +1,44 @@
+#include "graphPlayer.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+GraphPlayer::GraphPlayer(GMainLoop& loop, std::string_view description)
+    : BasePlayer(),
+      description(description),
+      pipeline(std::make_unique<Pipeline>(loop, "graph-player")) {}
+
+GraphPlayer::GraphPlayer(std::unique_ptr<Pipeline> built)
+    : BasePlayer(), pipeline(std::move(built)) {}
+
+void GraphPlayer::create() {
+  if (description.empty()) {
+    instrument(*pipeline);
+    return;
+  }
+  auto graph = PipelineGraph::parse(description);
+  if (!graph) {
+    LOG(FATAL) << std::format("Failed to parse graph: {}", description);
+  }
+  if (!graph->build(*pipeline)) {
+    LOG(FATAL) << std::format("Failed to build graph: {}", description);
+  }
+  instrument(*pipeline);
+}
+
+void GraphPlayer::play() { pipeline->play(); }
+
+void GraphPlayer::stop() { pipeline->stop(); }
+
+bool GraphPlayer::drain(std::chrono::milliseconds timeout) {
+  return pipeline->drain(timeout);
+}
+
+bool GraphPlayer::restart() { return pipeline->restart(); }
+
+}  // namespace vptyp
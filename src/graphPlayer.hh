@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+
+#include "basePlayer.hh"
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Plays a pipeline described at runtime in gst-launch like syntax, so new
+// stream types don't need a dedicated player.
+class GraphPlayer : public BasePlayer {
+ public:
+  GraphPlayer(GMainLoop& loop, std::string_view description);
+  // plays a pipeline that is already built, e.g. one from a PipelinePool
+  explicit GraphPlayer(std::unique_ptr<Pipeline> built);
+  ~GraphPlayer() override = default;
+
+  void create() override;
+  void play() override;
+  void stop() override;
+  bool drain(std::chrono::milliseconds timeout) override;
+  bool restart() override;
+
+ protected:
+  std::string description;  // empty for a built pipeline
+  std::unique_ptr<Pipeline> pipeline;
+};
+
+}  // namespace vptyp
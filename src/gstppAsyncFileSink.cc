@@ -0,0 +1,361 @@
+#include "gstppAsyncFileSink.hh"
+
+#include <gst/base/gstbasesink.h>
+
+#include <string>
+
+#include "asyncFileWriter.hh"
+#include "metrics.hh"
+
+namespace {
+
+struct GstppAsyncFileSink {
+  GstBaseSink parent;
+
+  // properties, under the object lock
+  gchar* location;
+  guint batch_size;
+  guint queue_depth;
+  gboolean direct;
+  gboolean o_sync;
+
+  // opened in start, closed in stop and kept for its stats until the next
+  // start; replaced under the object lock
+  vptyp::AsyncFileWriter* writer;
+};
+
+struct GstppAsyncFileSinkClass {
+  GstBaseSinkClass parent_class;
+};
+
+enum {
+  PROP_0,
+  PROP_LOCATION,
+  PROP_BATCH_SIZE,
+  PROP_QUEUE_DEPTH,
+  PROP_DIRECT,
+  PROP_O_SYNC,
+  PROP_BACKEND,
+  PROP_BYTES_WRITTEN,
+  PROP_LATENCY_MEAN,
+  PROP_LATENCY_P99,
+  PROP_LATENCY_MAX
+};
+
+GstStaticPadTemplate sinkTemplate = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+}  // namespace
+
+G_DEFINE_TYPE(GstppAsyncFileSink, gstpp_async_file_sink, GST_TYPE_BASE_SINK)
+
+static void gstpp_async_file_sink_replace(GstppAsyncFileSink* self,
+                                          vptyp::AsyncFileWriter* writer) {
+  GST_OBJECT_LOCK(self);
+  vptyp::AsyncFileWriter* previous = self->writer;
+  self->writer = writer;
+  GST_OBJECT_UNLOCK(self);
+  delete previous;
+}
+
+static gboolean gstpp_async_file_sink_start(GstBaseSink* sink) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(sink);
+  vptyp::AsyncFileWriter::Options options;
+  std::string location;
+  GST_OBJECT_LOCK(self);
+  if (self->location) location = self->location;
+  options.batch_bytes = self->batch_size;
+  options.depth = self->queue_depth;
+  options.direct = self->direct;
+  options.sync = self->o_sync;
+  std::string name = GST_OBJECT_NAME(self);
+  GST_OBJECT_UNLOCK(self);
+
+  if (location.empty()) {
+    GST_ELEMENT_ERROR(self, RESOURCE, NOT_FOUND,
+                      ("No file name specified for writing."), (nullptr));
+    return FALSE;
+  }
+  options.latency = &vptyp::MetricsRegistry::instance().histogram(
+      "gstpp_file_write_latency_us",
+      "batch write latency of gstppasyncfilesink", {{"element", name}});
+  auto writer = vptyp::AsyncFileWriter::open(location, options);
+  if (!writer) {
+    GST_ELEMENT_ERROR(self, RESOURCE, OPEN_WRITE,
+                      ("Could not open file \"%s\" for writing.",
+                       location.c_str()),
+                      (nullptr));
+    return FALSE;
+  }
+  gstpp_async_file_sink_replace(self, writer.release());
+  return TRUE;
+}
+
+static gboolean gstpp_async_file_sink_stop(GstBaseSink* sink) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(sink);
+  if (self->writer && !self->writer->close()) {
+    GST_ELEMENT_ERROR(self, RESOURCE, CLOSE, ("Error closing file."),
+                      (nullptr));
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static GstFlowReturn gstpp_async_file_sink_render(GstBaseSink* sink,
+                                                  GstBuffer* buffer) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(sink);
+  GstMapInfo map;
+  if (!gst_buffer_map(buffer, &map, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR(self, STREAM, FAILED, ("cannot map buffer"),
+                      (nullptr));
+    return GST_FLOW_ERROR;
+  }
+  bool written = self->writer->write(map.data, map.size);
+  gst_buffer_unmap(buffer, &map);
+  if (!written) {
+    GST_ELEMENT_ERROR(self, RESOURCE, WRITE, ("Error while writing to file."),
+                      (nullptr));
+    return GST_FLOW_ERROR;
+  }
+  return GST_FLOW_OK;
+}
+
+static gboolean gstpp_async_file_sink_event(GstBaseSink* sink,
+                                            GstEvent* event) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(sink);
+  bool ok{true};
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_SEGMENT: {
+      // a byte segment moves the write position, e.g. mp4mux going back
+      // to its header at the end
+      const GstSegment* segment{nullptr};
+      gst_event_parse_segment(event, &segment);
+      if (segment->format == GST_FORMAT_BYTES) {
+        ok = self->writer->seek(segment->start);
+      }
+      break;
+    }
+    case GST_EVENT_EOS:
+      ok = self->writer->flush();
+      break;
+    default:
+      break;
+  }
+  if (!ok) {
+    GST_ELEMENT_ERROR(self, RESOURCE, WRITE, ("Error while writing to file."),
+                      (nullptr));
+    gst_event_unref(event);
+    return FALSE;
+  }
+  return GST_BASE_SINK_CLASS(gstpp_async_file_sink_parent_class)
+      ->event(sink, event);
+}
+
+static gboolean gstpp_async_file_sink_query(GstBaseSink* sink,
+                                            GstQuery* query) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(sink);
+  switch (GST_QUERY_TYPE(query)) {
+    case GST_QUERY_POSITION: {
+      GstFormat format;
+      gst_query_parse_position(query, &format, nullptr);
+      if (format != GST_FORMAT_BYTES && format != GST_FORMAT_DEFAULT) break;
+      GST_OBJECT_LOCK(self);
+      gint64 position = self->writer ? self->writer->position() : 0;
+      GST_OBJECT_UNLOCK(self);
+      gst_query_set_position(query, GST_FORMAT_BYTES, position);
+      return TRUE;
+    }
+    case GST_QUERY_FORMATS:
+      gst_query_set_formats(query, 2, GST_FORMAT_DEFAULT, GST_FORMAT_BYTES);
+      return TRUE;
+    case GST_QUERY_SEEKING: {
+      GstFormat format;
+      gst_query_parse_seeking(query, &format, nullptr, nullptr, nullptr);
+      bool bytes = format == GST_FORMAT_BYTES || format == GST_FORMAT_DEFAULT;
+      gst_query_set_seeking(query, format, bytes, 0, -1);
+      return TRUE;
+    }
+    default:
+      break;
+  }
+  return GST_BASE_SINK_CLASS(gstpp_async_file_sink_parent_class)
+      ->query(sink, query);
+}
+
+static void gstpp_async_file_sink_set_property(GObject* object, guint id,
+                                               const GValue* value,
+                                               GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(object);
+  GST_OBJECT_LOCK(self);
+  switch (id) {
+    case PROP_LOCATION:
+      g_free(self->location);
+      self->location = g_value_dup_string(value);
+      break;
+    case PROP_BATCH_SIZE:
+      self->batch_size = g_value_get_uint(value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      self->queue_depth = g_value_get_uint(value);
+      break;
+    case PROP_DIRECT:
+      self->direct = g_value_get_boolean(value);
+      break;
+    case PROP_O_SYNC:
+      self->o_sync = g_value_get_boolean(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+static void gstpp_async_file_sink_get_property(GObject* object, guint id,
+                                               GValue* value,
+                                               GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(object);
+  GST_OBJECT_LOCK(self);
+  vptyp::AsyncFileWriter::Stats stats{};
+  if (self->writer) stats = self->writer->stats();
+  switch (id) {
+    case PROP_LOCATION:
+      g_value_set_string(value, self->location);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint(value, self->batch_size);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_uint(value, self->queue_depth);
+      break;
+    case PROP_DIRECT:
+      g_value_set_boolean(value, self->direct);
+      break;
+    case PROP_O_SYNC:
+      g_value_set_boolean(value, self->o_sync);
+      break;
+    case PROP_BACKEND:
+      if (!self->writer) {
+        g_value_set_string(value, "");
+      } else {
+        bool uring =
+            self->writer->backend() == vptyp::AsyncFileWriter::Backend::IoUring;
+        g_value_set_string(value, uring ? "io_uring" : "threads");
+      }
+      break;
+    case PROP_BYTES_WRITTEN:
+      g_value_set_uint64(value, stats.bytes);
+      break;
+    case PROP_LATENCY_MEAN:
+      g_value_set_uint64(value, guint64(stats.latency.mean()));
+      break;
+    case PROP_LATENCY_P99:
+      g_value_set_uint64(value, stats.latency.percentile(0.99));
+      break;
+    case PROP_LATENCY_MAX:
+      g_value_set_uint64(value, stats.latency.max);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+static void gstpp_async_file_sink_finalize(GObject* object) {
+  auto self = reinterpret_cast<GstppAsyncFileSink*>(object);
+  delete self->writer;
+  self->writer = nullptr;
+  g_free(self->location);
+  self->location = nullptr;
+  G_OBJECT_CLASS(gstpp_async_file_sink_parent_class)->finalize(object);
+}
+
+static void gstpp_async_file_sink_class_init(GstppAsyncFileSinkClass* klass) {
+  auto objectClass = G_OBJECT_CLASS(klass);
+  objectClass->set_property = gstpp_async_file_sink_set_property;
+  objectClass->get_property = gstpp_async_file_sink_get_property;
+  objectClass->finalize = gstpp_async_file_sink_finalize;
+
+  vptyp::AsyncFileWriter::Options defaults;
+  // applied when the file is opened
+  auto flags = GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+                           GST_PARAM_MUTABLE_READY);
+  auto readable = GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property(
+      objectClass, PROP_LOCATION,
+      g_param_spec_string("location", "File Location",
+                          "Location of the file to write", nullptr, flags));
+  g_object_class_install_property(
+      objectClass, PROP_BATCH_SIZE,
+      g_param_spec_uint("batch-size", "Batch size",
+                        "Bytes per write, rounded up to 4 KiB",
+                        guint(vptyp::AsyncFileWriter::kAlignment),
+                        G_MAXINT32, guint(defaults.batch_bytes), flags));
+  g_object_class_install_property(
+      objectClass, PROP_QUEUE_DEPTH,
+      g_param_spec_uint("queue-depth", "Queue depth",
+                        "Batches in flight at most", 1, 256,
+                        guint(defaults.depth), flags));
+  g_object_class_install_property(
+      objectClass, PROP_DIRECT,
+      g_param_spec_boolean("direct", "Direct",
+                           "Write aligned batches O_DIRECT, past the page "
+                           "cache",
+                           defaults.direct, flags));
+  g_object_class_install_property(
+      objectClass, PROP_O_SYNC,
+      g_param_spec_boolean("o-sync", "Synchronous IO",
+                           "Open the file O_DSYNC, a written batch is on "
+                           "stable storage",
+                           defaults.sync, flags));
+  g_object_class_install_property(
+      objectClass, PROP_BACKEND,
+      g_param_spec_string("backend", "Backend",
+                          "\"io_uring\" or \"threads\" once started", "",
+                          readable));
+  g_object_class_install_property(
+      objectClass, PROP_BYTES_WRITTEN,
+      g_param_spec_uint64("bytes-written", "Bytes written",
+                          "Bytes on disk so far", 0, G_MAXUINT64, 0,
+                          readable));
+  g_object_class_install_property(
+      objectClass, PROP_LATENCY_MEAN,
+      g_param_spec_uint64("write-latency-mean", "Mean write latency",
+                          "Mean batch write latency, us", 0, G_MAXUINT64, 0,
+                          readable));
+  g_object_class_install_property(
+      objectClass, PROP_LATENCY_P99,
+      g_param_spec_uint64("write-latency-p99", "99th percentile latency",
+                          "Batch write latency percentile, us", 0,
+                          G_MAXUINT64, 0, readable));
+  g_object_class_install_property(
+      objectClass, PROP_LATENCY_MAX,
+      g_param_spec_uint64("write-latency-max", "Maximum write latency",
+                          "Slowest batch write, us", 0, G_MAXUINT64, 0,
+                          readable));
+
+  auto elementClass = GST_ELEMENT_CLASS(klass);
+  gst_element_class_add_static_pad_template(elementClass, &sinkTemplate);
+  gst_element_class_set_static_metadata(
+      elementClass, "gstpp async file sink", "Sink/File",
+      "Writes the stream to a file in large batches from the background",
+      "gstPlayground");
+
+  auto sinkClass = GST_BASE_SINK_CLASS(klass);
+  sinkClass->start = gstpp_async_file_sink_start;
+  sinkClass->stop = gstpp_async_file_sink_stop;
+  sinkClass->render = gstpp_async_file_sink_render;
+  sinkClass->event = gstpp_async_file_sink_event;
+  sinkClass->query = gstpp_async_file_sink_query;
+}
+
+static void gstpp_async_file_sink_init(GstppAsyncFileSink* self) {
+  vptyp::AsyncFileWriter::Options defaults;
+  self->location = nullptr;
+  self->batch_size = guint(defaults.batch_bytes);
+  self->queue_depth = guint(defaults.depth);
+  self->direct = defaults.direct;
+  self->o_sync = defaults.sync;
+  self->writer = nullptr;
+  // like filesink, the file is written as fast as buffers arrive
+  gst_base_sink_set_sync(GST_BASE_SINK(self), FALSE);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <gst/gst.h>
+
+// "gstppasyncfilesink": filesink that collects buffers into large aligned
+// batches and writes them from the background through an AsyncFileWriter,
+// io_uring where the kernel allows it and a thread pool otherwise, so a
+// slow disk does not stall the streaming thread on every buffer. Seekable
+// in bytes like filesink, so mp4mux can rewrite its header. "backend",
+// "bytes-written" and the "write-latency-*" properties (us) report the
+// writes; latencies also go to the gstpp_file_write_latency_us histogram.
+GType gstpp_async_file_sink_get_type();
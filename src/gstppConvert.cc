@@ -0,0 +1,296 @@
+#include "gstppConvert.hh"
+
+#include <glog/logging.h>
+#include <gst/video/gstvideofilter.h>
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <initializer_list>
+#include <format>
+#include <optional>
+#include <string_view>
+#include <thread>
+
+#include "colorKernels.hh"
+
+namespace {
+
+using vptyp::color::Image;
+using vptyp::color::Isa;
+using vptyp::color::PixelFormat;
+
+constexpr unsigned kMaxThreads = 64;
+constexpr unsigned kAutoThreads = 8;
+
+struct GstppConvert {
+  GstVideoFilter parent;
+  guint threads;  // 0 - auto
+  Isa isa;
+  vptyp::color::SlicePool* pool;  // owned, sized on caps
+};
+
+struct GstppConvertClass {
+  GstVideoFilterClass parent_class;
+};
+
+enum { PROP_0, PROP_N_THREADS, PROP_ISA };
+
+#define GSTPP_CONVERT_FORMATS "{ NV12, I420, RGBA, BGRx }"
+
+GstStaticPadTemplate sinkTemplate = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE(GSTPP_CONVERT_FORMATS)));
+
+GstStaticPadTemplate srcTemplate = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE(GSTPP_CONVERT_FORMATS)));
+
+std::optional<PixelFormat> pixel_format(GstVideoFormat format) {
+  switch (format) {
+    case GST_VIDEO_FORMAT_NV12:
+      return PixelFormat::NV12;
+    case GST_VIDEO_FORMAT_I420:
+      return PixelFormat::I420;
+    case GST_VIDEO_FORMAT_RGBA:
+      return PixelFormat::RGBA;
+    case GST_VIDEO_FORMAT_BGRx:
+      return PixelFormat::BGRx;
+    default:
+      return std::nullopt;
+  }
+}
+
+void set_formats(GstStructure* structure,
+                 std::initializer_list<const char*> names) {
+  GValue formats = G_VALUE_INIT;
+  g_value_init(&formats, GST_TYPE_LIST);
+  for (auto name : names) {
+    GValue format = G_VALUE_INIT;
+    g_value_init(&format, G_TYPE_STRING);
+    g_value_set_static_string(&format, name);
+    gst_value_list_append_and_take_value(&formats, &format);
+  }
+  gst_structure_take_value(structure, "format", &formats);
+}
+
+// the kernels implement BT.601 limited range YUV and full range RGB
+bool kernel_colorimetry(const GstVideoInfo* info) {
+  if (GST_VIDEO_INFO_IS_RGB(info)) return true;
+  auto& colorimetry = GST_VIDEO_INFO_COLORIMETRY(info);
+  return colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_BT601 &&
+         colorimetry.range == GST_VIDEO_COLOR_RANGE_16_235;
+}
+
+// fixed colorimetry of the caps other than what the kernels implement; an
+// unfixed one is checked on set_info
+bool foreign_colorimetry(const GstStructure* structure) {
+  const gchar* name = gst_structure_get_string(structure, "colorimetry");
+  if (!name) return false;
+  GstVideoColorimetry colorimetry;
+  if (!gst_video_colorimetry_from_string(&colorimetry, name)) return true;
+  if (colorimetry.matrix == GST_VIDEO_COLOR_MATRIX_RGB) return false;
+  return colorimetry.matrix != GST_VIDEO_COLOR_MATRIX_BT601 ||
+         colorimetry.range != GST_VIDEO_COLOR_RANGE_16_235;
+}
+
+Image to_image(GstVideoFrame* frame) {
+  Image image{.format = *pixel_format(GST_VIDEO_FRAME_FORMAT(frame)),
+              .width = GST_VIDEO_FRAME_WIDTH(frame),
+              .height = GST_VIDEO_FRAME_HEIGHT(frame)};
+  for (guint i = 0; i < GST_VIDEO_FRAME_N_PLANES(frame); ++i) {
+    image.planes[i] = {
+        .data = static_cast<uint8_t*>(GST_VIDEO_FRAME_PLANE_DATA(frame, i)),
+        .stride = GST_VIDEO_FRAME_PLANE_STRIDE(frame, i)};
+  }
+  return image;
+}
+
+}  // namespace
+
+G_DEFINE_TYPE(GstppConvert, gstpp_convert, GST_TYPE_VIDEO_FILTER)
+
+// the same caps in any supported format, YUV as BT.601 limited range and
+// RGB as full range; other colorimetry only passes through, so it fails to
+// negotiate a conversion instead of getting the wrong matrix. The input
+// format stays first, so equal caps are preferred and end up in
+// passthrough.
+static GstCaps* gstpp_convert_transform_caps(GstBaseTransform*,
+                                             GstPadDirection, GstCaps* caps,
+                                             GstCaps* filter) {
+  GstCaps* result = gst_caps_copy(caps);
+  for (guint i = 0; i < gst_caps_get_size(caps); ++i) {
+    const GstStructure* original = gst_caps_get_structure(caps, i);
+    if (foreign_colorimetry(original)) continue;
+    GstCapsFeatures* features = gst_caps_get_features(caps, i);
+
+    GstStructure* yuv = gst_structure_copy(original);
+    gst_structure_remove_field(yuv, "chroma-site");
+    gst_structure_set(yuv, "colorimetry", G_TYPE_STRING,
+                      GST_VIDEO_COLORIMETRY_BT601, nullptr);
+    set_formats(yuv, {"NV12", "I420"});
+    GstStructure* rgb = gst_structure_copy(original);
+    gst_structure_remove_fields(rgb, "colorimetry", "chroma-site", nullptr);
+    set_formats(rgb, {"RGBA", "BGRx"});
+    result = gst_caps_merge_structure_full(result, yuv,
+                                           gst_caps_features_copy(features));
+    result = gst_caps_merge_structure_full(result, rgb,
+                                           gst_caps_features_copy(features));
+  }
+  if (filter) {
+    GstCaps* intersection =
+        gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+    gst_caps_unref(result);
+    result = intersection;
+  }
+  return result;
+}
+
+static gboolean gstpp_convert_set_info(GstVideoFilter* filter, GstCaps*,
+                                       GstVideoInfo* in_info, GstCaps*,
+                                       GstVideoInfo* out_info) {
+  auto self = reinterpret_cast<GstppConvert*>(filter);
+  auto in = GST_VIDEO_INFO_FORMAT(in_info);
+  auto out = GST_VIDEO_INFO_FORMAT(out_info);
+  if (GST_VIDEO_INFO_WIDTH(in_info) != GST_VIDEO_INFO_WIDTH(out_info) ||
+      GST_VIDEO_INFO_HEIGHT(in_info) != GST_VIDEO_INFO_HEIGHT(out_info)) {
+    LOG(ERROR) << "gstppconvert does not scale";
+    return FALSE;
+  }
+  gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(filter), in == out);
+  if (in == out) return TRUE;
+  if (!kernel_colorimetry(in_info) || !kernel_colorimetry(out_info)) {
+    // e.g. HD input without colorimetry in its caps defaults to BT.709
+    LOG(ERROR) << "gstppconvert only converts BT.601 limited range YUV";
+    return FALSE;
+  }
+
+  if (!vptyp::color::find_kernel(*pixel_format(in), *pixel_format(out),
+                                 self->isa)) {
+    LOG(ERROR) << std::format("gstppconvert: no kernel for {} to {}",
+                              gst_video_format_to_string(in),
+                              gst_video_format_to_string(out));
+    return FALSE;
+  }
+
+  unsigned threads = self->threads;
+  if (!threads) {
+    // a slice per kMinSliceRows rows at most
+    unsigned slices =
+        GST_VIDEO_INFO_HEIGHT(in_info) / vptyp::color::kMinSliceRows;
+    threads = std::max(1u, std::min({std::thread::hardware_concurrency(),
+                                     kAutoThreads, slices}));
+  }
+  if (!self->pool || self->pool->size() != threads) {
+    delete self->pool;
+    self->pool = threads > 1 ? new vptyp::color::SlicePool(threads - 1)
+                             : nullptr;
+  }
+  LOG(INFO) << std::format("gstppconvert: {} to {}, {}, {} threads",
+                           gst_video_format_to_string(in),
+                           gst_video_format_to_string(out),
+                           vptyp::color::isa_name(std::min(
+                               self->isa, vptyp::color::detect_isa())),
+                           threads);
+  return TRUE;
+}
+
+static GstFlowReturn gstpp_convert_transform_frame(GstVideoFilter* filter,
+                                                   GstVideoFrame* in,
+                                                   GstVideoFrame* out) {
+  auto self = reinterpret_cast<GstppConvert*>(filter);
+  if (!vptyp::color::convert(to_image(in), to_image(out), self->isa,
+                             self->pool)) {
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  return GST_FLOW_OK;
+}
+
+static void gstpp_convert_set_property(GObject* object, guint id,
+                                       const GValue* value, GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppConvert*>(object);
+  switch (id) {
+    case PROP_N_THREADS:
+      // applied on the next caps
+      self->threads = g_value_get_uint(value);
+      break;
+    case PROP_ISA: {
+      std::string_view name = g_value_get_string(value)
+                                   ? g_value_get_string(value)
+                                   : "auto";
+      auto isa = vptyp::color::parse_isa(name);
+      if (name != "auto" && !isa) {
+        LOG(WARNING) << std::format("gstppconvert: unknown isa {}", name);
+      }
+      self->isa = isa.value_or(vptyp::color::detect_isa());
+      break;
+    }
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+}
+
+static void gstpp_convert_get_property(GObject* object, guint id,
+                                       GValue* value, GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppConvert*>(object);
+  switch (id) {
+    case PROP_N_THREADS:
+      g_value_set_uint(value, self->threads);
+      break;
+    case PROP_ISA:
+      g_value_set_string(value, vptyp::color::isa_name(self->isa).data());
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+}
+
+static void gstpp_convert_finalize(GObject* object) {
+  auto self = reinterpret_cast<GstppConvert*>(object);
+  delete self->pool;
+  self->pool = nullptr;
+  G_OBJECT_CLASS(gstpp_convert_parent_class)->finalize(object);
+}
+
+static void gstpp_convert_class_init(GstppConvertClass* klass) {
+  auto objectClass = G_OBJECT_CLASS(klass);
+  objectClass->set_property = gstpp_convert_set_property;
+  objectClass->get_property = gstpp_convert_get_property;
+  objectClass->finalize = gstpp_convert_finalize;
+
+  g_object_class_install_property(
+      objectClass, PROP_N_THREADS,
+      g_param_spec_uint("n-threads", "Threads",
+                        "Row slices converted in parallel, 0 - auto", 0,
+                        kMaxThreads, 0,
+                        GParamFlags(G_PARAM_READWRITE |
+                                    G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+      objectClass, PROP_ISA,
+      g_param_spec_string("isa", "Instruction set",
+                          "auto, scalar, sse4.1 or avx2, capped at what the "
+                          "cpu supports",
+                          "auto",
+                          GParamFlags(G_PARAM_READWRITE |
+                                      G_PARAM_STATIC_STRINGS)));
+
+  auto elementClass = GST_ELEMENT_CLASS(klass);
+  gst_element_class_add_static_pad_template(elementClass, &sinkTemplate);
+  gst_element_class_add_static_pad_template(elementClass, &srcTemplate);
+  gst_element_class_set_static_metadata(
+      elementClass, "gstpp colorspace converter", "Filter/Converter/Video",
+      "SIMD conversion between NV12, I420, RGBA and BGRx", "gstPlayground");
+
+  auto transformClass = GST_BASE_TRANSFORM_CLASS(klass);
+  transformClass->transform_caps = gstpp_convert_transform_caps;
+  transformClass->passthrough_on_same_caps = TRUE;
+
+  auto filterClass = GST_VIDEO_FILTER_CLASS(klass);
+  filterClass->set_info = gstpp_convert_set_info;
+  filterClass->transform_frame = gstpp_convert_transform_frame;
+}
+
+static void gstpp_convert_init(GstppConvert* self) {
+  self->threads = 0;
+  self->isa = vptyp::color::detect_isa();
+  self->pool = nullptr;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <gst/gst.h>
+
+// "gstppconvert": colorspace conversion between NV12, I420, RGBA and BGRx on
+// the color kernels, YUV as BT.601 limited range only: other colorimetry
+// does not negotiate a conversion. Properties: "n-threads" (row slices per
+// frame, 0 - auto) and "isa" ("auto", "scalar", "sse4.1", "avx2").
+GType gstpp_convert_get_type();
@@ -0,0 +1,165 @@
+#include "gstppDecimate.hh"
+
+#include <gst/base/gstbasetransform.h>
+
+namespace {
+
+struct GstppDecimate {
+  GstBaseTransform parent;
+  guint keep;  // under the object lock
+  gboolean raw;  // every buffer stands alone
+  guint64 position;  // buffers, or GOPs when encoded, since keep changed
+  guint last_keep;
+  gboolean skipping_gop;  // the current GOP is dropped
+  guint64 passed;
+  guint64 dropped;
+};
+
+struct GstppDecimateClass {
+  GstBaseTransformClass parent_class;
+};
+
+enum { PROP_0, PROP_KEEP, PROP_PASSED, PROP_DROPPED };
+
+GstStaticPadTemplate sinkTemplate = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+GstStaticPadTemplate srcTemplate = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS_ANY);
+
+}  // namespace
+
+G_DEFINE_TYPE(GstppDecimate, gstpp_decimate, GST_TYPE_BASE_TRANSFORM)
+
+static gboolean gstpp_decimate_set_caps(GstBaseTransform* trans, GstCaps* in,
+                                        GstCaps*) {
+  auto self = reinterpret_cast<GstppDecimate*>(trans);
+  const GstStructure* structure = gst_caps_get_structure(in, 0);
+  self->raw = gst_structure_has_name(structure, "video/x-raw") ||
+              gst_structure_has_name(structure, "audio/x-raw");
+  return TRUE;
+}
+
+static gboolean gstpp_decimate_start(GstBaseTransform* trans) {
+  auto self = reinterpret_cast<GstppDecimate*>(trans);
+  self->position = 0;
+  self->skipping_gop = FALSE;
+  return TRUE;
+}
+
+static GstFlowReturn gstpp_decimate_transform_ip(GstBaseTransform* trans,
+                                                 GstBuffer* buffer) {
+  auto self = reinterpret_cast<GstppDecimate*>(trans);
+  GST_OBJECT_LOCK(self);
+  guint keep = self->keep;
+  GST_OBJECT_UNLOCK(self);
+
+  // the first buffer after a change passes, the pattern restarts from it
+  if (keep != self->last_keep) {
+    self->last_keep = keep;
+    self->position = 0;
+  }
+
+  bool pass{true};
+  if (self->raw) {
+    pass = self->position++ % keep == 0;
+  } else if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    // delta units may reference any earlier one of their GOP, so whole
+    // GOPs pass or go
+    self->skipping_gop = self->position++ % keep != 0;
+    pass = !self->skipping_gop;
+  } else {
+    pass = !self->skipping_gop;
+  }
+
+  GST_OBJECT_LOCK(self);
+  ++(pass ? self->passed : self->dropped);
+  GST_OBJECT_UNLOCK(self);
+  return pass ? GST_FLOW_OK : GST_BASE_TRANSFORM_FLOW_DROPPED;
+}
+
+static void gstpp_decimate_set_property(GObject* object, guint id,
+                                        const GValue* value,
+                                        GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppDecimate*>(object);
+  switch (id) {
+    case PROP_KEEP:
+      GST_OBJECT_LOCK(self);
+      self->keep = g_value_get_uint(value);
+      GST_OBJECT_UNLOCK(self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+}
+
+static void gstpp_decimate_get_property(GObject* object, guint id,
+                                        GValue* value, GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppDecimate*>(object);
+  GST_OBJECT_LOCK(self);
+  switch (id) {
+    case PROP_KEEP:
+      g_value_set_uint(value, self->keep);
+      break;
+    case PROP_PASSED:
+      g_value_set_uint64(value, self->passed);
+      break;
+    case PROP_DROPPED:
+      g_value_set_uint64(value, self->dropped);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+static void gstpp_decimate_class_init(GstppDecimateClass* klass) {
+  auto objectClass = G_OBJECT_CLASS(klass);
+  objectClass->set_property = gstpp_decimate_set_property;
+  objectClass->get_property = gstpp_decimate_get_property;
+
+  g_object_class_install_property(
+      objectClass, PROP_KEEP,
+      g_param_spec_uint("keep", "Keep", "Pass one of every N frames", 1,
+                        G_MAXUINT, 1,
+                        GParamFlags(G_PARAM_READWRITE |
+                                    G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+      objectClass, PROP_PASSED,
+      g_param_spec_uint64("passed", "Passed", "Buffers passed on", 0,
+                          G_MAXUINT64, 0,
+                          GParamFlags(G_PARAM_READABLE |
+                                      G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+      objectClass, PROP_DROPPED,
+      g_param_spec_uint64("dropped", "Dropped", "Buffers dropped", 0,
+                          G_MAXUINT64, 0,
+                          GParamFlags(G_PARAM_READABLE |
+                                      G_PARAM_STATIC_STRINGS)));
+
+  auto elementClass = GST_ELEMENT_CLASS(klass);
+  gst_element_class_add_static_pad_template(elementClass, &sinkTemplate);
+  gst_element_class_add_static_pad_template(elementClass, &srcTemplate);
+  gst_element_class_set_static_metadata(
+      elementClass, "gstpp decimator", "Filter/Effect",
+      "Drops frames at an adjustable ratio, keyframe aware",
+      "gstPlayground");
+
+  auto transformClass = GST_BASE_TRANSFORM_CLASS(klass);
+  transformClass->set_caps = gstpp_decimate_set_caps;
+  transformClass->start = gstpp_decimate_start;
+  transformClass->transform_ip = gstpp_decimate_transform_ip;
+  // buffers are passed or dropped, never touched
+  transformClass->transform_ip_on_passthrough = TRUE;
+}
+
+static void gstpp_decimate_init(GstppDecimate* self) {
+  self->keep = 1;
+  self->raw = TRUE;
+  self->position = 0;
+  self->last_keep = 1;
+  self->skipping_gop = FALSE;
+  self->passed = 0;
+  self->dropped = 0;
+  gst_base_transform_set_passthrough(GST_BASE_TRANSFORM(self), TRUE);
+}
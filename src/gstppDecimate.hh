@@ -0,0 +1,9 @@
+#pragma once
+#include <gst/gst.h>
+
+// "gstppdecimate": passes one of every "keep" frames and drops the rest
+// without touching timestamps. Encoded streams are decimated by whole GOPs,
+// one of every "keep" passes, so the ratio holds on average and nothing
+// references a dropped frame. "keep" may change while playing, e.g. from a
+// DecimationController; "dropped" and "passed" count buffers.
+GType gstpp_decimate_get_type();
@@ -0,0 +1,321 @@
+#include "gstppMotion.hh"
+
+#include <gst/base/gstbasetransform.h>
+#include <gst/video/video.h>
+
+#include <algorithm>
+#include <new>
+
+#include "motionDetect.hh"
+
+namespace {
+
+struct GstppMotion {
+  GstBaseTransform parent;
+
+  // properties, under the object lock
+  guint block;
+  gdouble threshold;
+  gdouble min_area;
+  guint hold;
+  guint analyze_every;
+  guint message_interval;
+  gboolean drop_static;
+  gboolean dirty;  // analyzer options changed
+
+  // streaming thread only
+  GstVideoInfo info;
+  vptyp::MotionAnalyzer* analyzer;  // owned
+  gboolean motion;
+  guint quiet;  // analyzed frames since the last one with motion
+  guint64 frames;
+  guint since_message;
+  vptyp::MotionAnalyzer::Analysis last;
+};
+
+struct GstppMotionClass {
+  GstBaseTransformClass parent_class;
+};
+
+enum {
+  PROP_0,
+  PROP_BLOCK_SIZE,
+  PROP_THRESHOLD,
+  PROP_MIN_AREA,
+  PROP_HOLD,
+  PROP_ANALYZE_EVERY,
+  PROP_MESSAGE_INTERVAL,
+  PROP_DROP_STATIC,
+};
+
+// formats with a full resolution 8 bit luma plane first
+#define GSTPP_MOTION_CAPS \
+  GST_VIDEO_CAPS_MAKE("{ I420, YV12, NV12, NV21, Y42B, Y444, GRAY8 }")
+
+GstStaticPadTemplate sinkTemplate = GST_STATIC_PAD_TEMPLATE(
+    "sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS(GSTPP_MOTION_CAPS));
+
+GstStaticPadTemplate srcTemplate = GST_STATIC_PAD_TEMPLATE(
+    "src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS(GSTPP_MOTION_CAPS));
+
+}  // namespace
+
+G_DEFINE_TYPE(GstppMotion, gstpp_motion, GST_TYPE_BASE_TRANSFORM)
+
+static void gstpp_motion_reset(GstppMotion* self) {
+  delete self->analyzer;
+  GST_OBJECT_LOCK(self);
+  self->analyzer = new vptyp::MotionAnalyzer(
+      {.block = int(self->block),
+       .threshold = self->threshold,
+       .min_area = self->min_area});
+  self->dirty = FALSE;
+  GST_OBJECT_UNLOCK(self);
+  self->motion = FALSE;
+  self->quiet = 0;
+  self->frames = 0;
+  self->since_message = 0;
+  self->last = {};
+}
+
+static gboolean gstpp_motion_start(GstBaseTransform* trans) {
+  gstpp_motion_reset(reinterpret_cast<GstppMotion*>(trans));
+  return TRUE;
+}
+
+static gboolean gstpp_motion_stop(GstBaseTransform* trans) {
+  auto self = reinterpret_cast<GstppMotion*>(trans);
+  delete self->analyzer;
+  self->analyzer = nullptr;
+  return TRUE;
+}
+
+static gboolean gstpp_motion_set_caps(GstBaseTransform* trans, GstCaps* in,
+                                      GstCaps*) {
+  auto self = reinterpret_cast<GstppMotion*>(trans);
+  if (!gst_video_info_from_caps(&self->info, in)) return FALSE;
+  // a new resolution starts over, the first frame has nothing to compare to
+  if (self->analyzer) self->analyzer->reset();
+  return TRUE;
+}
+
+static void gstpp_motion_post(GstppMotion* self, GstBuffer* buffer,
+                              bool changed) {
+  const auto& last = self->last;
+  vptyp::MotionEvent event{
+      .motion = bool(self->motion),
+      .changed = changed,
+      .score = last.score,
+      .active_blocks = last.active_blocks,
+      .blocks = unsigned(last.cols * last.rows),
+      .pts = GST_BUFFER_PTS(buffer)};
+  gst_element_post_message(
+      GST_ELEMENT(self), vptyp::make_motion_message(GST_OBJECT(self), event));
+}
+
+static GstFlowReturn gstpp_motion_transform_ip(GstBaseTransform* trans,
+                                               GstBuffer* buffer) {
+  auto self = reinterpret_cast<GstppMotion*>(trans);
+
+  GST_OBJECT_LOCK(self);
+  bool dirty = self->dirty;
+  guint hold = self->hold;
+  guint every = std::max(self->analyze_every, 1u);
+  guint interval = self->message_interval;
+  bool dropStatic = self->drop_static;
+  GST_OBJECT_UNLOCK(self);
+  if (dirty || !self->analyzer) gstpp_motion_reset(self);
+
+  bool analyzed = self->frames++ % every == 0;
+  bool changed{false};
+  if (analyzed) {
+    GstVideoFrame frame;
+    if (!gst_video_frame_map(&frame, &self->info, buffer, GST_MAP_READ)) {
+      GST_ELEMENT_ERROR(self, STREAM, FAILED, ("cannot map frame"),
+                        (nullptr));
+      return GST_FLOW_ERROR;
+    }
+    self->last = self->analyzer->analyze(
+        static_cast<const uint8_t*>(GST_VIDEO_FRAME_COMP_DATA(&frame, 0)),
+        GST_VIDEO_FRAME_COMP_STRIDE(&frame, 0),
+        GST_VIDEO_FRAME_COMP_WIDTH(&frame, 0),
+        GST_VIDEO_FRAME_COMP_HEIGHT(&frame, 0));
+    gst_video_frame_unmap(&frame);
+
+    // motion holds for a while after the scene calmed down
+    self->quiet = self->last.motion ? 0 : self->quiet + 1;
+    bool motion = self->last.motion || (self->motion && self->quiet <= hold);
+    changed = motion != bool(self->motion);
+    self->motion = motion;
+  }
+
+  // the buffer struct is writable in place, the memory is only read
+  auto meta = vptyp::gstpp_buffer_add_motion_meta(buffer, self->last);
+  if (meta) meta->motion = self->motion;
+
+  ++self->since_message;
+  if (changed || (interval && self->since_message >= interval)) {
+    gstpp_motion_post(self, buffer, changed);
+    self->since_message = 0;
+  }
+
+  if (dropStatic && !self->motion) return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  return GST_FLOW_OK;
+}
+
+static void gstpp_motion_set_property(GObject* object, guint id,
+                                      const GValue* value, GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppMotion*>(object);
+  GST_OBJECT_LOCK(self);
+  switch (id) {
+    case PROP_BLOCK_SIZE:
+      self->block = g_value_get_uint(value);
+      self->dirty = TRUE;
+      break;
+    case PROP_THRESHOLD:
+      self->threshold = g_value_get_double(value);
+      self->dirty = TRUE;
+      break;
+    case PROP_MIN_AREA:
+      self->min_area = g_value_get_double(value);
+      self->dirty = TRUE;
+      break;
+    case PROP_HOLD:
+      self->hold = g_value_get_uint(value);
+      break;
+    case PROP_ANALYZE_EVERY:
+      self->analyze_every = g_value_get_uint(value);
+      break;
+    case PROP_MESSAGE_INTERVAL:
+      self->message_interval = g_value_get_uint(value);
+      break;
+    case PROP_DROP_STATIC:
+      self->drop_static = g_value_get_boolean(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+static void gstpp_motion_get_property(GObject* object, guint id,
+                                      GValue* value, GParamSpec* spec) {
+  auto self = reinterpret_cast<GstppMotion*>(object);
+  GST_OBJECT_LOCK(self);
+  switch (id) {
+    case PROP_BLOCK_SIZE:
+      g_value_set_uint(value, self->block);
+      break;
+    case PROP_THRESHOLD:
+      g_value_set_double(value, self->threshold);
+      break;
+    case PROP_MIN_AREA:
+      g_value_set_double(value, self->min_area);
+      break;
+    case PROP_HOLD:
+      g_value_set_uint(value, self->hold);
+      break;
+    case PROP_ANALYZE_EVERY:
+      g_value_set_uint(value, self->analyze_every);
+      break;
+    case PROP_MESSAGE_INTERVAL:
+      g_value_set_uint(value, self->message_interval);
+      break;
+    case PROP_DROP_STATIC:
+      g_value_set_boolean(value, self->drop_static);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, id, spec);
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+static void gstpp_motion_finalize(GObject* object) {
+  auto self = reinterpret_cast<GstppMotion*>(object);
+  delete self->analyzer;
+  self->analyzer = nullptr;
+  self->last.~Analysis();
+  G_OBJECT_CLASS(gstpp_motion_parent_class)->finalize(object);
+}
+
+static void gstpp_motion_class_init(GstppMotionClass* klass) {
+  auto objectClass = G_OBJECT_CLASS(klass);
+  objectClass->set_property = gstpp_motion_set_property;
+  objectClass->get_property = gstpp_motion_get_property;
+  objectClass->finalize = gstpp_motion_finalize;
+
+  vptyp::MotionAnalyzer::Options defaults;
+  auto flags = GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+  g_object_class_install_property(
+      objectClass, PROP_BLOCK_SIZE,
+      g_param_spec_uint("block-size", "Block size",
+                        "Side of the compared blocks, power of two", 16, 128,
+                        defaults.block, flags));
+  g_object_class_install_property(
+      objectClass, PROP_THRESHOLD,
+      g_param_spec_double("threshold", "Threshold",
+                          "Mean absolute luma difference of an active block",
+                          0, 255, defaults.threshold, flags));
+  g_object_class_install_property(
+      objectClass, PROP_MIN_AREA,
+      g_param_spec_double("min-area", "Minimum area",
+                          "Share of active blocks that counts as motion", 0,
+                          1, defaults.min_area, flags));
+  g_object_class_install_property(
+      objectClass, PROP_HOLD,
+      g_param_spec_uint("hold", "Hold",
+                        "Analyzed frames motion lasts after it stopped", 0,
+                        G_MAXUINT, 15, flags));
+  g_object_class_install_property(
+      objectClass, PROP_ANALYZE_EVERY,
+      g_param_spec_uint("analyze-every", "Analyze every",
+                        "Analyze every Nth frame, the others repeat the last "
+                        "result",
+                        1, G_MAXUINT, 1, flags));
+  g_object_class_install_property(
+      objectClass, PROP_MESSAGE_INTERVAL,
+      g_param_spec_uint("message-interval", "Message interval",
+                        "Also post a message every N frames, 0 - only on "
+                        "changes",
+                        0, G_MAXUINT, 0, flags));
+  g_object_class_install_property(
+      objectClass, PROP_DROP_STATIC,
+      g_param_spec_boolean("drop-static", "Drop static",
+                           "Drop buffers without motion", FALSE, flags));
+
+  auto elementClass = GST_ELEMENT_CLASS(klass);
+  gst_element_class_add_static_pad_template(elementClass, &sinkTemplate);
+  gst_element_class_add_static_pad_template(elementClass, &srcTemplate);
+  gst_element_class_set_static_metadata(
+      elementClass, "gstpp motion detector", "Filter/Analyzer/Video",
+      "Block wise luma frame differencing with motion meta and messages",
+      "gstPlayground");
+
+  auto transformClass = GST_BASE_TRANSFORM_CLASS(klass);
+  transformClass->start = gstpp_motion_start;
+  transformClass->stop = gstpp_motion_stop;
+  transformClass->set_caps = gstpp_motion_set_caps;
+  transformClass->transform_ip = gstpp_motion_transform_ip;
+}
+
+static void gstpp_motion_init(GstppMotion* self) {
+  vptyp::MotionAnalyzer::Options defaults;
+  self->block = defaults.block;
+  self->threshold = defaults.threshold;
+  self->min_area = defaults.min_area;
+  self->hold = 15;
+  self->analyze_every = 1;
+  self->message_interval = 0;
+  self->drop_static = FALSE;
+  self->dirty = FALSE;
+  gst_video_info_init(&self->info);
+  self->analyzer = nullptr;
+  self->motion = FALSE;
+  self->quiet = 0;
+  self->frames = 0;
+  self->since_message = 0;
+  new (&self->last) vptyp::MotionAnalyzer::Analysis();
+
+  // the luma plane is only read, meta goes on the buffer struct
+  gst_base_transform_set_in_place(GST_BASE_TRANSFORM(self), TRUE);
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <gst/gst.h>
+
+// "gstppmotion": in place motion detection on the luma plane of raw video.
+// Every analyzed buffer gets a GstppMotionMeta; "gstpp-motion" element
+// messages are posted when motion starts or stops (and every
+// "message-interval" frames). With "drop-static" buffers without motion are
+// dropped, so expensive analytics downstream only see moving scenes.
+GType gstpp_motion_get_type();
@@ -0,0 +1,43 @@
+#include "gstppPlugin.hh"
+
+#include <glog/logging.h>
+#include <gst/gst.h>
+
+#include <mutex>
+
+#include "gstppAsyncFileSink.hh"
+#include "gstppConvert.hh"
+#include "gstppDecimate.hh"
+#include "gstppMotion.hh"
+
+namespace {
+
+gboolean plugin_init(GstPlugin* plugin) {
+  return gst_element_register(plugin, "gstppconvert", GST_RANK_NONE,
+                              gstpp_convert_get_type()) &&
+         gst_element_register(plugin, "gstppmotion", GST_RANK_NONE,
+                              gstpp_motion_get_type()) &&
+         gst_element_register(plugin, "gstppdecimate", GST_RANK_NONE,
+                              gstpp_decimate_get_type()) &&
+         gst_element_register(plugin, "gstppasyncfilesink", GST_RANK_NONE,
+                              gstpp_async_file_sink_get_type());
+}
+
+}  // namespace
+
+namespace vptyp {
+
+bool register_elements() {
+  static std::once_flag once;
+  static bool registered{false};
+  std::call_once(once, []() {
+    registered = gst_plugin_register_static(
+        GST_VERSION_MAJOR, GST_VERSION_MINOR, "gstpp",
+        "Elements of the gstPlayground library", plugin_init, "1.0", "unknown",
+        "gstpp", "gstPlayground", "gstPlayground");
+    if (!registered) LOG(ERROR) << "gstpp plugin registration failed";
+  });
+  return registered;
+}
+
+}  // namespace vptyp
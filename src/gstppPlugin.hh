@@ -0,0 +1,10 @@
+#pragma once
+
+namespace vptyp {
+
+// Registers the elements of the gstpp library as a static plugin, so they
+// are found by name like any installed element. Call after gst_init,
+// repeated calls are no-ops.
+bool register_elements();
+
+}  // namespace vptyp
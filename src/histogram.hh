@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+namespace vptyp {
+
+// Lock-free histogram with power of two buckets, safe to record from any
+// number of streaming threads. Bucket i holds values in [2^(i-1), 2^i).
+class Histogram {
+ public:
+  static constexpr size_t kBuckets = 65;
+
+  struct Snapshot {
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t min{0};
+    uint64_t max{0};
+    std::array<uint64_t, kBuckets> buckets{};
+
+    double mean() const { return count ? double(sum) / count : 0; }
+
+    // upper bound of the bucket holding the q-th quantile
+    uint64_t percentile(double q) const {
+      if (!count) return 0;
+      uint64_t rank = uint64_t(q * (count - 1)) + 1;
+      uint64_t seen{0};
+      for (size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return i == 0 ? 0 : std::min(upper_bound(i), max);
+      }
+      return max;
+    }
+  };
+
+  static constexpr uint64_t upper_bound(size_t bucket) {
+    return bucket >= 64 ? std::numeric_limits<uint64_t>::max()
+                        : (uint64_t(1) << bucket) - 1;
+  }
+
+  void record(uint64_t value) {
+    buckets[std::bit_width(value)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum.fetch_add(value, std::memory_order_relaxed);
+
+    uint64_t current = max.load(std::memory_order_relaxed);
+    while (value > current &&
+           !max.compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {
+    }
+    current = min.load(std::memory_order_relaxed);
+    while (value < current &&
+           !min.compare_exchange_weak(current, value,
+                                      std::memory_order_relaxed)) {
+    }
+  }
+
+  Snapshot snapshot() const {
+    Snapshot result;
+    result.count = count.load(std::memory_order_relaxed);
+    result.sum = sum.load(std::memory_order_relaxed);
+    result.max = max.load(std::memory_order_relaxed);
+    result.min = result.count ? min.load(std::memory_order_relaxed) : 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      result.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+    }
+    return result;
+  }
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> min{std::numeric_limits<uint64_t>::max()};
+  std::atomic<uint64_t> max{0};
+};
+
+}  // namespace vptyp
@@ -1,12 +1,17 @@
 #include <gflags/gflags.h>
+#include <glib-unix.h>
 #include <glib.h>
 #include <glog/logging.h>
 #include <gst/gst.h>
 
+#include <chrono>
+#include <csignal>
 #include <filesystem>
 
 #include "basePlayer.hh"
 #include "flags.hh"
+#include "gstppPlugin.hh"
+#include "metrics.hh"
 #include "playerFactory.hh"
 
 DEFINE_string(filename, "", "mp4 file path");
@@ -14,6 +19,107 @@ DEFINE_string(url, "", "web URL to stream from");
 DEFINE_string(output, "", "output file path");
 DEFINE_string(webrtc, "",
               "provide uri for signalling server. E.g.: ws://127.0.0.1:8443");
+DEFINE_string(graph, "",
+              "gst-launch like pipeline description, e.g.: "
+              "\"videotestsrc ! videoconvert ! autovideosink\", or a JSON "
+              "object with nodes and links");
+DEFINE_string(profile, "",
+              "write per element profile json to the path, \"-\" to log it");
+DEFINE_int32(profile_interval_ms, 5000, "period of profile dumps");
+DEFINE_int32(metrics_port, 0,
+             "serve prometheus metrics on 127.0.0.1:<port>, 0 disables");
+DEFINE_string(metrics_file, "",
+              "periodically write prometheus metrics to the path");
+DEFINE_int32(segments, 1,
+             "transcode in N keyframe aligned segments in parallel, 0 uses "
+             "one per core");
+DEFINE_bool(force_transcode, false,
+            "re-encode even when the input could be remuxed as is");
+DEFINE_string(download_dir, "",
+              "directory for the download buffer, system temp dir if empty");
+DEFINE_int32(download_ring_mb, 0,
+             "keep only this many MiB of the download on disk, 0 keeps all");
+DEFINE_bool(fast_convert, false,
+            "convert colorspaces with gstppconvert instead of videoconvert, "
+            "limited to 8 bit NV12/I420/RGBA/BGRx, BT.601 and no scaling");
+DEFINE_string(fanout, "",
+              "uri or path decoded once and fanned out to --record, "
+              "--preview and --webrtc at the same time");
+DEFINE_string(record, "", "mp4 path the fan out source is recorded to");
+DEFINE_bool(preview, false, "show the fan out source in a local window");
+DEFINE_bool(rtc_low_latency, false,
+            "webrtc low latency profile: gcc congestion control, zero "
+            "latency encoder settings and short GOP");
+DEFINE_string(rtc_codec, "", "webrtc video codec, e.g. vp8 or h264");
+DEFINE_string(rtc_congestion, "",
+              "webrtc congestion control: disabled, homegrown or gcc");
+DEFINE_int32(rtc_start_kbps, 0, "webrtc start bitrate, 0 keeps the default");
+DEFINE_int32(rtc_min_kbps, 0, "webrtc minimum bitrate, 0 keeps the default");
+DEFINE_int32(rtc_max_kbps, 0, "webrtc maximum bitrate, 0 keeps the default");
+DEFINE_int32(rtc_keyframe_interval, 0,
+             "webrtc keyframe interval in frames, 0 keeps the default");
+DEFINE_string(rtc_ladder, "",
+              "encode once per rendition and share it between all webrtc "
+              "peers: \"default\" or name:WxH@kbps,... e.g. "
+              "hd:1280x720@2500,sd:640x360@800");
+DEFINE_string(rtc_source, "",
+              "uri or path streamed over webrtc: file, http(s) or rtsp; "
+              "empty streams a test pattern");
+DEFINE_bool(rtc_passthrough, true,
+            "send h264/vp8 sources matching --rtc_codec without decoding "
+            "and encoding them again");
+DEFINE_int32(drain_timeout_ms, 5000,
+             "on SIGINT/SIGTERM wait this long for EOS to finish the output "
+             "before stopping; a second signal stops right away");
+DEFINE_string(recording_mode, "single",
+              "how --url is written to --filename: single mp4, fragmented "
+              "mp4 or segmented files rotated by time and size");
+DEFINE_int32(recording_fragment_ms, 1000, "fragmented mp4 fragment length");
+DEFINE_int32(recording_segment_s, 60,
+             "segment length, 0 rotates by --recording_segment_mb only");
+DEFINE_int32(recording_segment_mb, 0,
+             "segment size limit, 0 rotates by time only");
+DEFINE_int32(recording_max_files, 0,
+             "segments kept on disk, the oldest are reused; 0 keeps all");
+DEFINE_string(recording_sync, "none",
+              "fsync policy: none, segment (each closed segment and the "
+              "index) or write (every write, O_SYNC)");
+DEFINE_string(recording_index, "",
+              "file listing each closed segment with its start and end ms");
+DEFINE_string(recording_sink, "filesink",
+              "element writing the recording: filesink, or "
+              "gstppasyncfilesink for batched io_uring/thread pool writes");
+
+namespace {
+
+struct Shutdown {
+  vptyp::BasePlayer* player{nullptr};
+  GMainLoop* loop{nullptr};
+  std::chrono::milliseconds timeout{0};
+  bool draining{false};
+};
+
+// first signal drains so recordings stay playable, the next one quits
+gboolean on_terminate(gpointer data) {
+  auto shutdown = static_cast<Shutdown*>(data);
+  if (shutdown->draining || !shutdown->player->drain(shutdown->timeout)) {
+    g_main_loop_quit(shutdown->loop);
+    return G_SOURCE_CONTINUE;
+  }
+  LOG(INFO) << "draining, signal again to stop right away";
+  shutdown->draining = true;
+  return G_SOURCE_CONTINUE;
+}
+
+// plays from the start with the pipeline as built
+gboolean on_restart(gpointer data) {
+  auto shutdown = static_cast<Shutdown*>(data);
+  if (shutdown->draining) return G_SOURCE_CONTINUE;
+  if (!shutdown->player->restart()) LOG(ERROR) << "restart failed";
+  return G_SOURCE_CONTINUE;
+}
+
+}  // namespace
 
 void loggerSetup(char* argv[]) {
   if (!std::filesystem::exists("logs") ||
@@ -30,15 +136,53 @@ int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
   loggerSetup(argv);
   gst_init(&argc, &argv);
+  vptyp::register_elements();
 
   GMainLoop* loop = g_main_loop_new(nullptr, false);
 
   vptyp::Flags flags{.url = FLAGS_url,
                      .filename = FLAGS_filename,
                      .output = FLAGS_output,
-                     .wsUri = FLAGS_webrtc};
+                     .wsUri = FLAGS_webrtc,
+                     .graph = FLAGS_graph,
+                     .profile = FLAGS_profile,
+                     .profile_interval_ms = FLAGS_profile_interval_ms,
+                     .metrics_port = FLAGS_metrics_port,
+                     .metrics_file = FLAGS_metrics_file,
+                     .segments = FLAGS_segments,
+                     .force_transcode = FLAGS_force_transcode,
+                     .download_dir = FLAGS_download_dir,
+                     .download_ring_mb = FLAGS_download_ring_mb,
+                     .fast_convert = FLAGS_fast_convert,
+                     .fanout = FLAGS_fanout,
+                     .record = FLAGS_record,
+                     .preview = FLAGS_preview,
+                     .rtc_low_latency = FLAGS_rtc_low_latency,
+                     .rtc_codec = FLAGS_rtc_codec,
+                     .rtc_congestion = FLAGS_rtc_congestion,
+                     .rtc_start_kbps = FLAGS_rtc_start_kbps,
+                     .rtc_min_kbps = FLAGS_rtc_min_kbps,
+                     .rtc_max_kbps = FLAGS_rtc_max_kbps,
+                     .rtc_keyframe_interval = FLAGS_rtc_keyframe_interval,
+                     .rtc_ladder = FLAGS_rtc_ladder,
+                     .rtc_source = FLAGS_rtc_source,
+                     .rtc_passthrough = FLAGS_rtc_passthrough,
+                     .drain_timeout_ms = FLAGS_drain_timeout_ms,
+                     .recording_mode = FLAGS_recording_mode,
+                     .recording_fragment_ms = FLAGS_recording_fragment_ms,
+                     .recording_segment_s = FLAGS_recording_segment_s,
+                     .recording_segment_mb = FLAGS_recording_segment_mb,
+                     .recording_max_files = FLAGS_recording_max_files,
+                     .recording_sync = FLAGS_recording_sync,
+                     .recording_index = FLAGS_recording_index,
+                     .recording_sink = FLAGS_recording_sink};
 
   vptyp::init_flags(flags);
+  if (!vptyp::MetricsRegistry::instance().start_export(
+          {.port = static_cast<uint16_t>(flags.metrics_port),
+           .path = flags.metrics_file})) {
+    LOG(FATAL) << "Metrics export failed";
+  }
 
   std::unique_ptr<vptyp::BasePlayer> player =
       vptyp::PlayerFactory().create(flags, *loop);
@@ -48,10 +192,20 @@ int main(int argc, char* argv[]) {
   }
 
   player->create();
+  Shutdown shutdown{
+      .player = player.get(),
+      .loop = loop,
+      .timeout = std::chrono::milliseconds(flags.drain_timeout_ms)};
+  guint signals[] = {g_unix_signal_add(SIGINT, on_terminate, &shutdown),
+                     g_unix_signal_add(SIGTERM, on_terminate, &shutdown),
+                     g_unix_signal_add(SIGHUP, on_restart, &shutdown)};
   player->play();
   g_main_loop_run(loop);
+  for (guint id : signals) g_source_remove(id);
   player->stop();
 
+  vptyp::MetricsRegistry::instance().stop_export();
+
   g_main_loop_unref(loop);
   loop = nullptr;
   return 0;
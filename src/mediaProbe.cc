@@ -0,0 +1,117 @@
+#include "mediaProbe.hh"
+
+#include <glog/logging.h>
+
+#include <condition_variable>
+#include <format>
+#include <mutex>
+
+#include "pipeline.hh"
+#include "pipelineGraph.hh"
+#include "pipelineManager.hh"
+
+namespace vptyp {
+
+namespace {
+
+struct ProbeState {
+  std::mutex guard;
+  std::condition_variable exposed;
+  bool done{false};
+  std::vector<std::string> streams;
+};
+
+void pad_added(GstElement*, GstPad* pad, gpointer data) {
+  auto state = static_cast<ProbeState*>(data);
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  if (!caps) caps = gst_pad_query_caps(pad, nullptr);
+  gchar* description = gst_caps_to_string(caps);
+  gst_caps_unref(caps);
+
+  std::lock_guard lock(state->guard);
+  state->streams.emplace_back(description);
+  g_free(description);
+}
+
+void no_more_pads(GstElement*, gpointer data) {
+  auto state = static_cast<ProbeState*>(data);
+  {
+    std::lock_guard lock(state->guard);
+    state->done = true;
+  }
+  state->exposed.notify_all();
+}
+
+}  // namespace
+
+std::optional<std::string> MediaInfo::video() const {
+  for (auto& stream : streams) {
+    if (stream.starts_with("video/")) return stream;
+  }
+  return std::nullopt;
+}
+
+const char* source_factory(std::string_view location) {
+  bool remote =
+      location.starts_with("http://") || location.starts_with("https://");
+  return remote ? "souphttpsrc" : "filesrc";
+}
+
+std::optional<MediaInfo> probe_media(std::string_view location,
+                                     std::chrono::milliseconds timeout) {
+  // outlives the manager, signals arrive from the demuxer streaming thread
+  ProbeState state;
+  PipelineManager manager({.shards = 1, .pin_threads = false});
+
+  GstElement* demuxer{nullptr};
+  Pipeline& pipeline = manager.add("media-probe", [&](Pipeline& pipeline) {
+    PipelineGraph graph;
+    graph.add(source_factory(location), "source")
+        .set("location", location)
+        .then("qtdemux", "demuxer");
+    if (!graph.build(pipeline)) return;
+
+    demuxer = pipeline.find("demuxer")->raw();
+    g_signal_connect(demuxer, "pad-added", G_CALLBACK(pad_added), &state);
+    g_signal_connect(demuxer, "no-more-pads", G_CALLBACK(no_more_pads),
+                     &state);
+  });
+  if (!demuxer) return std::nullopt;
+
+  // no sinks, so PAUSED is reached at once and only the demuxer task runs;
+  // it errors out as not-linked once streams are exposed, which is expected
+  if (gst_element_set_state(pipeline.raw(), GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE) {
+    LOG(ERROR) << std::format("cannot open {}", location);
+    return std::nullopt;
+  }
+  MediaInfo info;
+  {
+    std::unique_lock lock(state.guard);
+    if (!state.exposed.wait_for(lock, timeout, [&]() { return state.done; })) {
+      LOG(ERROR) << std::format("{}: streams not exposed in {}ms", location,
+                                timeout.count());
+      return std::nullopt;
+    }
+    info.streams = state.streams;
+  }
+
+  gint64 duration{0};
+  if (gst_element_query_duration(demuxer, GST_FORMAT_TIME, &duration) &&
+      duration >= 0) {
+    info.duration = duration;
+  }
+  pipeline.stop();
+  return info;
+}
+
+bool caps_compatible(std::string_view caps, std::string_view target) {
+  GstCaps* have = gst_caps_from_string(std::string(caps).c_str());
+  GstCaps* want = gst_caps_from_string(std::string(target).c_str());
+  bool compatible = have && want && gst_caps_can_intersect(have, want);
+  if (have) gst_caps_unref(have);
+  if (want) gst_caps_unref(want);
+  return compatible;
+}
+
+}  // namespace vptyp
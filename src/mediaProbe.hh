@@ -0,0 +1,32 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vptyp {
+
+struct MediaInfo {
+  GstClockTime duration{GST_CLOCK_TIME_NONE};
+  std::vector<std::string> streams{};  // caps of every demuxed stream
+
+  // caps of the first video stream
+  std::optional<std::string> video() const;
+};
+
+// source element for a local path or an http(s) url
+const char* source_factory(std::string_view location);
+
+// demuxes the head of an mp4 until all streams are exposed, nothing is
+// decoded; nullopt if the demuxer gave up or the timeout passed
+std::optional<MediaInfo> probe_media(std::string_view location,
+                                     std::chrono::milliseconds timeout);
+
+// whether caps would negotiate with the target, i.e. the stream can be muxed
+// as is where target is accepted
+bool caps_compatible(std::string_view caps, std::string_view target);
+
+}  // namespace vptyp
@@ -0,0 +1,250 @@
+#include "metrics.hh"
+
+#include <arpa/inet.h>
+#include <glog/logging.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+namespace vptyp {
+
+namespace {
+
+std::string escape(std::string_view value) {
+  std::string result;
+  result.reserve(value.size());
+  for (char c : value) {
+    if (c == '\\' || c == '"') result += '\\';
+    if (c == '\n') {
+      result += "\\n";
+      continue;
+    }
+    result += c;
+  }
+  return result;
+}
+
+std::string label_set(const MetricsRegistry::Labels& labels) {
+  if (labels.empty()) return {};
+  std::string result = "{";
+  for (auto& [key, value] : labels) {
+    if (result.size() > 1) result += ',';
+    result += std::format("{}=\"{}\"", key, escape(value));
+  }
+  return result + "}";
+}
+
+// labels of an existing series with one more appended, for histogram "le"
+std::string with_label(const std::string& labels, std::string_view extra) {
+  if (labels.empty()) return std::format("{{{}}}", extra);
+  return std::format("{},{}}}", labels.substr(0, labels.size() - 1), extra);
+}
+
+int listen_local(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+  int reuse{1};
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+      listen(fd, 8) < 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void respond(int client, const std::string& body) {
+  // the request itself is irrelevant, every path gets the exposition
+  char request[1024];
+  pollfd readable{.fd = client, .events = POLLIN, .revents = 0};
+  if (poll(&readable, 1, 1000) > 0) recv(client, request, sizeof(request), 0);
+
+  auto response = std::format(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: {}\r\n"
+      "Connection: close\r\n\r\n{}",
+      body.size(), body);
+  size_t sent{0};
+  while (sent < response.size()) {
+    auto n = send(client, response.data() + sent, response.size() - sent,
+                  MSG_NOSIGNAL);
+    if (n <= 0) break;
+    sent += n;
+  }
+  close(client);
+}
+
+}  // namespace
+
+MetricsRegistry& MetricsRegistry::instance() {
+  static MetricsRegistry registry;
+  return registry;
+}
+
+MetricsRegistry::~MetricsRegistry() { stop_export(); }
+
+MetricsRegistry::Family& MetricsRegistry::family(std::string_view name,
+                                                 std::string_view help,
+                                                 Type type) {
+  auto it = families.find(name);
+  if (it == families.end()) {
+    it = families.emplace(std::string(name), Family{}).first;
+    it->second.type = type;
+    it->second.help = help;
+  } else if (it->second.type != type) {
+    LOG(ERROR) << std::format("metric {} registered with another type", name);
+  }
+  return it->second;
+}
+
+Counter& MetricsRegistry::counter(std::string_view name, std::string_view help,
+                                  const Labels& labels) {
+  std::lock_guard lock(guard);
+  auto& series = family(name, help, Type::Counter).counters[label_set(labels)];
+  if (!series) series = std::make_unique<Counter>();
+  return *series;
+}
+
+Gauge& MetricsRegistry::gauge(std::string_view name, std::string_view help,
+                              const Labels& labels) {
+  std::lock_guard lock(guard);
+  auto& series = family(name, help, Type::Gauge).gauges[label_set(labels)];
+  if (!series) series = std::make_unique<Gauge>();
+  return *series;
+}
+
+Histogram& MetricsRegistry::histogram(std::string_view name,
+                                      std::string_view help,
+                                      const Labels& labels) {
+  std::lock_guard lock(guard);
+  auto& series =
+      family(name, help, Type::Histogram).histograms[label_set(labels)];
+  if (!series) series = std::make_unique<Histogram>();
+  return *series;
+}
+
+std::string MetricsRegistry::exposition() const {
+  std::lock_guard lock(guard);
+  std::string text;
+  for (auto& [name, family] : families) {
+    const char* type = family.type == Type::Counter ? "counter"
+                       : family.type == Type::Gauge ? "gauge"
+                                                    : "histogram";
+    text += std::format("# HELP {} {}\n# TYPE {} {}\n", name, family.help, name,
+                        type);
+    for (auto& [labels, counter] : family.counters) {
+      text += std::format("{}{} {}\n", name, labels, counter->value());
+    }
+    for (auto& [labels, gauge] : family.gauges) {
+      text += std::format("{}{} {}\n", name, labels, gauge->value());
+    }
+    for (auto& [labels, histogram] : family.histograms) {
+      auto s = histogram->snapshot();
+      // cumulative buckets, trailing empty power of two buckets are skipped
+      size_t last = std::bit_width(s.max);
+      uint64_t cumulative{0};
+      for (size_t i = 0; i <= last && i < Histogram::kBuckets - 1; ++i) {
+        cumulative += s.buckets[i];
+        text += std::format(
+            "{}_bucket{} {}\n", name,
+            with_label(labels,
+                       std::format("le=\"{}\"", Histogram::upper_bound(i))),
+            cumulative);
+      }
+      text += std::format("{}_bucket{} {}\n", name,
+                          with_label(labels, "le=\"+Inf\""), s.count);
+      text += std::format("{}_sum{} {}\n", name, labels, s.sum);
+      text += std::format("{}_count{} {}\n", name, labels, s.count);
+    }
+  }
+  return text;
+}
+
+bool MetricsRegistry::write(const std::string& path) const {
+  // readers never see a half written file
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::trunc);
+    if (!out) {
+      LOG(ERROR) << std::format("cannot write metrics to {}", temporary);
+      return false;
+    }
+    out << exposition();
+  }
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    LOG(ERROR) << std::format("cannot move metrics to {}: {}", path,
+                              error.message());
+    return false;
+  }
+  return true;
+}
+
+bool MetricsRegistry::start_export(const ExportOptions& options) {
+  stop_export();
+  if (!options.port && options.path.empty()) return true;
+
+  int server{-1};
+  if (options.port) {
+    server = listen_local(options.port);
+    if (server < 0) {
+      LOG(ERROR) << std::format("cannot listen on 127.0.0.1:{}: {}",
+                                options.port, std::strerror(errno));
+      return false;
+    }
+    LOG(INFO) << std::format("metrics on http://127.0.0.1:{}/metrics",
+                             options.port);
+  }
+  exporter = std::jthread([this, options, server](std::stop_token stop) {
+    export_loop(stop, options, server);
+  });
+  return true;
+}
+
+void MetricsRegistry::stop_export() {
+  if (!exporter.joinable()) return;
+  exporter.request_stop();
+  exporter.join();
+}
+
+void MetricsRegistry::export_loop(std::stop_token stop, ExportOptions options,
+                                  int server) {
+  using clock = std::chrono::steady_clock;
+  // short poll slices keep stop requests responsive
+  constexpr std::chrono::milliseconds kSlice{100};
+  auto nextWrite = clock::now();
+
+  while (!stop.stop_requested()) {
+    if (!options.path.empty() && clock::now() >= nextWrite) {
+      write(options.path);
+      nextWrite = clock::now() + options.interval;
+    }
+    if (server < 0) {
+      std::this_thread::sleep_for(kSlice);
+      continue;
+    }
+    pollfd pending{.fd = server, .events = POLLIN, .revents = 0};
+    if (poll(&pending, 1, kSlice.count()) <= 0) continue;
+    int client = accept4(server, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client >= 0) respond(client, exposition());
+  }
+
+  if (!options.path.empty()) write(options.path);
+  if (server >= 0) close(server);
+}
+
+}  // namespace vptyp
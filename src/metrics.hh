@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "histogram.hh"
+
+namespace vptyp {
+
+class Counter {
+ public:
+  void inc(uint64_t n = 1) { count.fetch_add(n, std::memory_order_relaxed); }
+  uint64_t value() const { return count.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<uint64_t> count{0};
+};
+
+class Gauge {
+ public:
+  void set(double v) { current.store(v, std::memory_order_relaxed); }
+  void add(double v) { current.fetch_add(v, std::memory_order_relaxed); }
+  double value() const { return current.load(std::memory_order_relaxed); }
+
+ private:
+  std::atomic<double> current{0};
+};
+
+// Process wide metrics in Prometheus text exposition format. Lookups take a
+// lock and are meant for setup; the returned references stay valid for the
+// process lifetime and are updated lock-free on the hot path.
+class MetricsRegistry {
+ public:
+  using Labels = std::vector<std::pair<std::string, std::string>>;
+
+  struct ExportOptions {
+    uint16_t port{0};  // serve GET /metrics on localhost, 0 - off
+    std::string path{};  // rewrite text file every interval, empty - off
+    std::chrono::milliseconds interval{5000};
+  };
+
+  static MetricsRegistry& instance();
+
+  Counter& counter(std::string_view name, std::string_view help,
+                   const Labels& labels = {});
+  Gauge& gauge(std::string_view name, std::string_view help,
+               const Labels& labels = {});
+  Histogram& histogram(std::string_view name, std::string_view help,
+                       const Labels& labels = {});
+
+  std::string exposition() const;
+  bool write(const std::string& path) const;
+
+  // background thread serving and/or writing the exposition
+  bool start_export(const ExportOptions& options);
+  void stop_export();
+
+  ~MetricsRegistry();
+
+ protected:
+  enum class Type { Counter, Gauge, Histogram };
+
+  struct Family {
+    Type type{Type::Counter};
+    std::string help{};
+    std::map<std::string, std::unique_ptr<Counter>> counters{};
+    std::map<std::string, std::unique_ptr<Gauge>> gauges{};
+    std::map<std::string, std::unique_ptr<Histogram>> histograms{};
+  };
+
+  MetricsRegistry() = default;
+  Family& family(std::string_view name, std::string_view help, Type type);
+  void export_loop(std::stop_token stop, ExportOptions options, int server);
+
+ protected:
+  mutable std::mutex guard;
+  std::map<std::string, Family, std::less<>> families;
+  std::jthread exporter;
+};
+
+}  // namespace vptyp
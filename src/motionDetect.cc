@@ -0,0 +1,247 @@
+#include "motionDetect.hh"
+
+#include <glog/logging.h>
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+
+namespace vptyp {
+
+namespace {
+
+void sad_row_scalar(const uint8_t* a, const uint8_t* b, int x, int width,
+                    int shift, uint32_t* sums) {
+  for (; x < width; ++x) sums[x >> shift] += std::abs(a[x] - b[x]);
+}
+
+__attribute__((target("sse4.1"))) int sad_row_sse41(const uint8_t* a,
+                                                    const uint8_t* b,
+                                                    int width, int shift,
+                                                    uint32_t* sums) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    __m128i sad = _mm_sad_epu8(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + x)),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + x)));
+    sums[x >> shift] += _mm_cvtsi128_si32(sad) + _mm_extract_epi32(sad, 2);
+  }
+  return x;
+}
+
+// a 32 byte step may straddle two blocks of 16
+__attribute__((target("avx2"))) int sad_row_avx2(const uint8_t* a,
+                                                 const uint8_t* b, int width,
+                                                 int shift, uint32_t* sums) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    __m256i sad = _mm256_sad_epu8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + x)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + x)));
+    __m128i lo = _mm256_castsi256_si128(sad);
+    __m128i hi = _mm256_extracti128_si256(sad, 1);
+    sums[x >> shift] += _mm_cvtsi128_si32(lo) + _mm_extract_epi32(lo, 2);
+    sums[(x + 16) >> shift] +=
+        _mm_cvtsi128_si32(hi) + _mm_extract_epi32(hi, 2);
+  }
+  return x;
+}
+
+}  // namespace
+
+MotionAnalyzer::MotionAnalyzer() : MotionAnalyzer(Options{}) {}
+
+MotionAnalyzer::MotionAnalyzer(const Options& options, color::Isa isa)
+    : options(options), isa(std::min(isa, color::detect_isa())) {
+  unsigned block = std::bit_floor(unsigned(std::clamp(options.block, 16, 128)));
+  if (int(block) != options.block) {
+    LOG(WARNING) << std::format("motion block {} adjusted to {}",
+                                options.block, block);
+    this->options.block = int(block);
+  }
+}
+
+void MotionAnalyzer::block_sad(const uint8_t* a, int a_stride,
+                               const uint8_t* b, int b_stride, int width,
+                               int height, int block, uint32_t* sums,
+                               color::Isa isa) {
+  int shift = std::countr_zero(unsigned(block));
+  int cols = (width + block - 1) >> shift;
+  for (int y = 0; y < height; ++y) {
+    const uint8_t* rowA = a + ptrdiff_t(y) * a_stride;
+    const uint8_t* rowB = b + ptrdiff_t(y) * b_stride;
+    uint32_t* rowSums = sums + ptrdiff_t(y >> shift) * cols;
+    int x{0};
+    if (isa == color::Isa::AVX2) {
+      x = sad_row_avx2(rowA, rowB, width, shift, rowSums);
+    } else if (isa == color::Isa::SSE41) {
+      x = sad_row_sse41(rowA, rowB, width, shift, rowSums);
+    }
+    sad_row_scalar(rowA, rowB, x, width, shift, rowSums);
+  }
+}
+
+MotionAnalyzer::Analysis MotionAnalyzer::analyze(const uint8_t* luma,
+                                                 int stride, int width,
+                                                 int height) {
+  int block = options.block;
+  Analysis result{.cols = (width + block - 1) / block,
+                  .rows = (height + block - 1) / block};
+  result.map.assign(size_t(result.cols) * result.rows, 0);
+
+  bool comparable = width == this->width && height == this->height;
+  if (comparable) {
+    sums.assign(result.map.size(), 0);
+    block_sad(luma, stride, previous.data(), width, width, height, block,
+              sums.data(), isa);
+
+    uint64_t total{0};
+    for (int by = 0; by < result.rows; ++by) {
+      int blockHeight = std::min(block, height - by * block);
+      for (int bx = 0; bx < result.cols; ++bx) {
+        int blockWidth = std::min(block, width - bx * block);
+        size_t index = size_t(by) * result.cols + bx;
+        total += sums[index];
+        if (sums[index] > options.threshold * blockWidth * blockHeight) {
+          result.map[index] = 1;
+          ++result.active_blocks;
+        }
+      }
+    }
+    result.score = double(total) / (double(width) * height);
+    result.motion =
+        result.active_blocks > 0 &&
+        result.active_blocks >= options.min_area * result.map.size();
+  }
+
+  this->width = width;
+  this->height = height;
+  previous.resize(size_t(width) * height);
+  for (int y = 0; y < height; ++y) {
+    std::memcpy(previous.data() + size_t(y) * width,
+                luma + ptrdiff_t(y) * stride, width);
+  }
+  return result;
+}
+
+void MotionAnalyzer::reset() {
+  width = 0;
+  height = 0;
+  previous.clear();
+}
+
+// ---- meta ----
+
+static gboolean motion_meta_init(GstMeta* meta, gpointer, GstBuffer*) {
+  auto motion = reinterpret_cast<GstppMotionMeta*>(meta);
+  motion->motion = FALSE;
+  motion->score = 0;
+  motion->active_blocks = 0;
+  motion->cols = 0;
+  motion->rows = 0;
+  motion->map = nullptr;
+  return TRUE;
+}
+
+static void motion_meta_free(GstMeta* meta, GstBuffer*) {
+  auto motion = reinterpret_cast<GstppMotionMeta*>(meta);
+  g_free(motion->map);
+  motion->map = nullptr;
+}
+
+static gboolean motion_meta_transform(GstBuffer* dest, GstMeta* meta,
+                                      GstBuffer*, GQuark type, gpointer) {
+  // the analysis holds for copies, not for scaled or cropped frames
+  if (!GST_META_TRANSFORM_IS_COPY(type)) return FALSE;
+  auto source = reinterpret_cast<GstppMotionMeta*>(meta);
+  auto copy = reinterpret_cast<GstppMotionMeta*>(
+      gst_buffer_add_meta(dest, gstpp_motion_meta_get_info(), nullptr));
+  if (!copy) return FALSE;
+  copy->motion = source->motion;
+  copy->score = source->score;
+  copy->active_blocks = source->active_blocks;
+  copy->cols = source->cols;
+  copy->rows = source->rows;
+  copy->map = static_cast<guint8*>(
+      g_memdup2(source->map, gsize(source->cols) * source->rows));
+  return TRUE;
+}
+
+GType gstpp_motion_meta_api_get_type() {
+  static GType type = []() {
+    static const gchar* tags[] = {nullptr};
+    return gst_meta_api_type_register("GstppMotionMetaAPI", tags);
+  }();
+  return type;
+}
+
+const GstMetaInfo* gstpp_motion_meta_get_info() {
+  static const GstMetaInfo* info = gst_meta_register(
+      gstpp_motion_meta_api_get_type(), "GstppMotionMeta",
+      sizeof(GstppMotionMeta), motion_meta_init, motion_meta_free,
+      motion_meta_transform);
+  return info;
+}
+
+GstppMotionMeta* gstpp_buffer_add_motion_meta(
+    GstBuffer* buffer, const MotionAnalyzer::Analysis& analysis) {
+  auto meta = reinterpret_cast<GstppMotionMeta*>(
+      gst_buffer_add_meta(buffer, gstpp_motion_meta_get_info(), nullptr));
+  if (!meta) return nullptr;
+  meta->motion = analysis.motion;
+  meta->score = analysis.score;
+  meta->active_blocks = analysis.active_blocks;
+  meta->cols = analysis.cols;
+  meta->rows = analysis.rows;
+  meta->map = static_cast<guint8*>(
+      g_memdup2(analysis.map.data(), analysis.map.size()));
+  return meta;
+}
+
+GstppMotionMeta* gstpp_buffer_get_motion_meta(GstBuffer* buffer) {
+  return reinterpret_cast<GstppMotionMeta*>(
+      gst_buffer_get_meta(buffer, gstpp_motion_meta_api_get_type()));
+}
+
+// ---- bus messages ----
+
+GstMessage* make_motion_message(GstObject* source, const MotionEvent& event) {
+  GstStructure* structure = gst_structure_new(
+      MotionEvent::kName, "motion", G_TYPE_BOOLEAN, gboolean(event.motion),
+      "changed", G_TYPE_BOOLEAN, gboolean(event.changed), "score",
+      G_TYPE_DOUBLE, event.score, "active-blocks", G_TYPE_UINT,
+      event.active_blocks, "blocks", G_TYPE_UINT, event.blocks, "pts",
+      G_TYPE_UINT64, guint64(event.pts), nullptr);
+  return gst_message_new_element(source, structure);
+}
+
+std::optional<MotionEvent> parse_motion_message(GstMessage* msg) {
+  if (GST_MESSAGE_TYPE(msg) != GST_MESSAGE_ELEMENT) return std::nullopt;
+  const GstStructure* structure = gst_message_get_structure(msg);
+  if (!structure || !gst_structure_has_name(structure, MotionEvent::kName)) {
+    return std::nullopt;
+  }
+
+  MotionEvent event;
+  gboolean motion{FALSE}, changed{FALSE};
+  guint64 pts{GST_CLOCK_TIME_NONE};
+  gst_structure_get_boolean(structure, "motion", &motion);
+  gst_structure_get_boolean(structure, "changed", &changed);
+  gst_structure_get_double(structure, "score", &event.score);
+  gst_structure_get_uint(structure, "active-blocks", &event.active_blocks);
+  gst_structure_get_uint(structure, "blocks", &event.blocks);
+  gst_structure_get_uint64(structure, "pts", &pts);
+  event.motion = motion;
+  event.changed = changed;
+  event.pts = pts;
+  if (gchar* name = gst_object_get_name(GST_MESSAGE_SRC(msg))) {
+    event.element = name;
+    g_free(name);
+  }
+  return event;
+}
+
+}  // namespace vptyp
@@ -0,0 +1,91 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "colorKernels.hh"
+
+namespace vptyp {
+
+// Frame differencing on a luma plane. The previous plane is kept, the new
+// one is compared in blocks: a block is active when its mean absolute
+// difference exceeds the threshold, a frame has motion when enough of its
+// blocks are active.
+class MotionAnalyzer {
+ public:
+  struct Options {
+    int block{16};  // square block side, power of two, 16..128
+    double threshold{12};  // mean abs luma difference of an active block
+    double min_area{0.01};  // share of active blocks for motion
+  };
+
+  struct Analysis {
+    bool motion{false};
+    double score{0};  // mean abs luma difference over the frame
+    unsigned active_blocks{0};
+    int cols{0};
+    int rows{0};
+    std::vector<uint8_t> map{};  // cols x rows, row major, 1 - active
+  };
+
+  MotionAnalyzer();
+  explicit MotionAnalyzer(const Options& options,
+                          color::Isa isa = color::detect_isa());
+
+  // compares against the previous call, the first frame has no motion
+  Analysis analyze(const uint8_t* luma, int stride, int width, int height);
+  void reset();
+
+  // sums of absolute differences per block, accumulated into sums (a row of
+  // blocks per block rows); block a power of two of at least 16
+  static void block_sad(const uint8_t* a, int a_stride, const uint8_t* b,
+                        int b_stride, int width, int height, int block,
+                        uint32_t* sums, color::Isa isa);
+
+ protected:
+  Options options;
+  color::Isa isa;
+  int width{0};
+  int height{0};
+  std::vector<uint8_t> previous{};  // tight stride
+  std::vector<uint32_t> sums{};
+};
+
+// GstMeta with the analysis of one buffer
+struct GstppMotionMeta {
+  GstMeta meta;
+  gboolean motion;
+  gdouble score;
+  guint active_blocks;
+  guint cols;
+  guint rows;
+  guint8* map;  // owned, cols x rows
+};
+
+GType gstpp_motion_meta_api_get_type();
+const GstMetaInfo* gstpp_motion_meta_get_info();
+GstppMotionMeta* gstpp_buffer_add_motion_meta(
+    GstBuffer* buffer, const MotionAnalyzer::Analysis& analysis);
+GstppMotionMeta* gstpp_buffer_get_motion_meta(GstBuffer* buffer);
+
+// "gstpp-motion" element message
+struct MotionEvent {
+  static constexpr const char* kName = "gstpp-motion";
+
+  std::string element{};
+  bool motion{false};
+  bool changed{false};  // motion started or stopped with this frame
+  double score{0};
+  unsigned active_blocks{0};
+  unsigned blocks{0};
+  GstClockTime pts{GST_CLOCK_TIME_NONE};
+};
+
+GstMessage* make_motion_message(GstObject* source, const MotionEvent& event);
+// nullopt for any other message
+std::optional<MotionEvent> parse_motion_message(GstMessage* msg);
+
+}  // namespace vptyp
@@ -0,0 +1,66 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+namespace vptyp {
+
+// Unbounded lock-free queue for any number of producers and a single
+// consumer (Vyukov's intrusive MPSC list with a stub node). push() is wait
+// free, pop() may briefly see the queue empty while a push is half done,
+// which is why waiters go by the notification counter rather than empty().
+template <typename T>
+class MpscQueue {
+ public:
+  MpscQueue() : head(new Node), tail(head.load(std::memory_order_relaxed)) {}
+  ~MpscQueue() {
+    while (pop()) {
+    }
+    delete tail;
+  }
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+
+  // any thread
+  void push(T value) {
+    auto node = new Node{.value = std::move(value)};
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+    pushed.fetch_add(1, std::memory_order_release);
+    pushed.notify_one();
+  }
+
+  // consumer thread only
+  std::optional<T> pop() {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next) return std::nullopt;
+    std::optional<T> value(std::move(next->value));
+    delete tail;
+    tail = next;
+    return value;
+  }
+
+  // blocks until a push happened after `seen` was read from pushes()
+  void wait(uint64_t seen) const {
+    pushed.wait(seen, std::memory_order_acquire);
+  }
+  uint64_t pushes() const { return pushed.load(std::memory_order_acquire); }
+  // wakes a waiting consumer without pushing, e.g. to stop it
+  void wake() {
+    pushed.fetch_add(1, std::memory_order_release);
+    pushed.notify_all();
+  }
+
+ private:
+  struct Node {
+    std::atomic<Node*> next{nullptr};
+    T value{};
+  };
+
+  std::atomic<Node*> head;  // last pushed, producers
+  Node* tail;               // consumed stub, consumer
+  std::atomic<uint64_t> pushed{0};
+};
+
+}  // namespace vptyp
@@ -2,19 +2,108 @@
 
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <bit>
 #include <format>
 #include <functional>
+#include <string_view>
+#include <utility>
 
+#include "elementCatalog.hh"
 #include "glib.h"
 #include "gst/gstmessage.h"
 namespace vptyp {
 
+namespace {
+
+std::string_view klass_of(GstElement* element) {
+  const gchar* klass = gst_element_class_get_metadata(
+      GST_ELEMENT_GET_CLASS(element), GST_ELEMENT_METADATA_KLASS);
+  return klass ? klass : "";
+}
+
+std::string_view factory_of(GstElement* element) {
+  GstElementFactory* factory = gst_element_get_factory(element);
+  return factory ? gst_plugin_feature_get_name(GST_PLUGIN_FEATURE(factory))
+                 : "";
+}
+
+bool is_expensive(GstElement* element) {
+  auto klass = klass_of(element);
+  // parsers are "Codec/Parser/Converter", cheap enough to share a thread
+  if (klass.find("Parser") != std::string_view::npos) return false;
+  return klass.find("Decoder") != std::string_view::npos ||
+         klass.find("Encoder") != std::string_view::npos ||
+         klass.find("Converter") != std::string_view::npos;
+}
+
+bool is_network_source(GstElement* element) {
+  return klass_of(element).find("Source/Network") != std::string_view::npos;
+}
+
+bool is_queue(GstElement* element) {
+  auto factory = factory_of(element);
+  return factory == "queue" || factory == "queue2" || factory == "multiqueue";
+}
+
+struct Boundary {
+  GstPad* src{nullptr};   // owned ref
+  GstPad* sink{nullptr};  // owned ref
+  std::string owner{};
+  bool network{false};
+};
+
+gboolean collect_boundary(GstElement* element, GstPad* pad, gpointer data) {
+  auto boundaries = static_cast<std::vector<Boundary>*>(data);
+  GstPad* peer = gst_pad_get_peer(pad);
+  if (!peer) return TRUE;  // dynamic pads get linked later, nothing to split
+
+  GstElement* peerElement = gst_pad_get_parent_element(peer);
+  if (peerElement && is_queue(peerElement)) {
+    gst_object_unref(peerElement);
+    gst_object_unref(peer);
+    return TRUE;
+  }
+  if (peerElement) gst_object_unref(peerElement);
+
+  boundaries->push_back({GST_PAD(gst_object_ref(pad)), peer,
+                         GST_ELEMENT_NAME(element),
+                         is_network_source(element)});
+  return TRUE;
+}
+
+}  // namespace
+
 gboolean Pipeline::bus_handler(GstBus* bus, GstMessage* msg) {
-switch (GST_MESSAGE_TYPE(msg)) {
+  messages.fetch_add(1, std::memory_order_relaxed);
+  // status is updated before observers run, so they can rely on it
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS) eos = true;
+  if (GST_MESSAGE_TYPE(msg) == GST_MESSAGE_ERROR) error = true;
+  if (metrics) count_message(msg);
+  std::vector<std::shared_ptr<const BusObserver>> handlers;
+  {
+    std::lock_guard lock(observers_guard);
+    handlers = observers;
+    auto& typed = typed_handlers[message_slot(GST_MESSAGE_TYPE(msg))];
+    for (auto& [subscription, handler] : typed) handlers.push_back(handler);
+  }
+  // outside the lock, a handler may unsubscribe itself
+  for (auto& handler : handlers) (*handler)(msg);
+
+  switch (GST_MESSAGE_TYPE(msg)) {
     case GST_MESSAGE_EOS: {
       g_print("End of stream\n");
-      g_main_loop_quit(&loop);
-      return false;
+      if (profiler) profiler->dump();
+      finish();
+      // the watch stays, restart() plays the same pipeline again
+      break;
+    }
+    case GST_MESSAGE_STATE_CHANGED: {
+      if (GST_MESSAGE_SRC(msg) != GST_OBJECT(pipeline.get())) break;
+      GstState newState;
+      gst_message_parse_state_changed(msg, nullptr, &newState, nullptr);
+      state = newState;
+      break;
     }
     case GST_MESSAGE_ERROR: {
       gchar* debug;
@@ -26,45 +115,595 @@ switch (GST_MESSAGE_TYPE(msg)) {
       LOG(ERROR) << std::format("Error: {}", error->message);
       g_error_free(error);
 
-      g_main_loop_quit(&loop);
-      return false;
+      finish();
+      break;
+    }
+    case GST_MESSAGE_ELEMENT: {
+      auto event = parse_motion_message(msg);
+      if (!event) break;
+      std::unique_lock lock(observers_guard);
+      auto handlers = motion_handlers;
+      lock.unlock();
+      for (auto& handler : handlers) (*handler)(*event);
+      break;
     }
     case GST_MESSAGE_INFO: {
+      auto suppressed = log_budget.take();
+      if (!suppressed) break;
       GError* err;
       gchar* debug;
       gst_message_parse_info(msg, &err, &debug);
-      LOG(INFO) << std::format("err: {}, debug: {}", err->message, debug);
+      LOG(INFO) << std::format("err: {}, debug: {} ({} suppressed)",
+                               err->message, debug ? debug : "",
+                               *suppressed);
+      g_error_free(err);
+      g_free(debug);
+      break;
     }
-    default:
-      LOG(INFO) << std::format("Received message of type {}", static_cast<int>(GST_MESSAGE_TYPE(msg)));
+    default: {
+      auto suppressed = log_budget.take();
+      if (!suppressed) break;
+      LOG(INFO) << std::format("Received {} from {} ({} suppressed)",
+                               GST_MESSAGE_TYPE_NAME(msg),
+                               GST_MESSAGE_SRC_NAME(msg)
+                                   ? GST_MESSAGE_SRC_NAME(msg)
+                                   : "",
+                               *suppressed);
       break;
+    }
   }
   return true;
 }
 
+std::optional<uint64_t> Pipeline::LogBudget::take() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - window >= interval) {
+    window = now;
+    spent = 0;
+  }
+  if (spent >= burst) {
+    ++suppressed;
+    return std::nullopt;
+  }
+  ++spent;
+  return std::exchange(suppressed, 0);
+}
+
+size_t Pipeline::message_slot(GstMessageType type) {
+  if (type & GST_MESSAGE_EXTENDED) return kMessageSlots - 1;
+  return std::min<size_t>(std::countr_zero(guint(type)), kMessageSlots - 1);
+}
+
 gboolean Pipeline::bus_call(GstBus* bus, GstMessage* msg, gpointer data) {
   auto that = static_cast<Pipeline*>(data);
   return that->bus_handler(bus, msg);
 }
 
+GstBusSyncReply Pipeline::bus_sync_call(GstBus* bus, GstMessage* msg,
+                                        gpointer data) {
+  // runs on the posting thread, the worker handles it later
+  static_cast<Pipeline*>(data)->bus_queue->push(gst_message_ref(msg));
+  return GST_BUS_DROP;
+}
+
+void Pipeline::run_bus_worker() {
+  auto gstBus = make_gst(gst_pipeline_get_bus(GST_PIPELINE(pipeline.get())));
+  // a handler returning false ends handling, as it removes the bus watch
+  bool handling{true};
+  while (true) {
+    uint64_t seen = bus_queue->pushes();
+    while (auto msg = bus_queue->pop()) {
+      if (handling) handling = bus_handler(gstBus.get(), *msg);
+      gst_message_unref(*msg);
+    }
+    if (bus_stopping.load(std::memory_order_acquire)) return;
+    bus_queue->wait(seen);
+  }
+}
+
+void Pipeline::stop_bus_worker() {
+  if (!bus_worker.joinable()) return;
+  auto gstBus = make_gst(gst_pipeline_get_bus(GST_PIPELINE(pipeline.get())));
+  gst_bus_set_sync_handler(gstBus.get(), nullptr, nullptr, nullptr);
+  bus_stopping = true;
+  bus_queue->wake();
+  bus_worker.join();
+  // a post racing the handler reset may still have been queued
+  while (auto msg = bus_queue->pop()) gst_message_unref(*msg);
+}
+
+void Pipeline::attach_bus_watch() {
+  auto gstBus = make_gst(gst_pipeline_get_bus(GST_PIPELINE(pipeline.get())));
+  // attach to the loop's own context rather than the thread default one, so
+  // pipelines can be served from loops running in other threads
+  bus_watch = gst_bus_create_watch(gstBus.get());
+  g_source_set_callback(bus_watch, reinterpret_cast<GSourceFunc>(bus_call),
+                        this, nullptr);
+  g_source_attach(bus_watch, g_main_loop_get_context(&loop));
+}
+
+void Pipeline::dispatch_bus(BusDispatch dispatch) {
+  bool worker = dispatch == BusDispatch::Worker;
+  if (worker == bus_worker.joinable()) return;
+  GstState current{GST_STATE_NULL};
+  gst_element_get_state(pipeline.get(), &current, nullptr, 0);
+  if (current > GST_STATE_READY) {
+    // streaming threads post concurrently, the order would not hold
+    LOG(ERROR) << "bus dispatch can only be switched before play()";
+    return;
+  }
+  if (!worker) {
+    stop_bus_worker();
+    attach_bus_watch();
+    return;
+  }
+
+  drop_source(bus_watch);
+  if (!bus_queue) bus_queue = std::make_unique<MpscQueue<GstMessage*>>();
+  auto gstBus = make_gst(gst_pipeline_get_bus(GST_PIPELINE(pipeline.get())));
+  // posted before the switch and not handled by the watch yet; they go
+  // first, so the sync handler only queues what comes after them
+  while (GstMessage* msg = gst_bus_pop(gstBus.get())) bus_queue->push(msg);
+  gst_bus_set_sync_handler(gstBus.get(), bus_sync_call, this, nullptr);
+  bus_stopping = false;
+  bus_worker = std::thread(&Pipeline::run_bus_worker, this);
+}
+
+void Pipeline::invoke(std::function<void()> work) {
+  auto call = +[](gpointer data) {
+    (*static_cast<std::function<void()>*>(data))();
+    return gboolean(G_SOURCE_REMOVE);
+  };
+  auto destroy = +[](gpointer data) {
+    delete static_cast<std::function<void()>*>(data);
+  };
+  g_main_context_invoke_full(g_main_loop_get_context(&loop),
+                             G_PRIORITY_DEFAULT, call,
+                             new std::function<void()>(std::move(work)),
+                             destroy);
+}
+
 void Pipeline::play() {
   gst_element_set_state(pipeline.get(), GST_STATE_PLAYING);
 }
 
 void Pipeline::stop() { gst_element_set_state(pipeline.get(), GST_STATE_NULL); }
 
+bool Pipeline::drain(std::chrono::milliseconds timeout) {
+  GstState current{GST_STATE_NULL};
+  gst_element_get_state(pipeline.get(), &current, nullptr, 0);
+  if (current < GST_STATE_PAUSED || eos) return false;
+  // sources push it downstream from their streaming threads
+  if (!gst_element_send_event(pipeline.get(), gst_event_new_eos())) {
+    LOG(ERROR) << std::format("{}: cannot send EOS",
+                              GST_ELEMENT_NAME(pipeline.get()));
+    return false;
+  }
+  LOG(INFO) << std::format("{}: draining, up to {}ms",
+                           GST_ELEMENT_NAME(pipeline.get()), timeout.count());
+  drop_source(drain_timeout);
+  drain_timeout = attach_timeout(timeout, drain_timeout_call);
+  return true;
+}
+
+gboolean Pipeline::drain_timeout_call(gpointer data) {
+  auto that = static_cast<Pipeline*>(data);
+  if (!that->eos) {
+    LOG(WARNING) << std::format("{}: no EOS in time, finishing undrained",
+                                GST_ELEMENT_NAME(that->pipeline.get()));
+    that->finish();
+  }
+  return G_SOURCE_REMOVE;
+}
+
+bool Pipeline::restart() {
+  drop_source(drain_timeout);
+  // PAUSED to READY flushes EOS out of the sinks and resets the sources,
+  // what elements set up going from NULL to READY stays in place
+  if (gst_element_set_state(pipeline.get(), GST_STATE_READY) ==
+      GST_STATE_CHANGE_FAILURE) {
+    LOG(ERROR) << std::format("{}: cannot go to READY",
+                              GST_ELEMENT_NAME(pipeline.get()));
+    return false;
+  }
+  eos = false;
+  error = false;
+  return gst_element_set_state(pipeline.get(), GST_STATE_PLAYING) !=
+         GST_STATE_CHANGE_FAILURE;
+}
+
+bool Pipeline::preroll(std::chrono::milliseconds timeout) {
+  if (gst_element_set_state(pipeline.get(), GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE) {
+    return false;
+  }
+  GstState current;
+  auto result = gst_element_get_state(
+      pipeline.get(), &current, nullptr,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count());
+  return result == GST_STATE_CHANGE_SUCCESS ||
+         result == GST_STATE_CHANGE_NO_PREROLL;
+}
+
+std::optional<GstClockTime> Pipeline::duration() const {
+  gint64 value{0};
+  if (!gst_element_query_duration(pipeline.get(), GST_FORMAT_TIME, &value) ||
+      value < 0) {
+    return std::nullopt;
+  }
+  return GstClockTime(value);
+}
+
+bool Pipeline::seek(GstClockTime start, GstClockTime stop,
+                    GstSeekFlags flags) {
+  bool open = !GST_CLOCK_TIME_IS_VALID(stop);
+  bool sent = gst_element_seek(
+      pipeline.get(), 1.0, GST_FORMAT_TIME,
+      GstSeekFlags(flags | GST_SEEK_FLAG_FLUSH), GST_SEEK_TYPE_SET, start,
+      open ? GST_SEEK_TYPE_NONE : GST_SEEK_TYPE_SET, open ? -1 : stop);
+  if (!sent) {
+    LOG(ERROR) << std::format("{}: seek to {}ms failed",
+                              GST_ELEMENT_NAME(pipeline.get()),
+                              start / GST_MSECOND);
+  }
+  return sent;
+}
+
+void Pipeline::finish() {
+  if (quit_on_finish) g_main_loop_quit(&loop);
+}
+
+GstElement* Pipeline::raw() const { return pipeline.get(); }
+
+Pipeline::Status Pipeline::status() const {
+  return {state.load(), eos.load(), error.load(),
+          messages.load(std::memory_order_relaxed)};
+}
+
+void Pipeline::set_quit_on_finish(bool quit) { quit_on_finish = quit; }
+
+void Pipeline::add_bus_observer(BusObserver observer) {
+  std::lock_guard lock(observers_guard);
+  observers.push_back(
+      std::make_shared<const BusObserver>(std::move(observer)));
+}
+
+Pipeline::Subscription Pipeline::subscribe(GstMessageType types,
+                                           BusObserver handler) {
+  auto shared = std::make_shared<const BusObserver>(std::move(handler));
+  std::lock_guard lock(observers_guard);
+  Subscription subscription = ++last_subscription;
+  for (size_t slot = 0; slot < kMessageSlots; ++slot) {
+    if (guint(types) & (1u << slot)) {
+      typed_handlers[slot].push_back({subscription, shared});
+    }
+  }
+  return subscription;
+}
+
+void Pipeline::unsubscribe(Subscription subscription) {
+  std::lock_guard lock(observers_guard);
+  for (auto& slot : typed_handlers) {
+    std::erase_if(slot, [subscription](const TypedHandler& typed) {
+      return typed.subscription == subscription;
+    });
+  }
+}
+
+void Pipeline::on_motion(MotionHandler handler) {
+  std::lock_guard lock(observers_guard);
+  motion_handlers.push_back(
+      std::make_shared<const MotionHandler>(std::move(handler)));
+}
+
 Pipeline::Pipeline(GMainLoop& loop, std::string_view name) : loop(loop) {
   using namespace std::placeholders;
   pipeline = make_gst(gst_pipeline_new(name.data()));
+  attach_bus_watch();
+}
 
-  auto gstBus = make_gst(gst_pipeline_get_bus(GST_PIPELINE(pipeline.get())));
-  
-  bus_watch_id = gst_bus_add_watch(gstBus.get(), bus_call, this);
+size_t Pipeline::insert_queues(const QueuePolicy& policy) {
+  std::vector<Boundary> boundaries;
+  GstIterator* it = gst_bin_iterate_elements(GST_BIN(pipeline.get()));
+  auto collect = +[](const GValue* item, gpointer data) {
+    auto element = GST_ELEMENT(g_value_get_object(item));
+    if (is_expensive(element) || is_network_source(element)) {
+      gst_element_foreach_src_pad(element, collect_boundary, data);
+    }
+  };
+  while (gst_iterator_foreach(it, collect, &boundaries) ==
+         GST_ITERATOR_RESYNC) {
+    for (auto& b : boundaries) {
+      gst_object_unref(b.src);
+      gst_object_unref(b.sink);
+    }
+    boundaries.clear();
+    gst_iterator_resync(it);
+  }
+  gst_iterator_free(it);
+  if (boundaries.empty()) return 0;
+
+  using std::chrono::nanoseconds;
+  guint64 target = nanoseconds(policy.target_latency).count();
+  guint64 perQueue = policy.mode == QueuePolicy::Mode::Latency
+                         ? target / boundaries.size()
+                         : target * 4;
+
+  for (auto& boundary : boundaries) {
+    const char* factory = boundary.network ? "queue2" : "queue";
+    Element queue(factory, std::format("{}-{}", boundary.owner, factory));
+    queue.object_set("max-size-time", perQueue, "max-size-buffers", guint(0),
+                     "max-size-bytes", policy.max_bytes);
+    Element& owned = add_element(std::move(queue));
+
+    auto queueSink = make_gst(gst_element_get_static_pad(owned.raw(), "sink"));
+    auto queueSrc = make_gst(gst_element_get_static_pad(owned.raw(), "src"));
+    gst_pad_unlink(boundary.src, boundary.sink);
+    if (GST_PAD_LINK_FAILED(gst_pad_link(boundary.src, queueSink.get())) ||
+        GST_PAD_LINK_FAILED(gst_pad_link(queueSrc.get(), boundary.sink))) {
+      LOG(ERROR) << std::format("failed to insert {}", owned.get_alias());
+    }
+    gst_element_sync_state_with_parent(owned.raw());
+    queues.push_back(&owned);
+
+    gst_object_unref(boundary.src);
+    gst_object_unref(boundary.sink);
+  }
+
+  LOG(INFO) << std::format("inserted {} queues of {}ms each",
+                           boundaries.size(), perQueue / GST_MSECOND);
+  return boundaries.size();
+}
+
+bool Pipeline::set_bitrate(std::string_view encoder, guint bps) {
+  Element* element = find(encoder);
+  if (!element) {
+    LOG(ERROR) << std::format("no encoder {} in {}", encoder,
+                              GST_ELEMENT_NAME(pipeline.get()));
+    return false;
+  }
+  if (!element->set_bitrate(bps)) return false;
+  LOG(INFO) << std::format("{}: bitrate {} bit/s", encoder, bps);
+  return true;
+}
+
+bool Pipeline::set_caps(std::string_view capsfilter,
+                        std::string_view caps) {
+  Element* filter = find(capsfilter);
+  if (!filter || factory_of(filter->raw()) != "capsfilter") {
+    LOG(ERROR) << std::format("no capsfilter {} in {}", capsfilter,
+                              GST_ELEMENT_NAME(pipeline.get()));
+    return false;
+  }
+  GstCaps* wanted = gst_caps_from_string(std::string(caps).c_str());
+  if (!wanted) {
+    LOG(ERROR) << std::format("cannot parse caps {}", caps);
+    return false;
+  }
+
+  GstPad* sink = gst_element_get_static_pad(filter->raw(), "sink");
+  // a not-negotiated error would end the stream, asking first keeps it
+  GstCaps* possible = gst_pad_peer_query_caps(sink, wanted);
+  bool producible = possible && !gst_caps_is_empty(possible);
+  if (possible) gst_caps_unref(possible);
+  if (!producible) {
+    LOG(ERROR) << std::format("upstream of {} cannot produce {}",
+                              capsfilter, caps);
+    gst_caps_unref(wanted);
+    gst_object_unref(sink);
+    return false;
+  }
+  // runs right away on an idle pad, else once the buffer in flight left;
+  // the probe owns the caps
+  gst_pad_add_probe(sink, GST_PAD_PROBE_TYPE_IDLE, swap_caps_call, wanted,
+                    reinterpret_cast<GDestroyNotify>(gst_caps_unref));
+  gst_object_unref(sink);
+  LOG(INFO) << std::format("{}: caps {}", capsfilter, caps);
+  return true;
+}
+
+GstPadProbeReturn Pipeline::swap_caps_call(GstPad* pad, GstPadProbeInfo*,
+                                           gpointer data) {
+  // capsfilter sends a reconfigure upstream, videoscale and the like
+  // renegotiate before pushing on
+  if (GstElement* filter = gst_pad_get_parent_element(pad)) {
+    g_object_set(filter, "caps", static_cast<GstCaps*>(data), nullptr);
+    gst_object_unref(filter);
+  }
+  return GST_PAD_PROBE_REMOVE;
+}
+
+namespace {
+
+// typed reads, the levels are polled on every controller tick
+template <FixedString Factory>
+void read_level(GstElement* queue, Pipeline::QueueLevel& level,
+                guint64& maxTime, guint& maxBuffers, guint64& maxBytes) {
+  using Queue = Props<Factory>;
+  level.buffers = Queue::template get<"current-level-buffers">(queue);
+  level.time = Queue::template get<"current-level-time">(queue);
+  // queue2 reports byte levels as guint64, queue as guint
+  level.bytes = Queue::template get<"current-level-bytes">(queue);
+  maxTime = Queue::template get<"max-size-time">(queue);
+  maxBuffers = Queue::template get<"max-size-buffers">(queue);
+  maxBytes = Queue::template get<"max-size-bytes">(queue);
+}
+
+}  // namespace
+
+Pipeline::QueueLevel Pipeline::queue_level(Element& queue) {
+  QueueLevel level{.alias = queue.get_alias()};
+  guint64 maxTime{0};
+  guint maxBuffers{0};
+  guint64 maxBytes{0};
+  if (queue.get_name() == "queue2") {
+    read_level<"queue2">(queue.raw(), level, maxTime, maxBuffers, maxBytes);
+  } else {
+    read_level<"queue">(queue.raw(), level, maxTime, maxBuffers, maxBytes);
+  }
+  if (maxTime) level.fill = double(level.time) / maxTime;
+  if (maxBytes) {
+    level.fill = std::max(level.fill, double(level.bytes) / maxBytes);
+  }
+  if (maxBuffers) {
+    level.fill = std::max(level.fill, double(level.buffers) / maxBuffers);
+  }
+  return level;
+}
+
+std::vector<Pipeline::QueueLevel> Pipeline::queue_levels() {
+  std::vector<QueueLevel> levels;
+  for (auto queue : queues) levels.push_back(queue_level(*queue));
+  return levels;
+}
+
+gboolean Pipeline::queue_report_call(gpointer data) {
+  auto that = static_cast<Pipeline*>(data);
+  for (auto& level : that->queue_levels()) {
+    LOG(INFO) << std::format("{}: {} buffers, {} bytes, {}ms, {:.0f}% full",
+                             level.alias, level.buffers, level.bytes,
+                             level.time / GST_MSECOND, level.fill * 100);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+void Pipeline::report_queue_levels(std::chrono::milliseconds interval) {
+  drop_source(queue_report);
+  queue_report = attach_timeout(interval, queue_report_call);
+}
+
+gboolean Pipeline::profile_report_call(gpointer data) {
+  auto that = static_cast<Pipeline*>(data);
+  if (that->profiler) that->profiler->dump();
+  return G_SOURCE_CONTINUE;
+}
+
+void Pipeline::enable_profiling(const Profiler::Options& options) {
+  drop_source(profile_report);
+  profiler = std::make_unique<Profiler>(pipeline.get(), options);
+  profiler->attach();
+  if (options.interval.count() > 0) {
+    profile_report = attach_timeout(options.interval, profile_report_call);
+  }
 }
 
-void Pipeline::add_element(Element&& element) {
+Profiler* Pipeline::get_profiler() { return profiler.get(); }
+
+void Pipeline::enable_metrics() {
+  auto& registry = MetricsRegistry::instance();
+  MetricsRegistry::Labels labels{{"pipeline", GST_ELEMENT_NAME(pipeline.get())}};
+  auto fresh = std::make_unique<Metrics>();
+  fresh->state_changes = &registry.counter(
+      "gstpp_pipeline_state_changes_total", "pipeline state changes", labels);
+  fresh->bus_errors = &registry.counter("gstpp_pipeline_bus_errors_total",
+                                        "error messages on the bus", labels);
+  fresh->qos_events = &registry.counter("gstpp_pipeline_qos_events_total",
+                                        "QoS messages on the bus", labels);
+  fresh->frames = &registry.counter("gstpp_pipeline_frames_total",
+                                    "buffers reaching sink elements", labels);
+  fresh->state = &registry.gauge("gstpp_pipeline_state",
+                                 "current GstState of the pipeline", labels);
+  bool probed = metrics != nullptr;
+  metrics = std::move(fresh);
+  if (probed) return;  // probes hold the counter, which outlives us
+
+  GstIterator* it = gst_bin_iterate_sinks(GST_BIN(pipeline.get()));
+  auto probe = +[](const GValue* item, gpointer data) {
+    auto element = GST_ELEMENT(g_value_get_object(item));
+    gst_element_foreach_sink_pad(
+        element,
+        [](GstElement*, GstPad* pad, gpointer frames) {
+          gst_pad_add_probe(
+              pad,
+              GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER |
+                              GST_PAD_PROBE_TYPE_BUFFER_LIST),
+              frame_probe, frames, nullptr);
+          return gboolean(TRUE);
+        },
+        data);
+  };
+  // resync may probe a sink twice, only happens when sinks change meanwhile
+  while (gst_iterator_foreach(it, probe, metrics->frames) ==
+         GST_ITERATOR_RESYNC) {
+    gst_iterator_resync(it);
+  }
+  gst_iterator_free(it);
+}
+
+void Pipeline::count_message(GstMessage* msg) {
+  switch (GST_MESSAGE_TYPE(msg)) {
+    case GST_MESSAGE_STATE_CHANGED: {
+      if (GST_MESSAGE_SRC(msg) != GST_OBJECT(pipeline.get())) break;
+      GstState newState;
+      gst_message_parse_state_changed(msg, nullptr, &newState, nullptr);
+      metrics->state_changes->inc();
+      metrics->state->set(newState);
+      break;
+    }
+    case GST_MESSAGE_ERROR:
+      metrics->bus_errors->inc();
+      break;
+    case GST_MESSAGE_QOS: {
+      metrics->qos_events->inc();
+      GstFormat format;
+      guint64 processed{0}, dropped{0};
+      gst_message_parse_qos_stats(msg, &format, &processed, &dropped);
+      if (format != GST_FORMAT_BUFFERS && format != GST_FORMAT_DEFAULT) break;
+      // QoS carries running totals per element, rare enough for a lookup
+      MetricsRegistry::instance()
+          .gauge("gstpp_element_dropped_buffers",
+                 "buffers dropped by an element, from its QoS messages",
+                 {{"pipeline", GST_ELEMENT_NAME(pipeline.get())},
+                  {"element", GST_MESSAGE_SRC_NAME(msg)}})
+          .set(double(dropped));
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+GstPadProbeReturn Pipeline::frame_probe(GstPad* pad, GstPadProbeInfo* info,
+                                        gpointer data) {
+  auto frames = static_cast<Counter*>(data);
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    frames->inc(gst_buffer_list_length(GST_PAD_PROBE_INFO_BUFFER_LIST(info)));
+  } else {
+    frames->inc();
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+GSource* Pipeline::attach_timeout(std::chrono::milliseconds interval,
+                                  GSourceFunc callback) {
+  GSource* source = g_timeout_source_new(interval.count());
+  g_source_set_callback(source, callback, this, nullptr);
+  g_source_attach(source, g_main_loop_get_context(&loop));
+  return source;
+}
+
+void Pipeline::drop_source(GSource*& source) {
+  if (!source) return;
+  g_source_destroy(source);
+  g_source_unref(source);
+  source = nullptr;
+}
+
+Pipeline::~Pipeline() {
+  drop_source(drain_timeout);
+  drop_source(queue_report);
+  drop_source(profile_report);
+  if (pipeline) gst_element_set_state(pipeline.get(), GST_STATE_NULL);
+  // after NULL no streaming thread posts anymore
+  stop_bus_worker();
+  drop_source(bus_watch);
+}
+
+Element& Pipeline::add_element(Element&& element) {
   gst_bin_add(reinterpret_cast<GstBin*>(pipeline.get()), element.element.get());
   element.owned = 1;
+  elements.push_back(std::move(element));
+  return elements.back();
 }
 
 void Pipeline::add_element(Element& element) {
@@ -72,4 +711,25 @@ void Pipeline::add_element(Element& element) {
   element.owned = 1;
 }
 
+Element* Pipeline::find(std::string_view alias) {
+  for (auto& element : elements) {
+    if (element.alias == alias) return &element;
+  }
+  return nullptr;
+}
+
+bool Pipeline::remove_element(std::string_view alias) {
+  auto it = std::find_if(elements.begin(), elements.end(),
+                         [alias](Element& e) { return e.alias == alias; });
+  if (it == elements.end()) return false;
+  std::erase(queues, &*it);
+  GstElement* raw = it->raw();
+  // streaming stops first, then the Element disconnects its pad router while
+  // the bin still holds the only reference; removal finalizes the object
+  gst_element_set_state(raw, GST_STATE_NULL);
+  elements.erase(it);
+  gst_bin_remove(GST_BIN(pipeline.get()), raw);
+  return true;
+}
+
 }  // namespace vptyp
\ No newline at end of file
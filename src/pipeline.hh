@@ -1,29 +1,221 @@
 #pragma once
 #include <gst/gst.h>
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "element.hh"
 #include "glib.h"
+#include "metrics.hh"
+#include "motionDetect.hh"
+#include "mpscQueue.hh"
+#include "profiler.hh"
 namespace vptyp {
 
 class Pipeline {
  public:
+  struct Status {
+    GstState state{GST_STATE_NULL};
+    bool eos{false};
+    bool error{false};
+    uint64_t messages{0};
+  };
+  using BusObserver = std::function<void(GstMessage*)>;
+  using MotionHandler = std::function<void(const MotionEvent&)>;
+  using Subscription = uint64_t;
+
+  // where bus messages are handled. Worker takes them from the posting
+  // streaming threads through a sync handler and a lock-free queue to a
+  // thread of the pipeline, so a busy bus neither wakes nor blocks the loop
+  // other pipelines share
+  enum class BusDispatch { Loop, Worker };
+
+  // how inserted queues are sized; latency mode splits the target between
+  // all queues, throughput mode lets each of them absorb several targets
+  struct QueuePolicy {
+    enum class Mode { Latency, Throughput };
+    Mode mode{Mode::Throughput};
+    std::chrono::milliseconds target_latency{200};
+    guint max_bytes{64 * 1024 * 1024};  // per queue, 0 - unlimited
+  };
+
+  struct QueueLevel {
+    std::string alias{};
+    guint buffers{0};
+    guint64 bytes{0};
+    guint64 time{0};  // ns
+    double fill{0};   // 0..1 of the tightest configured limit
+  };
+
+  // bus is watched from the context of the given loop
   Pipeline(GMainLoop& loop, std::string_view name);
-  void add_element(Element&& element);
+  virtual ~Pipeline();
+  // takes the element over, returned reference stays valid with the pipeline
+  Element& add_element(Element&& element);
   void add_element(Element& element);
+  // owned element by alias, nullptr if there is none
+  Element* find(std::string_view alias);
+  // stops an owned element and takes it out of the pipeline, it has to be
+  // unlinked from the rest already
+  bool remove_element(std::string_view alias);
 
   void play();
   void stop();
+  // sends EOS so muxers finish their files; the loop quits once it came
+  // out of the sinks, like on any EOS, or after the timeout if it did not.
+  // False when there is nothing playing to drain
+  bool drain(std::chrono::milliseconds timeout);
+  // plays from the start again through READY, keeping the elements, their
+  // links and plugins instead of building anew
+  bool restart();
+  // goes to PAUSED and blocks until every sink prerolled
+  bool preroll(std::chrono::milliseconds timeout);
+  std::optional<GstClockTime> duration() const;
+  // flushing time seek, stop GST_CLOCK_TIME_NONE plays to the end
+  bool seek(GstClockTime start, GstClockTime stop, GstSeekFlags flags);
+
+  // live reconfiguration without a restart. Bitrate of an owned encoder in
+  // bit/s, see Element::set_bitrate()
+  bool set_bitrate(std::string_view encoder, guint bps);
+  // new caps for an owned capsfilter, e.g. another size behind videoscale.
+  // Refused when upstream cannot produce them; otherwise swapped in while
+  // no buffer is inside the capsfilter, the stream renegotiates with the
+  // next one
+  bool set_caps(std::string_view capsfilter, std::string_view caps);
+
+  GstElement* raw() const;
+  Status status() const;
+
+  // whether EOS or error quits the loop, true by default
+  void set_quit_on_finish(bool quit);
+  // observers see every bus message before it is handled, on the thread
+  // chosen by dispatch_bus(). With the worker they run concurrently with the
+  // loop, so whatever they share with loop callbacks has to be atomic or
+  // locked; invoke() hands work over to the loop instead
+  void add_bus_observer(BusObserver observer);
+  // handler for messages of the types in the mask, e.g.
+  // GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR); GST_MESSAGE_EXTENDED
+  // takes every extended type. Runs after the observers. Observers and
+  // handlers are called without a lock held, so they may subscribe or
+  // unsubscribe themselves; changes apply from the next message
+  Subscription subscribe(GstMessageType types, BusObserver handler);
+  void unsubscribe(Subscription subscription);
+  // "gstpp-motion" messages of any gstppmotion element
+  void on_motion(MotionHandler handler);
+  // loop by default; only switched before play(), so no message is handled
+  // twice or out of order. Moves every observer and handler to the worker
+  // thread, see add_bus_observer()
+  void dispatch_bus(BusDispatch dispatch);
+  // runs work in the loop's context: right away when called from it,
+  // otherwise on the next iteration
+  void invoke(std::function<void()> work);
+
+  // puts a queue behind every decoder, encoder and converter (queue2 behind
+  // network sources) whose output is statically linked to a non-queue, so
+  // they run in their own streaming threads; call before play()
+  size_t insert_queues(const QueuePolicy& policy);
+  std::vector<QueueLevel> queue_levels();
+  // level of any queue or queue2 element
+  static QueueLevel queue_level(Element& queue);
+  // periodically logs queue levels from the loop
+  void report_queue_levels(std::chrono::milliseconds interval);
+
+  // opt-in per element profiling, dumped periodically and on EOS
+  void enable_profiling(const Profiler::Options& options);
+  Profiler* get_profiler();
+
+  // opt-in metrics labelled with the pipeline name: state changes, bus
+  // errors, QoS events, dropped buffers and frames reaching sink elements
+  // present at the call
+  void enable_metrics();
 
  protected:
+  struct Metrics {
+    Counter* state_changes{nullptr};
+    Counter* bus_errors{nullptr};
+    Counter* qos_events{nullptr};
+    Counter* frames{nullptr};
+    Gauge* state{nullptr};
+  };
+
+  struct TypedHandler {
+    Subscription subscription{0};
+    std::shared_ptr<const BusObserver> handler{};
+  };
+
+  // lets a burst of lines through per interval and counts the rest, so a
+  // chatty bus costs no formatting
+  struct LogBudget {
+    std::chrono::milliseconds interval{1000};
+    unsigned burst{20};
+    std::chrono::steady_clock::time_point window{};
+    unsigned spent{0};
+    uint64_t suppressed{0};
+
+    // lines suppressed since the last one let through, nullopt - suppress
+    std::optional<uint64_t> take();
+  };
+
+  // one slot per GstMessageType bit, extended types share the last one
+  static constexpr size_t kMessageSlots = 32;
+  static size_t message_slot(GstMessageType type);
+
   static gboolean bus_call(GstBus* bus, GstMessage* msg, gpointer data);
-  gboolean bus_handler(GstBus* bus, GstMessage* msg);
+  static GstBusSyncReply bus_sync_call(GstBus* bus, GstMessage* msg,
+                                       gpointer data);
+  virtual gboolean bus_handler(GstBus* bus, GstMessage* msg);
+  void attach_bus_watch();
+  void run_bus_worker();
+  void stop_bus_worker();
+  void finish();
+  static GstPadProbeReturn swap_caps_call(GstPad* pad, GstPadProbeInfo* info,
+                                          gpointer data);
+  static gboolean drain_timeout_call(gpointer data);
+  static gboolean queue_report_call(gpointer data);
+  static gboolean profile_report_call(gpointer data);
+  void count_message(GstMessage* msg);
+  static GstPadProbeReturn frame_probe(GstPad* pad, GstPadProbeInfo* info,
+                                       gpointer data);
+  GSource* attach_timeout(std::chrono::milliseconds interval,
+                          GSourceFunc callback);
+  static void drop_source(GSource*& source);
 
  protected:
   GMainLoop& loop;
-  guint bus_watch_id;
+  GSource* bus_watch{nullptr};
+  std::atomic<bool> quit_on_finish{true};  // set from any thread
+  // the lists below are copied under it and called after releasing it,
+  // shared handlers keep the copies cheap
+  std::mutex observers_guard;
+  std::vector<std::shared_ptr<const BusObserver>> observers;
+  std::vector<std::shared_ptr<const MotionHandler>> motion_handlers;
+  std::array<std::vector<TypedHandler>, kMessageSlots> typed_handlers;
+  Subscription last_subscription{0};
+  LogBudget log_budget;  // bus handling thread only
+  std::unique_ptr<MpscQueue<GstMessage*>> bus_queue{nullptr};  // owned refs
+  std::thread bus_worker;
+  std::atomic<bool> bus_stopping{false};
+  std::atomic<GstState> state{GST_STATE_NULL};
+  std::atomic<bool> eos{false};
+  std::atomic<bool> error{false};
+  std::atomic<uint64_t> messages{0};
   std::unique_ptr<GstElement, Deleter<GstElement>> pipeline{nullptr};
   std::list<Element> elements;  // owned elements
+  std::vector<Element*> queues;  // inserted by insert_queues, owned
+  GSource* drain_timeout{nullptr};
+  GSource* queue_report{nullptr};
+  std::unique_ptr<Profiler> profiler{nullptr};
+  GSource* profile_report{nullptr};
+  std::unique_ptr<Metrics> metrics{nullptr};
 };
 
 }  // namespace vptyp
\ No newline at end of file
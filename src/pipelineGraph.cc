@@ -0,0 +1,685 @@
+#include "pipelineGraph.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+
+namespace vptyp {
+
+namespace {
+
+enum class TokenKind { Link, Reference, Caps, Property, Factory };
+
+TokenKind classify(const std::string& token) {
+  if (token == "!") return TokenKind::Link;
+
+  auto eq = token.find('=');
+  auto slash = token.find('/');
+  if (token.back() == '.' && eq == std::string::npos &&
+      slash == std::string::npos) {
+    return TokenKind::Reference;
+  }
+  if (slash != std::string::npos && slash < std::min(eq, token.find(','))) {
+    return TokenKind::Caps;
+  }
+  if (eq != std::string::npos && eq > 0) {
+    bool isKey = std::all_of(token.begin(), token.begin() + eq, [](char c) {
+      return std::isalnum(static_cast<unsigned char>(c)) || c == '-' ||
+             c == '_' || c == ':';
+    });
+    if (isKey) return TokenKind::Property;
+  }
+  return TokenKind::Factory;
+}
+
+std::optional<std::vector<std::string>> tokenize(std::string_view text) {
+  std::vector<std::string> tokens;
+  std::string token;
+  bool quoted{false};
+  auto flush = [&]() {
+    if (!token.empty()) tokens.push_back(std::move(token));
+    token.clear();
+  };
+
+  for (char c : text) {
+    if (c == '"') {
+      quoted = !quoted;
+    } else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+      flush();
+    } else if (!quoted && c == '!') {
+      flush();
+      tokens.emplace_back("!");
+    } else {
+      token += c;
+    }
+  }
+  if (quoted) return std::nullopt;
+  flush();
+  return tokens;
+}
+
+GstCaps* template_caps(GstElementFactory* factory, GstPadDirection direction) {
+  GstCaps* result = gst_caps_new_empty();
+  for (const GList* l = gst_element_factory_get_static_pad_templates(factory);
+       l != nullptr; l = l->next) {
+    auto templ = static_cast<GstStaticPadTemplate*>(l->data);
+    if (templ->direction != direction) continue;
+    result = gst_caps_merge(result, gst_static_pad_template_get_caps(templ));
+  }
+  return result;
+}
+
+// capsfilter nodes are checked against their filter, others against templates
+GstCaps* node_caps(const PipelineGraph::Node& node, GstElementFactory* factory,
+                   GstPadDirection direction) {
+  if (node.factory == "capsfilter") {
+    auto it = std::find_if(node.properties.begin(), node.properties.end(),
+                           [](const auto& p) { return p.first == "caps"; });
+    if (it != node.properties.end()) {
+      if (GstCaps* caps = gst_caps_from_string(it->second.c_str())) return caps;
+    }
+  }
+  return template_caps(factory, direction);
+}
+
+bool apply_property(GstElement* element, const std::string& property,
+                    const std::string& value) {
+  if (property.find("::") != std::string::npos && GST_IS_CHILD_PROXY(element)) {
+    GObject* child{nullptr};
+    GParamSpec* pspec{nullptr};
+    if (!gst_child_proxy_lookup(GST_CHILD_PROXY(element), property.c_str(),
+                                &child, &pspec)) {
+      LOG(ERROR) << std::format("no child property {} on {}", property,
+                                GST_ELEMENT_NAME(element));
+      return false;
+    }
+    gst_util_set_object_arg(child, pspec->name, value.c_str());
+    g_object_unref(child);
+    return true;
+  }
+
+  if (!g_object_class_find_property(G_OBJECT_GET_CLASS(element),
+                                    property.c_str())) {
+    LOG(ERROR) << std::format("no property {} on {}", property,
+                              GST_ELEMENT_NAME(element));
+    return false;
+  }
+  gst_util_set_object_arg(G_OBJECT(element), property.c_str(), value.c_str());
+  return true;
+}
+
+// static pads get a capsfilter in between, the way gst-launch does it
+bool link_filtered(Element& from, Element& to, const std::string& filter) {
+  GstCaps* caps = gst_caps_from_string(filter.c_str());
+  if (!caps) {
+    LOG(ERROR) << std::format("bad caps {} between {} and {}", filter,
+                              from.get_alias(), to.get_alias());
+    return false;
+  }
+  bool linked = gst_element_link_filtered(from.raw(), to.raw(), caps);
+  gst_caps_unref(caps);
+  if (!linked) {
+    LOG(ERROR) << std::format("{} and {} do not link with {}",
+                              from.get_alias(), to.get_alias(), filter);
+  }
+  return linked;
+}
+
+// just enough JSON for graph descriptions: objects, arrays, strings, numbers,
+// true, false and null; numbers and literals keep their text
+struct JsonValue {
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  Type type{Type::Null};
+  std::string text{};  // string contents, number or literal as written
+  std::vector<JsonValue> items{};  // array elements or object values
+  std::vector<std::string> keys{};  // object keys, one per item
+
+  const JsonValue* get(std::string_view key) const {
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] == key) return &items[i];
+    }
+    return nullptr;
+  }
+};
+
+class JsonReader {
+ public:
+  explicit JsonReader(std::string_view text) : text(text) {}
+
+  // the whole text has to be one value
+  std::optional<JsonValue> read() {
+    auto result = value(0);
+    skip_space();
+    if (!result || pos != text.size()) return std::nullopt;
+    return result;
+  }
+
+ private:
+  static constexpr int kMaxDepth = 32;
+
+  void skip_space() {
+    while (pos < text.size() &&
+           std::isspace(static_cast<unsigned char>(text[pos]))) {
+      ++pos;
+    }
+  }
+
+  bool consume(char c) {
+    skip_space();
+    if (pos < text.size() && text[pos] == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  bool literal(std::string_view word) {
+    if (text.substr(pos, word.size()) != word) return false;
+    pos += word.size();
+    return true;
+  }
+
+  std::optional<JsonValue> value(int depth) {
+    if (depth > kMaxDepth) return std::nullopt;
+    skip_space();
+    if (pos >= text.size()) return std::nullopt;
+    JsonValue result;
+    char c = text[pos];
+    if (c == '{') return object(depth);
+    if (c == '[') return array(depth);
+    if (c == '"') {
+      auto contents = string();
+      if (!contents) return std::nullopt;
+      result.type = JsonValue::Type::String;
+      result.text = std::move(*contents);
+      return result;
+    }
+    for (auto word : {"true", "false"}) {
+      if (literal(word)) {
+        result.type = JsonValue::Type::Bool;
+        result.text = word;
+        return result;
+      }
+    }
+    if (literal("null")) return result;
+    return number();
+  }
+
+  std::optional<JsonValue> number() {
+    size_t start = pos;
+    while (pos < text.size() &&
+           (std::isdigit(static_cast<unsigned char>(text[pos])) ||
+            std::string_view("+-.eE").find(text[pos]) !=
+                std::string_view::npos)) {
+      ++pos;
+    }
+    std::string literal(text.substr(start, pos - start));
+    char* end{nullptr};
+    if (literal.empty()) return std::nullopt;
+    std::strtod(literal.c_str(), &end);
+    if (end != literal.c_str() + literal.size()) return std::nullopt;
+    return JsonValue{.type = JsonValue::Type::Number, .text = literal};
+  }
+
+  std::optional<JsonValue> array(int depth) {
+    ++pos;  // [
+    JsonValue result{.type = JsonValue::Type::Array};
+    if (consume(']')) return result;
+    do {
+      auto item = value(depth + 1);
+      if (!item) return std::nullopt;
+      result.items.push_back(std::move(*item));
+    } while (consume(','));
+    if (!consume(']')) return std::nullopt;
+    return result;
+  }
+
+  std::optional<JsonValue> object(int depth) {
+    ++pos;  // {
+    JsonValue result{.type = JsonValue::Type::Object};
+    if (consume('}')) return result;
+    do {
+      skip_space();
+      auto key = string();
+      if (!key || !consume(':')) return std::nullopt;
+      auto item = value(depth + 1);
+      if (!item) return std::nullopt;
+      result.keys.push_back(std::move(*key));
+      result.items.push_back(std::move(*item));
+    } while (consume(','));
+    if (!consume('}')) return std::nullopt;
+    return result;
+  }
+
+  // four hex digits of a \u escape
+  std::optional<uint32_t> hex4() {
+    if (pos + 4 > text.size()) return std::nullopt;
+    uint32_t code{0};
+    for (size_t i = 0; i < 4; ++i) {
+      char c = text[pos++];
+      code <<= 4;
+      if (c >= '0' && c <= '9') {
+        code |= uint32_t(c - '0');
+      } else if (c >= 'a' && c <= 'f') {
+        code |= uint32_t(c - 'a' + 10);
+      } else if (c >= 'A' && c <= 'F') {
+        code |= uint32_t(c - 'A' + 10);
+      } else {
+        return std::nullopt;
+      }
+    }
+    return code;
+  }
+
+  static void append_utf8(std::string& out, uint32_t code) {
+    if (code < 0x80) {
+      out += char(code);
+    } else if (code < 0x800) {
+      out += char(0xC0 | (code >> 6));
+      out += char(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += char(0xE0 | (code >> 12));
+      out += char(0x80 | ((code >> 6) & 0x3F));
+      out += char(0x80 | (code & 0x3F));
+    } else {
+      out += char(0xF0 | (code >> 18));
+      out += char(0x80 | ((code >> 12) & 0x3F));
+      out += char(0x80 | ((code >> 6) & 0x3F));
+      out += char(0x80 | (code & 0x3F));
+    }
+  }
+
+  std::optional<std::string> string() {
+    if (pos >= text.size() || text[pos] != '"') return std::nullopt;
+    ++pos;
+    std::string out;
+    while (pos < text.size()) {
+      char c = text[pos++];
+      if (c == '"') return out;
+      if (static_cast<unsigned char>(c) < 0x20) return std::nullopt;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (pos >= text.size()) return std::nullopt;
+      switch (char escaped = text[pos++]) {
+        case '"':
+        case '\\':
+        case '/':
+          out += escaped;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          auto code = hex4();
+          if (!code) return std::nullopt;
+          // a surrogate pair spells a code point above the BMP
+          if (*code >= 0xD800 && *code < 0xDC00 && literal("\\u")) {
+            auto low = hex4();
+            if (!low || *low < 0xDC00 || *low >= 0xE000) return std::nullopt;
+            *code = 0x10000 + ((*code - 0xD800) << 10) + (*low - 0xDC00);
+          }
+          append_utf8(out, *code);
+          break;
+        }
+        default:
+          return std::nullopt;
+      }
+    }
+    return std::nullopt;
+  }
+
+  std::string_view text;
+  size_t pos{0};
+};
+
+}  // namespace
+
+std::optional<PipelineGraph> PipelineGraph::parse(std::string_view description) {
+  auto start = description.find_first_not_of(" \t\r\n");
+  if (start != std::string_view::npos && description[start] == '{') {
+    return parse_json(description);
+  }
+  auto tokens = tokenize(description);
+  if (!tokens) {
+    LOG(ERROR) << std::format("unterminated quote in '{}'", description);
+    return std::nullopt;
+  }
+
+  PipelineGraph graph;
+  bool pendingLink{false};
+  for (auto& token : *tokens) {
+    switch (classify(token)) {
+      case TokenKind::Link:
+        if (!graph.current || pendingLink) {
+          LOG(ERROR) << std::format("dangling '!' in '{}'", description);
+          return std::nullopt;
+        }
+        pendingLink = true;
+        break;
+      case TokenKind::Reference: {
+        auto alias = std::string_view(token).substr(0, token.size() - 1);
+        auto index = graph.find(alias);
+        if (!index) {
+          LOG(ERROR) << std::format("unknown reference '{}'", token);
+          return std::nullopt;
+        }
+        if (pendingLink) graph.graphLinks.push_back({*graph.current, *index});
+        graph.current = index;
+        pendingLink = false;
+        break;
+      }
+      case TokenKind::Caps:
+        if (pendingLink) {
+          graph.caps(token);
+        } else {
+          graph.add("capsfilter").set("caps", token);
+        }
+        pendingLink = false;
+        break;
+      case TokenKind::Property: {
+        if (!graph.current || pendingLink) {
+          LOG(ERROR) << std::format("property '{}' without element", token);
+          return std::nullopt;
+        }
+        auto eq = token.find('=');
+        auto key = token.substr(0, eq);
+        auto value = token.substr(eq + 1);
+        if (key == "name") {
+          if (graph.find(value)) {
+            LOG(ERROR) << std::format("duplicate name '{}'", value);
+            return std::nullopt;
+          }
+          graph.graphNodes[*graph.current].alias = value;
+        } else {
+          graph.set(key, value);
+        }
+        break;
+      }
+      case TokenKind::Factory:
+        if (pendingLink) {
+          graph.then(token);
+        } else {
+          graph.add(token);
+        }
+        pendingLink = false;
+        break;
+    }
+  }
+
+  if (pendingLink) {
+    LOG(ERROR) << std::format("dangling '!' in '{}'", description);
+    return std::nullopt;
+  }
+  return graph;
+}
+
+std::optional<PipelineGraph> PipelineGraph::parse_json(
+    std::string_view description) {
+  auto fail = [](std::string_view what) {
+    LOG(ERROR) << std::format("graph description: {}", what);
+    return std::nullopt;
+  };
+  auto root = JsonReader(description).read();
+  if (!root || root->type != JsonValue::Type::Object) {
+    return fail("not a JSON object");
+  }
+  const JsonValue* nodes = root->get("nodes");
+  if (!nodes || nodes->type != JsonValue::Type::Array || nodes->items.empty()) {
+    return fail("\"nodes\" has to be a non-empty array");
+  }
+
+  PipelineGraph graph;
+  for (auto& node : nodes->items) {
+    const JsonValue* factory = node.get("factory");
+    if (!factory || factory->type != JsonValue::Type::String) {
+      return fail("every node needs a \"factory\" string");
+    }
+    std::string alias;
+    if (const JsonValue* name = node.get("name")) {
+      if (name->type != JsonValue::Type::String || graph.find(name->text)) {
+        return fail(std::format("bad or duplicate name of {}", factory->text));
+      }
+      alias = name->text;
+    }
+    graph.add(factory->text, alias);
+
+    const JsonValue* properties = node.get("properties");
+    if (!properties) continue;
+    if (properties->type != JsonValue::Type::Object) {
+      return fail(std::format("properties of {} are no object", factory->text));
+    }
+    for (size_t i = 0; i < properties->keys.size(); ++i) {
+      auto& value = properties->items[i];
+      if (value.type == JsonValue::Type::Null ||
+          value.type == JsonValue::Type::Array ||
+          value.type == JsonValue::Type::Object) {
+        return fail(std::format("property {} needs a string, number or bool",
+                                properties->keys[i]));
+      }
+      graph.set(properties->keys[i], value.text);
+    }
+  }
+
+  const JsonValue* links = root->get("links");
+  if (!links) return graph;
+  if (links->type != JsonValue::Type::Array) {
+    return fail("\"links\" has to be an array");
+  }
+  for (auto& link : links->items) {
+    const JsonValue* from = link.get("from");
+    const JsonValue* to = link.get("to");
+    const JsonValue* caps = link.get("caps");
+    if (!from || !to || from->type != JsonValue::Type::String ||
+        to->type != JsonValue::Type::String || !graph.find(from->text) ||
+        !graph.find(to->text)) {
+      return fail("links need \"from\" and \"to\" naming nodes");
+    }
+    if (caps && caps->type != JsonValue::Type::String) {
+      return fail("link caps have to be a string");
+    }
+    graph.link(from->text, to->text, caps ? caps->text : "");
+  }
+  return graph;
+}
+
+PipelineGraph& PipelineGraph::add(std::string_view factory,
+                                  std::string_view alias) {
+  Node node{.factory = std::string(factory),
+            .alias = alias.empty() ? unique_alias(factory)
+                                   : std::string(alias)};
+  if (find(node.alias)) {
+    LOG(ERROR) << std::format("duplicate alias {}", node.alias);
+    node.alias = unique_alias(node.alias);
+  }
+  graphNodes.push_back(std::move(node));
+  current = graphNodes.size() - 1;
+  return *this;
+}
+
+PipelineGraph& PipelineGraph::then(std::string_view factory,
+                                   std::string_view alias) {
+  auto previous = current;
+  add(factory, alias);
+  if (previous) graphLinks.push_back({*previous, *current});
+  return *this;
+}
+
+PipelineGraph& PipelineGraph::caps(std::string_view caps) {
+  return then("capsfilter").set("caps", caps);
+}
+
+PipelineGraph& PipelineGraph::queue(std::string_view alias) {
+  return then("queue", alias);
+}
+
+PipelineGraph& PipelineGraph::from(std::string_view alias) {
+  auto index = find(alias);
+  if (!index) {
+    LOG(ERROR) << std::format("unknown graph node {}", alias);
+  }
+  current = index;
+  return *this;
+}
+
+PipelineGraph& PipelineGraph::link(std::string_view from,
+                                   std::string_view to,
+                                   std::string_view caps) {
+  auto src = find(from);
+  auto dst = find(to);
+  if (!src || !dst) {
+    LOG(ERROR) << std::format("cannot link unknown nodes {} and {}", from, to);
+    return *this;
+  }
+  graphLinks.push_back({*src, *dst, std::string(caps)});
+  current = dst;
+  return *this;
+}
+
+PipelineGraph& PipelineGraph::set_string(std::string_view property,
+                                         std::string value) {
+  if (!current) {
+    LOG(ERROR) << std::format("property {} set without a node", property);
+    return *this;
+  }
+  graphNodes[*current].properties.emplace_back(property, std::move(value));
+  return *this;
+}
+
+PipelineGraph& PipelineGraph::prefix_aliases(std::string_view prefix) {
+  for (auto& node : graphNodes) {
+    node.alias = std::format("{}-{}", prefix, node.alias);
+  }
+  return *this;
+}
+
+std::string PipelineGraph::unique_alias(std::string_view factory) const {
+  for (size_t i = 0;; ++i) {
+    auto alias = std::format("{}{}", factory, i);
+    if (!find(alias)) return alias;
+  }
+}
+
+const std::vector<PipelineGraph::Node>& PipelineGraph::nodes() const {
+  return graphNodes;
+}
+
+const std::vector<PipelineGraph::Link>& PipelineGraph::links() const {
+  return graphLinks;
+}
+
+std::optional<size_t> PipelineGraph::find(std::string_view alias) const {
+  for (size_t i = 0; i < graphNodes.size(); ++i) {
+    if (graphNodes[i].alias == alias) return i;
+  }
+  return std::nullopt;
+}
+
+bool PipelineGraph::validate() const {
+  std::vector<GstElementFactory*> factories;
+  bool valid{true};
+  for (auto& node : graphNodes) {
+    auto factory = gst_element_factory_find(node.factory.c_str());
+    if (!factory) {
+      LOG(ERROR) << std::format("no element factory {} for {}", node.factory,
+                                node.alias);
+      valid = false;
+    }
+    factories.push_back(factory);
+  }
+
+  for (size_t i = 0; valid && i < graphLinks.size(); ++i) {
+    auto& [from, to, caps] = graphLinks[i];
+    GstCaps* out = node_caps(graphNodes[from], factories[from], GST_PAD_SRC);
+    GstCaps* in = node_caps(graphNodes[to], factories[to], GST_PAD_SINK);
+    if (!gst_caps_can_intersect(out, in)) {
+      LOG(ERROR) << std::format("{} ! {}: pad templates can't intersect",
+                                graphNodes[from].alias, graphNodes[to].alias);
+      valid = false;
+    }
+    gst_caps_unref(out);
+    gst_caps_unref(in);
+  }
+
+  for (auto factory : factories) {
+    if (factory) gst_object_unref(factory);
+  }
+  return valid;
+}
+
+bool PipelineGraph::build(Pipeline& pipeline) {
+  using clock = std::chrono::steady_clock;
+  auto since = [](clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(clock::now() -
+                                                                 start);
+  };
+  buildStats = {};
+
+  auto started = clock::now();
+  if (!validate()) return false;
+  buildStats.validate = since(started);
+
+  // elements are owned by the pipeline before linking, so dynamic pad
+  // handlers never see them move
+  started = clock::now();
+  std::vector<Element*> created;
+  for (auto& node : graphNodes) {
+    Element element(node.factory, node.alias);
+    if (!element.is_initialised()) return false;
+    for (auto& [property, value] : node.properties) {
+      if (!apply_property(element.raw(), property, value)) return false;
+    }
+    created.push_back(&pipeline.add_element(std::move(element)));
+  }
+  buildStats.elements = created.size();
+  buildStats.create = since(started);
+
+  started = clock::now();
+  for (auto& [from, to, caps] : graphLinks) {
+    bool dynamic = created[from]->pad_type() == Element::PadTypes::Sometime;
+    bool linked{false};
+    if (caps.empty()) {
+      linked = created[from]->link(*created[to]);
+    } else if (dynamic) {
+      linked = created[from]->route(*created[to], caps);
+    } else {
+      linked = link_filtered(*created[from], *created[to], caps);
+    }
+    if (!linked) return false;
+    if (dynamic) ++buildStats.dynamic_links;
+    ++buildStats.links;
+  }
+  buildStats.link = since(started);
+
+  LOG(INFO) << std::format(
+      "graph built: {} elements, {} links ({} dynamic); validate {}us, "
+      "create {}us, link {}us",
+      buildStats.elements, buildStats.links, buildStats.dynamic_links,
+      buildStats.validate.count(), buildStats.create.count(),
+      buildStats.link.count());
+  return true;
+}
+
+const PipelineGraph::BuildStats& PipelineGraph::stats() const {
+  return buildStats;
+}
+
+}  // namespace vptyp
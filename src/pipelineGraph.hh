@@ -0,0 +1,117 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Declarative description of a pipeline graph. Nodes and links are collected
+// first, validated against factory pad templates and then created and linked
+// in a single pass by build().
+//
+//   graph.add("videotestsrc").set("is-live", true)
+//       .caps("video/x-raw,width=640,height=360")
+//       .then("tee", "t")
+//       .then("queue").then("autovideosink")
+//       .from("t").then("queue").then("fakesink");
+//
+// The same graph can be given as a gst-launch like or a JSON description,
+// see parse() and parse_json().
+class PipelineGraph {
+ public:
+  struct Node {
+    std::string factory{};
+    std::string alias{};
+    std::vector<std::pair<std::string, std::string>> properties{};
+  };
+
+  struct Link {
+    size_t from{0};
+    size_t to{0};
+    std::string caps{};  // filter, a capsfilter between static pads
+  };
+
+  struct BuildStats {
+    size_t elements{0};
+    size_t links{0};
+    size_t dynamic_links{0};
+    std::chrono::microseconds validate{0};
+    std::chrono::microseconds create{0};
+    std::chrono::microseconds link{0};
+  };
+
+  // supports `factory prop=value`, `!`, `name=alias`, `alias.` references
+  // for branches and bare caps strings which become capsfilters; a
+  // description starting with '{' goes to parse_json()
+  static std::optional<PipelineGraph> parse(std::string_view description);
+  // nodes and explicit links, links may carry caps:
+  //   {"nodes": [{"factory": "videotestsrc", "name": "src",
+  //               "properties": {"num-buffers": 10}},
+  //              {"factory": "fakesink", "name": "sink"}],
+  //    "links": [{"from": "src", "to": "sink", "caps": "video/x-raw"}]}
+  static std::optional<PipelineGraph> parse_json(std::string_view description);
+
+  // new unlinked node, becomes the current one
+  PipelineGraph& add(std::string_view factory, std::string_view alias = {});
+  // new node linked from the current one
+  PipelineGraph& then(std::string_view factory, std::string_view alias = {});
+  // capsfilter linked from the current one
+  PipelineGraph& caps(std::string_view caps);
+  // queue linked from the current one
+  PipelineGraph& queue(std::string_view alias = {});
+  // continue from an existing node, e.g. to start another tee branch
+  PipelineGraph& from(std::string_view alias);
+  // caps pick which of the pads from adds later go to, e.g. "audio/x-raw"
+  // for the audio branch behind decodebin; static pads link through them
+  PipelineGraph& link(std::string_view from, std::string_view to,
+                      std::string_view caps = {});
+  // renames every node to "<prefix>-<alias>", so one description can be
+  // built into the same pipeline several times
+  PipelineGraph& prefix_aliases(std::string_view prefix);
+
+  // property of the current node, value uses gst-launch serialisation;
+  // child proxy properties are addressed as "child::property"
+  template <typename T>
+  PipelineGraph& set(std::string_view property, const T& value);
+
+  const std::vector<Node>& nodes() const;
+  const std::vector<Link>& links() const;
+  std::optional<size_t> find(std::string_view alias) const;
+
+  // checks factories exist and linked pad templates can intersect
+  bool validate() const;
+  // creates, adds and links everything into the pipeline
+  bool build(Pipeline& pipeline);
+  const BuildStats& stats() const;
+
+ protected:
+  PipelineGraph& set_string(std::string_view property, std::string value);
+  std::string unique_alias(std::string_view factory) const;
+
+ protected:
+  std::vector<Node> graphNodes;
+  std::vector<Link> graphLinks;
+  std::optional<size_t> current{};
+  BuildStats buildStats{};
+};
+
+template <typename T>
+PipelineGraph& PipelineGraph::set(std::string_view property, const T& value) {
+  if constexpr (std::is_same_v<T, bool>) {
+    return set_string(property, value ? "true" : "false");
+  } else if constexpr (std::is_arithmetic_v<T>) {
+    return set_string(property, std::to_string(value));
+  } else {
+    return set_string(property, std::string(value));
+  }
+}
+
+}  // namespace vptyp
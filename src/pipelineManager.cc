@@ -0,0 +1,138 @@
+#include "pipelineManager.hh"
+
+#include <glog/logging.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <format>
+
+namespace vptyp {
+
+PipelineManager::PipelineManager() : PipelineManager(Options{}) {}
+
+PipelineManager::PipelineManager(const Options& options) : options(options) {
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  unsigned count = options.shards ? options.shards : cores;
+
+  for (unsigned i = 0; i < count; ++i) {
+    auto shard = std::make_unique<Shard>();
+    shard->context = g_main_context_new();
+    shard->loop = g_main_loop_new(shard->context, false);
+    shard->worker = std::thread(&PipelineManager::run_shard, this,
+                                std::ref(*shard), i);
+    shards.push_back(std::move(shard));
+  }
+  LOG(INFO) << std::format("pipeline manager started {} shards", count);
+}
+
+PipelineManager::~PipelineManager() {
+  stop_all();
+  for (auto& shard : shards) {
+    // a worker may not run its loop yet, g_main_loop_run would reset a direct
+    // quit; an attached source is dispatched once the loop runs
+    GSource* quit = g_idle_source_new();
+    g_source_set_callback(
+        quit,
+        +[](gpointer data) {
+          g_main_loop_quit(static_cast<GMainLoop*>(data));
+          return gboolean(G_SOURCE_REMOVE);
+        },
+        shard->loop, nullptr);
+    g_source_attach(quit, shard->context);
+    g_source_unref(quit);
+    if (shard->worker.joinable()) shard->worker.join();
+    shard->pipelines.clear();
+    g_main_loop_unref(shard->loop);
+    g_main_context_unref(shard->context);
+  }
+}
+
+void PipelineManager::run_shard(Shard& shard, unsigned index) {
+  if (options.pin_threads) {
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cores, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      LOG(WARNING) << std::format("failed to pin shard {}", index);
+    }
+  }
+
+  g_main_context_push_thread_default(shard.context);
+  g_main_loop_run(shard.loop);
+  g_main_context_pop_thread_default(shard.context);
+}
+
+Pipeline& PipelineManager::add(std::string_view name, const Builder& build) {
+  std::unique_lock lock(guard);
+  auto& shard = **std::min_element(
+      shards.begin(), shards.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs->pipelines.size() < rhs->pipelines.size();
+      });
+
+  auto pipeline = std::make_unique<Pipeline>(*shard.loop, name);
+  pipeline->set_quit_on_finish(false);
+  pipeline->add_bus_observer([this](GstMessage* msg) {
+    auto type = GST_MESSAGE_TYPE(msg);
+    if (type == GST_MESSAGE_EOS || type == GST_MESSAGE_ERROR) {
+      notify_finished();
+    }
+  });
+  build(*pipeline);
+
+  shard.pipelines.push_back(std::move(pipeline));
+  return *shard.pipelines.back();
+}
+
+void PipelineManager::play_all() {
+  std::lock_guard lock(guard);
+  for (auto& shard : shards)
+    for (auto& pipeline : shard->pipelines) pipeline->play();
+}
+
+void PipelineManager::stop_all() {
+  std::lock_guard lock(guard);
+  for (auto& shard : shards)
+    for (auto& pipeline : shard->pipelines) pipeline->stop();
+}
+
+size_t PipelineManager::size() const {
+  std::lock_guard lock(guard);
+  size_t total{0};
+  for (auto& shard : shards) total += shard->pipelines.size();
+  return total;
+}
+
+size_t PipelineManager::shard_count() const { return shards.size(); }
+
+PipelineManager::Status PipelineManager::status() const {
+  std::lock_guard lock(guard);
+  Status result;
+  for (auto& shard : shards) {
+    result.per_shard.push_back(shard->pipelines.size());
+    for (auto& pipeline : shard->pipelines) {
+      auto status = pipeline->status();
+      ++result.pipelines;
+      if (status.state == GST_STATE_PLAYING) ++result.playing;
+      if (status.eos) ++result.finished;
+      if (status.error) ++result.failed;
+    }
+  }
+  return result;
+}
+
+void PipelineManager::notify_finished() {
+  { std::lock_guard lock(finished_guard); }
+  finished.notify_all();
+}
+
+bool PipelineManager::wait_finished(std::chrono::milliseconds timeout) {
+  std::unique_lock lock(finished_guard);
+  return finished.wait_for(lock, timeout, [this]() {
+    auto current = status();
+    return current.finished + current.failed == current.pipelines;
+  });
+}
+
+}  // namespace vptyp
@@ -0,0 +1,74 @@
+#pragma once
+#include <glib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Hosts many pipelines in one process. Pipelines are spread over shards, each
+// shard runs its own GMainContext/GMainLoop in a dedicated worker thread.
+class PipelineManager {
+ public:
+  struct Options {
+    unsigned shards{0};      // 0 - one per hardware thread
+    bool pin_threads{true};  // pin shard workers to cores round robin
+  };
+
+  struct Status {
+    size_t pipelines{0};
+    size_t playing{0};
+    size_t finished{0};  // reached EOS
+    size_t failed{0};    // posted an error
+    std::vector<size_t> per_shard{};
+  };
+
+  using Builder = std::function<void(Pipeline&)>;
+
+  PipelineManager();
+  explicit PipelineManager(const Options& options);
+  PipelineManager(const PipelineManager&) = delete;
+  PipelineManager& operator=(const PipelineManager&) = delete;
+  ~PipelineManager();
+
+  // creates the pipeline on the least loaded shard and lets builder fill it
+  Pipeline& add(std::string_view name, const Builder& build);
+
+  void play_all();
+  void stop_all();
+
+  size_t size() const;
+  size_t shard_count() const;
+  Status status() const;
+
+  // true once every pipeline reached EOS or failed
+  bool wait_finished(std::chrono::milliseconds timeout);
+
+ protected:
+  struct Shard {
+    GMainContext* context{nullptr};
+    GMainLoop* loop{nullptr};
+    std::thread worker{};
+    std::vector<std::unique_ptr<Pipeline>> pipelines{};
+  };
+
+  void run_shard(Shard& shard, unsigned index);
+  void notify_finished();
+
+ protected:
+  Options options;
+  std::vector<std::unique_ptr<Shard>> shards;
+  mutable std::mutex guard;
+  std::mutex finished_guard;
+  std::condition_variable finished;
+};
+
+}  // namespace vptyp
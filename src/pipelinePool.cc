@@ -0,0 +1,157 @@
+#include "pipelinePool.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+PipelinePool::PipelinePool(GMainLoop& loop) : PipelinePool(loop, Options{}) {}
+
+PipelinePool::PipelinePool(GMainLoop& loop, const Options& options)
+    : loop(loop),
+      options(options),
+      worker(&PipelinePool::refill, this) {}
+
+PipelinePool::~PipelinePool() {
+  {
+    std::lock_guard lock(guard);
+    stopping = true;
+  }
+  wanted.notify_all();
+  worker.join();
+}
+
+bool PipelinePool::add_template(std::string_view name, Builder build) {
+  {
+    std::lock_guard lock(guard);
+    if (templates.contains(name)) {
+      LOG(ERROR) << std::format("pool template {} already exists", name);
+      return false;
+    }
+    templates.emplace(std::string(name), Template{.build = std::move(build)});
+  }
+  wanted.notify_one();
+  return true;
+}
+
+bool PipelinePool::add_template(std::string_view name,
+                                std::string_view description) {
+  auto graph = PipelineGraph::parse(description);
+  if (!graph) {
+    LOG(ERROR) << std::format("pool template {}: cannot parse {}", name,
+                              description);
+    return false;
+  }
+  // plugins are loaded here rather than by the first build
+  for (auto& node : graph->nodes()) Element::prefetch(node.factory);
+  return add_template(name, [graph = std::move(*graph)](Pipeline& pipeline) {
+    PipelineGraph copy = graph;
+    return copy.build(pipeline);
+  });
+}
+
+std::unique_ptr<Pipeline> PipelinePool::acquire(std::string_view name) {
+  std::unique_lock lock(guard);
+  auto it = templates.find(name);
+  if (it == templates.end()) {
+    LOG(ERROR) << std::format("no pool template {}", name);
+    return nullptr;
+  }
+  auto& entry = it->second;
+  while (!entry.warm.empty()) {
+    auto pipeline = std::move(entry.warm.front());
+    entry.warm.pop_front();
+    // a warm pipeline that failed meanwhile is of no use
+    if (pipeline->status().error) continue;
+    ++entry.hits;
+    lock.unlock();
+    wanted.notify_one();
+    pipeline->set_quit_on_finish(true);
+    return pipeline;
+  }
+
+  ++entry.misses;
+  Builder build = entry.build;
+  size_t serial = entry.serial++;
+  lock.unlock();
+  wanted.notify_one();
+  LOG(WARNING) << std::format("pool template {} ran dry, building", name);
+  return make(name, build, serial, false);
+}
+
+bool PipelinePool::contains(std::string_view name) const {
+  std::lock_guard lock(guard);
+  return templates.contains(name);
+}
+
+PipelinePool::Status PipelinePool::status(std::string_view name) const {
+  std::lock_guard lock(guard);
+  auto it = templates.find(name);
+  if (it == templates.end()) return {};
+  return {it->second.warm.size(), it->second.hits, it->second.misses};
+}
+
+std::unique_ptr<Pipeline> PipelinePool::make(std::string_view name,
+                                             const Builder& build,
+                                             size_t serial, bool preroll) {
+  auto pipeline =
+      std::make_unique<Pipeline>(loop, std::format("{}-{}", name, serial));
+  if (!build(*pipeline)) {
+    LOG(ERROR) << std::format("pool template {} failed to build", name);
+    return nullptr;
+  }
+  if (!preroll) return pipeline;
+
+  // an error while waiting in the pool must not end the loop
+  pipeline->set_quit_on_finish(false);
+  if (!pipeline->preroll(options.preroll_timeout)) {
+    LOG(ERROR) << std::format("pool template {} failed to preroll", name);
+    return nullptr;
+  }
+  return pipeline;
+}
+
+PipelinePool::Template* PipelinePool::wanting(std::string& name) {
+  for (auto& [key, entry] : templates) {
+    if (!entry.broken &&
+        entry.warm.size() + entry.building < options.per_template) {
+      name = key;
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+void PipelinePool::refill() {
+  std::unique_lock lock(guard);
+  while (true) {
+    std::string name;
+    Template* entry{nullptr};
+    wanted.wait(lock, [&]() {
+      return stopping || (entry = wanting(name)) != nullptr;
+    });
+    if (stopping) return;
+
+    // templates are never erased, the entry stays valid while unlocked
+    ++entry->building;
+    Builder build = entry->build;
+    size_t serial = entry->serial++;
+    lock.unlock();
+    auto pipeline = make(name, build, serial, true);
+    lock.lock();
+    --entry->building;
+    if (!pipeline) {
+      // a broken template would spin the thread, give up on refilling it
+      LOG(ERROR) << std::format("pool template {} is not warmed anymore",
+                                name);
+      entry->broken = true;
+      continue;
+    }
+    entry->warm.push_back(std::move(pipeline));
+  }
+}
+
+}  // namespace vptyp
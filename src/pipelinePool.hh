@@ -0,0 +1,84 @@
+#pragma once
+#include <glib.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "pipeline.hh"
+
+namespace vptyp {
+
+// Keeps pipelines of registered templates built and pre-rolled in PAUSED,
+// so a stream request only has to go to PLAYING. Acquired pipelines are
+// replaced from a background thread; a request finding its template dry
+// builds one on the spot.
+class PipelinePool {
+ public:
+  struct Options {
+    size_t per_template{2};  // pre-rolled pipelines kept per template
+    std::chrono::milliseconds preroll_timeout{5000};
+  };
+
+  struct Status {
+    size_t warm{0};
+    size_t hits{0};    // acquired pre-rolled
+    size_t misses{0};  // built on request
+  };
+
+  // fills the pipeline, false if it could not
+  using Builder = std::function<bool(Pipeline&)>;
+
+  explicit PipelinePool(GMainLoop& loop);
+  PipelinePool(GMainLoop& loop, const Options& options);
+  PipelinePool(const PipelinePool&) = delete;
+  PipelinePool& operator=(const PipelinePool&) = delete;
+  ~PipelinePool();
+
+  // registers the template and starts warming it up
+  bool add_template(std::string_view name, Builder build);
+  // gst-launch like description, see PipelineGraph::parse()
+  bool add_template(std::string_view name, std::string_view description);
+
+  // nullptr for an unknown template or when building fails; the pipeline
+  // quits the loop on EOS or error again, like any other
+  std::unique_ptr<Pipeline> acquire(std::string_view name);
+  bool contains(std::string_view name) const;
+  Status status(std::string_view name) const;
+
+ protected:
+  struct Template {
+    Builder build{};
+    std::deque<std::unique_ptr<Pipeline>> warm{};
+    size_t building{0};  // by the refill thread right now
+    size_t serial{0};  // pipeline names
+    size_t hits{0};
+    size_t misses{0};
+    bool broken{false};  // failed in the background, built on request only
+  };
+
+  // pipeline of the template, pre-rolled when preroll is set
+  std::unique_ptr<Pipeline> make(std::string_view name, const Builder& build,
+                                 size_t serial, bool preroll);
+  // template below its size, nullptr if every one is full; under guard
+  Template* wanting(std::string& name);
+  void refill();
+
+ protected:
+  GMainLoop& loop;
+  Options options;
+  mutable std::mutex guard;
+  std::condition_variable wanted;
+  std::map<std::string, Template, std::less<>> templates;
+  bool stopping{false};
+  std::thread worker;
+};
+
+}  // namespace vptyp
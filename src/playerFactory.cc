@@ -1,17 +1,121 @@
 #include "playerFactory.hh"
 
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
 #include <memory>
+#include <optional>
+#include <thread>
 
 #include "src/basePlayer.hh"
 #include "src/baseRtcPlayer.hh"
+#include "src/fanOutPlayer.hh"
+#include "src/graphPlayer.hh"
 #include "src/webPlayer.hh"
 
 namespace vptyp {
 
+namespace {
+
+std::optional<BaseRTCPlayer::Options> rtc_options(const Flags& flags) {
+  auto options = flags.rtc_low_latency ? BaseRTCPlayer::low_latency_profile()
+                                       : BaseRTCPlayer::Options{};
+  if (!flags.rtc_congestion.empty()) {
+    auto congestion = BaseRTCPlayer::parse_congestion(flags.rtc_congestion);
+    if (!congestion) {
+      LOG(ERROR) << std::format("unknown congestion control {}",
+                                flags.rtc_congestion);
+      return std::nullopt;
+    }
+    options.congestion = *congestion;
+  }
+  options.source = flags.rtc_source;
+  options.passthrough = flags.rtc_passthrough;
+  options.codec = flags.rtc_codec;
+  auto kbps = [](int value, guint& bps) {
+    if (value > 0) bps = guint(value) * 1000;
+  };
+  kbps(flags.rtc_start_kbps, options.start_bitrate);
+  kbps(flags.rtc_min_kbps, options.min_bitrate);
+  kbps(flags.rtc_max_kbps, options.max_bitrate);
+  if (flags.rtc_keyframe_interval > 0) {
+    options.keyframe_interval = flags.rtc_keyframe_interval;
+  }
+  if (flags.rtc_ladder == "default") {
+    options.renditions = BaseRTCPlayer::default_ladder();
+  } else if (!flags.rtc_ladder.empty()) {
+    auto ladder = BaseRTCPlayer::parse_ladder(flags.rtc_ladder);
+    if (!ladder) {
+      LOG(ERROR) << std::format("bad rendition ladder {}", flags.rtc_ladder);
+      return std::nullopt;
+    }
+    options.renditions = std::move(*ladder);
+  }
+  return options;
+}
+
+std::optional<RecordingStage::Options> recording_options(const Flags& flags) {
+  auto mode = RecordingStage::parse_mode(flags.recording_mode);
+  auto sync = RecordingStage::parse_sync(flags.recording_sync);
+  if (!mode || !sync) {
+    LOG(ERROR) << std::format("unknown recording mode {} or sync {}",
+                              flags.recording_mode, flags.recording_sync);
+    return std::nullopt;
+  }
+  return RecordingStage::Options{
+      .mode = *mode,
+      .fragment = std::chrono::milliseconds(
+          std::max(flags.recording_fragment_ms, 1)),
+      .segment_time =
+          std::chrono::seconds(std::max(flags.recording_segment_s, 0)),
+      .segment_bytes =
+          guint64(std::max(flags.recording_segment_mb, 0)) * 1024 * 1024,
+      .max_files = guint(std::max(flags.recording_max_files, 0)),
+      .sync = *sync,
+      .index = flags.recording_index,
+      .sink = flags.recording_sink};
+}
+
+}  // namespace
+
+PlayerFactory::PlayerFactory(PipelinePool& pool) : pool(&pool) {}
+
 std::unique_ptr<BasePlayer> PlayerFactory::create(const Flags& flags,
                                                   GMainLoop& loop) {
+  if (!flags.graph.empty()) {
+    if (pool && pool->contains(flags.graph)) {
+      if (auto warm = pool->acquire(flags.graph)) {
+        return std::make_unique<GraphPlayer>(std::move(warm));
+      }
+    }
+    return std::make_unique<GraphPlayer>(loop, flags.graph);
+  }
+
+  if (!flags.fanout.empty()) {
+    return std::make_unique<FanOutPlayer>(
+        loop, flags.fanout,
+        FanOutPlayer::Options{.record = flags.record,
+                              .preview = flags.preview,
+                              .ws_uri = flags.wsUri});
+  }
+
   if (!flags.url.empty() && !flags.filename.empty()) {
-    return std::make_unique<WebToFilePlayer>(loop, flags.url, flags.filename);
+    unsigned segments = flags.segments > 0
+                            ? flags.segments
+                            : std::max(1u, std::thread::hardware_concurrency());
+    auto recording = recording_options(flags);
+    if (!recording) return nullptr;
+    return std::make_unique<WebToFilePlayer>(
+        loop, flags.url, flags.filename,
+        WebToFilePlayer::Options{
+            .segments = segments,
+            .force_transcode = flags.force_transcode,
+            .download = {.directory = flags.download_dir,
+                         .ring_buffer_bytes =
+                             guint64(flags.download_ring_mb) * 1024 * 1024},
+            .recording = *recording});
   }
 
   if (!flags.output.empty()) {
@@ -19,7 +123,9 @@ std::unique_ptr<BasePlayer> PlayerFactory::create(const Flags& flags,
   }
 
   if (!flags.wsUri.empty()) {
-    return std::make_unique<BaseRTCPlayer>(loop, flags.wsUri);
+    auto options = rtc_options(flags);
+    if (!options) return nullptr;
+    return std::make_unique<BaseRTCPlayer>(loop, flags.wsUri, *options);
   }
 
   return nullptr;
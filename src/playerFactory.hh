@@ -1,11 +1,20 @@
 #pragma once
 #include "basePlayer.hh"
 #include "flags.hh"
+#include "pipelinePool.hh"
 namespace vptyp {
 
 class PlayerFactory {
  public:
+  PlayerFactory() = default;
+  // --graph descriptions the pool has a template of, under the description
+  // itself, are handed out pre-rolled
+  explicit PlayerFactory(PipelinePool& pool);
+
   std::unique_ptr<BasePlayer> create(const Flags& flags, GMainLoop& loop);
+
+ protected:
+  PipelinePool* pool{nullptr};
 };
 
 }  // namespace vptyp
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "profiler.hh"
+
+#include <glog/logging.h>
+
+#include <format>
+#include <fstream>
+#include <utility>
+
+namespace vptyp {
+
+namespace {
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+size_t slot_of(GstClockTime pts) {
+  return (pts / GST_USECOND) % Profiler::ElementStats::kRing;
+}
+
+std::string histogram_json(const Histogram& histogram) {
+  auto s = histogram.snapshot();
+  return std::format(
+      R"({{"count":{},"mean":{:.0f},"min":{},"p50":{},"p90":{},"p99":{},"max":{}}})",
+      s.count, s.mean(), s.min, s.percentile(0.5), s.percentile(0.9),
+      s.percentile(0.99), s.max);
+}
+
+}  // namespace
+
+Profiler::Profiler(GstElement* pipeline, const Options& options)
+    : pipeline(pipeline),
+      options(options),
+      started(std::chrono::steady_clock::now()) {}
+
+Profiler::~Profiler() {
+  if (elementAddedId) g_signal_handler_disconnect(pipeline, elementAddedId);
+  std::lock_guard lock(guard);
+  for (auto& probe : probes) {
+    gst_pad_remove_probe(probe.pad, probe.id);
+    gst_object_unref(probe.pad);
+  }
+  for (auto& stats : elements) {
+    g_signal_handler_disconnect(stats.element, stats.padAddedId);
+    gst_object_unref(stats.element);
+  }
+}
+
+const Profiler::Options& Profiler::get_options() const { return options; }
+
+void Profiler::attach() {
+  GstIterator* it = gst_bin_iterate_recurse(GST_BIN(pipeline));
+  auto each = +[](const GValue* item, gpointer data) {
+    auto element = GST_ELEMENT(g_value_get_object(item));
+    static_cast<Profiler*>(data)->watch(element);
+  };
+  while (gst_iterator_foreach(it, each, this) == GST_ITERATOR_RESYNC) {
+    gst_iterator_resync(it);
+  }
+  gst_iterator_free(it);
+
+  elementAddedId =
+      g_signal_connect(pipeline, "deep-element-added",
+                       G_CALLBACK(&Profiler::element_added), this);
+  started = std::chrono::steady_clock::now();
+}
+
+void Profiler::watch(GstElement* element) {
+  // bins are covered through their children
+  if (GST_IS_BIN(element)) return;
+
+  std::lock_guard lock(guard);
+  for (auto& existing : elements) {
+    if (existing.element == element) return;  // resync
+  }
+  auto& stats = elements.emplace_back();
+  stats.name = GST_ELEMENT_NAME(element);
+  stats.element = GST_ELEMENT(gst_object_ref(element));
+
+  using Target = std::pair<Profiler*, ElementStats*>;
+  Target target{this, &stats};
+  auto probe = +[](GstElement*, GstPad* pad, gpointer data) {
+    auto [that, stats] = *static_cast<Target*>(data);
+    that->add_probe(pad, stats);
+    return gboolean(TRUE);
+  };
+  gst_element_foreach_pad(element, probe, &target);
+  stats.padAddedId = g_signal_connect(
+      element, "pad-added", G_CALLBACK(&Profiler::pad_added), this);
+}
+
+void Profiler::add_probe(GstPad* pad, ElementStats* stats) {
+  gulong id = gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+                                GST_PAD_IS_SINK(pad) ? sink_probe : src_probe,
+                                stats, nullptr);
+  if (id) probes.push_back({GST_PAD(gst_object_ref(pad)), id});
+}
+
+void Profiler::pad_added(GstElement* element, GstPad* pad, gpointer data) {
+  auto that = static_cast<Profiler*>(data);
+  std::lock_guard lock(that->guard);
+  for (auto& stats : that->elements) {
+    if (stats.element != element) continue;
+    that->add_probe(pad, &stats);
+    return;
+  }
+}
+
+void Profiler::element_added(GstBin* bin, GstBin* sub, GstElement* element,
+                             gpointer data) {
+  static_cast<Profiler*>(data)->watch(element);
+}
+
+GstPadProbeReturn Profiler::sink_probe(GstPad* pad, GstPadProbeInfo* info,
+                                       gpointer data) {
+  auto stats = static_cast<ElementStats*>(data);
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  uint64_t now = now_ns();
+
+  stats->buffers.fetch_add(1, std::memory_order_relaxed);
+  stats->bytes.fetch_add(gst_buffer_get_size(buffer),
+                         std::memory_order_relaxed);
+
+  GstClockTime pts = GST_BUFFER_PTS(buffer);
+  if (GST_CLOCK_TIME_IS_VALID(pts)) {
+    auto& slot = stats->arrivals[slot_of(pts)];
+    slot.time.store(now, std::memory_order_relaxed);
+    slot.pts.store(pts, std::memory_order_release);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn Profiler::src_probe(GstPad* pad, GstPadProbeInfo* info,
+                                      gpointer data) {
+  auto stats = static_cast<ElementStats*>(data);
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  uint64_t now = now_ns();
+
+  GstClockTime pts = GST_BUFFER_PTS(buffer);
+  if (GST_CLOCK_TIME_IS_VALID(pts)) {
+    auto& slot = stats->arrivals[slot_of(pts)];
+    if (slot.pts.load(std::memory_order_acquire) == pts) {
+      uint64_t time = slot.time.load(std::memory_order_relaxed);
+      if (now >= time) stats->proctime.record(now - time);
+    }
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+std::string Profiler::to_json() const {
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - started;
+
+  std::lock_guard lock(guard);
+  std::string json = std::format(R"({{"pipeline":"{}","elapsed_s":{:.3f},)",
+                                 GST_ELEMENT_NAME(pipeline), elapsed.count());
+  json += R"("elements":[)";
+  bool first{true};
+  for (auto& stats : elements) {
+    uint64_t buffers = stats.buffers.load(std::memory_order_relaxed);
+    json += std::format(
+        R"({}{{"name":"{}","buffers":{},"bytes":{},"rate":{:.2f},)"
+        R"("proctime_ns":{}}})",
+        first ? "" : ",", stats.name, buffers,
+        stats.bytes.load(std::memory_order_relaxed),
+        elapsed.count() > 0 ? buffers / elapsed.count() : 0.0,
+        histogram_json(stats.proctime));
+    first = false;
+  }
+  json += "]}";
+  return json;
+}
+
+void Profiler::dump() const {
+  auto json = to_json();
+  if (options.output.empty()) {
+    LOG(INFO) << "profile: " << json;
+    return;
+  }
+
+  std::ofstream out(options.output, std::ios::trunc);
+  if (!out) {
+    LOG(ERROR) << std::format("cannot write profile to {}", options.output);
+    return;
+  }
+  out << json << std::endl;
+}
+
+}  // namespace vptyp
@@ -0,0 +1,85 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "histogram.hh"
+
+namespace vptyp {
+
+// Buffer pad probes on every element of a pipeline. Per element it records
+// processing time (same PTS from arrival to departure, covers queues and
+// codec delay), buffer and byte counts. A peer gets a buffer within the push
+// of its upstream element, so the time between elements is not recorded.
+// Recording is lock-free, dumps are JSON.
+class Profiler {
+ public:
+  struct Options {
+    std::chrono::milliseconds interval{5000};  // 0 - dump only on demand
+    std::string output{};  // json file, empty - log it
+  };
+
+  struct ElementStats {
+    static constexpr size_t kRing = 64;
+    struct Arrival {
+      std::atomic<uint64_t> pts{GST_CLOCK_TIME_NONE};
+      std::atomic<uint64_t> time{0};
+    };
+
+    std::string name{};
+    GstElement* element{nullptr};  // owned ref
+    gulong padAddedId{0};
+    Histogram proctime{};
+    std::atomic<uint64_t> buffers{0};
+    std::atomic<uint64_t> bytes{0};
+    std::array<Arrival, kRing> arrivals{};  // by PTS, overwritten
+  };
+
+  Profiler(GstElement* pipeline, const Options& options);
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+  ~Profiler();
+
+  // probes every element currently in the pipeline and the ones added later
+  void attach();
+  std::string to_json() const;
+  void dump() const;
+
+  const Options& get_options() const;
+
+ protected:
+  struct Probe {
+    GstPad* pad{nullptr};  // owned ref
+    gulong id{0};
+  };
+
+  void watch(GstElement* element);
+  // under guard
+  void add_probe(GstPad* pad, ElementStats* stats);
+
+  static GstPadProbeReturn sink_probe(GstPad* pad, GstPadProbeInfo* info,
+                                      gpointer data);
+  static GstPadProbeReturn src_probe(GstPad* pad, GstPadProbeInfo* info,
+                                     gpointer data);
+  static void pad_added(GstElement* element, GstPad* pad, gpointer data);
+  static void element_added(GstBin* bin, GstBin* sub, GstElement* element,
+                            gpointer data);
+
+ protected:
+  GstElement* pipeline;  // non-owned
+  Options options;
+  std::chrono::steady_clock::time_point started;
+  mutable std::mutex guard;  // structure only, never on the buffer path
+  std::deque<ElementStats> elements;
+  // removed with the profiler, the probes point into elements
+  std::vector<Probe> probes;
+  gulong elementAddedId{0};
+};
+
+}  // namespace vptyp
@@ -0,0 +1,162 @@
+#include "recordingStage.hh"
+
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <unistd.h>
+
+#include <array>
+#include <filesystem>
+#include <format>
+
+namespace vptyp {
+
+namespace {
+
+constexpr std::array<std::pair<std::string_view, RecordingStage::Mode>, 3>
+    kModes{{{"single", RecordingStage::Mode::Single},
+            {"fragmented", RecordingStage::Mode::Fragmented},
+            {"segmented", RecordingStage::Mode::Segmented}}};
+
+constexpr std::array<std::pair<std::string_view, RecordingStage::Sync>, 3>
+    kSyncs{{{"none", RecordingStage::Sync::None},
+            {"segment", RecordingStage::Sync::Segment},
+            {"write", RecordingStage::Sync::Write}}};
+
+bool sync_file(const std::string& location) {
+  int fd = open(location.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  bool synced = fsync(fd) == 0;
+  close(fd);
+  return synced;
+}
+
+bool append_line(const std::string& location, const std::string& line,
+                 bool sync) {
+  int fd = open(location.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0) return false;
+  // a single write keeps the line whole for readers tailing the index
+  bool written = write(fd, line.data(), line.size()) == ssize_t(line.size());
+  if (sync) written = fsync(fd) == 0 && written;
+  close(fd);
+  return written;
+}
+
+}  // namespace
+
+std::optional<RecordingStage::Mode> RecordingStage::parse_mode(
+    std::string_view name) {
+  for (auto [key, mode] : kModes) {
+    if (key == name) return mode;
+  }
+  return std::nullopt;
+}
+
+std::optional<RecordingStage::Sync> RecordingStage::parse_sync(
+    std::string_view name) {
+  for (auto [key, sync] : kSyncs) {
+    if (key == name) return sync;
+  }
+  return std::nullopt;
+}
+
+std::string RecordingStage::segment_pattern(std::string_view path) {
+  std::filesystem::path location(path);
+  std::string extension = location.has_extension()
+                              ? location.extension().string()
+                              : std::string(".mp4");
+  location.replace_extension();
+  return std::format("{}-%05d{}", location.string(), extension);
+}
+
+RecordingStage::RecordingStage(std::string_view path)
+    : RecordingStage(path, Options{}) {}
+
+RecordingStage::RecordingStage(std::string_view path, const Options& options)
+    : path(path), options(options) {}
+
+PipelineGraph& RecordingStage::add_to(PipelineGraph& graph) const {
+  bool oSync = options.sync == Sync::Write;
+  if (options.mode != Mode::Segmented) {
+    graph.then("mp4mux", "muxer");
+    if (options.mode == Mode::Fragmented) {
+      // no moov to fix up at the end, so nothing is kept for it either
+      graph.set("fragment-duration", guint(options.fragment.count()))
+          .set("streamable", true);
+    }
+    graph.then(options.sink, "file-sink").set("location", path);
+    if (oSync) graph.set("o-sync", true);
+    return graph;
+  }
+
+  graph.then("splitmuxsink", "muxer")
+      .set("location", segment_pattern(path))
+      .set("muxer-factory", "mp4mux")
+      .set("max-size-time",
+           guint64(std::chrono::nanoseconds(options.segment_time).count()))
+      .set("max-size-bytes", options.segment_bytes)
+      .set("max-files", options.max_files);
+  if (options.sink != "filesink") graph.set("sink-factory", options.sink);
+  // encoders behind a time split cut a keyframe right at the boundary
+  if (options.segment_time.count() && !options.segment_bytes) {
+    graph.set("send-keyframe-requests", true);
+  }
+  if (oSync) graph.set("sink-properties", "properties,o-sync=true");
+  return graph;
+}
+
+void RecordingStage::attach(Pipeline& pipeline) {
+  auto muxerElement = pipeline.find("muxer");
+  if (!muxerElement) {
+    LOG(ERROR) << "recording stage is not part of the pipeline";
+    return;
+  }
+  muxer = muxerElement->raw();
+  if (options.mode != Mode::Segmented) {
+    if (!options.index.empty() || options.sync == Sync::Segment) {
+      LOG(WARNING) << std::format("{}: index and segment syncs need "
+                                  "segmented recording",
+                                  path);
+    }
+    return;
+  }
+  pipeline.subscribe(GST_MESSAGE_ELEMENT,
+                     [this](GstMessage* msg) { on_message(msg); });
+}
+
+size_t RecordingStage::segments() const { return closed.load(); }
+
+void RecordingStage::on_message(GstMessage* msg) {
+  if (GST_MESSAGE_SRC(msg) != GST_OBJECT(muxer)) return;
+  const GstStructure* structure = gst_message_get_structure(msg);
+  if (!structure) return;
+  if (gst_structure_has_name(structure, "splitmuxsink-fragment-opened")) {
+    gst_structure_get_uint64(structure, "running-time", &opened_at);
+  } else if (gst_structure_has_name(structure,
+                                    "splitmuxsink-fragment-closed")) {
+    on_segment_closed(structure);
+  }
+}
+
+void RecordingStage::on_segment_closed(const GstStructure* structure) {
+  const gchar* location = gst_structure_get_string(structure, "location");
+  GstClockTime end{opened_at};
+  gst_structure_get_uint64(structure, "running-time", &end);
+  if (!location) return;
+  ++closed;
+
+  bool sync = options.sync == Sync::Segment;
+  // the file is on disk before the index points anyone at it
+  if (sync && !sync_file(location)) {
+    LOG(ERROR) << std::format("cannot sync segment {}", location);
+  }
+  LOG(INFO) << std::format("segment {} closed, {}ms", location,
+                           (end - opened_at) / GST_MSECOND);
+  if (options.index.empty()) return;
+  std::string line = std::format("{}\t{}\t{}\n", location,
+                                 opened_at / GST_MSECOND, end / GST_MSECOND);
+  if (!append_line(options.index, line, sync)) {
+    LOG(ERROR) << std::format("cannot append to index {}", options.index);
+  }
+}
+
+}  // namespace vptyp
@@ -0,0 +1,72 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "pipeline.hh"
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+// Muxes an encoded video stream into mp4 files. Single writes one file whose
+// index stays in memory until EOS. Fragmented writes moof fragments that are
+// playable as soon as they are on disk, and segmented rotates complete files
+// through splitmuxsink; both keep muxer memory flat for captures running
+// for days.
+class RecordingStage {
+ public:
+  enum class Mode { Single, Fragmented, Segmented };
+  // Segment syncs every closed segment and the index to disk (segmented
+  // mode), Write opens the output O_SYNC so every write survives a crash
+  enum class Sync { None, Segment, Write };
+
+  struct Options {
+    Mode mode{Mode::Single};
+    std::chrono::milliseconds fragment{1000};  // fragmented mode
+    std::chrono::seconds segment_time{60};  // segmented, 0 - by size only
+    guint64 segment_bytes{0};  // segmented, 0 - by time only
+    guint max_files{0};  // segmented, oldest files reused, 0 - keep all
+    Sync sync{Sync::None};
+    // segmented: "<location>\t<start ms>\t<end ms>" per closed segment,
+    // appended once the file is complete; empty - no index
+    std::string index{};
+    // factory writing the files: "filesink" or "gstppasyncfilesink" for
+    // large batched writes off the streaming thread
+    std::string sink{"filesink"};
+  };
+
+  static std::optional<Mode> parse_mode(std::string_view name);
+  static std::optional<Sync> parse_sync(std::string_view name);
+  // splitmuxsink location of the segments, "-%05d" before the extension
+  static std::string segment_pattern(std::string_view path);
+
+  explicit RecordingStage(std::string_view path);
+  RecordingStage(std::string_view path, const Options& options);
+
+  // adds "muxer" ! "file-sink" (a sink of the configured factory), or a
+  // splitmuxsink "muxer" writing through one in segmented mode, behind the
+  // current node of the graph
+  PipelineGraph& add_to(PipelineGraph& graph) const;
+  // follows closed segments for the index and the sync policy; call after
+  // the graph was built. Syncs run on the bus thread, the worker bus
+  // dispatch keeps them off the loop
+  void attach(Pipeline& pipeline);
+  size_t segments() const;  // closed so far
+
+ protected:
+  void on_message(GstMessage* msg);
+  void on_segment_closed(const GstStructure* structure);
+
+ protected:
+  std::string path;
+  Options options;
+  GstElement* muxer{nullptr};  // non-owned
+  GstClockTime opened_at{0};  // running time, bus thread only
+  std::atomic<size_t> closed{0};
+};
+
+}  // namespace vptyp
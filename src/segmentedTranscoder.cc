@@ -0,0 +1,272 @@
+#include "segmentedTranscoder.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <thread>
+
+#include "mediaProbe.hh"
+#include "pipeline.hh"
+#include "pipelineGraph.hh"
+#include "pipelineManager.hh"
+
+namespace vptyp {
+
+namespace {
+
+using clock = std::chrono::steady_clock;
+constexpr std::chrono::seconds kPrerollTimeout{30};
+
+std::chrono::milliseconds since(clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() -
+                                                               start);
+}
+
+// polls so a cancel does not wait for the whole timeout
+bool wait_all(PipelineManager& manager, std::chrono::seconds timeout,
+              const std::atomic<bool>& cancelled) {
+  auto deadline = clock::now() + timeout;
+  while (!manager.wait_finished(std::chrono::milliseconds(200))) {
+    if (cancelled || clock::now() > deadline) return false;
+  }
+  return manager.status().failed == 0;
+}
+
+GstPadProbeReturn segment_start_probe(GstPad* pad, GstPadProbeInfo* info,
+                                      gpointer data) {
+  GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+  if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT) {
+    const GstSegment* segment{nullptr};
+    gst_event_parse_segment(event, &segment);
+    static_cast<std::atomic<GstClockTime>*>(data)->store(segment->start);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+}  // namespace
+
+SegmentedTranscoder::SegmentedTranscoder(std::string_view location,
+                                         std::string_view output,
+                                         const Options& options)
+    : location(location), output(output), options(options) {}
+
+void SegmentedTranscoder::cancel() { cancelled = true; }
+
+SegmentedTranscoder::Result SegmentedTranscoder::run() {
+  Result result;
+  unsigned segments = options.segments
+                          ? options.segments
+                          : std::max(1u, std::thread::hardware_concurrency());
+
+  auto started = clock::now();
+  result.boundaries = find_boundaries(segments);
+  result.probe = since(started);
+  if (result.boundaries.empty() || cancelled) return result;
+
+  started = clock::now();
+  bool ok = transcode(result.boundaries);
+  result.transcode = since(started);
+
+  if (ok && !cancelled) {
+    started = clock::now();
+    ok = concat();
+    result.concat = since(started);
+  }
+
+  if (!options.keep_segments) {
+    std::error_code ignored;
+    for (auto& file : segmentFiles) std::filesystem::remove(file, ignored);
+  }
+  result.ok = ok && !cancelled;
+  LOG(INFO) << std::format(
+      "segmented transcode {}: {} segments; probe {}ms, transcode {}ms, "
+      "concat {}ms",
+      result.ok ? "done" : "failed", result.boundaries.size(),
+      result.probe.count(), result.transcode.count(), result.concat.count());
+  return result;
+}
+
+std::vector<GstClockTime> SegmentedTranscoder::find_boundaries(
+    unsigned segments) {
+  // outlives the manager, the probe writes it from a streaming thread
+  std::atomic<GstClockTime> segmentStart{GST_CLOCK_TIME_NONE};
+  PipelineManager manager({.shards = 1, .pin_threads = false});
+
+  bool built{false};
+  Pipeline& probe = manager.add("segment-probe", [&](Pipeline& pipeline) {
+    PipelineGraph graph;
+    graph.add(source_factory(location), "source")
+        .set("location", location)
+        .then("qtdemux", "demuxer")
+        .then("h264parse", "parser")
+        .then("fakesink", "sink");
+    if (!graph.build(pipeline)) return;
+
+    auto pad = make_gst(
+        gst_element_get_static_pad(pipeline.find("sink")->raw(), "sink"));
+    gst_pad_add_probe(pad.get(), GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+                      segment_start_probe, &segmentStart, nullptr);
+    built = true;
+  });
+  if (!built || !probe.preroll(kPrerollTimeout)) {
+    LOG(ERROR) << std::format("cannot preroll {}", location);
+    return {};
+  }
+
+  auto duration = probe.duration();
+  if (!duration || *duration == 0) {
+    LOG(ERROR) << std::format("unknown duration of {}", location);
+    return {};
+  }
+
+  // a key unit seek moves the segment start back to the keyframe, which is
+  // exactly where a segment can be cut without re-decoding a GOP twice
+  std::vector<GstClockTime> boundaries{0};
+  for (unsigned i = 1; i < segments && !cancelled; ++i) {
+    GstClockTime target = *duration * i / segments;
+    segmentStart = GST_CLOCK_TIME_NONE;
+    if (!probe.seek(target, GST_CLOCK_TIME_NONE,
+                    GstSeekFlags(GST_SEEK_FLAG_KEY_UNIT |
+                                 GST_SEEK_FLAG_SNAP_BEFORE)) ||
+        !probe.preroll(kPrerollTimeout)) {
+      return {};
+    }
+    GstClockTime keyframe = segmentStart.load();
+    // GOPs longer than a split collapse neighbouring boundaries
+    if (!GST_CLOCK_TIME_IS_VALID(keyframe) || keyframe <= boundaries.back()) {
+      continue;
+    }
+    boundaries.push_back(keyframe);
+  }
+  LOG(INFO) << std::format("{}: {}ms in {} segments", location,
+                           *duration / GST_MSECOND, boundaries.size());
+  return boundaries;
+}
+
+bool SegmentedTranscoder::transcode(const std::vector<GstClockTime>& boundaries) {
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  unsigned count = boundaries.size();
+  // segments share the cores, x264 threads would oversubscribe them
+  unsigned threads = std::max(1u, cores / count);
+
+  seeks.clear();
+  segmentFiles.clear();
+  PipelineManager manager(
+      {.shards = std::min(count, cores), .pin_threads = false});
+
+  for (size_t i = 0; i < count; ++i) {
+    auto seek = std::make_unique<SegmentSeek>();
+    seek->start = boundaries[i];
+    seek->stop = i + 1 < count ? boundaries[i + 1] : GST_CLOCK_TIME_NONE;
+    segmentFiles.push_back(segment_path(i));
+
+    bool built{false};
+    manager.add(std::format("segment-{}", i), [&](Pipeline& pipeline) {
+      PipelineGraph graph;
+      graph.add(source_factory(location), "source")
+          .set("location", location)
+          .then("qtdemux", "demuxer")
+          .then("h264parse", "parser")
+          .then("avdec_h264", "decoder")
+          .then(options.converter, "converter")
+          .then("x264enc", "encoder")
+          .set("threads", threads)
+          .then("mp4mux", "muxer")
+          .then("filesink", "file-sink")
+          .set("location", segmentFiles.back());
+      if (!graph.build(pipeline)) return;
+
+      seek->pipeline = &pipeline;
+      auto pad = make_gst(
+          gst_element_get_static_pad(pipeline.find("parser")->raw(), "sink"));
+      gst_pad_add_probe(pad.get(),
+                        GstPadProbeType(GST_PAD_PROBE_TYPE_BUFFER |
+                                        GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+                        seek_probe, seek.get(), nullptr);
+      built = true;
+    });
+    if (!built) return false;
+    seeks.push_back(std::move(seek));
+  }
+
+  manager.play_all();
+  if (!wait_all(manager, options.timeout, cancelled)) {
+    LOG(ERROR) << std::format("segment transcode of {} failed", location);
+    return false;
+  }
+  return true;
+}
+
+GstPadProbeReturn SegmentedTranscoder::seek_probe(GstPad* pad,
+                                                  GstPadProbeInfo* info,
+                                                  gpointer data) {
+  auto seek = static_cast<SegmentSeek*>(data);
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) ==
+            GST_EVENT_FLUSH_STOP &&
+        seek->requested) {
+      seek->flushed = true;
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  // the first buffer proves the demuxer has its index, everything before the
+  // seek is dropped so decoder, encoder and muxer never see it
+  if (seek->flushed) return GST_PAD_PROBE_REMOVE;
+  if (!seek->requested.exchange(true)) {
+    gst_element_call_async(
+        seek->pipeline->raw(),
+        +[](GstElement*, gpointer data) {
+          auto seek = static_cast<SegmentSeek*>(data);
+          seek->pipeline->seek(seek->start, seek->stop, GST_SEEK_FLAG_ACCURATE);
+        },
+        seek, nullptr);
+  }
+  return GST_PAD_PROBE_DROP;
+}
+
+bool SegmentedTranscoder::concat() {
+  PipelineManager manager({.shards = 1, .pin_threads = false});
+
+  // identical encoder settings give identical codec data in every segment,
+  // so mp4mux accepts the caps concat forwards at each border
+  bool built{false};
+  manager.add("segment-concat", [&](Pipeline& pipeline) {
+    PipelineGraph graph;
+    graph.add("concat", "concat");
+    for (size_t i = 0; i < segmentFiles.size(); ++i) {
+      auto parser = std::format("parser-{}", i);
+      graph.add("filesrc", std::format("source-{}", i))
+          .set("location", segmentFiles[i])
+          .then("qtdemux", std::format("demuxer-{}", i))
+          .then("h264parse", parser)
+          .link(parser, "concat");
+    }
+    graph.from("concat")
+        .then("mp4mux", "muxer")
+        .then("filesink", "file-sink")
+        .set("location", output);
+    built = graph.build(pipeline);
+  });
+  if (!built) return false;
+
+  manager.play_all();
+  if (!wait_all(manager, options.timeout, cancelled)) {
+    LOG(ERROR) << std::format("concat into {} failed", output);
+    return false;
+  }
+  return true;
+}
+
+std::string SegmentedTranscoder::segment_path(size_t index) const {
+  std::filesystem::path target(output);
+  std::filesystem::path directory =
+      options.workdir.empty() ? target.parent_path()
+                              : std::filesystem::path(options.workdir);
+  auto name = std::format("{}.segment-{}.mp4", target.stem().string(), index);
+  return (directory / name).string();
+}
+
+}  // namespace vptyp
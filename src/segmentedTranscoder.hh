@@ -0,0 +1,71 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vptyp {
+
+class Pipeline;
+
+// Offline H.264 mp4 transcode split into keyframe aligned segments. Segments
+// are encoded by parallel pipelines on a PipelineManager and joined with
+// concat into one mp4, timestamps continue across segment borders.
+class SegmentedTranscoder {
+ public:
+  struct Options {
+    unsigned segments{0};  // 0 - one per hardware thread
+    std::string workdir{};  // segment files, empty - next to the output
+    std::chrono::seconds timeout{3600};
+    bool keep_segments{false};
+    std::string converter{"videoconvert"};  // colorspace element factory
+  };
+
+  struct Result {
+    bool ok{false};
+    std::vector<GstClockTime> boundaries{};  // segment starts, keyframes
+    std::chrono::milliseconds probe{0};
+    std::chrono::milliseconds transcode{0};
+    std::chrono::milliseconds concat{0};
+  };
+
+  // location is a local path or an http(s) url
+  SegmentedTranscoder(std::string_view location, std::string_view output,
+                      const Options& options);
+
+  // blocks until the output is written or something failed
+  Result run();
+  void cancel();
+
+ protected:
+  struct SegmentSeek {
+    Pipeline* pipeline{nullptr};  // non-owned
+    GstClockTime start{0};
+    GstClockTime stop{GST_CLOCK_TIME_NONE};
+    std::atomic<bool> requested{false};
+    std::atomic<bool> flushed{false};
+  };
+
+  // keyframe positions close to equal splits of the duration
+  std::vector<GstClockTime> find_boundaries(unsigned segments);
+  bool transcode(const std::vector<GstClockTime>& boundaries);
+  bool concat();
+  std::string segment_path(size_t index) const;
+
+  static GstPadProbeReturn seek_probe(GstPad* pad, GstPadProbeInfo* info,
+                                      gpointer data);
+
+ protected:
+  std::string location;
+  std::string output;
+  Options options;
+  std::vector<std::unique_ptr<SegmentSeek>> seeks;
+  std::vector<std::string> segmentFiles;
+  std::atomic<bool> cancelled{false};
+};
+
+}  // namespace vptyp
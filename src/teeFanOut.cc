@@ -0,0 +1,239 @@
+#include "teeFanOut.hh"
+
+#include <glog/logging.h>
+
+#include <algorithm>
+#include <format>
+
+namespace vptyp {
+
+TeeFanOut::TeeFanOut(Pipeline& pipeline, GMainLoop& loop,
+                     std::string_view tee)
+    : pipeline(pipeline), loop(loop) {
+  if (auto element = pipeline.find(tee)) {
+    this->tee = element->raw();
+  } else {
+    LOG(ERROR) << std::format("no tee {} to fan out from", tee);
+  }
+}
+
+TeeFanOut::~TeeFanOut() {
+  {
+    // waits for a probe or source that is using the fan out right now
+    std::lock_guard lock(lifetime->guard);
+    lifetime->alive = false;
+  }
+  // elements stay with the pipeline, only the pad references and the probes
+  // on them are ours
+  for (auto& branch : branches) {
+    if (branch.unlink_probe) {
+      gst_pad_remove_probe(branch.tee_pad, branch.unlink_probe);
+    }
+    for (size_t i = 0; i < branch.eos_probes.size(); ++i) {
+      gst_pad_remove_probe(branch.sinks[i], branch.eos_probes[i]);
+    }
+    release(branch);
+  }
+}
+
+void TeeFanOut::release(Branch& branch) {
+  if (branch.tee_pad) gst_object_unref(branch.tee_pad);
+  if (branch.head) gst_object_unref(branch.head);
+  for (auto pad : branch.sinks) gst_object_unref(pad);
+  branch.tee_pad = branch.head = nullptr;
+  branch.sinks.clear();
+}
+
+TeeFanOut::Branch* TeeFanOut::find_branch(std::string_view name) {
+  auto it = std::find_if(branches.begin(), branches.end(),
+                         [name](Branch& b) { return b.name == name; });
+  return it == branches.end() ? nullptr : &*it;
+}
+
+bool TeeFanOut::contains(std::string_view name) const {
+  std::lock_guard lock(branches_guard);
+  return std::any_of(branches.begin(), branches.end(),
+                     [name](const Branch& b) { return b.name == name; });
+}
+
+std::vector<std::string> TeeFanOut::names() const {
+  std::lock_guard lock(branches_guard);
+  std::vector<std::string> result;
+  for (auto& branch : branches) result.push_back(branch.name);
+  return result;
+}
+
+bool TeeFanOut::add(std::string_view name, PipelineGraph graph,
+                    bool finalize) {
+  if (!tee || graph.nodes().empty()) return false;
+  if (contains(name)) {
+    LOG(ERROR) << std::format("branch {} exists already", name);
+    return false;
+  }
+
+  Branch branch{.name = std::string(name), .finalize = finalize};
+  graph.prefix_aliases(name);
+  for (auto& node : graph.nodes()) branch.aliases.push_back(node.alias);
+  auto drop = [this, &branch]() {
+    for (auto& alias : branch.aliases) pipeline.remove_element(alias);
+    release(branch);
+    return false;
+  };
+  if (!graph.build(pipeline)) {
+    LOG(ERROR) << std::format("branch {} was not built", name);
+    return drop();
+  }
+
+  for (auto& alias : branch.aliases) {
+    GstElement* element = pipeline.find(alias)->raw();
+    if (GST_OBJECT_FLAG_IS_SET(element, GST_ELEMENT_FLAG_SINK)) {
+      if (auto pad = gst_element_get_static_pad(element, "sink")) {
+        branch.sinks.push_back(pad);
+      }
+    }
+  }
+  branch.head = gst_element_get_static_pad(
+      pipeline.find(branch.aliases.front())->raw(), "sink");
+  if (!branch.head) {
+    LOG(ERROR) << std::format("branch {} starts without a sink pad", name);
+    return drop();
+  }
+
+  // downstream first and linked last, so the tee never pushes into an
+  // element that is not running yet
+  for (auto it = branch.aliases.rbegin(); it != branch.aliases.rend(); ++it) {
+    gst_element_sync_state_with_parent(pipeline.find(*it)->raw());
+  }
+  branch.tee_pad = gst_element_request_pad_simple(tee, "src_%u");
+  if (!branch.tee_pad ||
+      GST_PAD_LINK_FAILED(gst_pad_link(branch.tee_pad, branch.head))) {
+    LOG(ERROR) << std::format("branch {} was not linked to the tee", name);
+    if (branch.tee_pad) gst_element_release_request_pad(tee, branch.tee_pad);
+    return drop();
+  }
+
+  LOG(INFO) << std::format("branch {} added on {}", name,
+                           GST_PAD_NAME(branch.tee_pad));
+  std::lock_guard lock(branches_guard);
+  branches.push_back(std::move(branch));
+  return true;
+}
+
+bool TeeFanOut::remove(std::string_view name) {
+  GstPad* teePad{nullptr};
+  {
+    std::lock_guard lock(branches_guard);
+    auto branch = find_branch(name);
+    if (!branch || branch->removing) return false;
+    branch->removing = true;
+    teePad = GST_PAD(gst_object_ref(branch->tee_pad));
+  }
+  // runs right away when nothing flows, otherwise between two buffers
+  gulong probe = gst_pad_add_probe(
+      teePad, GST_PAD_PROBE_TYPE_IDLE, unlink_call,
+      new Removal{this, std::string(name), lifetime}, free_removal);
+  gst_object_unref(teePad);
+  std::lock_guard lock(branches_guard);
+  // the probe may have run on a streaming thread already
+  auto branch = find_branch(name);
+  if (branch && !branch->unlinked) branch->unlink_probe = probe;
+  return true;
+}
+
+GstPadProbeReturn TeeFanOut::unlink_call(GstPad*, GstPadProbeInfo*,
+                                         gpointer data) {
+  auto removal = static_cast<Removal*>(data);
+  std::unique_lock alive(removal->lifetime->guard);
+  if (!removal->lifetime->alive) return GST_PAD_PROBE_REMOVE;
+  auto that = removal->fanout;
+
+  std::unique_lock lock(that->branches_guard);
+  auto branch = that->find_branch(removal->name);
+  if (!branch) return GST_PAD_PROBE_REMOVE;
+  branch->unlinked = true;
+  branch->unlink_probe = 0;
+  gst_pad_unlink(branch->tee_pad, branch->head);
+
+  // a flushing head belongs to a stopped branch, nothing to drain
+  if (!branch->finalize || GST_PAD_IS_FLUSHING(branch->head) ||
+      branch->sinks.empty()) {
+    lock.unlock();
+    that->schedule_detach(*removal);
+    return GST_PAD_PROBE_REMOVE;
+  }
+  that->watch_sinks(*branch, *removal);
+  auto head = GST_PAD(gst_object_ref(branch->head));
+  // the EOS reaches eos_call on this thread, nothing of the fan out is
+  // touched after it
+  lock.unlock();
+  alive.unlock();
+  gst_pad_send_event(head, gst_event_new_eos());
+  gst_object_unref(head);
+  return GST_PAD_PROBE_REMOVE;
+}
+
+void TeeFanOut::watch_sinks(Branch& branch, const Removal& removal) {
+  branch.pending_eos = branch.sinks.size();
+  for (auto pad : branch.sinks) {
+    branch.eos_probes.push_back(
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, eos_call,
+                          new Removal(removal), free_removal));
+  }
+}
+
+GstPadProbeReturn TeeFanOut::eos_call(GstPad*, GstPadProbeInfo* info,
+                                      gpointer data) {
+  if (GST_EVENT_TYPE(GST_PAD_PROBE_INFO_EVENT(info)) != GST_EVENT_EOS) {
+    return GST_PAD_PROBE_OK;
+  }
+  auto removal = static_cast<Removal*>(data);
+  std::lock_guard alive(removal->lifetime->guard);
+  if (!removal->lifetime->alive) return GST_PAD_PROBE_OK;
+  auto that = removal->fanout;
+
+  std::unique_lock lock(that->branches_guard);
+  auto branch = that->find_branch(removal->name);
+  if (branch && branch->pending_eos && --branch->pending_eos == 0) {
+    lock.unlock();
+    that->schedule_detach(*removal);
+  }
+  // the muxer already finished the file, the pipeline must not count the
+  // branch EOS as its own
+  return GST_PAD_PROBE_DROP;
+}
+
+void TeeFanOut::schedule_detach(const Removal& removal) {
+  GSource* idle = g_idle_source_new();
+  g_source_set_callback(idle, detach_call, new Removal(removal), free_removal);
+  g_source_attach(idle, g_main_loop_get_context(&loop));
+  g_source_unref(idle);
+}
+
+gboolean TeeFanOut::detach_call(gpointer data) {
+  auto removal = static_cast<Removal*>(data);
+  std::lock_guard alive(removal->lifetime->guard);
+  if (removal->lifetime->alive) removal->fanout->detach(removal->name);
+  return G_SOURCE_REMOVE;
+}
+
+void TeeFanOut::free_removal(gpointer data) {
+  delete static_cast<Removal*>(data);
+}
+
+void TeeFanOut::detach(std::string_view name) {
+  Branch branch;
+  {
+    std::lock_guard lock(branches_guard);
+    auto it = std::find_if(branches.begin(), branches.end(),
+                           [name](Branch& b) { return b.name == name; });
+    if (it == branches.end()) return;
+    branch = std::move(*it);
+    branches.erase(it);
+  }
+  gst_element_release_request_pad(tee, branch.tee_pad);
+  release(branch);
+  for (auto& alias : branch.aliases) pipeline.remove_element(alias);
+  LOG(INFO) << std::format("branch {} removed", name);
+}
+
+}  // namespace vptyp
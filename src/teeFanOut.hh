@@ -0,0 +1,88 @@
+#pragma once
+#include <gst/gst.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "pipeline.hh"
+#include "pipelineGraph.hh"
+
+namespace vptyp {
+
+// Manages the branches behind a tee of a pipeline. Branches are graphs built
+// into the pipeline and linked to their own tee request pad; they can be
+// added and removed while the pipeline plays, the other branches keep
+// flowing. Removal blocks the tee pad only until it is idle, unlinks the
+// branch and then drops its elements from the loop.
+class TeeFanOut {
+ public:
+  // the tee has to be an element of the pipeline already
+  TeeFanOut(Pipeline& pipeline, GMainLoop& loop, std::string_view tee);
+  TeeFanOut(const TeeFanOut&) = delete;
+  TeeFanOut& operator=(const TeeFanOut&) = delete;
+  ~TeeFanOut();
+
+  // builds the graph with aliases prefixed by the branch name and links its
+  // first node to a new tee pad; finalize branches (muxers, files) get an
+  // EOS on removal and are dropped once all their sinks saw it
+  bool add(std::string_view name, PipelineGraph graph, bool finalize = false);
+  // starts detaching, the branch is gone once its elements were removed
+  bool remove(std::string_view name);
+  bool contains(std::string_view name) const;
+  std::vector<std::string> names() const;
+
+ protected:
+  struct Branch {
+    std::string name;
+    std::vector<std::string> aliases;  // in graph order, head first
+    GstPad* tee_pad{nullptr};  // owned ref of the request pad
+    GstPad* head{nullptr};  // owned ref of the first sink pad
+    std::vector<GstPad*> sinks{};  // owned refs of sink element pads
+    bool finalize{false};
+    bool removing{false};
+    bool unlinked{false};
+    gulong unlink_probe{0};  // idle probe on tee_pad until it ran
+    std::vector<gulong> eos_probes{};  // on sinks, in the same order
+    size_t pending_eos{0};  // sinks yet to see the EOS
+  };
+
+  // outlives the fan out in the probes and sources still pending
+  struct Lifetime {
+    std::mutex guard;  // held while a callback works on the fan out
+    std::atomic<bool> alive{true};
+  };
+
+  // context of the probes and sources of one removal
+  struct Removal {
+    TeeFanOut* fanout;
+    std::string name;
+    std::shared_ptr<Lifetime> lifetime;
+  };
+
+  Branch* find_branch(std::string_view name);
+  static GstPadProbeReturn unlink_call(GstPad* pad, GstPadProbeInfo* info,
+                                       gpointer data);
+  static GstPadProbeReturn eos_call(GstPad* pad, GstPadProbeInfo* info,
+                                    gpointer data);
+  static gboolean detach_call(gpointer data);
+  static void free_removal(gpointer data);
+  void schedule_detach(const Removal& removal);
+  // waits for EOS on every sink element of the branch
+  void watch_sinks(Branch& branch, const Removal& removal);
+  static void release(Branch& branch);
+  void detach(std::string_view name);
+
+ protected:
+  Pipeline& pipeline;
+  GMainLoop& loop;
+  GstElement* tee{nullptr};  // non-owned
+  mutable std::mutex branches_guard;
+  std::vector<Branch> branches;
+  std::shared_ptr<Lifetime> lifetime{std::make_shared<Lifetime>()};
+};
+
+}  // namespace vptyp
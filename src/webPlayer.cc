@@ -1,58 +1,152 @@
 #include "webPlayer.hh"
 
+#include <glog/logging.h>
 #include <gst/gst.h>
 
-#include "element.hh"
+#include <format>
+
+#include "mediaProbe.hh"
+#include "pipelineGraph.hh"
 
 namespace vptyp {
+
+namespace {
+constexpr std::chrono::seconds kProbeTimeout{10};
+}  // namespace
+
 WebToFilePlayer::WebToFilePlayer(GMainLoop& loop, std::string_view url,
                                  std::string_view output_file)
+    : WebToFilePlayer(loop, url, output_file, Options{}) {}
+
+WebToFilePlayer::WebToFilePlayer(GMainLoop& loop, std::string_view url,
+                                 std::string_view output_file,
+                                 const Options& options)
     : BasePlayer(),
       url(url),
       output_file(output_file),
       loop(loop),
-      pipeline(loop, "web-to-file-player") {}
+      download(url, options.download),
+      recording(output_file, options.recording),
+      pipeline(loop, "web-to-file-player"),
+      options(options) {}
 
-void WebToFilePlayer::play() { pipeline.play(); }
-void WebToFilePlayer::stop() { pipeline.stop(); }
+WebToFilePlayer::~WebToFilePlayer() { stop(); }
 
-void WebToFilePlayer::create() {
-  Element src = Element("souphttpsrc", "web-source");
-  src.object_set("location", url.data());
-  pipeline.add_element(src);
+void WebToFilePlayer::play() {
+  if (!transcoder) {
+    pipeline.play();
+    return;
+  }
+  if (worker.joinable()) {
+    LOG(WARNING) << std::format("transcode of {} runs already", url);
+    return;
+  }
+  worker = std::thread([this]() {
+    auto result = transcoder->run();
+    if (!result.ok) LOG(ERROR) << std::format("transcode of {} failed", url);
+    // the loop may not run yet and g_main_loop_run would reset a direct
+    // quit; an attached source is dispatched once it runs
+    GSource* quit = g_idle_source_new();
+    g_source_set_callback(
+        quit,
+        +[](gpointer data) {
+          g_main_loop_quit(static_cast<GMainLoop*>(data));
+          return gboolean(G_SOURCE_REMOVE);
+        },
+        &loop, nullptr);
+    g_source_attach(quit, g_main_loop_get_context(&loop));
+    g_source_unref(quit);
+  });
+}
+
+void WebToFilePlayer::stop() {
+  if (transcoder) transcoder->cancel();
+  if (worker.joinable()) worker.join();
+  pipeline.stop();
+}
 
-  auto demux = Element("qtdemux", "demuxer");
-  pipeline.add_element(demux);
+bool WebToFilePlayer::drain(std::chrono::milliseconds timeout) {
+  return !transcoder && pipeline.drain(timeout);
+}
 
-  auto parse = Element("h264parse", "h264parse");
-  pipeline.add_element(parse);
+bool WebToFilePlayer::restart() {
+  return !transcoder && pipeline.restart();
+}
 
-  auto decoder = Element("avdec_h264", "decoder");
-  pipeline.add_element(decoder);
+bool WebToFilePlayer::set_bitrate(guint bps) {
+  if (transcoder || !pipeline.find("encoder")) {
+    LOG(ERROR) << std::format("{} is not transcoded in one pipeline", url);
+    return false;
+  }
+  return pipeline.set_bitrate("encoder", bps);
+}
 
-  auto converter = Element("videoconvert", "converter");
-  pipeline.add_element(converter);
+void WebToFilePlayer::create() {
+  if (!options.force_transcode && can_remux()) {
+    create_remux();
+    return;
+  }
+  if (options.segments > 1) {
+    transcoder = std::make_unique<SegmentedTranscoder>(
+        url, output_file,
+        SegmentedTranscoder::Options{.segments = options.segments,
+                                     .converter = std::string(converter())});
+    return;
+  }
+  create_transcode();
+}
 
-  auto encoder = Element("x264enc", "encoder");
-  pipeline.add_element(encoder);
+bool WebToFilePlayer::can_remux() const {
+  auto info = probe_media(url, kProbeTimeout);
+  auto video = info ? info->video() : std::nullopt;
+  if (!video) {
+    LOG(WARNING) << std::format("no video caps probed from {}, transcoding",
+                                url);
+    return false;
+  }
+  bool compatible = caps_compatible(*video, kRemuxTarget);
+  LOG(INFO) << std::format("{} input {}: {}",
+                           compatible ? "remuxing" : "transcoding", url,
+                           *video);
+  return compatible;
+}
 
-  auto muxer = Element("mp4mux", "muxer");
-  pipeline.add_element(muxer);
+void WebToFilePlayer::create_remux() {
+  PipelineGraph graph;
+  download.add_to(graph)
+      .then("qtdemux", "demuxer")
+      .then("h264parse", "h264parse");
+  recording.add_to(graph);
 
-  Element sink = Element("filesink", "file-sink");
-  sink.object_set("location", output_file.data());
-  pipeline.add_element(sink);
+  if (!graph.build(pipeline)) {
+    LOG(ERROR) << "Linkage failed";
+    return;
+  }
+  download.attach(pipeline);
+  recording.attach(pipeline);
+  pipeline.insert_queues({.mode = Pipeline::QueuePolicy::Mode::Throughput});
+  instrument(pipeline);
+}
 
-  std::list<Element> elements;
-  elements.push_back(std::move(demux));
-  elements.push_back(std::move(parse));
-  elements.push_back(std::move(decoder));
-  elements.push_back(std::move(converter));
-  elements.push_back(std::move(encoder));
-  elements.push_back(std::move(muxer));
-  elements.push_back(std::move(sink));
+void WebToFilePlayer::create_transcode() {
+  PipelineGraph graph;
+  download.add_to(graph)
+      .then("qtdemux", "demuxer")
+      .then("h264parse", "h264parse")
+      .then("avdec_h264", "decoder")
+      .then(converter(), "converter")
+      .then("x264enc", "encoder");
+  recording.add_to(graph);
 
-  src.link(elements.begin(), elements.end());
+  if (!graph.build(pipeline)) {
+    LOG(ERROR) << "Linkage failed";
+    return;
+  }
+  download.attach(pipeline);
+  recording.attach(pipeline);
+  // offline transcode, favour throughput over latency
+  pipeline.insert_queues({.mode = Pipeline::QueuePolicy::Mode::Throughput});
+  instrument(pipeline);
 }
 
 }  // namespace vptyp
\ No newline at end of file
@@ -1,23 +1,62 @@
 #pragma once
 
+#include <memory>
+#include <thread>
+
 #include "basePlayer.hh"
+#include "downloadStage.hh"
 #include "pipeline.hh"
+#include "recordingStage.hh"
+#include "segmentedTranscoder.hh"
 
 namespace vptyp {
 class WebToFilePlayer : public BasePlayer {
  public:
+  struct Options {
+    unsigned segments{1};  // > 1 transcodes keyframe aligned parts in parallel
+    bool force_transcode{false};  // re-encode even when a remux would do
+    DownloadStage::Options download{};
+    // fragmented or segmented output for long captures; the parallel
+    // segmented transcode always writes a single file
+    RecordingStage::Options recording{};
+  };
+
+  // what mp4 input has to negotiate to, so it is stored without re-encoding
+  static constexpr std::string_view kRemuxTarget =
+      "video/x-h264, profile=(string){ constrained-baseline, baseline, main, "
+      "high }";
+
   WebToFilePlayer(GMainLoop& loop, std::string_view url,
                   std::string_view output_file);
-  ~WebToFilePlayer() override = default;
+  WebToFilePlayer(GMainLoop& loop, std::string_view url,
+                  std::string_view output_file, const Options& options);
+  ~WebToFilePlayer() override;
 
   void create() override;
   void play() override;
   void stop() override;
+  // a segmented transcode has no single pipeline to drain or restart
+  bool drain(std::chrono::milliseconds timeout) override;
+  bool restart() override;
+
+  // encoder bitrate in bit/s while transcoding in a single pipeline; a
+  // remux has no encoder, segments are encoded by their own pipelines
+  bool set_bitrate(guint bps);
+
+ protected:
+  bool can_remux() const;
+  void create_remux();
+  void create_transcode();
 
  protected:
   std::string url;
   std::string output_file;
   GMainLoop& loop;
+  DownloadStage download;  // observes the pipeline, so outlives it
+  RecordingStage recording;  // same
   Pipeline pipeline;
+  Options options;
+  std::unique_ptr<SegmentedTranscoder> transcoder{nullptr};
+  std::thread worker{};
 };
 }  // namespace vptyp
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include <asyncFileWriter.hh>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "logger.hh"
+
+class AsyncFileWriterTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    directory = std::filesystem::temp_directory_path() /
+                std::format("gstpp-writer-{}", getpid());
+    std::filesystem::create_directories(directory);
+  }
+  void TearDown() override { std::filesystem::remove_all(directory); }
+
+  // bytes that differ with the offset, so misplaced batches show
+  static std::string pattern(size_t size) {
+    std::string data(size, '\0');
+    for (size_t i = 0; i < size; ++i) data[i] = char(i * 31 + i / 4096);
+    return data;
+  }
+
+  // in chunks of muxer like, uneven sizes
+  static bool write_chunks(vptyp::AsyncFileWriter& writer,
+                           const std::string& data) {
+    size_t offset{0};
+    for (size_t i = 0; offset < data.size(); ++i) {
+      size_t chunk = std::min(data.size() - offset, 1000 + i * 37 % 9000);
+      if (!writer.write(reinterpret_cast<const uint8_t*>(data.data()) + offset,
+                        chunk)) {
+        return false;
+      }
+      offset += chunk;
+    }
+    return true;
+  }
+
+  static std::string read(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+
+ public:
+  std::filesystem::path directory;
+};
+
+TEST_F(AsyncFileWriterTest, EveryBackendWritesTheSameFile) {
+  auto data = pattern(3 * 1024 * 1024 + 123);
+  for (bool uring : {true, false}) {
+    for (bool direct : {false, true}) {
+      auto path = directory / std::format("out-{}-{}.bin", uring, direct);
+      auto writer = vptyp::AsyncFileWriter::open(
+          path.string(), {.batch_bytes = 64 * 1024,
+                          .depth = 2,
+                          .direct = direct,
+                          .uring = uring});
+      ASSERT_TRUE(writer) << path;
+      if (!uring) {
+        EXPECT_EQ(writer->backend(), vptyp::AsyncFileWriter::Backend::Threads);
+      }
+      ASSERT_TRUE(write_chunks(*writer, data)) << path;
+      ASSERT_TRUE(writer->close()) << path;
+
+      auto stats = writer->stats();
+      EXPECT_EQ(stats.bytes, data.size()) << path;
+      EXPECT_EQ(stats.latency.count, stats.batches) << path;
+      EXPECT_GE(stats.batches, data.size() / (64 * 1024));
+      EXPECT_TRUE(read(path) == data) << path;
+    }
+  }
+}
+
+TEST_F(AsyncFileWriterTest, SeekRewritesWrittenBytes) {
+  auto path = directory / "rewrite.bin";
+  auto data = pattern(200 * 1024 + 7);
+  auto writer = vptyp::AsyncFileWriter::open(
+      path.string(), {.batch_bytes = 16 * 1024, .direct = true});
+  ASSERT_TRUE(writer);
+  ASSERT_TRUE(write_chunks(*writer, data));
+
+  // like mp4mux patching sizes into its header at the end
+  const std::string header = "moov";
+  ASSERT_TRUE(writer->seek(10));
+  EXPECT_EQ(writer->position(), 10u);
+  ASSERT_TRUE(writer->write(reinterpret_cast<const uint8_t*>(header.data()),
+                            header.size()));
+  ASSERT_TRUE(writer->seek(data.size()));
+  ASSERT_TRUE(writer->write(reinterpret_cast<const uint8_t*>(header.data()),
+                            header.size()));
+  ASSERT_TRUE(writer->close());
+
+  data.replace(10, header.size(), header);
+  data += header;
+  EXPECT_TRUE(read(path) == data);
+}
+
+TEST_F(AsyncFileWriterTest, MissingDirectoryFailsToOpen) {
+  EXPECT_FALSE(vptyp::AsyncFileWriter::open(
+      (directory / "missing" / "out.bin").string(), {}));
+}
@@ -0,0 +1,44 @@
+#include <baseRtcPlayer.hh>
+#include <gtest/gtest.h>
+
+using vptyp::BaseRTCPlayer;
+
+TEST(BaseRtcPlayerTest, ParsesLadder) {
+  auto ladder =
+      BaseRTCPlayer::parse_ladder("hd:1280x720@2500,sd:640x360@800");
+  ASSERT_TRUE(ladder);
+  ASSERT_EQ(ladder->size(), 2u);
+  EXPECT_EQ((*ladder)[0].name, "hd");
+  EXPECT_EQ((*ladder)[0].width, 1280);
+  EXPECT_EQ((*ladder)[0].height, 720);
+  EXPECT_EQ((*ladder)[0].bitrate, 2'500'000u);
+  EXPECT_EQ((*ladder)[1].name, "sd");
+  EXPECT_EQ((*ladder)[1].bitrate, 800'000u);
+
+  auto single = BaseRTCPlayer::parse_ladder("low:320x180@250");
+  ASSERT_TRUE(single);
+  EXPECT_EQ(single->size(), 1u);
+}
+
+TEST(BaseRtcPlayerTest, RefusesMalformedLadder) {
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder(""));
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("1280x720@2500"));  // no name
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder(":1280x720@2500"));
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("hd:1280x720"));  // no bitrate
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("hd:1280@2500"));
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("hd:0x720@2500"));
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("hd:1280x720@0"));
+  EXPECT_FALSE(BaseRTCPlayer::parse_ladder("hd:1280x720@2500,,sd:1x1@1"));
+}
+
+TEST(BaseRtcPlayerTest, ParsesCongestion) {
+  using Congestion = BaseRTCPlayer::Options::Congestion;
+  EXPECT_EQ(BaseRTCPlayer::parse_congestion("disabled"),
+            Congestion::Disabled);
+  EXPECT_EQ(BaseRTCPlayer::parse_congestion("homegrown"),
+            Congestion::Homegrown);
+  EXPECT_EQ(BaseRTCPlayer::parse_congestion("gcc"), Congestion::GoogleCC);
+  EXPECT_FALSE(BaseRTCPlayer::parse_congestion(""));
+  EXPECT_FALSE(BaseRTCPlayer::parse_congestion("GCC"));
+  EXPECT_FALSE(BaseRTCPlayer::parse_congestion("googlecc"));
+}
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <bufferPool.hh>
+#include <element.hh>
+#include <memory>
+#include <pipeline.hh>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class BufferPoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(BufferPoolTest, SizeClasses) {
+  EXPECT_EQ(vptyp::BufferPool::size_class(1), 4096u);
+  EXPECT_EQ(vptyp::BufferPool::size_class(4096), 4096u);
+  EXPECT_EQ(vptyp::BufferPool::size_class(8192), 8192u);
+  EXPECT_EQ(vptyp::BufferPool::size_class(8193), 10240u);
+  // 1080p I420 frame
+  gsize frame = 1920 * 1080 * 3 / 2;
+  EXPECT_GE(vptyp::BufferPool::size_class(frame), frame);
+  EXPECT_LE(vptyp::BufferPool::size_class(frame), frame + frame / 4);
+}
+
+TEST_F(BufferPoolTest, AcquireRecyclesAlignedBuffers) {
+  vptyp::BufferPool pool({.min_buffers = 2, .max_buffers = 0, .align = 64});
+
+  for (int i = 0; i < 8; ++i) {
+    GstBuffer* buffer = pool.acquire(1000);
+    ASSERT_NE(buffer, nullptr);
+    EXPECT_EQ(gst_buffer_get_size(buffer), 1000u);
+
+    GstMapInfo info;
+    ASSERT_TRUE(gst_buffer_map(buffer, &info, GST_MAP_WRITE));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(info.data) % 64, 0u);
+    gst_buffer_unmap(buffer, &info);
+    gst_buffer_unref(buffer);
+  }
+
+  auto stats = pool.stats();
+  EXPECT_EQ(stats.hits, 8u);
+  EXPECT_EQ(stats.misses, 0u);
+  EXPECT_EQ(stats.allocated, 2u);
+}
+
+TEST_F(BufferPoolTest, ElementUsesPool) {
+  vptyp::Pipeline pipeline(*loop, "pool-test");
+  vptyp::Element src("videotestsrc", "src");
+  src.object_set("num-buffers", 30);
+  vptyp::Element sink("fakesink", "sink");
+
+  auto pool = std::make_shared<vptyp::BufferPool>();
+  EXPECT_TRUE(src.use_buffer_pool(pool));
+
+  pipeline.add_element(src);
+  pipeline.add_element(sink);
+  EXPECT_TRUE(src.link(sink));
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+  auto stats = pool->stats();
+  EXPECT_EQ(stats.hits + stats.misses, 30u);
+  EXPECT_GT(stats.hits, stats.misses);
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mpscQueue.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <thread>
+#include <vector>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class BusDispatchTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  // id of the thread that ran the loop, default one on timeout
+  std::thread::id run(vptyp::Pipeline& pipeline) {
+    pipeline.play();
+    auto thread = vptyp::test::run_loop(loop);
+    pipeline.stop();
+    return thread.value_or(std::thread::id{});
+  }
+
+  static void post_ping(vptyp::Pipeline& pipeline, int sequence) {
+    gst_element_post_message(
+        pipeline.raw(),
+        gst_message_new_application(
+            GST_OBJECT(pipeline.raw()),
+            gst_structure_new("ping", "sequence", G_TYPE_INT, sequence,
+                              nullptr)));
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(BusDispatchTest, TypedHandlersSeeOnlyTheirTypes) {
+  vptyp::Pipeline pipeline(*loop, "bus-typed");
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc num-buffers=10 ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::atomic<int> finished{0}, states{0}, removed{0};
+  pipeline.subscribe(GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR),
+                     [&](GstMessage*) { ++finished; });
+  pipeline.subscribe(GST_MESSAGE_STATE_CHANGED, [&](GstMessage* msg) {
+    EXPECT_EQ(GST_MESSAGE_TYPE(msg), GST_MESSAGE_STATE_CHANGED);
+    ++states;
+  });
+  auto subscription =
+      pipeline.subscribe(GST_MESSAGE_ANY, [&](GstMessage*) { ++removed; });
+  pipeline.unsubscribe(subscription);
+
+  EXPECT_NE(run(pipeline), std::thread::id{});
+  EXPECT_EQ(finished, 1);
+  EXPECT_GT(states, 0);
+  EXPECT_EQ(removed, 0);
+}
+
+TEST_F(BusDispatchTest, WorkerHandlesMessagesOffTheLoop) {
+  vptyp::Pipeline pipeline(*loop, "bus-worker");
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc is-live=true ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.dispatch_bus(vptyp::Pipeline::BusDispatch::Worker);
+
+  constexpr int kPosters = 4;
+  constexpr int kPings = 2000;
+  std::atomic<int> pings{0};
+  std::atomic<bool> ordered{true};
+  std::thread::id handler;
+  std::vector<int> last(kPosters, -1);
+  pipeline.subscribe(GST_MESSAGE_APPLICATION, [&](GstMessage* msg) {
+    handler = std::this_thread::get_id();
+    int sequence{0};
+    gst_structure_get_int(gst_message_get_structure(msg), "sequence",
+                          &sequence);
+    // one consumer keeps the order of every single poster
+    int& previous = last[sequence / kPings];
+    if (sequence % kPings <= previous) ordered = false;
+    previous = sequence % kPings;
+    if (++pings == kPosters * kPings) {
+      gst_element_post_message(pipeline.raw(),
+                               gst_message_new_eos(GST_OBJECT(pipeline.raw())));
+    }
+  });
+
+  std::vector<std::thread> posters;
+  for (int poster = 0; poster < kPosters; ++poster) {
+    posters.emplace_back([&pipeline, poster]() {
+      for (int i = 0; i < kPings; ++i) post_ping(pipeline, poster * kPings + i);
+    });
+  }
+  auto loopThread = run(pipeline);
+  for (auto& poster : posters) poster.join();
+
+  EXPECT_NE(loopThread, std::thread::id{});
+  EXPECT_EQ(pings, kPosters * kPings);
+  EXPECT_TRUE(ordered);
+  EXPECT_NE(handler, loopThread);
+  EXPECT_TRUE(pipeline.status().eos);
+}
+
+TEST(MpscQueueTest, DeliversEveryPushOnce) {
+  constexpr int kProducers = 4;
+  constexpr int kItems = 50000;
+  vptyp::MpscQueue<int> queue;
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < kProducers; ++producer) {
+    producers.emplace_back([&queue, producer]() {
+      for (int i = 0; i < kItems; ++i) queue.push(producer * kItems + i);
+    });
+  }
+
+  std::vector<int> last(kProducers, -1);
+  int received{0};
+  while (received < kProducers * kItems) {
+    uint64_t seen = queue.pushes();
+    while (auto item = queue.pop()) {
+      int& previous = last[*item / kItems];
+      EXPECT_EQ(*item % kItems, previous + 1);
+      previous = *item % kItems;
+      ++received;
+    }
+    if (received < kProducers * kItems) queue.wait(seen);
+  }
+  for (auto& producer : producers) producer.join();
+  EXPECT_FALSE(queue.pop());
+}
+
+TEST_F(BusDispatchTest, InvokeHandsWorkToTheLoop) {
+  vptyp::Pipeline pipeline(*loop, "bus-invoke");
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc num-buffers=10 ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.dispatch_bus(vptyp::Pipeline::BusDispatch::Worker);
+  pipeline.set_quit_on_finish(false);
+
+  std::thread::id handler, invoked;
+  pipeline.subscribe(GST_MESSAGE_EOS, [&](GstMessage*) {
+    handler = std::this_thread::get_id();
+    pipeline.invoke([&]() {
+      invoked = std::this_thread::get_id();
+      g_main_loop_quit(loop);
+    });
+  });
+  auto loopThread = run(pipeline);
+
+  EXPECT_NE(loopThread, std::thread::id{});
+  EXPECT_NE(handler, loopThread);
+  EXPECT_EQ(invoked, loopThread);
+}
+
+TEST_F(BusDispatchTest, HandlerUnsubscribesItself) {
+  vptyp::Pipeline pipeline(*loop, "bus-one-shot");
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc num-buffers=10 ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::atomic<int> states{0};
+  vptyp::Pipeline::Subscription subscription{0};
+  subscription = pipeline.subscribe(GST_MESSAGE_STATE_CHANGED,
+                                    [&](GstMessage*) {
+                                      ++states;
+                                      pipeline.unsubscribe(subscription);
+                                    });
+
+  EXPECT_NE(run(pipeline), std::thread::id{});
+  EXPECT_EQ(states, 1);
+}
+
+TEST_F(BusDispatchTest, SwitchKeepsPendingMessagesFirst) {
+  vptyp::Pipeline pipeline(*loop, "bus-switch");
+  auto graph =
+      vptyp::PipelineGraph::parse("videotestsrc num-buffers=10 ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::vector<int> sequences;
+  pipeline.subscribe(GST_MESSAGE_APPLICATION, [&](GstMessage* msg) {
+    int sequence{0};
+    gst_structure_get_int(gst_message_get_structure(msg), "sequence",
+                          &sequence);
+    sequences.push_back(sequence);
+  });
+  for (int i = 0; i < 10; ++i) post_ping(pipeline, i);
+  pipeline.dispatch_bus(vptyp::Pipeline::BusDispatch::Worker);
+  for (int i = 10; i < 20; ++i) post_ping(pipeline, i);
+
+  EXPECT_NE(run(pipeline), std::thread::id{});
+  ASSERT_EQ(sequences.size(), 20u);
+  for (int i = 0; i < 20; ++i) EXPECT_EQ(sequences[i], i);
+}
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <colorKernels.hh>
+#include <gstppPlugin.hh>
+#include <metrics.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <random>
+#include <vector>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+namespace {
+
+using vptyp::color::Image;
+using vptyp::color::Isa;
+using vptyp::color::PixelFormat;
+
+constexpr PixelFormat kFormats[] = {PixelFormat::NV12, PixelFormat::I420,
+                                    PixelFormat::RGBA, PixelFormat::BGRx};
+
+// an image with padded strides over its own storage
+struct TestImage {
+  TestImage(PixelFormat format, int width, int height) {
+    image = {.format = format, .width = width, .height = height};
+    int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+    switch (format) {
+      case PixelFormat::NV12:
+        add_plane(0, width + 3, height);
+        add_plane(1, 2 * chromaWidth + 5, chromaHeight);
+        break;
+      case PixelFormat::I420:
+        add_plane(0, width + 3, height);
+        add_plane(1, chromaWidth + 5, chromaHeight);
+        add_plane(2, chromaWidth + 7, chromaHeight);
+        break;
+      default:
+        add_plane(0, 4 * width + 4, height);
+    }
+  }
+
+  void add_plane(int index, int stride, int rows) {
+    storage[index].assign(size_t(stride) * rows, 0);
+    image.planes[index] = {.data = storage[index].data(), .stride = stride};
+  }
+
+  void randomize(std::mt19937& random) {
+    for (auto& plane : storage) {
+      for (auto& byte : plane) byte = uint8_t(random());
+    }
+  }
+
+  // bytes of a row that belong to the picture
+  std::vector<uint8_t> row(int plane, int y) const {
+    int chromaWidth = (image.width + 1) / 2;
+    int bytes = image.width;
+    if (image.format == PixelFormat::RGBA ||
+        image.format == PixelFormat::BGRx) {
+      bytes = 4 * image.width;
+    } else if (plane > 0) {
+      bytes = image.format == PixelFormat::NV12 ? 2 * chromaWidth
+                                                : chromaWidth;
+    }
+    auto begin =
+        storage[plane].begin() + ptrdiff_t(y) * image.planes[plane].stride;
+    return {begin, begin + bytes};
+  }
+
+  bool same_as(const TestImage& other) const {
+    for (int plane = 0; plane < 3; ++plane) {
+      if (storage[plane].empty()) continue;
+      int rows = plane ? (image.height + 1) / 2 : image.height;
+      for (int y = 0; y < rows; ++y) {
+        if (row(plane, y) != other.row(plane, y)) return false;
+      }
+    }
+    return true;
+  }
+
+  Image image;
+  std::vector<uint8_t> storage[3];
+};
+
+}  // namespace
+
+class ColorKernelsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(ColorKernelsTest, VectorPathsMatchScalar) {
+  std::mt19937 random(42);
+  vptyp::color::SlicePool pool(3);
+  // odd sizes exercise the scalar tails, 301 rows the slicing
+  std::pair<int, int> sizes[] = {{1, 1}, {37, 9}, {64, 64}, {101, 301}};
+
+  for (auto in : kFormats) {
+    for (auto out : kFormats) {
+      if (in == out) continue;
+      for (auto [width, height] : sizes) {
+        TestImage src(in, width, height);
+        src.randomize(random);
+        TestImage expected(out, width, height);
+        ASSERT_TRUE(vptyp::color::convert(src.image, expected.image,
+                                          Isa::Scalar));
+
+        for (auto isa : {Isa::SSE41, Isa::AVX2}) {
+          TestImage actual(out, width, height);
+          ASSERT_TRUE(vptyp::color::convert(src.image, actual.image, isa,
+                                            &pool));
+          EXPECT_TRUE(expected.same_as(actual))
+              << vptyp::color::format_name(in) << " to "
+              << vptyp::color::format_name(out) << " "
+              << vptyp::color::isa_name(isa) << " " << width << "x" << height;
+        }
+      }
+    }
+  }
+}
+
+TEST_F(ColorKernelsTest, KnownColors) {
+  TestImage nv12(PixelFormat::NV12, 32, 2);
+  for (int y = 0; y < 2; ++y) {
+    // white on the left half, black on the right, no chroma
+    std::fill_n(nv12.image.planes[0].data + y * nv12.image.planes[0].stride,
+                16, 235);
+    std::fill_n(
+        nv12.image.planes[0].data + y * nv12.image.planes[0].stride + 16, 16,
+        16);
+  }
+  std::fill_n(nv12.image.planes[1].data, 32, 128);
+
+  TestImage rgba(PixelFormat::RGBA, 32, 2);
+  ASSERT_TRUE(vptyp::color::convert(nv12.image, rgba.image,
+                                    vptyp::color::detect_isa()));
+  auto pixels = rgba.row(0, 1);
+  EXPECT_EQ(std::vector<uint8_t>(pixels.begin(), pixels.begin() + 4),
+            (std::vector<uint8_t>{255, 255, 255, 255}));
+  EXPECT_EQ(std::vector<uint8_t>(pixels.end() - 4, pixels.end()),
+            (std::vector<uint8_t>{0, 0, 0, 255}));
+
+  // and back, within a step of rounding
+  TestImage i420(PixelFormat::I420, 32, 2);
+  ASSERT_TRUE(vptyp::color::convert(rgba.image, i420.image,
+                                    vptyp::color::detect_isa()));
+  auto luma = i420.row(0, 0);
+  EXPECT_NEAR(luma.front(), 235, 1);
+  EXPECT_NEAR(luma.back(), 16, 1);
+  EXPECT_NEAR(i420.row(1, 0).front(), 128, 1);
+  EXPECT_NEAR(i420.row(2, 0).back(), 128, 1);
+
+  EXPECT_EQ(vptyp::color::find_kernel(PixelFormat::NV12, PixelFormat::NV12,
+                                      Isa::AVX2),
+            nullptr);
+}
+
+TEST_F(ColorKernelsTest, ElementConverts) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "gstppconvert");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=12 ! "
+      "video/x-raw,format=NV12,width=1280,height=720 ! "
+      "gstppconvert n-threads=4 ! video/x-raw,format=BGRx ! "
+      "gstppconvert ! video/x-raw,format=I420 ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.enable_metrics();
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(10)));
+
+  EXPECT_EQ(vptyp::MetricsRegistry::instance()
+                .counter("gstpp_pipeline_frames_total", "",
+                         {{"pipeline", "gstppconvert"}})
+                .value(),
+            12u);
+}
+
+TEST_F(ColorKernelsTest, ElementRefusesOtherColorimetry) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "gstppconvert-bt709");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=2 ! "
+      "video/x-raw,format=NV12,width=1280,height=720,colorimetry=bt709 ! "
+      "gstppconvert ! video/x-raw,format=BGRx ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(10)));
+  // BT.709 would come out with the BT.601 matrix, it is not negotiated
+  EXPECT_TRUE(pipeline.status().error);
+}
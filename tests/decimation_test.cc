@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <decimationController.hh>
+#include <gstDeleter.hh>
+#include <gstppPlugin.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <vector>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class DecimationTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  // collects pts of buffers reaching the sink pad of element
+  static void watch(vptyp::Element& element, std::vector<GstClockTime>& pts) {
+    auto pad =
+        vptyp::make_gst(gst_element_get_static_pad(element.raw(), "sink"));
+    gst_pad_add_probe(
+        pad.get(), GST_PAD_PROBE_TYPE_BUFFER,
+        +[](GstPad*, GstPadProbeInfo* info, gpointer data) {
+          static_cast<std::vector<GstClockTime>*>(data)->push_back(
+              GST_BUFFER_PTS(GST_PAD_PROBE_INFO_BUFFER(info)));
+          return GST_PAD_PROBE_OK;
+        },
+        &pts, nullptr);
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(DecimationTest, KeepsEveryNthRawFrame) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "decimate-raw");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=30 ! "
+      "video/x-raw,format=I420,width=160,height=120,framerate=30/1 ! "
+      "gstppdecimate name=decimate keep=3 ! fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::vector<GstClockTime> pts;
+  watch(*pipeline.find("sink"), pts);
+  EXPECT_TRUE(vptyp::test::run_pipeline(pipeline, loop));
+
+  ASSERT_EQ(pts.size(), 10u);
+  for (size_t i = 0; i < pts.size(); ++i) {
+    // timestamps pass untouched, the gaps stay visible downstream
+    EXPECT_EQ(pts[i], gst_util_uint64_scale(i * 3, GST_SECOND, 30));
+  }
+  auto decimate = pipeline.find("decimate");
+  EXPECT_EQ(decimate->object_get<guint64>("passed"), 10u);
+  EXPECT_EQ(decimate->object_get<guint64>("dropped"), 20u);
+}
+
+TEST_F(DecimationTest, KeepsWholeGopsOfEncodedStream) {
+  ASSERT_TRUE(vptyp::register_elements());
+  if (!gst_element_factory_find("x264enc")) GTEST_SKIP() << "no x264enc";
+  vptyp::Pipeline pipeline(*loop, "decimate-encoded");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=40 ! "
+      "video/x-raw,format=I420,width=160,height=120,framerate=30/1 ! "
+      "x264enc key-int-max=10 tune=zerolatency ! "
+      "gstppdecimate name=decimate keep=2 ! fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::vector<GstClockTime> pts;
+  watch(*pipeline.find("sink"), pts);
+  EXPECT_TRUE(vptyp::test::run_pipeline(pipeline, loop));
+
+  // the first and the third of four GOPs pass complete
+  ASSERT_EQ(pts.size(), 20u);
+  EXPECT_EQ(pts[10], gst_util_uint64_scale(20, GST_SECOND, 30));
+  EXPECT_EQ(pipeline.find("decimate")->object_get<guint64>("dropped"), 20u);
+}
+
+TEST_F(DecimationTest, ControllerReactsToPressure) {
+  vptyp::DecimationController controller(
+      *loop, {}, {.max_keep = 8, .calm_ticks = 2});
+  unsigned calm{0};
+  EXPECT_EQ(controller.next_keep(1, calm, {.fill = 0.9}), 2u);
+  EXPECT_EQ(controller.next_keep(2, calm, {.late = true}), 4u);
+  EXPECT_EQ(controller.next_keep(4, calm, {.fill = 1.0}), 8u);
+  EXPECT_EQ(controller.next_keep(8, calm, {.fill = 1.0}), 8u);
+  // between the watermarks nothing changes
+  EXPECT_EQ(controller.next_keep(8, calm, {.fill = 0.5}), 8u);
+  // a calm branch steps down once every calm_ticks ticks
+  EXPECT_EQ(controller.next_keep(8, calm, {}), 8u);
+  EXPECT_EQ(controller.next_keep(8, calm, {}), 7u);
+  EXPECT_EQ(controller.next_keep(7, calm, {}), 7u);
+  EXPECT_EQ(controller.next_keep(7, calm, {.late = true}), 8u);
+  calm = 0;
+  EXPECT_EQ(controller.next_keep(1, calm, {}), 1u);
+  EXPECT_EQ(controller.next_keep(1, calm, {}), 1u);
+}
+
+TEST_F(DecimationTest, SlowBranchIsDecimated) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "decimate-tee");
+  // the analytics branch needs 60 ms a frame, the source produces 30 fps
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=90 is-live=true ! "
+      "video/x-raw,format=I420,width=160,height=120,framerate=30/1 ! "
+      "tee name=split "
+      "split. ! queue ! fakesink name=display sync=true "
+      "split. ! queue name=analytics-queue max-size-buffers=8 ! "
+      "gstppdecimate name=decimate ! identity sleep-time=60000 ! "
+      "fakesink name=analytics sync=false");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  vptyp::DecimationController controller(
+      *loop,
+      {{.decimator = "decimate",
+        .queue = "analytics-queue",
+        .sink = "analytics"}},
+      {.interval = std::chrono::milliseconds(100)});
+  ASSERT_TRUE(controller.attach(pipeline));
+
+  std::vector<GstClockTime> display, analytics;
+  watch(*pipeline.find("display"), display);
+  watch(*pipeline.find("analytics"), analytics);
+  EXPECT_TRUE(vptyp::test::run_pipeline(pipeline, loop));
+
+  EXPECT_EQ(display.size(), 90u);
+  EXPECT_LT(analytics.size(), 90u);
+  // the ratio may have stepped down again once the queue drained
+  EXPECT_GT(pipeline.find("decimate")->object_get<guint64>("dropped"), 0u);
+}
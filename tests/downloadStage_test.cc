@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <downloadStage.hh>
+#include <metrics.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <pipelineManager.hh>
+#include <sstream>
+
+#include "httpServer.hh"
+#include "logger.hh"
+
+class DownloadStageTest : public ::testing::Test {
+ protected:
+  static constexpr uint64_t kFrames = 60;
+
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+
+    // mp4mux writes the moov atom at the end unless faststart is set
+    auto path = std::filesystem::temp_directory_path() / "gstpp-download.mp4";
+    vptyp::PipelineManager manager({.shards = 1, .pin_threads = false});
+    bool built{false};
+    manager.add("download-source", [&](vptyp::Pipeline& pipeline) {
+      auto graph = vptyp::PipelineGraph::parse(std::format(
+          "videotestsrc num-buffers={} ! "
+          "video/x-raw,width=320,height=240,framerate=30/1 ! x264enc ! "
+          "mp4mux ! filesink location={}",
+          kFrames, path.string()));
+      built = graph && graph->build(pipeline);
+    });
+    ASSERT_TRUE(built);
+    manager.play_all();
+    ASSERT_TRUE(manager.wait_finished(std::chrono::seconds(10)));
+
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    media = content.str();
+    std::filesystem::remove(path);
+  }
+
+  // downloads and demuxes the url, returns the number of demuxed frames
+  static uint64_t demux(std::string_view name, const std::string& url,
+                        vptyp::DownloadStage::Progress& progress) {
+    vptyp::DownloadStage stage(url);
+    vptyp::PipelineManager manager({.shards = 1, .pin_threads = false});
+    bool built{false};
+    auto& pipeline = manager.add(name, [&](vptyp::Pipeline& pipeline) {
+      vptyp::PipelineGraph graph;
+      stage.add_to(graph)
+          .then("qtdemux", "demuxer")
+          .then("h264parse", "parser")
+          .then("fakesink", "sink");
+      built = graph.build(pipeline);
+      if (!built) return;
+      stage.attach(pipeline);
+      pipeline.enable_metrics();
+    });
+    if (!built) return 0;
+
+    manager.play_all();
+    EXPECT_TRUE(manager.wait_finished(std::chrono::seconds(20)));
+    EXPECT_FALSE(pipeline.status().error);
+    progress = stage.progress();
+    manager.stop_all();
+    return vptyp::MetricsRegistry::instance()
+        .counter("gstpp_pipeline_frames_total", "",
+                 {{"pipeline", std::string(name)}})
+        .value();
+  }
+
+ public:
+  std::string media;
+};
+
+TEST_F(DownloadStageTest, FetchesTrailingMoovWithRanges) {
+  LocalHttpServer server(media);
+  vptyp::DownloadStage::Progress progress;
+  EXPECT_EQ(demux("download-moov", server.url(), progress), kFrames);
+  // qtdemux pulls the moov from the end before reading mdat
+  EXPECT_GT(server.range_requests(), 0u);
+  EXPECT_EQ(progress.total, media.size());
+  EXPECT_FALSE(progress.buffering);
+}
+
+TEST_F(DownloadStageTest, ResumesDroppedConnection) {
+  LocalHttpServer server(media, media.size() / 3);
+  vptyp::DownloadStage::Progress progress;
+  EXPECT_EQ(demux("download-resume", server.url(), progress), kFrames);
+  EXPECT_TRUE(server.dropped());
+  EXPECT_GT(server.requests(), 1u);
+}
@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <elementCatalog.hh>
+#include <gstppPlugin.hh>
+#include <string>
+
+#include "logger.hh"
+
+class ElementCatalogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+  }
+};
+
+static_assert(vptyp::has_property<"queue", "max-size-time">);
+static_assert(!vptyp::has_property<"queue", "use-buffering">);
+static_assert(std::is_same_v<vptyp::PropType<"queue2", "current-level-bytes">,
+                             guint64>);
+static_assert(std::is_same_v<vptyp::PropType<"x264enc", "bitrate">, guint>);
+
+TEST_F(ElementCatalogTest, TypedPropertiesRoundTrip) {
+  vptyp::Elem<"queue"> queue("queue");
+  ASSERT_TRUE(queue.is_initialised());
+  EXPECT_TRUE(queue.set<"max-size-buffers">(7u));
+  EXPECT_TRUE(queue.set<"max-size-time">(guint64(40 * GST_MSECOND)));
+  EXPECT_TRUE(queue.set<"leaky">("downstream"));
+  EXPECT_EQ(queue.get<"max-size-buffers">(), 7u);
+  EXPECT_EQ(queue.get<"max-size-time">(), 40 * GST_MSECOND);
+  EXPECT_EQ(queue.get<"leaky">(), "downstream");
+  // the generic path sees the same values
+  EXPECT_EQ(queue.object_get<guint>("max-size-buffers"), 7u);
+
+  EXPECT_FALSE(queue.set<"leaky">("sideways"));
+  EXPECT_EQ(queue.get<"leaky">(), "downstream");
+  // read only
+  EXPECT_FALSE(queue.set<"current-level-buffers">(3u));
+}
+
+TEST_F(ElementCatalogTest, OutOfRangeValueIsRejected) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Element decimate("gstppdecimate", "decimate");
+  ASSERT_TRUE(decimate.is_initialised());
+  using Decimate = vptyp::Props<"gstppdecimate">;
+  EXPECT_TRUE(Decimate::set<"keep">(decimate.raw(), 4u));
+  EXPECT_EQ(Decimate::get<"keep">(decimate.raw()), 4u);
+  EXPECT_FALSE(Decimate::set<"keep">(decimate.raw(), 0u));
+  EXPECT_EQ(Decimate::get<"keep">(decimate.raw()), 4u);
+  EXPECT_EQ(Decimate::get<"passed">(decimate.raw()), 0u);
+}
+
+TEST_F(ElementCatalogTest, SpecsCheckTheObjectType) {
+  vptyp::Elem<"queue"> queue("queue");
+  EXPECT_TRUE(queue.set<"max-size-buffers">(5u));
+  // the queue's cached spec never reaches another class' vfuncs
+  vptyp::Element sink("fakesink", "sink");
+  ASSERT_TRUE(sink.is_initialised());
+  EXPECT_EQ(vptyp::Props<"queue">::get<"max-size-buffers">(sink.raw()), 0u);
+  EXPECT_TRUE(vptyp::Props<"fakesink">::get<"sync">(sink.raw()));
+}
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <element.hh>
+#include <frameTap.hh>
+#include <mutex>
+#include <pipeline.hh>
+#include <set>
+#include <vector>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class FrameTapTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  static vptyp::Element make_source(int frames) {
+    vptyp::Element src("videotestsrc", "src");
+    src.object_set("num-buffers", frames);
+    return src;
+  }
+
+  static vptyp::Element make_caps() {
+    vptyp::Element filter("capsfilter", "caps");
+    GstCaps* caps = gst_caps_from_string(
+        "video/x-raw,format=GRAY8,width=64,height=48,framerate=30/1");
+    filter.object_set("caps", caps);
+    gst_caps_unref(caps);
+    return filter;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(FrameTapTest, PullsMappedFrames) {
+  vptyp::Pipeline pipeline(*loop, "tap-pull");
+  auto src = make_source(5);
+  auto caps = make_caps();
+  vptyp::FrameTap tap("tap");
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  pipeline.add_element(tap.sink());
+  EXPECT_TRUE(src.link(caps));
+  EXPECT_TRUE(caps.link(tap.sink()));
+
+  pipeline.play();
+  int frames{0};
+  while (auto frame = tap.pull(GST_SECOND)) {
+    EXPECT_TRUE(frame->is_mapped());
+    EXPECT_EQ(frame->size(), 64u * 48u);
+    ASSERT_NE(frame->video_info(), nullptr);
+    EXPECT_EQ(GST_VIDEO_INFO_WIDTH(frame->video_info()), 64);
+    ++frames;
+  }
+  pipeline.stop();
+
+  EXPECT_EQ(frames, 5);
+  EXPECT_EQ(tap.pulled(), 5u);
+}
+
+TEST_F(FrameTapTest, PushesBackWithoutCopy) {
+  vptyp::Pipeline pipeline(*loop, "tap-roundtrip");
+  auto src = make_source(10);
+  auto caps = make_caps();
+  vptyp::FrameTap tap("tap");
+  vptyp::Element sink("fakesink", "sink");
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  tap.attach(pipeline);
+  pipeline.add_element(sink);
+  EXPECT_TRUE(src.link(caps));
+  EXPECT_TRUE(caps.link(tap.sink()));
+  EXPECT_TRUE(tap.source().link(sink));
+
+  std::mutex guard;
+  std::set<GstBuffer*> pulled;
+  std::set<GstBuffer*> received;
+  tap.on_frame([&](vptyp::Frame& frame) {
+    {
+      std::lock_guard lock(guard);
+      pulled.insert(frame.buffer());
+    }
+    EXPECT_TRUE(tap.push(std::move(frame)));
+  });
+
+  GstPad* sinkPad = gst_element_get_static_pad(sink.raw(), "sink");
+  auto probe = +[](GstPad*, GstPadProbeInfo* info, gpointer data) {
+    auto ctx = static_cast<std::pair<std::mutex*, std::set<GstBuffer*>*>*>(data);
+    std::lock_guard lock(*ctx->first);
+    ctx->second->insert(GST_PAD_PROBE_INFO_BUFFER(info));
+    return GST_PAD_PROBE_OK;
+  };
+  std::pair<std::mutex*, std::set<GstBuffer*>*> ctx{&guard, &received};
+  gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_BUFFER, probe, &ctx, nullptr);
+  gst_object_unref(sinkPad);
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+  EXPECT_EQ(tap.pushed(), 10u);
+  // the very same buffers arrive downstream, nothing was copied on the way
+  EXPECT_EQ(pulled, received);
+}
+
+TEST_F(FrameTapTest, EmptyStreamStillEnds) {
+  vptyp::Pipeline pipeline(*loop, "tap-empty");
+  auto src = make_source(0);
+  auto caps = make_caps();
+  vptyp::FrameTap tap("tap", {.writable = true});
+  vptyp::Element sink("fakesink", "sink");
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  tap.attach(pipeline);
+  pipeline.add_element(sink);
+  EXPECT_TRUE(src.link(caps));
+  EXPECT_TRUE(caps.link(tap.sink()));
+  EXPECT_TRUE(tap.source().link(sink));
+  tap.on_frame([&](vptyp::Frame& frame) { tap.push(std::move(frame)); });
+
+  // the EOS went through the appsrc although nothing was pushed
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+  EXPECT_EQ(tap.pushed(), 0u);
+  EXPECT_TRUE(pipeline.status().eos);
+}
+
+TEST_F(FrameTapTest, ForwardsRenegotiatedCaps) {
+  vptyp::Pipeline pipeline(*loop, "tap-renegotiate");
+  auto src = make_source(30);
+  auto caps = make_caps();
+  vptyp::FrameTap tap("tap");
+  vptyp::Element sink("fakesink", "sink");
+
+  pipeline.add_element(src);
+  pipeline.add_element(caps);
+  tap.attach(pipeline);
+  pipeline.add_element(sink);
+  EXPECT_TRUE(src.link(caps));
+  EXPECT_TRUE(caps.link(tap.sink()));
+  EXPECT_TRUE(tap.source().link(sink));
+
+  GstElement* filter = caps.raw();
+  int frames{0};
+  tap.on_frame([&](vptyp::Frame& frame) {
+    if (++frames == 5) {
+      // upstream switches the resolution mid-stream
+      GstCaps* smaller = gst_caps_from_string(
+          "video/x-raw,format=GRAY8,width=32,height=24,framerate=30/1");
+      g_object_set(filter, "caps", smaller, nullptr);
+      gst_caps_unref(smaller);
+    }
+    tap.push(std::move(frame));
+  });
+
+  std::mutex guard;
+  std::vector<int> widths;
+  GstPad* sinkPad = gst_element_get_static_pad(sink.raw(), "sink");
+  auto probe = +[](GstPad*, GstPadProbeInfo* info, gpointer data) {
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) return GST_PAD_PROBE_OK;
+    GstCaps* eventCaps{nullptr};
+    gst_event_parse_caps(event, &eventCaps);
+    int width{0};
+    gst_structure_get_int(gst_caps_get_structure(eventCaps, 0), "width",
+                          &width);
+    auto ctx = static_cast<std::pair<std::mutex*, std::vector<int>*>*>(data);
+    std::lock_guard lock(*ctx->first);
+    ctx->second->push_back(width);
+    return GST_PAD_PROBE_OK;
+  };
+  std::pair<std::mutex*, std::vector<int>*> ctx{&guard, &widths};
+  gst_pad_add_probe(sinkPad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, probe, &ctx,
+                    nullptr);
+  gst_object_unref(sinkPad);
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+  ASSERT_FALSE(widths.empty());
+  EXPECT_EQ(widths.front(), 64);
+  EXPECT_EQ(widths.back(), 32);
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Local HTTP/1.1 stand-in serving one body with byte range support. It can
+// cut the first response short to simulate a dropped connection.
+class LocalHttpServer {
+ public:
+  explicit LocalHttpServer(std::string body, size_t drop_after = 0)
+      : body(std::move(body)), dropAfter(drop_after) {
+    server = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse{1};
+    setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+    socklen_t length = sizeof(address);
+    getsockname(server, reinterpret_cast<sockaddr*>(&address), &length);
+    serverPort = ntohs(address.sin_port);
+    listen(server, 16);
+    acceptor = std::thread([this]() { accept_loop(); });
+  }
+
+  ~LocalHttpServer() {
+    stopping = true;
+    acceptor.join();
+    std::lock_guard lock(guard);
+    for (auto& connection : connections) connection.join();
+    close(server);
+  }
+
+  std::string url(std::string_view path = "/media.mp4") const {
+    return std::format("http://127.0.0.1:{}{}", serverPort, path);
+  }
+  size_t requests() const { return requestCount; }
+  size_t range_requests() const { return rangeCount; }
+  bool dropped() const { return droppedOnce; }
+
+ private:
+  void accept_loop() {
+    while (!stopping) {
+      pollfd pending{.fd = server, .events = POLLIN, .revents = 0};
+      if (poll(&pending, 1, 100) <= 0) continue;
+      int client = accept(server, nullptr, nullptr);
+      if (client < 0) continue;
+      std::lock_guard lock(guard);
+      connections.emplace_back([this, client]() { serve(client); });
+    }
+  }
+
+  std::optional<std::string> read_request(int client) {
+    std::string request;
+    char chunk[1024];
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      pollfd readable{.fd = client, .events = POLLIN, .revents = 0};
+      if (stopping || poll(&readable, 1, 100) < 0) return std::nullopt;
+      if (!(readable.revents & POLLIN)) continue;
+      auto n = recv(client, chunk, sizeof(chunk), 0);
+      if (n <= 0) return std::nullopt;
+      request.append(chunk, n);
+    }
+    return request;
+  }
+
+  void send_all(int client, std::string_view data) {
+    while (!data.empty()) {
+      auto n = send(client, data.data(), data.size(), MSG_NOSIGNAL);
+      if (n <= 0) return;
+      data.remove_prefix(n);
+    }
+  }
+
+  // one request per connection, every response closes it
+  void serve(int client) {
+    auto request = read_request(client);
+    if (!request) {
+      close(client);
+      return;
+    }
+    ++requestCount;
+
+    size_t start{0}, end{body.size() - 1};
+    bool ranged{false};
+    auto range = request->find("Range: bytes=");
+    if (range != std::string::npos) {
+      ranged = true;
+      ++rangeCount;
+      auto spec = request->substr(range + 13);
+      start = std::stoull(spec);
+      auto dash = spec.find('-');
+      if (dash + 1 < spec.size() && std::isdigit(spec[dash + 1])) {
+        end = std::min<size_t>(std::stoull(spec.substr(dash + 1)), end);
+      }
+    }
+    if (start > end) {
+      send_all(client, std::format("HTTP/1.1 416 Range Not Satisfiable\r\n"
+                                   "Content-Range: bytes */{}\r\n"
+                                   "Connection: close\r\n\r\n",
+                                   body.size()));
+      close(client);
+      return;
+    }
+
+    std::string headers =
+        ranged ? std::format("HTTP/1.1 206 Partial Content\r\n"
+                             "Content-Range: bytes {}-{}/{}\r\n",
+                             start, end, body.size())
+               : std::string("HTTP/1.1 200 OK\r\n");
+    headers += std::format(
+        "Content-Length: {}\r\nAccept-Ranges: bytes\r\n"
+        "Content-Type: video/mp4\r\nConnection: close\r\n\r\n",
+        end - start + 1);
+    send_all(client, headers);
+
+    std::string_view payload(body.data() + start, end - start + 1);
+    if (request->starts_with("HEAD")) payload = {};
+    if (dropAfter && payload.size() > dropAfter &&
+        !droppedOnce.exchange(true)) {
+      payload = payload.substr(0, dropAfter);
+    }
+    send_all(client, payload);
+    shutdown(client, SHUT_RDWR);
+    close(client);
+  }
+
+ private:
+  std::string body;
+  size_t dropAfter{0};
+  int server{-1};
+  uint16_t serverPort{0};
+  std::atomic<bool> stopping{false};
+  std::atomic<bool> droppedOnce{false};
+  std::atomic<size_t> requestCount{0};
+  std::atomic<size_t> rangeCount{0};
+  std::mutex guard;
+  std::vector<std::thread> connections;
+  std::thread acceptor;
+};
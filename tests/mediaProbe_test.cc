@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <format>
+#include <mediaProbe.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <pipelineManager.hh>
+#include <webPlayer.hh>
+
+#include "logger.hh"
+
+class MediaProbeTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    input = (std::filesystem::temp_directory_path() / "gstpp-probe-input.mp4")
+                .string();
+
+    // 1s of H.264 at 30fps
+    vptyp::PipelineManager manager({.shards = 1, .pin_threads = false});
+    bool built{false};
+    manager.add("probe-source", [&](vptyp::Pipeline& pipeline) {
+      auto graph = vptyp::PipelineGraph::parse(std::format(
+          "videotestsrc num-buffers=30 ! "
+          "video/x-raw,width=320,height=240,framerate=30/1 ! x264enc ! "
+          "mp4mux ! filesink location={}",
+          input));
+      built = graph && graph->build(pipeline);
+    });
+    ASSERT_TRUE(built);
+    manager.play_all();
+    ASSERT_TRUE(manager.wait_finished(std::chrono::seconds(10)));
+  }
+  void TearDown() override { std::filesystem::remove(input); }
+
+ public:
+  std::string input;
+};
+
+TEST_F(MediaProbeTest, ExposesVideoCaps) {
+  auto info = vptyp::probe_media(input, std::chrono::seconds(5));
+  ASSERT_TRUE(info);
+  auto video = info->video();
+  ASSERT_TRUE(video);
+  EXPECT_TRUE(video->starts_with("video/x-h264")) << *video;
+  ASSERT_TRUE(GST_CLOCK_TIME_IS_VALID(info->duration));
+  EXPECT_NEAR(double(info->duration) / GST_SECOND, 1.0, 0.05);
+}
+
+TEST_F(MediaProbeTest, DecidesRemux) {
+  auto info = vptyp::probe_media(input, std::chrono::seconds(5));
+  ASSERT_TRUE(info && info->video());
+  EXPECT_TRUE(vptyp::caps_compatible(*info->video(),
+                                     vptyp::WebToFilePlayer::kRemuxTarget));
+  EXPECT_FALSE(vptyp::caps_compatible(*info->video(), "video/x-vp8"));
+  EXPECT_FALSE(vptyp::caps_compatible(
+      *info->video(), "video/x-h264, profile=(string)\"high-4:4:4\""));
+}
+
+TEST_F(MediaProbeTest, MissingFile) {
+  EXPECT_FALSE(vptyp::probe_media("/nonexistent/input.mp4",
+                                  std::chrono::milliseconds(500)));
+}
@@ -0,0 +1,111 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <metrics.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class MetricsTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(MetricsTest, Exposition) {
+  auto& registry = vptyp::MetricsRegistry::instance();
+  registry.counter("test_events_total", "events", {{"kind", "a"}}).inc(3);
+  registry.gauge("test_level", "level").set(1.5);
+  auto& histogram = registry.histogram("test_latency_ns", "latency");
+  histogram.record(3);
+  histogram.record(100);
+
+  auto text = registry.exposition();
+  EXPECT_NE(text.find("# TYPE test_events_total counter"), std::string::npos);
+  EXPECT_NE(text.find("test_events_total{kind=\"a\"} 3\n"), std::string::npos)
+      << text;
+  EXPECT_NE(text.find("test_level 1.5\n"), std::string::npos) << text;
+  EXPECT_NE(text.find("test_latency_ns_bucket{le=\"3\"} 1\n"),
+            std::string::npos)
+      << text;
+  EXPECT_NE(text.find("test_latency_ns_bucket{le=\"127\"} 2\n"),
+            std::string::npos)
+      << text;
+  EXPECT_NE(text.find("test_latency_ns_count 2\n"), std::string::npos);
+
+  // same name and labels resolve to the same series
+  EXPECT_EQ(&registry.counter("test_events_total", "", {{"kind", "a"}}),
+            &registry.counter("test_events_total", "", {{"kind", "a"}}));
+}
+
+TEST_F(MetricsTest, CountsPipelineFrames) {
+  vptyp::Pipeline pipeline(*loop, "metered");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=15 ! videoconvert ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.enable_metrics();
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+
+  auto& registry = vptyp::MetricsRegistry::instance();
+  EXPECT_EQ(registry
+                .counter("gstpp_pipeline_frames_total", "",
+                         {{"pipeline", "metered"}})
+                .value(),
+            15u);
+  EXPECT_GE(registry
+                .counter("gstpp_pipeline_state_changes_total", "",
+                         {{"pipeline", "metered"}})
+                .value(),
+            3u);
+  EXPECT_EQ(registry
+                .counter("gstpp_pipeline_bus_errors_total", "",
+                         {{"pipeline", "metered"}})
+                .value(),
+            0u);
+}
+
+TEST_F(MetricsTest, ServesHttp) {
+  constexpr uint16_t kPort = 19464;
+  auto& registry = vptyp::MetricsRegistry::instance();
+  registry.counter("test_served_total", "served").inc();
+  ASSERT_TRUE(registry.start_export({.port = kPort}));
+
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(kPort);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  ASSERT_EQ(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)),
+            0);
+  std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  send(fd, request.data(), request.size(), 0);
+
+  std::string response;
+  char chunk[4096];
+  for (ssize_t n; (n = recv(fd, chunk, sizeof(chunk), 0)) > 0;) {
+    response.append(chunk, n);
+  }
+  close(fd);
+  registry.stop_export();
+
+  EXPECT_EQ(response.rfind("HTTP/1.1 200 OK", 0), 0u);
+  EXPECT_NE(response.find("test_served_total 1\n"), std::string::npos);
+}
@@ -0,0 +1,145 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <gstDeleter.hh>
+#include <gstppPlugin.hh>
+#include <metrics.hh>
+#include <motionDetect.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <random>
+#include <vector>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class MotionDetectTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(MotionDetectTest, VectorSadMatchesScalar) {
+  using vptyp::color::Isa;
+  std::mt19937 random(7);
+  // odd width leaves a scalar tail and a partial block
+  constexpr int kWidth = 211, kHeight = 67, kStride = 224;
+  std::vector<uint8_t> a(kStride * kHeight), b(kStride * kHeight);
+  for (auto& byte : a) byte = uint8_t(random());
+  for (auto& byte : b) byte = uint8_t(random());
+
+  for (int block : {16, 32, 64}) {
+    size_t blocks = size_t((kWidth + block - 1) / block) *
+                    ((kHeight + block - 1) / block);
+    std::vector<uint32_t> expected(blocks, 0);
+    vptyp::MotionAnalyzer::block_sad(a.data(), kStride, b.data(), kStride,
+                                     kWidth, kHeight, block, expected.data(),
+                                     Isa::Scalar);
+    for (auto isa : {Isa::SSE41, Isa::AVX2}) {
+      if (isa > vptyp::color::detect_isa()) continue;
+      std::vector<uint32_t> actual(blocks, 0);
+      vptyp::MotionAnalyzer::block_sad(a.data(), kStride, b.data(), kStride,
+                                       kWidth, kHeight, block, actual.data(),
+                                       isa);
+      EXPECT_EQ(expected, actual)
+          << "block " << block << " " << vptyp::color::isa_name(isa);
+    }
+  }
+}
+
+TEST_F(MotionDetectTest, FindsMovingSquare) {
+  constexpr int kWidth = 128, kHeight = 64;
+  vptyp::MotionAnalyzer analyzer({.block = 16, .threshold = 12});
+  std::vector<uint8_t> frame(kWidth * kHeight, 40);
+
+  EXPECT_FALSE(analyzer.analyze(frame.data(), kWidth, kWidth, kHeight).motion);
+  auto still = analyzer.analyze(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_FALSE(still.motion);
+  EXPECT_EQ(still.active_blocks, 0u);
+
+  // bright 16x16 square aligned with block (2, 1)
+  for (int y = 16; y < 32; ++y) {
+    std::fill_n(frame.begin() + y * kWidth + 32, 16, 200);
+  }
+  auto moved = analyzer.analyze(frame.data(), kWidth, kWidth, kHeight);
+  EXPECT_TRUE(moved.motion);
+  EXPECT_EQ(moved.cols, 8);
+  EXPECT_EQ(moved.rows, 4);
+  EXPECT_EQ(moved.active_blocks, 1u);
+  EXPECT_EQ(moved.map[1 * 8 + 2], 1);
+  EXPECT_NEAR(moved.score, 160.0 * 256 / (kWidth * kHeight), 1e-9);
+}
+
+TEST_F(MotionDetectTest, ElementReportsMotion) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "motion");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=30 pattern=ball ! "
+      "video/x-raw,format=I420,width=320,height=240 ! "
+      "gstppmotion name=motion hold=0 threshold=4 min-area=0 ! "
+      "fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  std::vector<vptyp::MotionEvent> events;
+  pipeline.on_motion(
+      [&events](const vptyp::MotionEvent& event) { events.push_back(event); });
+  std::atomic<int> withMeta{0};
+  auto pad = vptyp::make_gst(
+      gst_element_get_static_pad(pipeline.find("sink")->raw(), "sink"));
+  gst_pad_add_probe(
+      pad.get(), GST_PAD_PROBE_TYPE_BUFFER,
+      +[](GstPad*, GstPadProbeInfo* info, gpointer data) {
+        auto buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+        auto meta = vptyp::gstpp_buffer_get_motion_meta(buffer);
+        if (meta && meta->cols == 20 && meta->rows == 15) {
+          ++*static_cast<std::atomic<int>*>(data);
+        }
+        return GST_PAD_PROBE_OK;
+      },
+      &withMeta, nullptr);
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(10)));
+  EXPECT_EQ(withMeta, 30);
+  ASSERT_FALSE(events.empty());
+  EXPECT_TRUE(events.front().motion);
+  EXPECT_TRUE(events.front().changed);
+  EXPECT_EQ(events.front().element, "motion");
+  EXPECT_GT(events.front().active_blocks, 0u);
+  EXPECT_EQ(events.front().blocks, 300u);
+}
+
+TEST_F(MotionDetectTest, DropsStaticFrames) {
+  ASSERT_TRUE(vptyp::register_elements());
+  vptyp::Pipeline pipeline(*loop, "static-scene");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=20 pattern=black ! "
+      "video/x-raw,format=NV12,width=320,height=240 ! "
+      "gstppmotion drop-static=true ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.enable_metrics();
+
+  size_t events{0};
+  pipeline.on_motion([&events](const vptyp::MotionEvent&) { ++events; });
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(10)));
+  EXPECT_EQ(events, 0u);
+  EXPECT_EQ(vptyp::MetricsRegistry::instance()
+                .counter("gstpp_pipeline_frames_total", "",
+                         {{"pipeline", "static-scene"}})
+                .value(),
+            0u);
+}
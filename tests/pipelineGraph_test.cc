@@ -0,0 +1,250 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <gstDeleter.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class PipelineGraphTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  bool run_to_eos(vptyp::Pipeline& pipeline) {
+    return vptyp::test::run_pipeline(pipeline, loop,
+                                     std::chrono::seconds(5)) &&
+           pipeline.status().eos;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(PipelineGraphTest, ParsesChain) {
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=5 name=src ! "
+      "video/x-raw,width=64,height=48 ! fakesink");
+  ASSERT_TRUE(graph);
+
+  ASSERT_EQ(graph->nodes().size(), 3u);
+  EXPECT_EQ(graph->nodes()[0].alias, "src");
+  EXPECT_EQ(graph->nodes()[1].factory, "capsfilter");
+  EXPECT_EQ(graph->links().size(), 2u);
+}
+
+TEST_F(PipelineGraphTest, RejectsMalformedDescriptions) {
+  EXPECT_FALSE(vptyp::PipelineGraph::parse("videotestsrc !"));
+  EXPECT_FALSE(vptyp::PipelineGraph::parse("! fakesink"));
+  EXPECT_FALSE(vptyp::PipelineGraph::parse("videotestsrc ! missing."));
+  EXPECT_FALSE(vptyp::PipelineGraph::parse("filesrc location=\"a b"));
+}
+
+TEST_F(PipelineGraphTest, ParsesJson) {
+  auto graph = vptyp::PipelineGraph::parse(R"(
+    {"nodes": [{"factory": "videotestsrc", "name": "src",
+                "properties": {"num-buffers": 5, "is-live": false}},
+               {"factory": "fakesink", "name": "sink"}],
+     "links": [{"from": "src", "to": "sink", "caps": "video/x-raw"}]})");
+  ASSERT_TRUE(graph);
+  ASSERT_EQ(graph->nodes().size(), 2u);
+  EXPECT_EQ(graph->nodes()[0].alias, "src");
+  EXPECT_EQ(graph->nodes()[0].properties,
+            (std::vector<std::pair<std::string, std::string>>{
+                {"num-buffers", "5"}, {"is-live", "false"}}));
+  ASSERT_EQ(graph->links().size(), 1u);
+  EXPECT_EQ(graph->links()[0].caps, "video/x-raw");
+
+  vptyp::Pipeline pipeline(*loop, "graph-json");
+  ASSERT_TRUE(graph->build(pipeline));
+  EXPECT_TRUE(run_to_eos(pipeline));
+}
+
+TEST_F(PipelineGraphTest, RejectsMalformedJson) {
+  using vptyp::PipelineGraph;
+  EXPECT_FALSE(PipelineGraph::parse(R"({"nodes": [})"));
+  EXPECT_FALSE(PipelineGraph::parse(R"({"nodes": []})"));
+  EXPECT_FALSE(PipelineGraph::parse(R"({"nodes": [{"name": "x"}]})"));
+  EXPECT_FALSE(PipelineGraph::parse(
+      R"({"nodes": [{"factory": "a", "name": "x"},
+                    {"factory": "b", "name": "x"}]})"));
+  EXPECT_FALSE(PipelineGraph::parse(
+      R"({"nodes": [{"factory": "a", "properties": {"p": [1]}}]})"));
+  EXPECT_FALSE(PipelineGraph::parse(
+      R"({"nodes": [{"factory": "a"}], "links": [{"from": "a0"}]})"));
+}
+
+TEST_F(PipelineGraphTest, ValidatesBeforeCreating) {
+  vptyp::Pipeline pipeline(*loop, "graph-test");
+
+  auto unknown = vptyp::PipelineGraph::parse("videotestsrc ! nonexistent");
+  ASSERT_TRUE(unknown);
+  EXPECT_FALSE(unknown->build(pipeline));
+
+  auto mismatch = vptyp::PipelineGraph::parse("videotestsrc ! audioconvert");
+  ASSERT_TRUE(mismatch);
+  EXPECT_FALSE(mismatch->validate());
+  EXPECT_EQ(pipeline.find("videotestsrc0"), nullptr);
+}
+
+TEST_F(PipelineGraphTest, BuildsTeeBranches) {
+  vptyp::Pipeline pipeline(*loop, "graph-test");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=10 ! tee name=t "
+      "t. ! queue ! fakesink name=first "
+      "t. ! queue ! fakesink name=second");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  EXPECT_EQ(graph->stats().elements, 6u);
+  EXPECT_EQ(graph->stats().links, 5u);
+  EXPECT_NE(pipeline.find("first"), nullptr);
+  EXPECT_TRUE(run_to_eos(pipeline));
+}
+
+TEST_F(PipelineGraphTest, FluentDynamicPads) {
+  vptyp::Pipeline pipeline(*loop, "graph-test");
+  vptyp::PipelineGraph graph;
+  graph.add("videotestsrc", "src")
+      .set("num-buffers", 10)
+      .then("decodebin", "decoder")
+      .queue()
+      .then("fakesink", "sink");
+
+  ASSERT_TRUE(graph.build(pipeline));
+  EXPECT_EQ(graph.stats().dynamic_links, 1u);
+  EXPECT_TRUE(run_to_eos(pipeline));
+}
+
+TEST_F(PipelineGraphTest, FiltersStaticLinksByCaps) {
+  vptyp::Pipeline pipeline(*loop, "graph-test");
+  vptyp::PipelineGraph graph;
+  graph.add("videotestsrc", "src").set("num-buffers", 5);
+  graph.add("fakesink", "sink").link("src", "sink", "video/x-raw,width=32");
+  ASSERT_TRUE(graph.build(pipeline));
+
+  int width{0};
+  auto pad = vptyp::make_gst(
+      gst_element_get_static_pad(pipeline.find("sink")->raw(), "sink"));
+  gst_pad_add_probe(
+      pad.get(), GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      +[](GstPad*, GstPadProbeInfo* info, gpointer data) {
+        GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+        if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS) return GST_PAD_PROBE_OK;
+        GstCaps* caps{nullptr};
+        gst_event_parse_caps(event, &caps);
+        gst_structure_get_int(gst_caps_get_structure(caps, 0), "width",
+                              static_cast<int*>(data));
+        return GST_PAD_PROBE_OK;
+      },
+      &width, nullptr);
+  EXPECT_TRUE(run_to_eos(pipeline));
+  EXPECT_EQ(width, 32);
+
+  vptyp::Pipeline refused(*loop, "graph-refused");
+  vptyp::PipelineGraph audio;
+  audio.add("videotestsrc", "src");
+  audio.add("fakesink", "sink").link("src", "sink", "audio/x-raw");
+  EXPECT_FALSE(audio.build(refused));
+}
+
+namespace {
+
+// raw video and optionally raw audio in a matroska file
+bool write_matroska(GMainLoop& loop, const std::string& path, bool audio,
+                    const std::function<bool(vptyp::Pipeline&)>& run) {
+  vptyp::Pipeline pipeline(loop, "matroska-writer");
+  vptyp::PipelineGraph graph;
+  graph.add("videotestsrc")
+      .set("num-buffers", 10)
+      .caps("video/x-raw,format=I420,width=64,height=48,framerate=10/1")
+      .then("matroskamux", "mux")
+      .then("filesink")
+      .set("location", path);
+  if (audio) {
+    graph.add("audiotestsrc")
+        .set("num-buffers", 10)
+        .set("samplesperbuffer", 800)
+        .then("capsfilter", "audio-caps")
+        .set("caps", "audio/x-raw,format=S16LE,rate=8000,channels=1")
+        .link("audio-caps", "mux");
+  }
+  return graph.build(pipeline) && run(pipeline);
+}
+
+void count_buffers(vptyp::Element& sink, std::atomic<int>& buffers) {
+  auto pad = vptyp::make_gst(gst_element_get_static_pad(sink.raw(), "sink"));
+  gst_pad_add_probe(
+      pad.get(), GST_PAD_PROBE_TYPE_BUFFER,
+      +[](GstPad*, GstPadProbeInfo*, gpointer data) {
+        ++*static_cast<std::atomic<int>*>(data);
+        return GST_PAD_PROBE_OK;
+      },
+      &buffers, nullptr);
+}
+
+// demuxer with a video and an audio chain, the audio one routed by caps
+vptyp::PipelineGraph demux_graph(const std::string& path) {
+  vptyp::PipelineGraph graph;
+  graph.add("filesrc")
+      .set("location", path)
+      .then("matroskademux", "demux")
+      .then("queue", "video-queue")
+      .then("videoconvert")
+      .then("fakesink", "video-sink")
+      .add("queue", "audio-queue")
+      .then("audioconvert")
+      .then("fakesink", "audio-sink")
+      .link("demux", "audio-queue", "audio/x-raw");
+  return graph;
+}
+
+}  // namespace
+
+TEST_F(PipelineGraphTest, RoutesDynamicPadsByCaps) {
+  auto path = std::filesystem::temp_directory_path() / "gstpp-routes.mkv";
+  auto run = [this](vptyp::Pipeline& p) { return run_to_eos(p); };
+  ASSERT_TRUE(write_matroska(*loop, path.string(), true, run));
+
+  vptyp::Pipeline pipeline(*loop, "route-by-caps");
+  auto graph = demux_graph(path.string());
+  ASSERT_TRUE(graph.build(pipeline));
+  EXPECT_EQ(graph.stats().dynamic_links, 2u);
+
+  std::atomic<int> video{0}, audio{0};
+  count_buffers(*pipeline.find("video-sink"), video);
+  count_buffers(*pipeline.find("audio-sink"), audio);
+  EXPECT_TRUE(run_to_eos(pipeline));
+  // whichever pad comes first, each lands in its own chain
+  EXPECT_EQ(video, 10);
+  EXPECT_GT(audio, 0);
+  std::filesystem::remove(path);
+}
+
+TEST_F(PipelineGraphTest, EndsRoutesThatGetNoPad) {
+  auto path = std::filesystem::temp_directory_path() / "gstpp-no-audio.mkv";
+  auto run = [this](vptyp::Pipeline& p) { return run_to_eos(p); };
+  ASSERT_TRUE(write_matroska(*loop, path.string(), false, run));
+
+  vptyp::Pipeline pipeline(*loop, "route-missing");
+  auto graph = demux_graph(path.string());
+  ASSERT_TRUE(graph.build(pipeline));
+
+  std::atomic<int> audio{0};
+  count_buffers(*pipeline.find("audio-sink"), audio);
+  // without an EOS on the audio chain its sink would never preroll
+  EXPECT_TRUE(run_to_eos(pipeline));
+  EXPECT_EQ(audio, 0);
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <element.hh>
+#include <format>
+#include <pipeline.hh>
+#include <pipelineManager.hh>
+
+#include "logger.hh"
+
+class PipelineManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+  }
+
+  static void build_finite(vptyp::Pipeline& pipeline) {
+    vptyp::Element src("videotestsrc", "src");
+    src.object_set("num-buffers", 10);
+    vptyp::Element sink("fakesink", "sink");
+    pipeline.add_element(src);
+    pipeline.add_element(sink);
+    EXPECT_TRUE(src.link(sink));
+  }
+};
+
+TEST_F(PipelineManagerTest, BalancesAcrossShards) {
+  vptyp::PipelineManager manager({.shards = 2, .pin_threads = false});
+  for (int i = 0; i < 4; ++i) {
+    manager.add(std::format("p{}", i), build_finite);
+  }
+
+  auto status = manager.status();
+  EXPECT_EQ(manager.size(), 4u);
+  EXPECT_EQ(status.per_shard, (std::vector<size_t>{2, 2}));
+}
+
+TEST_F(PipelineManagerTest, RunsAllToCompletion) {
+  vptyp::PipelineManager manager({.shards = 2, .pin_threads = false});
+  for (int i = 0; i < 6; ++i) {
+    manager.add(std::format("p{}", i), build_finite);
+  }
+
+  manager.play_all();
+  EXPECT_TRUE(manager.wait_finished(std::chrono::seconds(5)));
+
+  auto status = manager.status();
+  EXPECT_EQ(status.pipelines, 6u);
+  EXPECT_EQ(status.finished, 6u);
+  EXPECT_EQ(status.failed, 0u);
+}
+
+TEST_F(PipelineManagerTest, DestroysRightAfterConstruction) {
+  // workers may not run their loops yet, the quit must not be lost
+  for (int i = 0; i < 20; ++i) {
+    vptyp::PipelineManager manager({.shards = 4, .pin_threads = false});
+  }
+}
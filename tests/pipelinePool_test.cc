@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <element.hh>
+#include <pipeline.hh>
+#include <pipelinePool.hh>
+#include <thread>
+
+#include "logger.hh"
+
+class PipelinePoolTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  static bool wait_warm(vptyp::PipelinePool& pool, std::string_view name,
+                        size_t count) {
+    for (int i = 0; i < 200; ++i) {
+      if (pool.status(name).warm >= count) return true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(25));
+    }
+    return false;
+  }
+
+  static GstState state_of(vptyp::Pipeline& pipeline) {
+    GstState state{GST_STATE_VOID_PENDING};
+    gst_element_get_state(pipeline.raw(), &state, nullptr, 0);
+    return state;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(PipelinePoolTest, HandsOutPrerolledPipelines) {
+  vptyp::PipelinePool pool(*loop, {.per_template = 1});
+  ASSERT_TRUE(pool.add_template("test", "videotestsrc ! fakesink name=sink"));
+  EXPECT_FALSE(pool.add_template("test", "videotestsrc ! fakesink"));
+  ASSERT_TRUE(wait_warm(pool, "test", 1));
+
+  auto pipeline = pool.acquire("test");
+  ASSERT_TRUE(pipeline);
+  EXPECT_EQ(state_of(*pipeline), GST_STATE_PAUSED);
+  EXPECT_NE(pipeline->find("sink"), nullptr);
+  EXPECT_EQ(pool.status("test").hits, 1u);
+
+  // the acquired one is replaced in the background
+  EXPECT_TRUE(wait_warm(pool, "test", 1));
+  auto second = pool.acquire("test");
+  ASSERT_TRUE(second);
+  EXPECT_NE(second.get(), pipeline.get());
+  EXPECT_EQ(pool.status("test").misses, 0u);
+}
+
+TEST_F(PipelinePoolTest, DryTemplateBuildsOnRequest) {
+  vptyp::PipelinePool pool(*loop, {.per_template = 0});
+  ASSERT_TRUE(pool.add_template("dry", "videotestsrc ! fakesink"));
+  EXPECT_FALSE(pool.acquire("unknown"));
+
+  auto pipeline = pool.acquire("dry");
+  ASSERT_TRUE(pipeline);
+  EXPECT_EQ(state_of(*pipeline), GST_STATE_NULL);
+  EXPECT_EQ(pool.status("dry").misses, 1u);
+  EXPECT_EQ(pool.status("dry").warm, 0u);
+}
+
+TEST_F(PipelinePoolTest, BrokenTemplateIsNotWarmed) {
+  vptyp::PipelinePool pool(*loop, {.per_template = 1});
+  ASSERT_TRUE(pool.add_template(
+      "broken", [](vptyp::Pipeline&) { return false; }));
+  EXPECT_FALSE(wait_warm(pool, "broken", 1));
+  EXPECT_FALSE(pool.acquire("broken"));
+}
+
+TEST_F(PipelinePoolTest, ElementFactoriesAreCached) {
+  EXPECT_TRUE(vptyp::Element::prefetch("decodebin"));
+  EXPECT_FALSE(vptyp::Element::prefetch("gstpp-no-such-factory"));
+
+  vptyp::Element first("decodebin", "first");
+  vptyp::Element second("decodebin", "second");
+  ASSERT_TRUE(second.is_initialised());
+  EXPECT_NE(first.raw(), second.raw());
+  // the second one takes the pad type from the cache
+  EXPECT_EQ(first.pad_type(), vptyp::Element::PadTypes::Sometime);
+  EXPECT_EQ(second.pad_type(), vptyp::Element::PadTypes::Sometime);
+  EXPECT_EQ(std::string(GST_ELEMENT_NAME(second.raw())), "second");
+
+  vptyp::Element missing("gstpp-no-such-factory", "missing");
+  EXPECT_FALSE(missing.is_initialised());
+}
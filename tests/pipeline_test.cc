@@ -1,9 +1,15 @@
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
+#include <cstdio>
 #include <element.hh>
+#include <format>
 #include <pipeline.hh>
+#include <pipelineGraph.hh>
 
 #include "logger.hh"
+#include "test_utils.hh"
 
 class PipelineTest : public ::testing::Test {
  protected:
@@ -43,6 +49,18 @@ TEST_F(PipelineTest, AddElementByReference) {
   pipeline.add_element(element);
 }
 
+TEST_F(PipelineTest, RemovesRoutedElement) {
+  vptyp::Pipeline pipeline(*loop, "test-pipeline");
+
+  auto& decode = pipeline.add_element(vptyp::Element("decodebin", "decode"));
+  auto& sink = pipeline.add_element(vptyp::Element("fakesink", "sink"));
+  EXPECT_TRUE(decode.route(sink, "video/x-raw"));
+
+  // the router is disconnected before the bin drops the last reference
+  EXPECT_TRUE(pipeline.remove_element("decode"));
+  EXPECT_FALSE(pipeline.remove_element("decode"));
+}
+
 TEST_F(PipelineTest, PipelinePlaybackControl) {
   vptyp::Pipeline pipeline(*loop, "test-pipeline");
 
@@ -56,4 +74,104 @@ TEST_F(PipelineTest, PipelinePlaybackControl) {
   pipeline.play();
   usleep(250000);
   pipeline.stop();
-}
\ No newline at end of file
+}
+
+TEST_F(PipelineTest, InsertsQueuesAtExpensiveBoundaries) {
+  vptyp::Pipeline pipeline(*loop, "test-pipeline");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=30 ! videoconvert name=convert ! "
+      "x264enc name=encoder ! queue ! h264parse name=parse ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  // encoder is already followed by a queue, the parser is no boundary
+  EXPECT_EQ(pipeline.insert_queues(
+                {.mode = vptyp::Pipeline::QueuePolicy::Mode::Latency}),
+            1u);
+  EXPECT_NE(pipeline.find("convert-queue"), nullptr);
+  EXPECT_EQ(pipeline.find("parse-queue"), nullptr);
+  EXPECT_EQ(pipeline.queue_levels().size(), 1u);
+  // second pass finds nothing left to split
+  EXPECT_EQ(pipeline.insert_queues({}), 0u);
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(10)));
+  EXPECT_TRUE(pipeline.status().eos);
+}
+
+TEST_F(PipelineTest, ReconfiguresWithoutRestart) {
+  vptyp::Pipeline pipeline(*loop, "test-pipeline");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc is-live=true ! videoscale ! "
+      "capsfilter name=size caps=video/x-raw,width=320,height=240 ! "
+      "x264enc name=encoder tune=zerolatency ! fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.play();
+  usleep(250000);
+
+  EXPECT_TRUE(pipeline.set_bitrate("encoder", 800'000));
+  EXPECT_EQ(pipeline.find("encoder")->object_get<guint>("bitrate"), 800u);
+  EXPECT_FALSE(pipeline.set_bitrate("sink", 800'000));
+
+  EXPECT_FALSE(pipeline.set_caps("size", "audio/x-raw"));
+  EXPECT_FALSE(pipeline.set_caps("encoder", "video/x-raw"));
+  ASSERT_TRUE(pipeline.set_caps("size", "video/x-raw,width=160,height=120"));
+
+  // the encoder's input follows with the next buffers
+  GstPad* pad = gst_element_get_static_pad(pipeline.find("encoder")->raw(),
+                                           "sink");
+  int width{0};
+  for (int i = 0; i < 40 && width != 160; ++i) {
+    usleep(50000);
+    if (GstCaps* caps = gst_pad_get_current_caps(pad)) {
+      gst_structure_get_int(gst_caps_get_structure(caps, 0), "width", &width);
+      gst_caps_unref(caps);
+    }
+  }
+  gst_object_unref(pad);
+  EXPECT_EQ(width, 160);
+  EXPECT_FALSE(pipeline.status().error);
+  pipeline.stop();
+}
+
+TEST_F(PipelineTest, DrainsToFinishedFileAndRestarts) {
+  std::string path = std::format("{}/gstpp-drain-{}.mp4", g_get_tmp_dir(),
+                                 getpid());
+  vptyp::Pipeline pipeline(*loop, "test-pipeline");
+  auto graph = vptyp::PipelineGraph::parse(std::format(
+      "videotestsrc is-live=true ! x264enc tune=zerolatency ! mp4mux ! "
+      "filesink location={}",
+      path));
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  EXPECT_FALSE(pipeline.drain(std::chrono::seconds(1)));
+
+  auto run = [this](vptyp::Pipeline& pipeline) {
+    auto drain = [&pipeline]() {
+      usleep(500000);
+      EXPECT_TRUE(pipeline.drain(std::chrono::seconds(5)));
+    };
+    auto thread = vptyp::test::run_loop(loop, std::chrono::seconds(10), drain);
+    EXPECT_TRUE(thread.has_value());
+    EXPECT_TRUE(pipeline.status().eos);
+  };
+  pipeline.play();
+  run(pipeline);
+  // only a finished mp4 has its moov
+  std::string contents;
+  {
+    gchar* data{nullptr};
+    gsize size{0};
+    ASSERT_TRUE(g_file_get_contents(path.c_str(), &data, &size, nullptr));
+    contents.assign(data, size);
+    g_free(data);
+  }
+  EXPECT_NE(contents.find("moov"), std::string::npos);
+
+  ASSERT_TRUE(pipeline.restart());
+  EXPECT_FALSE(pipeline.status().eos);
+  run(pipeline);
+  pipeline.stop();
+  std::remove(path.c_str());
+}
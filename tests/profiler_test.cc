@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <histogram.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <thread>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class ProfilerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(ProfilerTest, HistogramPercentiles) {
+  vptyp::Histogram histogram;
+  for (uint64_t i = 1; i <= 1000; ++i) histogram.record(i);
+
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(snapshot.count, 1000u);
+  EXPECT_EQ(snapshot.min, 1u);
+  EXPECT_EQ(snapshot.max, 1000u);
+  EXPECT_DOUBLE_EQ(snapshot.mean(), 500.5);
+  // bucket upper bounds, at most 2x off
+  EXPECT_GE(snapshot.percentile(0.5), 500u);
+  EXPECT_LE(snapshot.percentile(0.5), 1000u);
+  EXPECT_EQ(snapshot.percentile(1.0), 1000u);
+}
+
+TEST_F(ProfilerTest, CountsBuffersPerElement) {
+  vptyp::Pipeline pipeline(*loop, "profiled");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=20 ! videoconvert name=convert ! queue ! "
+      "fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.enable_profiling({.interval = std::chrono::milliseconds(0)});
+  ASSERT_NE(pipeline.get_profiler(), nullptr);
+
+  EXPECT_TRUE(
+      vptyp::test::run_pipeline(pipeline, loop, std::chrono::seconds(5)));
+
+  auto json = pipeline.get_profiler()->to_json();
+  EXPECT_NE(json.find(R"("name":"convert","buffers":20)"), std::string::npos)
+      << json;
+  EXPECT_NE(json.find(R"("name":"sink","buffers":20)"), std::string::npos)
+      << json;
+}
+
+TEST_F(ProfilerTest, ReplacedWhilePlaying) {
+  vptyp::Pipeline pipeline(*loop, "reprofiled");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc is-live=true num-buffers=30 ! "
+      "video/x-raw,framerate=30/1 ! videoconvert name=convert ! "
+      "fakesink name=sink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+  pipeline.enable_profiling({.interval = std::chrono::milliseconds(0)});
+
+  pipeline.play();
+  // the first profiler's probes go with it, buffers keep flowing
+  auto replace = [&pipeline]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    pipeline.enable_profiling({.interval = std::chrono::milliseconds(0)});
+  };
+  auto thread = vptyp::test::run_loop(loop, std::chrono::seconds(5), replace);
+  EXPECT_TRUE(thread.has_value());
+  pipeline.stop();
+
+  auto json = pipeline.get_profiler()->to_json();
+  EXPECT_NE(json.find(R"("name":"sink")"), std::string::npos) << json;
+  EXPECT_EQ(json.find(R"("name":"sink","buffers":30)"), std::string::npos)
+      << json;
+}
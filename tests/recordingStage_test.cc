@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <gstppPlugin.hh>
+#include <metrics.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <recordingStage.hh>
+#include <sstream>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class RecordingStageTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+    directory = std::filesystem::temp_directory_path() /
+                std::format("gstpp-recording-{}", getpid());
+    std::filesystem::create_directories(directory);
+  }
+  void TearDown() override {
+    std::filesystem::remove_all(directory);
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  // records 5s of 30fps test video through the stage until EOS
+  bool record(vptyp::RecordingStage& stage) {
+    vptyp::Pipeline pipeline(*loop, "recording");
+    vptyp::PipelineGraph graph;
+    graph.add("videotestsrc", "src")
+        .set("num-buffers", 150)
+        .caps("video/x-raw,width=320,height=240,framerate=30/1")
+        .then("x264enc", "encoder")
+        .set("key-int-max", 30)
+        .then("h264parse", "parser");
+    stage.add_to(graph);
+    if (!graph.build(pipeline)) return false;
+    stage.attach(pipeline);
+
+    return vptyp::test::run_pipeline(pipeline, loop) &&
+           pipeline.status().eos;
+  }
+
+  static std::string read(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+  std::filesystem::path directory;
+};
+
+TEST_F(RecordingStageTest, ParsesNamesAndPatterns) {
+  using Stage = vptyp::RecordingStage;
+  EXPECT_EQ(Stage::parse_mode("segmented"), Stage::Mode::Segmented);
+  EXPECT_FALSE(Stage::parse_mode("rotating"));
+  EXPECT_EQ(Stage::parse_sync("write"), Stage::Sync::Write);
+  EXPECT_FALSE(Stage::parse_sync("always"));
+  EXPECT_EQ(Stage::segment_pattern("/data/capture.mp4"),
+            "/data/capture-%05d.mp4");
+  EXPECT_EQ(Stage::segment_pattern("capture"), "capture-%05d.mp4");
+}
+
+TEST_F(RecordingStageTest, FragmentedFileHasFragments) {
+  auto path = directory / "fragmented.mp4";
+  vptyp::RecordingStage stage(
+      path.string(), {.mode = vptyp::RecordingStage::Mode::Fragmented,
+                      .fragment = std::chrono::milliseconds(500)});
+  ASSERT_TRUE(record(stage));
+  auto content = read(path);
+  EXPECT_NE(content.find("moof"), std::string::npos);
+}
+
+TEST_F(RecordingStageTest, SegmentsRotateAndAreIndexed) {
+  auto index = directory / "index.tsv";
+  vptyp::RecordingStage stage(
+      (directory / "segment.mp4").string(),
+      {.mode = vptyp::RecordingStage::Mode::Segmented,
+       .segment_time = std::chrono::seconds(1),
+       .sync = vptyp::RecordingStage::Sync::Segment,
+       .index = index.string()});
+  ASSERT_TRUE(record(stage));
+  EXPECT_GE(stage.segments(), 4u);
+
+  std::ifstream in(index);
+  std::string line;
+  size_t lines{0};
+  while (std::getline(in, line)) {
+    ++lines;
+    auto location = line.substr(0, line.find('\t'));
+    // every indexed segment is a complete mp4 on its own
+    EXPECT_NE(read(location).find("moov"), std::string::npos) << location;
+  }
+  EXPECT_EQ(lines, stage.segments());
+}
+
+TEST_F(RecordingStageTest, AsyncSinkWritesCompleteFile) {
+  ASSERT_TRUE(vptyp::register_elements());
+  auto path = directory / "async.mp4";
+  vptyp::RecordingStage stage(path.string(),
+                              {.sink = "gstppasyncfilesink"});
+  ASSERT_TRUE(record(stage));
+  auto content = read(path);
+  auto mdat = content.find("mdat");
+  auto moov = content.find("moov");
+  ASSERT_NE(mdat, std::string::npos);
+  ASSERT_NE(moov, std::string::npos);
+  // mp4mux seeks back to patch the mdat size once it is known, so the
+  // patched box has to end right where the moov starts
+  auto number = [&content](size_t at, size_t bytes) {
+    uint64_t value{0};
+    for (size_t i = 0; i < bytes; ++i) {
+      value = value << 8 | uint8_t(content[at + i]);
+    }
+    return value;
+  };
+  uint64_t size = number(mdat - 4, 4);
+  if (size == 1) size = number(mdat + 4, 8);  // 64 bit size
+  EXPECT_EQ(mdat - 4 + size, moov - 4);
+
+  auto latency = vptyp::MetricsRegistry::instance()
+                     .histogram("gstpp_file_write_latency_us",
+                                "batch write latency of gstppasyncfilesink",
+                                {{"element", "file-sink"}})
+                     .snapshot();
+  EXPECT_GT(latency.count, 0u);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <format>
+#include <metrics.hh>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <pipelineManager.hh>
+#include <segmentedTranscoder.hh>
+
+#include "logger.hh"
+
+class SegmentedTranscoderTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    auto tmp = std::filesystem::temp_directory_path();
+    input = (tmp / "gstpp-segment-input.mp4").string();
+    output = (tmp / "gstpp-segment-output.mp4").string();
+  }
+  void TearDown() override {
+    std::filesystem::remove(input);
+    std::filesystem::remove(output);
+  }
+
+  // runs a gst-launch like description to EOS
+  static bool run(std::string_view name, std::string_view description,
+                  bool metered = false) {
+    vptyp::PipelineManager manager({.shards = 1, .pin_threads = false});
+    bool built{false};
+    manager.add(name, [&](vptyp::Pipeline& pipeline) {
+      auto graph = vptyp::PipelineGraph::parse(description);
+      built = graph && graph->build(pipeline);
+      if (built && metered) pipeline.enable_metrics();
+    });
+    if (!built) return false;
+    manager.play_all();
+    return manager.wait_finished(std::chrono::seconds(30)) &&
+           manager.status().failed == 0;
+  }
+
+ public:
+  std::string input;
+  std::string output;
+};
+
+TEST_F(SegmentedTranscoderTest, JoinsSegmentsWithoutLosingFrames) {
+  // 5s at 30fps with a keyframe every half second
+  ASSERT_TRUE(run("segment-source",
+                  std::format("videotestsrc num-buffers=150 ! "
+                              "video/x-raw,width=320,height=240,framerate=30/1 "
+                              "! x264enc key-int-max=15 ! mp4mux ! "
+                              "filesink location={}",
+                              input)));
+
+  vptyp::SegmentedTranscoder transcoder(input, output, {.segments = 4});
+  auto result = transcoder.run();
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(result.boundaries.size(), 4u);
+  EXPECT_TRUE(std::is_sorted(result.boundaries.begin(),
+                             result.boundaries.end()));
+  for (size_t i = 0; i < 4; ++i) {
+    auto segment = std::filesystem::path(output).parent_path() /
+                   std::format("gstpp-segment-output.segment-{}.mp4", i);
+    EXPECT_FALSE(std::filesystem::exists(segment));
+  }
+
+  ASSERT_TRUE(run("segment-output",
+                  std::format("filesrc location={} ! qtdemux ! h264parse ! "
+                              "fakesink",
+                              output),
+                  true));
+  auto frames = vptyp::MetricsRegistry::instance()
+                    .counter("gstpp_pipeline_frames_total", "",
+                             {{"pipeline", "segment-output"}})
+                    .value();
+  EXPECT_EQ(frames, 150u);
+}
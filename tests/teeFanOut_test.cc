@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <gstDeleter.hh>
+#include <iterator>
+#include <pipeline.hh>
+#include <pipelineGraph.hh>
+#include <teeFanOut.hh>
+
+#include "logger.hh"
+#include "test_utils.hh"
+
+class TeeFanOutTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    loggerSetup(nullptr);
+    gst_init(nullptr, nullptr);
+    loop = g_main_loop_new(nullptr, false);
+  }
+  void TearDown() override {
+    g_main_loop_unref(loop);
+    loop = nullptr;
+  }
+
+  static void count(vptyp::Element& element, std::atomic<int>& buffers) {
+    auto pad =
+        vptyp::make_gst(gst_element_get_static_pad(element.raw(), "sink"));
+    gst_pad_add_probe(
+        pad.get(), GST_PAD_PROBE_TYPE_BUFFER,
+        +[](GstPad*, GstPadProbeInfo*, gpointer data) {
+          ++*static_cast<std::atomic<int>*>(data);
+          return GST_PAD_PROBE_OK;
+        },
+        &buffers, nullptr);
+  }
+
+  // runs the action on the loop after the delay
+  static void after(guint ms, std::function<void()> action) {
+    g_timeout_add_full(
+        G_PRIORITY_DEFAULT, ms,
+        +[](gpointer data) {
+          (*static_cast<std::function<void()>*>(data))();
+          return G_SOURCE_REMOVE;
+        },
+        new std::function<void()>(std::move(action)),
+        +[](gpointer data) {
+          delete static_cast<std::function<void()>*>(data);
+        });
+  }
+
+ public:
+  GMainLoop* loop{nullptr};
+};
+
+TEST_F(TeeFanOutTest, RejectsDuplicateBranch) {
+  vptyp::Pipeline pipeline(*loop, "fan-out-duplicate");
+  auto graph = vptyp::PipelineGraph::parse("videotestsrc ! tee name=split");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  vptyp::TeeFanOut fanout(pipeline, *loop, "split");
+  auto branch = vptyp::PipelineGraph::parse("queue ! fakesink");
+  ASSERT_TRUE(branch);
+  EXPECT_TRUE(fanout.add("a", *branch));
+  EXPECT_FALSE(fanout.add("a", *branch));
+  EXPECT_TRUE(fanout.add("b", *branch));
+  EXPECT_NE(pipeline.find("b-queue0"), nullptr);
+  EXPECT_EQ(fanout.names(), (std::vector<std::string>{"a", "b"}));
+}
+
+TEST_F(TeeFanOutTest, HotAddsAndRemovesBranches) {
+  vptyp::Pipeline pipeline(*loop, "fan-out-hot");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=60 is-live=true ! "
+      "video/x-raw,width=160,height=120,framerate=30/1 ! "
+      "tee name=split allow-not-linked=true "
+      "split. ! queue ! fakesink name=main");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  vptyp::TeeFanOut fanout(pipeline, *loop, "split");
+  std::atomic<int> main{0}, extra{0};
+  count(*pipeline.find("main"), main);
+  after(300, [&]() {
+    ASSERT_TRUE(fanout.add(
+        "extra", *vptyp::PipelineGraph::parse("queue ! fakesink name=sink")));
+    count(*pipeline.find("extra-sink"), extra);
+  });
+  after(1200, [&]() { EXPECT_TRUE(fanout.remove("extra")); });
+  EXPECT_TRUE(vptyp::test::run_pipeline(pipeline, loop));
+
+  // the remaining branch never noticed
+  EXPECT_EQ(main, 60);
+  EXPECT_GT(extra, 0);
+  EXPECT_LT(extra, 60);
+  EXPECT_FALSE(fanout.contains("extra"));
+  EXPECT_EQ(pipeline.find("extra-sink"), nullptr);
+}
+
+TEST_F(TeeFanOutTest, FinishesRecordingOnRemoval) {
+  if (!gst_element_factory_find("x264enc")) GTEST_SKIP() << "no x264enc";
+  auto path = std::filesystem::temp_directory_path() / "gstpp-fan-out.mp4";
+  std::filesystem::remove(path);
+
+  vptyp::Pipeline pipeline(*loop, "fan-out-record");
+  auto graph = vptyp::PipelineGraph::parse(
+      "videotestsrc num-buffers=45 is-live=true ! "
+      "video/x-raw,format=I420,width=160,height=120,framerate=30/1 ! "
+      "tee name=split allow-not-linked=true "
+      "split. ! queue ! fakesink");
+  ASSERT_TRUE(graph);
+  ASSERT_TRUE(graph->build(pipeline));
+
+  vptyp::TeeFanOut fanout(pipeline, *loop, "split");
+  auto record = vptyp::PipelineGraph::parse(
+      "queue ! x264enc tune=zerolatency ! h264parse ! mp4mux ! "
+      "filesink location=" +
+      path.string());
+  ASSERT_TRUE(record);
+  ASSERT_TRUE(fanout.add("record", *record, true));
+  after(700, [&]() { EXPECT_TRUE(fanout.remove("record")); });
+  EXPECT_TRUE(vptyp::test::run_pipeline(pipeline, loop));
+
+  EXPECT_FALSE(fanout.contains("record"));
+  // the muxer only writes its index when it sees EOS
+  std::ifstream file(path, std::ios::binary);
+  std::string content((std::istreambuf_iterator<char>(file)),
+                      std::istreambuf_iterator<char>());
+  EXPECT_NE(content.find("moov"), std::string::npos);
+  std::filesystem::remove(path);
+}
@@ -1,18 +1,47 @@
+#pragma once
 #include <gtest/gtest.h>
+#include <unistd.h>
 
+#include <chrono>
 #include <element.hh>
+#include <functional>
+#include <future>
+#include <optional>
 #include <pipeline.hh>
 #include <string>
+#include <thread>
 
 namespace vptyp {
 namespace test {
 
-// Helper function to create a test pipeline with setup
-inline std::pair<GMainLoop*, vptyp::Pipeline> create_test_pipeline(
-    const std::string& name = "test-pipeline") {
-  GMainLoop* loop = g_main_loop_new(NULL, FALSE);
-  vptyp::Pipeline pipeline(*loop, name);
-  return {loop, std::move(pipeline)};
+// Runs the loop on another thread until something quits it, e.g. the
+// pipeline on EOS, while meanwhile runs on the calling thread. Returns the id
+// of the loop thread, nullopt if the loop had to be quit after the timeout
+inline std::optional<std::thread::id> run_loop(
+    GMainLoop* loop,
+    std::chrono::milliseconds timeout = std::chrono::seconds(20),
+    const std::function<void()>& meanwhile = {}) {
+  auto waiter = std::async(std::launch::async, [loop]() {
+    g_main_loop_run(loop);
+    return std::this_thread::get_id();
+  });
+  if (meanwhile) meanwhile();
+  if (waiter.wait_for(timeout) == std::future_status::timeout) {
+    g_main_loop_quit(loop);
+    waiter.wait();
+    return std::nullopt;
+  }
+  return waiter.get();
+}
+
+// plays the pipeline until the loop is quit and stops it; false on timeout
+inline bool run_pipeline(
+    vptyp::Pipeline& pipeline, GMainLoop* loop,
+    std::chrono::milliseconds timeout = std::chrono::seconds(20)) {
+  pipeline.play();
+  bool finished = run_loop(loop, timeout).has_value();
+  pipeline.stop();
+  return finished;
 }
 
 // Helper function to create a simple video pipeline